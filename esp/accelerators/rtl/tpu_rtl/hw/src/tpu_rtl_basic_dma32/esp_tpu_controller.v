@@ -0,0 +1,236 @@
+`timescale 1ns/1ps
+
+// APB master for the cfg block of tpu_top. On start it programs the cfg
+// registers from the ESP configuration registers, sets start_tpu, polls
+// done_tpu and clears start_tpu again. done pulses once the output pipeline
+// has written the last column of C back to BRAM A.
+//
+// activation_reg: 0 = none, 1 = ReLU, 2 = TanH
+// pooling_reg:    pooling window, 1 (no pooling), 2 or 4
+// norm_reg:       bit 0 enable, bits 15:8 mean, bits 23:16 inverse variance
+//
+// Operands are read from addr_a and addr_b with a stride of one word, and
+// column j of C is written to addr_c + j.
+//
+// pe_clear is sampled with start. When set, the write that sets start_tpu
+// also pulses pe_reset, which clears the PE accumulators before the matmul.
+// Otherwise the product is added to what the PEs hold from the last tile.
+module esp_tpu_controller
+#(
+parameter REG_ADDRWIDTH = 8,
+parameter REG_DATAWIDTH = 32,
+parameter AWIDTH = 10,
+parameter DESIGN_SIZE = 16
+)
+(
+  input wire clk,
+  input wire rst_n,
+  input wire start,
+  input wire pe_clear,
+  output wire done,
+  input wire [31:0] activation_reg,
+  input wire [31:0] pooling_reg,
+  input wire [31:0] norm_reg,
+  input wire [AWIDTH-1:0] addr_a,
+  input wire [AWIDTH-1:0] addr_b,
+  input wire [AWIDTH-1:0] addr_c,
+
+  output wire [REG_ADDRWIDTH-1:0] PADDR,
+  output wire PWRITE,
+  output wire PSEL,
+  output wire PENABLE,
+  output wire [REG_DATAWIDTH-1:0] PWDATA,
+  input wire [REG_DATAWIDTH-1:0] PRDATA,
+  input wire PREADY
+);
+
+  // Register map of the cfg block (see tpu_top.v)
+  localparam REG_ENABLES_ADDR         = 8'h00;
+  localparam REG_STDN_TPU_ADDR        = 8'h04;
+  localparam REG_MEAN_ADDR            = 8'h08;
+  localparam REG_INV_VAR_ADDR         = 8'h0A;
+  localparam REG_MATRIX_A_ADDR        = 8'h0E;
+  localparam REG_MATRIX_B_ADDR        = 8'h12;
+  localparam REG_MATRIX_C_ADDR        = 8'h16;
+  localparam REG_MATRIX_A_STRIDE_ADDR = 8'h28;
+  localparam REG_MATRIX_B_STRIDE_ADDR = 8'h32;
+  localparam REG_MATRIX_C_STRIDE_ADDR = 8'h36;
+  localparam REG_ACTIVATION_CSR_ADDR  = 8'h3A;
+  localparam REG_POOL_WINDOW_ADDR     = 8'h3E;
+
+  // Writes issued before start_tpu, the last one sets it
+  localparam NUM_WRITES = 12;
+
+  // done_tpu only waits for the enabled blocks, the flop stage in front of
+  // BRAM A can still hold the last column for a few cycles
+  localparam DRAIN_CYCLES = DESIGN_SIZE;
+
+  localparam idle = 0;
+  localparam wr_setup = 1;
+  localparam wr_access = 2;
+  localparam rd_setup = 3;
+  localparam rd_access = 4;
+  localparam rd_data = 5;
+  localparam drain = 6;
+
+  reg [2:0] state_reg;
+  reg [3:0] step;
+  reg clearing;
+  reg pe_clear_reg;
+  reg [7:0] drain_cnt;
+  reg done_int;
+
+  reg [REG_ADDRWIDTH-1:0] wr_addr;
+  reg [REG_DATAWIDTH-1:0] wr_data;
+
+  wire enable_norm;
+  wire enable_pool;
+  wire enable_activation;
+  wire activation_type;
+
+  assign enable_norm = norm_reg[0];
+  assign enable_pool = (pooling_reg > 1);
+  assign enable_activation = (activation_reg != 0);
+  assign activation_type = (activation_reg == 2);
+
+  always @(*) begin
+    wr_addr = REG_STDN_TPU_ADDR;
+    wr_data = 0;
+    if (clearing == 1'b0) begin
+      case (step)
+        0: begin
+          wr_addr = REG_ENABLES_ADDR;
+          wr_data = {28'b0, enable_activation, enable_pool, enable_norm, 1'b1};
+        end
+        1: begin
+          wr_addr = REG_MEAN_ADDR;
+          wr_data = norm_reg[15:8];
+        end
+        2: begin
+          wr_addr = REG_INV_VAR_ADDR;
+          wr_data = norm_reg[23:16];
+        end
+        3: begin
+          wr_addr = REG_ACTIVATION_CSR_ADDR;
+          wr_data = activation_type;
+        end
+        4: begin
+          wr_addr = REG_POOL_WINDOW_ADDR;
+          wr_data = pooling_reg[2:0];
+        end
+        5: begin
+          wr_addr = REG_MATRIX_A_ADDR;
+          wr_data = addr_a;
+        end
+        6: begin
+          wr_addr = REG_MATRIX_B_ADDR;
+          wr_data = addr_b;
+        end
+        7: begin
+          // output_logic starts from the last column and walks down
+          wr_addr = REG_MATRIX_C_ADDR;
+          wr_data = addr_c + DESIGN_SIZE - 1;
+        end
+        8: begin
+          wr_addr = REG_MATRIX_A_STRIDE_ADDR;
+          wr_data = 1;
+        end
+        9: begin
+          wr_addr = REG_MATRIX_B_STRIDE_ADDR;
+          wr_data = 1;
+        end
+        10: begin
+          wr_addr = REG_MATRIX_C_STRIDE_ADDR;
+          wr_data = 1;
+        end
+        default: begin
+          // bit 15 is pe_reset
+          wr_addr = REG_STDN_TPU_ADDR;
+          wr_data = {16'b0, pe_clear_reg, 14'b0, 1'b1};
+        end
+      endcase
+    end
+  end
+
+  always @(posedge clk) begin
+    if (rst_n == 1'b0) begin
+      state_reg <= idle;
+      step <= 0;
+      clearing <= 1'b0;
+      pe_clear_reg <= 1'b0;
+      drain_cnt <= 0;
+      done_int <= 1'b0;
+    end
+    else begin
+      done_int <= 1'b0;
+      case (state_reg)
+        idle: begin
+          step <= 0;
+          clearing <= 1'b0;
+          if (start == 1'b1) begin
+            pe_clear_reg <= pe_clear;
+            state_reg <= wr_setup;
+          end
+        end
+
+        wr_setup: begin
+          state_reg <= wr_access;
+        end
+
+        wr_access: begin
+          if (clearing == 1'b1) begin
+            drain_cnt <= 0;
+            state_reg <= drain;
+          end
+          else if (step == NUM_WRITES - 1) begin
+            state_reg <= rd_setup;
+          end
+          else begin
+            step <= step + 1;
+            state_reg <= wr_setup;
+          end
+        end
+
+        rd_setup: begin
+          state_reg <= rd_access;
+        end
+
+        rd_access: begin
+          state_reg <= rd_data;
+        end
+
+        // PRDATA is valid the cycle after the access phase
+        rd_data: begin
+          if (PRDATA[31] == 1'b1) begin
+            clearing <= 1'b1;
+            state_reg <= wr_setup;
+          end
+          else begin
+            state_reg <= rd_setup;
+          end
+        end
+
+        drain: begin
+          drain_cnt <= drain_cnt + 1;
+          if (drain_cnt == DRAIN_CYCLES - 1) begin
+            done_int <= 1'b1;
+            state_reg <= idle;
+          end
+        end
+
+        default: begin
+          state_reg <= idle;
+        end
+      endcase
+    end
+  end
+
+  assign PSEL = (state_reg == wr_setup) || (state_reg == wr_access) ||
+                (state_reg == rd_setup) || (state_reg == rd_access);
+  assign PENABLE = (state_reg == wr_access) || (state_reg == rd_access);
+  assign PWRITE = (state_reg == wr_setup) || (state_reg == wr_access);
+  assign PADDR = PWRITE ? wr_addr : REG_STDN_TPU_ADDR;
+  assign PWDATA = wr_data;
+  assign done = done_int;
+
+endmodule
@@ -0,0 +1,499 @@
+`timescale 1ns/1ps
+
+// Datapath shared by the tpu_rtl_basic_dma32 and tpu_rtl_basic_dma64 wrappers.
+//
+// Every conf_done runs tiles_reg[11:0] tiles (0 counts as 1). For each tile
+// load_input_unit writes A and B into the BRAMs of tpu_top through their
+// external ports, esp_tpu_controller programs the cfg block and runs the
+// matmul, and store_output_unit reads C back from BRAM A. Tile t uses bank
+// t & 1 of every operand, so the three units work on up to three tiles at
+// once: tile t+1 loads and tile t-1 drains while tile t computes. The BRAM
+// map is
+//   BRAM A: A at A_BASE(bank), C at C_BASE(bank) (column j of C at C_BASE + j),
+//           resident weights at A_WS
+//   BRAM B: B at B_BASE(bank)
+// The external port of BRAM A is shared by load and store; load writes win
+// and the store unit waits a cycle.
+//
+// Tile t is read from data_in_reg * t bytes into the input buffer and written
+// to data_out_reg * t bytes into the output buffer.
+//
+// The PEs accumulate in place, so a C tile can be summed over several K tiles
+// run back to back. tiles_reg[21:12] is the number of K tiles per C tile
+// (0 and 1: every tile is a C tile of its own) and tiles_reg[31:22] the K
+// index of the first tile of the invocation, which lets a C tile span
+// invocations. The accumulators are cleared before every tile with K index 0;
+// only the C of the last K tile of a C tile holds the full sum.
+//
+// ws_reg selects the weight-stationary mode: bit 0 keeps A at A_WS for every
+// tile, so the input buffer only carries B, and bit 1 first loads a new A
+// (one column per word, like in the default mode) from the start of the
+// input buffer, in which case the B tiles follow it. A stays resident across
+// invocations until the next load.
+//
+// im2col_reg bit 0 builds B on chip instead (see im2col_unit.v) and implies
+// the weight-stationary mode. Bit 1 first loads the feature map, data_in_reg
+// bytes from the input buffer, after A if that is loaded too. Fields:
+//   im2col_reg:   7:4 kernel, 11:8 stride, 15:12 pad, 31:16 channels
+//   fm_size_reg:  15:0 height, 31:16 width of the feature map
+//   conv_out_reg: 15:0 height, 31:16 width of the output
+//   conv_pos_reg: 15:0 im2col row of the first row of B, 31:16 im2col
+//                 column of the first tile
+//
+// rst is the active-low ESP accelerator reset.
+module esp_tpu_datapath
+#(
+parameter DMA_DATA_WIDTH = 32,
+parameter DMA_USER_WIDTH = 5
+)
+(
+  input wire clk,
+  input wire rst,
+
+  input wire [31:0] data_in_reg,
+  input wire [31:0] data_out_reg,
+  input wire [31:0] activation_reg,
+  input wire [31:0] pooling_reg,
+  input wire [31:0] norm_reg,
+  input wire [31:0] tiles_reg,
+  input wire [31:0] ws_reg,
+  input wire [31:0] im2col_reg,
+  input wire [31:0] fm_size_reg,
+  input wire [31:0] conv_pos_reg,
+  input wire [31:0] conv_out_reg,
+  input wire conf_done,
+  output wire acc_done,
+  output wire [31:0] debug,
+
+  input wire dma_read_ctrl_ready,
+  output wire dma_read_ctrl_valid,
+  output wire [31:0] dma_read_ctrl_data_index,
+  output wire [31:0] dma_read_ctrl_data_length,
+  output wire [2:0] dma_read_ctrl_data_size,
+  output wire [DMA_USER_WIDTH-1:0] dma_read_ctrl_data_user,
+
+  output wire dma_read_chnl_ready,
+  input wire dma_read_chnl_valid,
+  input wire [DMA_DATA_WIDTH-1:0] dma_read_chnl_data,
+
+  input wire dma_write_ctrl_ready,
+  output wire dma_write_ctrl_valid,
+  output wire [31:0] dma_write_ctrl_data_index,
+  output wire [31:0] dma_write_ctrl_data_length,
+  output wire [2:0] dma_write_ctrl_data_size,
+  output wire [DMA_USER_WIDTH-1:0] dma_write_ctrl_data_user,
+
+  input wire dma_write_chnl_ready,
+  output wire dma_write_chnl_valid,
+  output wire [DMA_DATA_WIDTH-1:0] dma_write_chnl_data
+);
+
+  // Memory interface parameters, AWIDTH/DWIDTH/DESIGN_SIZE match tpu_top
+  parameter AWIDTH = 10;
+  parameter DWIDTH = 8;
+  parameter DESIGN_SIZE = 16;
+  parameter BRAM_INDEX = 1;
+  parameter ADDR_WIDTH = 4;
+
+  // Bank 0 and bank 1 of each operand
+  localparam [AWIDTH-1:0] A_BASE0 = 0;
+  localparam [AWIDTH-1:0] C_BASE0 = DESIGN_SIZE;
+  localparam [AWIDTH-1:0] A_BASE1 = 2 * DESIGN_SIZE;
+  localparam [AWIDTH-1:0] C_BASE1 = 3 * DESIGN_SIZE;
+  localparam [AWIDTH-1:0] B_BASE0 = 0;
+  localparam [AWIDTH-1:0] B_BASE1 = DESIGN_SIZE;
+  localparam [AWIDTH-1:0] A_WS = 4 * DESIGN_SIZE;
+
+  localparam [31:0] WEIGHT_BYTES = DESIGN_SIZE * DESIGN_SIZE * DWIDTH / 8;
+
+  reg running;
+  reg acc_done_reg;
+  wire [31:0] tiles;
+  wire [9:0] k_tiles;
+  reg [9:0] k_pos;
+  reg pe_clear;
+  wire ws_mode;
+  reg weights_pending;
+  reg weights_loading;
+  wire im2col_en;
+  reg fm_pending;
+  reg fm_loading;
+
+  // Tiles handed to and finished by each unit
+  reg [31:0] load_issued;
+  reg [31:0] load_count;
+  reg [31:0] compute_issued;
+  reg [31:0] compute_count;
+  reg [31:0] store_issued;
+  reg [31:0] store_count;
+
+  // Buffer offsets of the tile being loaded/stored (bytes)
+  reg [31:0] load_offset;
+  reg [31:0] store_offset;
+
+  // Control signals
+  reg start_load;
+  reg start_fm;
+  reg start_gather;
+  reg start_tpu;
+  reg start_store;
+  wire loading;
+  wire load_done;
+  wire fm_done;
+  wire gathering;
+  wire gather_done;
+  wire tile_loaded;
+  wire tpu_done;
+  wire storing;
+  wire store_done;
+
+  // Banks of the tile in flight in each unit
+  wire load_bank;
+  wire compute_bank;
+  wire store_bank;
+
+  // DMA interface signals, the read channel is shared by the load unit and
+  // the feature map load
+  wire [66:0] read_ctrl_data;
+  wire [66:0] write_ctrl_data;
+  wire load_read_ctrl_valid;
+  wire load_read_chnl_ready;
+  wire fm_read_ctrl_valid;
+  wire [66:0] fm_read_ctrl_data;
+  wire fm_read_chnl_ready;
+
+  // Connection between modules
+  wire [BRAM_INDEX+ADDR_WIDTH-1:0] load_mem_addr;
+  wire [DESIGN_SIZE-1:0] load_mem_we;
+  wire [DESIGN_SIZE*DWIDTH-1:0] load_mem_data;
+  wire [ADDR_WIDTH-1:0] store_mem_addr;
+  wire load_to_a;
+  wire load_wr_a;
+  wire [31:0] load_bytes;
+  wire [ADDR_WIDTH-1:0] gather_mem_addr;
+  wire gather_mem_we;
+  wire [DESIGN_SIZE*DWIDTH-1:0] gather_mem_data;
+
+  wire [DESIGN_SIZE*DWIDTH-1:0] bram_rdata_a;
+  wire [DESIGN_SIZE*DWIDTH-1:0] bram_rdata_b;
+
+  // APB interface signals
+  wire [7:0] PADDR;
+  wire [31:0] PWDATA;
+  wire PWRITE;
+  wire PSEL;
+  wire PENABLE;
+  wire [31:0] PRDATA;
+  wire PREADY;
+
+  assign tiles = (tiles_reg[11:0] == 0) ? 1 : {20'b0, tiles_reg[11:0]};
+  assign k_tiles = tiles_reg[21:12];
+  assign im2col_en = im2col_reg[0];
+  assign ws_mode = ws_reg[0] | im2col_en;
+  assign tile_loaded = im2col_en ? gather_done : (load_done && !weights_loading);
+
+  assign load_bank = load_count[0];
+  assign compute_bank = compute_count[0];
+  assign store_bank = store_count[0];
+
+  // Tile scheduler. A unit takes the next tile once it is idle and the tile
+  // is ready for it: loads may run two tiles ahead of the matmul (the banks it
+  // reads), and the matmul two tiles ahead of the stores (the C bank it
+  // writes). A weight load goes first, through the same load unit, then a
+  // feature map load.
+  always @(posedge clk) begin
+    if (rst == 1'b0) begin
+      running <= 1'b0;
+      acc_done_reg <= 1'b0;
+      weights_pending <= 1'b0;
+      weights_loading <= 1'b0;
+      fm_pending <= 1'b0;
+      fm_loading <= 1'b0;
+      start_load <= 1'b0;
+      start_fm <= 1'b0;
+      start_gather <= 1'b0;
+      start_tpu <= 1'b0;
+      start_store <= 1'b0;
+      load_issued <= 0;
+      load_count <= 0;
+      compute_issued <= 0;
+      compute_count <= 0;
+      store_issued <= 0;
+      store_count <= 0;
+      load_offset <= 0;
+      store_offset <= 0;
+      k_pos <= 0;
+      pe_clear <= 1'b0;
+    end
+    else begin
+      start_load <= 1'b0;
+      start_fm <= 1'b0;
+      start_gather <= 1'b0;
+      start_tpu <= 1'b0;
+      start_store <= 1'b0;
+      acc_done_reg <= 1'b0;
+
+      if (running == 1'b0) begin
+        if (conf_done) begin
+          running <= 1'b1;
+          weights_pending <= ws_reg[0] & ws_reg[1];
+          fm_pending <= im2col_reg[0] & im2col_reg[1];
+          load_issued <= 0;
+          load_count <= 0;
+          compute_issued <= 0;
+          compute_count <= 0;
+          store_issued <= 0;
+          store_count <= 0;
+          load_offset <= 0;
+          store_offset <= 0;
+          k_pos <= tiles_reg[31:22];
+        end
+      end
+      else begin
+        if (load_done && weights_loading) begin
+          weights_loading <= 1'b0;
+          load_offset <= load_offset + WEIGHT_BYTES;
+        end
+        if (fm_done) begin
+          fm_loading <= 1'b0;
+          load_offset <= load_offset + data_in_reg;
+        end
+        if (tile_loaded) begin
+          load_count <= load_count + 1;
+          load_offset <= load_offset + data_in_reg;
+        end
+        if (tpu_done)
+          compute_count <= compute_count + 1;
+        if (store_done) begin
+          store_count <= store_count + 1;
+          store_offset <= store_offset + data_out_reg;
+        end
+
+        if (load_issued == load_count && weights_loading == 1'b0 && fm_loading == 1'b0) begin
+          if (weights_pending) begin
+            start_load <= 1'b1;
+            weights_pending <= 1'b0;
+            weights_loading <= 1'b1;
+          end
+          else if (fm_pending) begin
+            start_fm <= 1'b1;
+            fm_pending <= 1'b0;
+            fm_loading <= 1'b1;
+          end
+          else if (load_issued != tiles && load_issued != compute_count + 2) begin
+            if (im2col_en)
+              start_gather <= 1'b1;
+            else
+              start_load <= 1'b1;
+            load_issued <= load_issued + 1;
+          end
+        end
+        if (compute_issued == compute_count && compute_issued != load_count &&
+            compute_issued != store_count + 2) begin
+          start_tpu <= 1'b1;
+          compute_issued <= compute_issued + 1;
+          pe_clear <= (k_pos == 0);
+          k_pos <= ({1'b0, k_pos} + 1 >= {1'b0, k_tiles}) ? 10'd0 : k_pos + 1;
+        end
+        if (store_issued == store_count && store_issued != compute_count) begin
+          start_store <= 1'b1;
+          store_issued <= store_issued + 1;
+        end
+
+        if (store_count == tiles) begin
+          running <= 1'b0;
+          acc_done_reg <= 1'b1;
+        end
+      end
+    end
+  end
+
+  load_input_unit #(
+    .ADDR_WIDTH(ADDR_WIDTH),
+    .DMA_DATA_WIDTH(DMA_DATA_WIDTH),
+    .DATA_WIDTH(DWIDTH),
+    .BRAM_INDEX(BRAM_INDEX),
+    .DESIGN_SIZE(DESIGN_SIZE)
+  ) load_input_inst (
+    .clk(clk),
+    .rst(rst),
+    .start_load(start_load),
+    .loading(loading),
+    .done(load_done),
+    .data_in_reg(load_bytes),
+    .data_in_offset(load_offset),
+    .read_ctrl_valid(load_read_ctrl_valid),
+    .read_ctrl_ready(dma_read_ctrl_ready),
+    .read_ctrl_data(read_ctrl_data),
+    .read_chnl_valid(dma_read_chnl_valid),
+    .read_chnl_ready(load_read_chnl_ready),
+    .read_chnl_data(dma_read_chnl_data),
+    .mem_addr(load_mem_addr),
+    .mem_we(load_mem_we),
+    .mem_data(load_mem_data)
+  );
+
+  im2col_unit #(
+    .ADDR_WIDTH(ADDR_WIDTH),
+    .DMA_DATA_WIDTH(DMA_DATA_WIDTH),
+    .DATA_WIDTH(DWIDTH),
+    .DESIGN_SIZE(DESIGN_SIZE)
+  ) im2col_inst (
+    .clk(clk),
+    .rst(rst),
+    .kernel(im2col_reg[7:4]),
+    .stride(im2col_reg[11:8]),
+    .pad(im2col_reg[15:12]),
+    .channels(im2col_reg[31:16]),
+    .height(fm_size_reg[15:0]),
+    .width(fm_size_reg[31:16]),
+    .out_h(conv_out_reg[15:0]),
+    .out_w(conv_out_reg[31:16]),
+    .row_start(conv_pos_reg[15:0]),
+    .col_start(conv_pos_reg[31:16]),
+    .start_fm(start_fm),
+    .fm_loading(),
+    .fm_done(fm_done),
+    .fm_bytes(data_in_reg),
+    .fm_offset(load_offset),
+    .read_ctrl_valid(fm_read_ctrl_valid),
+    .read_ctrl_ready(dma_read_ctrl_ready),
+    .read_ctrl_data(fm_read_ctrl_data),
+    .read_chnl_valid(dma_read_chnl_valid),
+    .read_chnl_ready(fm_read_chnl_ready),
+    .read_chnl_data(dma_read_chnl_data),
+    .start_tile(start_gather),
+    .first_tile(load_count == 0),
+    .gathering(gathering),
+    .tile_done(gather_done),
+    .mem_addr(gather_mem_addr),
+    .mem_we(gather_mem_we),
+    .mem_data(gather_mem_data)
+  );
+
+  // Only one of the two is past its request state at a time
+  assign dma_read_ctrl_valid = load_read_ctrl_valid | fm_read_ctrl_valid;
+  assign dma_read_chnl_ready = load_read_chnl_ready | fm_read_chnl_ready;
+
+  // Port A: operand writes from the load unit, C reads for the store unit
+  // in the cycles the load unit leaves it alone
+  reg [AWIDTH-1:0] bram_addr_a_mux;
+  reg [DESIGN_SIZE-1:0] bram_we_a_mux;
+
+  assign load_bytes = weights_loading ? WEIGHT_BYTES : data_in_reg;
+
+  // Weights go to A_WS, and in weight-stationary mode tiles only carry B
+  assign load_to_a = weights_loading ||
+                     (!ws_mode && load_mem_addr[BRAM_INDEX+ADDR_WIDTH-1 -: BRAM_INDEX] == 0);
+  assign load_wr_a = (load_mem_we != 0) && load_to_a;
+
+  always @(*) begin
+    if (load_wr_a) begin
+      bram_addr_a_mux = (weights_loading ? A_WS : load_bank ? A_BASE1 : A_BASE0) +
+                        load_mem_addr[ADDR_WIDTH-1:0];
+      bram_we_a_mux = load_mem_we;
+    end else begin
+      bram_addr_a_mux = (store_bank ? C_BASE1 : C_BASE0) + store_mem_addr;
+      bram_we_a_mux = {DESIGN_SIZE{1'b0}};
+    end
+  end
+
+  // Port B: operand writes only, from the load unit or the im2col gather
+  wire [AWIDTH-1:0] bram_addr_b_mux;
+  wire [DESIGN_SIZE-1:0] bram_we_b_mux;
+  wire [DESIGN_SIZE*DWIDTH-1:0] bram_wdata_b_mux;
+
+  assign bram_addr_b_mux = (load_bank ? B_BASE1 : B_BASE0) +
+                           (gathering ? gather_mem_addr : load_mem_addr[ADDR_WIDTH-1:0]);
+  assign bram_we_b_mux = gathering ? {DESIGN_SIZE{gather_mem_we}} :
+                         load_to_a ? {DESIGN_SIZE{1'b0}} : load_mem_we;
+  assign bram_wdata_b_mux = gathering ? gather_mem_data : load_mem_data;
+
+  esp_tpu_controller #(
+    .REG_ADDRWIDTH(8),
+    .REG_DATAWIDTH(32),
+    .AWIDTH(AWIDTH),
+    .DESIGN_SIZE(DESIGN_SIZE)
+  ) esp_tpu_controller_inst (
+    .clk(clk),
+    .rst_n(rst),
+    .start(start_tpu),
+    .pe_clear(pe_clear),
+    .done(tpu_done),
+    .activation_reg(activation_reg),
+    .pooling_reg(pooling_reg),
+    .norm_reg(norm_reg),
+    .addr_a(ws_mode ? A_WS : compute_bank ? A_BASE1 : A_BASE0),
+    .addr_b(compute_bank ? B_BASE1 : B_BASE0),
+    .addr_c(compute_bank ? C_BASE1 : C_BASE0),
+    .PADDR(PADDR),
+    .PWRITE(PWRITE),
+    .PSEL(PSEL),
+    .PENABLE(PENABLE),
+    .PWDATA(PWDATA),
+    .PRDATA(PRDATA),
+    .PREADY(PREADY)
+  );
+
+  tpu_top tpu_top_inst (
+    .clk(clk),
+    .clk_mem(clk),
+    .reset(~rst),
+    .resetn(rst),
+    .PADDR(PADDR),
+    .PWRITE(PWRITE),
+    .PSEL(PSEL),
+    .PENABLE(PENABLE),
+    .PWDATA(PWDATA),
+    .PRDATA(PRDATA),
+    .PREADY(PREADY),
+    .bram_addr_a_ext(bram_addr_a_mux),
+    .bram_rdata_a_ext(bram_rdata_a),
+    .bram_wdata_a_ext(load_mem_data),
+    .bram_we_a_ext(bram_we_a_mux),
+    .bram_addr_b_ext(bram_addr_b_mux),
+    .bram_rdata_b_ext(bram_rdata_b),
+    .bram_wdata_b_ext(bram_wdata_b_mux),
+    .bram_we_b_ext(bram_we_b_mux)
+  );
+
+  store_output_unit #(
+    .ADDR_WIDTH(ADDR_WIDTH),
+    .DMA_DATA_WIDTH(DMA_DATA_WIDTH),
+    .DATA_WIDTH(DWIDTH),
+    .DESIGN_SIZE(DESIGN_SIZE)
+  ) store_output_inst (
+    .clk(clk),
+    .rst(rst),
+    .start_store(start_store),
+    .storing(storing),
+    .done(store_done),
+    .data_out_reg(data_out_reg),
+    .data_out_offset(store_offset),
+    .mem_addr(store_mem_addr),
+    .mem_gnt(!load_wr_a),
+    .mem_data(bram_rdata_a),
+    .write_ctrl_valid(dma_write_ctrl_valid),
+    .write_ctrl_ready(dma_write_ctrl_ready),
+    .write_ctrl_data(write_ctrl_data),
+    .write_chnl_valid(dma_write_chnl_valid),
+    .write_chnl_ready(dma_write_chnl_ready),
+    .write_chnl_data(dma_write_chnl_data)
+  );
+
+  // DMA control signals assignment
+  assign dma_read_ctrl_data_size = fm_loading ? fm_read_ctrl_data[66:64] : read_ctrl_data[66:64];
+  assign dma_read_ctrl_data_length = fm_loading ? fm_read_ctrl_data[63:32] : read_ctrl_data[63:32];
+  assign dma_read_ctrl_data_index = fm_loading ? fm_read_ctrl_data[31:0] : read_ctrl_data[31:0];
+  assign dma_read_ctrl_data_user = {DMA_USER_WIDTH{1'b0}};
+
+  assign dma_write_ctrl_data_size = write_ctrl_data[66:64];
+  assign dma_write_ctrl_data_length = write_ctrl_data[63:32];
+  assign dma_write_ctrl_data_index = write_ctrl_data[31:0];
+  assign dma_write_ctrl_data_user = {DMA_USER_WIDTH{1'b0}};
+
+  // Final output assignments
+  assign acc_done = acc_done_reg;
+  assign debug = {store_count[23:0], 4'h0, running, loading, compute_issued != compute_count, storing};
+
+endmodule
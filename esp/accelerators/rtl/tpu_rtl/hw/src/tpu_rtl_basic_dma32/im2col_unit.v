@@ -0,0 +1,430 @@
+`timescale 1ns/1ps
+
+// On-chip im2col for the B operand of a convolution.
+//
+// The raw int8 feature map (channels x height x width, NCHW) is read once
+// through DMA into a local buffer of 2^FM_AWIDTH bytes and stays there across
+// invocations until the next load. Each tile then gathers a 16x16 block of the
+// im2col matrix straight from that buffer and writes it into BRAM B, one row
+// of B per word:
+//   B[r][c] = fm[ch][oy * stride + ky - pad][ox * stride + kx - pad]
+//   r = (ch * kernel + ky) * kernel + kx,  c = oy * out_w + ox
+// and zero outside the feature map, past the last channel or past the last
+// output pixel.
+//
+// The first tile of an invocation starts at row row_start and column
+// col_start of the im2col matrix; later tiles move 16 columns to the right
+// and keep the rows. The start position is split into (ch, ky, kx) and
+// (oy, ox) by a small serial divider before the first tile.
+module im2col_unit
+#(
+parameter ADDR_WIDTH = 4,
+parameter DMA_DATA_WIDTH = 32,
+parameter DATA_WIDTH = 8,
+parameter DESIGN_SIZE = 16,
+parameter FM_AWIDTH = 14
+)
+(
+  input wire clk,
+  input wire rst,
+
+  // Geometry
+  input wire [3:0] kernel,
+  input wire [3:0] stride,
+  input wire [3:0] pad,
+  input wire [15:0] channels,
+  input wire [15:0] height,
+  input wire [15:0] width,
+  input wire [15:0] out_h,
+  input wire [15:0] out_w,
+  input wire [15:0] row_start,
+  input wire [15:0] col_start,
+
+  // Feature map load
+  input wire start_fm,
+  output wire fm_loading,
+  output wire fm_done,
+  input wire [31 : 0] fm_bytes,
+  input wire [31 : 0] fm_offset,      // bytes from the start of the input buffer
+  output wire read_ctrl_valid,
+  input wire read_ctrl_ready,
+  output wire [66 : 0] read_ctrl_data,
+  input wire read_chnl_valid,
+  output wire read_chnl_ready,
+  input wire [DMA_DATA_WIDTH-1 : 0] read_chnl_data,
+
+  // Tile gather, first_tile comes with start_tile
+  input wire start_tile,
+  input wire first_tile,
+  output wire gathering,
+  output wire tile_done,
+  output wire [ADDR_WIDTH-1 : 0] mem_addr,
+  output wire mem_we,
+  output wire [DESIGN_SIZE*DATA_WIDTH-1 : 0] mem_data
+);
+
+  localparam LOG2_BEAT_BYTES = $clog2(DMA_DATA_WIDTH / 8);
+  localparam FM_WORDS = (1 << FM_AWIDTH) >> LOG2_BEAT_BYTES;
+  localparam LANE_WIDTH = $clog2(DESIGN_SIZE);
+
+  //
+  // Feature map load
+  //
+  localparam fm_idle = 0;
+  localparam fm_req = 1;
+  localparam fm_data = 2;
+
+  reg [1:0] fm_state;
+  reg [31:0] fm_beat;
+  reg [DMA_DATA_WIDTH-1 : 0] fm_mem [0:FM_WORDS-1];
+
+  wire [31:0] fm_length;
+  wire fm_fire;
+
+  assign fm_length = (fm_bytes + (DMA_DATA_WIDTH / 8) - 1) >> LOG2_BEAT_BYTES;
+  assign fm_fire = read_chnl_valid & read_chnl_ready;
+
+  always @(posedge clk) begin
+    if (rst == 1'b0) begin
+      fm_state <= fm_idle;
+      fm_beat <= 0;
+    end
+    else begin
+      case (fm_state)
+        fm_idle: begin
+          fm_beat <= 0;
+          if (start_fm)
+            fm_state <= fm_req;
+        end
+
+        fm_req: begin
+          if (read_ctrl_ready == 1'b1)
+            fm_state <= fm_data;
+        end
+
+        fm_data: begin
+          if (fm_fire == 1'b1) begin
+            fm_beat <= fm_beat + 1;
+            if (fm_beat == fm_length - 1)
+              fm_state <= fm_idle;
+          end
+        end
+
+        default: begin
+          fm_state <= fm_idle;
+        end
+      endcase
+    end
+  end
+
+  always @(posedge clk) begin
+    if (fm_fire == 1'b1)
+      fm_mem[fm_beat[FM_AWIDTH-LOG2_BEAT_BYTES-1:0]] <= read_chnl_data;
+  end
+
+  assign read_ctrl_valid = (fm_state == fm_req);
+  assign read_ctrl_data = {(DMA_DATA_WIDTH == 64) ? 3'b011 : 3'b010, fm_length,
+                           fm_offset >> LOG2_BEAT_BYTES};
+  assign read_chnl_ready = (fm_state == fm_data);
+  assign fm_loading = (fm_state != fm_idle);
+  assign fm_done = (fm_state == fm_data) && fm_fire && (fm_beat == fm_length - 1);
+
+  //
+  // Tile gather
+  //
+  localparam g_idle = 0;
+  localparam g_div = 1;
+  localparam g_div_done = 2;
+  localparam g_run = 3;
+  localparam g_flush = 4;
+
+  // Divisions done before the first tile
+  localparam div_row = 0;   // row_start / kernel^2 -> ch, remainder
+  localparam div_k = 1;     // remainder / kernel -> ky, kx
+  localparam div_col = 2;   // col_start / out_w -> oy, ox
+
+  reg [2:0] g_state;
+  reg [1:0] div_sel;
+  reg [4:0] div_cnt;
+  reg [15:0] div_num;
+  reg [15:0] div_den;
+  reg [15:0] div_quo;
+  reg [16:0] div_rem;
+
+  wire [16:0] div_shift;
+
+  assign div_shift = {div_rem[15:0], div_num[15]};
+
+  // Row position of the first row of every tile
+  reg [15:0] s_ch;
+  reg [3:0] s_ky;
+  reg [3:0] s_kx;
+
+  // Column position of the first column of the next tile
+  reg [15:0] t_oy;
+  reg [15:0] t_ox;
+
+  // Element being issued
+  reg [15:0] r_ch;
+  reg [3:0] r_ky;
+  reg [3:0] r_kx;
+  reg [ADDR_WIDTH-1:0] r_k;
+  reg [15:0] c_oy;
+  reg [15:0] c_ox;
+  reg [LANE_WIDTH-1:0] c_j;
+
+  wire row_end;
+  wire tile_end;
+  wire [15:0] next_oy;
+  wire [15:0] next_ox;
+
+  assign row_end = (c_j == DESIGN_SIZE - 1);
+  assign tile_end = row_end && (r_k == DESIGN_SIZE - 1);
+  assign next_ox = (c_ox == out_w - 1) ? 0 : c_ox + 1;
+  assign next_oy = (c_ox == out_w - 1) ? c_oy + 1 : c_oy;
+
+  always @(posedge clk) begin
+    if (rst == 1'b0) begin
+      g_state <= g_idle;
+      div_sel <= div_row;
+      div_cnt <= 0;
+      div_num <= 0;
+      div_den <= 0;
+      div_quo <= 0;
+      div_rem <= 0;
+      s_ch <= 0;
+      s_ky <= 0;
+      s_kx <= 0;
+      t_oy <= 0;
+      t_ox <= 0;
+      r_ch <= 0;
+      r_ky <= 0;
+      r_kx <= 0;
+      r_k <= 0;
+      c_oy <= 0;
+      c_ox <= 0;
+      c_j <= 0;
+    end
+    else begin
+      case (g_state)
+        g_idle: begin
+          div_sel <= div_row;
+          div_cnt <= 0;
+          r_ch <= s_ch;
+          r_ky <= s_ky;
+          r_kx <= s_kx;
+          r_k <= 0;
+          c_oy <= t_oy;
+          c_ox <= t_ox;
+          c_j <= 0;
+          if (start_tile)
+            g_state <= first_tile ? g_div : g_run;
+        end
+
+        // Restoring division, one quotient bit per cycle
+        g_div: begin
+          div_cnt <= div_cnt + 1;
+          if (div_cnt == 0) begin
+            case (div_sel)
+              div_row: begin
+                div_num <= row_start;
+                div_den <= kernel * kernel;
+              end
+              div_k: begin
+                div_num <= div_rem[15:0];
+                div_den <= kernel;
+              end
+              default: begin
+                div_num <= col_start;
+                div_den <= out_w;
+              end
+            endcase
+            div_quo <= 0;
+            div_rem <= 0;
+          end
+          else begin
+            div_num <= div_num << 1;
+            if (div_shift >= {1'b0, div_den}) begin
+              div_rem <= div_shift - {1'b0, div_den};
+              div_quo <= {div_quo[14:0], 1'b1};
+            end
+            else begin
+              div_rem <= div_shift;
+              div_quo <= {div_quo[14:0], 1'b0};
+            end
+            if (div_cnt == 16)
+              g_state <= g_div_done;
+          end
+        end
+
+        g_div_done: begin
+          div_cnt <= 0;
+          case (div_sel)
+            div_row: begin
+              s_ch <= div_quo;
+              r_ch <= div_quo;
+              div_sel <= div_k;
+              g_state <= g_div;
+            end
+            div_k: begin
+              s_ky <= div_quo[3:0];
+              s_kx <= div_rem[3:0];
+              r_ky <= div_quo[3:0];
+              r_kx <= div_rem[3:0];
+              div_sel <= div_col;
+              g_state <= g_div;
+            end
+            default: begin
+              t_oy <= div_quo;
+              t_ox <= div_rem[15:0];
+              c_oy <= div_quo;
+              c_ox <= div_rem[15:0];
+              g_state <= g_run;
+            end
+          endcase
+        end
+
+        // Issue one element per cycle, columns innermost
+        g_run: begin
+          c_j <= c_j + 1;
+          if (row_end == 1'b0) begin
+            c_oy <= next_oy;
+            c_ox <= next_ox;
+          end
+          else if (tile_end == 1'b1) begin
+            t_oy <= next_oy;
+            t_ox <= next_ox;
+            g_state <= g_flush;
+          end
+          else begin
+            c_oy <= t_oy;
+            c_ox <= t_ox;
+            r_k <= r_k + 1;
+            if (r_kx == kernel - 1) begin
+              r_kx <= 0;
+              if (r_ky == kernel - 1) begin
+                r_ky <= 0;
+                r_ch <= r_ch + 1;
+              end
+              else begin
+                r_ky <= r_ky + 1;
+              end
+            end
+            else begin
+              r_kx <= r_kx + 1;
+            end
+          end
+        end
+
+        g_flush: begin
+          if (tile_done)
+            g_state <= g_idle;
+        end
+
+        default: begin
+          g_state <= g_idle;
+        end
+      endcase
+    end
+  end
+
+  // Stage 1: window coordinates
+  reg p1_valid;
+  reg p1_row_end;
+  reg p1_tile_end;
+  reg [ADDR_WIDTH-1:0] p1_k;
+  reg [LANE_WIDTH-1:0] p1_j;
+  reg p1_in;
+  reg signed [19:0] p1_y;
+  reg signed [19:0] p1_x;
+  reg [31:0] p1_plane;
+
+  // Stage 2: feature map address
+  reg p2_valid;
+  reg p2_row_end;
+  reg p2_tile_end;
+  reg [ADDR_WIDTH-1:0] p2_k;
+  reg [LANE_WIDTH-1:0] p2_j;
+  reg p2_in;
+  reg [31:0] p2_addr;
+
+  // Stage 3: feature map word
+  reg p3_valid;
+  reg p3_row_end;
+  reg p3_tile_end;
+  reg [ADDR_WIDTH-1:0] p3_k;
+  reg [LANE_WIDTH-1:0] p3_j;
+  reg p3_in;
+  reg [LOG2_BEAT_BYTES-1:0] p3_lane;
+  reg [DMA_DATA_WIDTH-1:0] fm_q;
+
+  // Stage 4: B row assembly and BRAM write
+  reg [DESIGN_SIZE*DATA_WIDTH-1:0] row;
+  reg [DESIGN_SIZE*DATA_WIDTH-1:0] row_next;
+  reg [DATA_WIDTH-1:0] elem;
+  reg wr_we;
+  reg [ADDR_WIDTH-1:0] wr_addr;
+  reg [DESIGN_SIZE*DATA_WIDTH-1:0] wr_data;
+  reg done_reg;
+
+  always @(posedge clk) begin
+    p1_valid <= (g_state == g_run);
+    p1_row_end <= row_end;
+    p1_tile_end <= tile_end;
+    p1_k <= r_k;
+    p1_j <= c_j;
+    p1_in <= (r_ch < channels) && (c_oy < out_h);
+    p1_y <= $signed({4'b0, c_oy * stride}) + $signed({16'b0, r_ky}) - $signed({16'b0, pad});
+    p1_x <= $signed({4'b0, c_ox * stride}) + $signed({16'b0, r_kx}) - $signed({16'b0, pad});
+    p1_plane <= r_ch * height;
+
+    p2_valid <= p1_valid;
+    p2_row_end <= p1_row_end;
+    p2_tile_end <= p1_tile_end;
+    p2_k <= p1_k;
+    p2_j <= p1_j;
+    p2_in <= p1_in && (p1_y >= 0) && (p1_y < $signed({4'b0, height})) &&
+             (p1_x >= 0) && (p1_x < $signed({4'b0, width}));
+    p2_addr <= (p1_plane + p1_y[15:0]) * width + p1_x[15:0];
+
+    p3_valid <= p2_valid;
+    p3_row_end <= p2_row_end;
+    p3_tile_end <= p2_tile_end;
+    p3_k <= p2_k;
+    p3_j <= p2_j;
+    p3_in <= p2_in;
+    p3_lane <= p2_addr[LOG2_BEAT_BYTES-1:0];
+    fm_q <= fm_mem[p2_addr[FM_AWIDTH-1:LOG2_BEAT_BYTES]];
+  end
+
+  always @(*) begin
+    elem = p3_in ? fm_q[p3_lane*DATA_WIDTH +: DATA_WIDTH] : {DATA_WIDTH{1'b0}};
+    row_next = row;
+    row_next[p3_j*DATA_WIDTH +: DATA_WIDTH] = elem;
+  end
+
+  always @(posedge clk) begin
+    if (rst == 1'b0) begin
+      row <= 0;
+      wr_we <= 1'b0;
+      wr_addr <= 0;
+      wr_data <= 0;
+      done_reg <= 1'b0;
+    end
+    else begin
+      wr_we <= p3_valid && p3_row_end;
+      wr_addr <= p3_k;
+      wr_data <= row_next;
+      done_reg <= p3_valid && p3_tile_end;
+      if (p3_valid)
+        row <= row_next;
+    end
+  end
+
+  assign gathering = (g_state != g_idle);
+  assign tile_done = done_reg;
+  assign mem_addr = wr_addr;
+  assign mem_we = wr_we;
+  assign mem_data = wr_data;
+
+endmodule
@@ -1,22 +1,29 @@
+`timescale 1ns/1ps
+
+// Streams the output tile from BRAM A to DMA, one column of C per BRAM word
+// and BEATS_PER_ROW beats per word. The next word is read while the current
+// one is being sent, so the write channel sees a beat every cycle.
 module store_output_unit
 #(
-parameter ADDR_LEN = 64,
-parameter ADDR_WIDTH = 5,
+parameter ADDR_WIDTH = 4,
 parameter DMA_DATA_WIDTH = 32,
 parameter DATA_WIDTH = 8,
-parameter BRAM_INDEX = 1,
 parameter DESIGN_SIZE = 16
 )
 (
   input wire clk,
   input wire rst,
-
-  input wire [95 : 0] conf_regs,
-  // BRAM output signals
-  input wire in_valid,
-  output wire in_ready,
-  output wire [ADDR_WIDTH-1 : 0] in_addr,
-  input wire [DMA_DATA_WIDTH-1 : 0] in_data,
+  input wire start_store,
+  output wire storing,
+  output wire done,
+  input wire [31 : 0] data_out_reg,   // bytes to store
+  input wire [31 : 0] data_out_offset, // bytes from the start of the output buffer
+
+  // BRAM read port, mem_data follows mem_addr by one cycle. mem_gnt is low
+  // when the port is lent to someone else for the cycle.
+  output wire [ADDR_WIDTH-1 : 0] mem_addr,
+  input wire mem_gnt,
+  input wire [DESIGN_SIZE*DATA_WIDTH-1 : 0] mem_data,
 
   output wire write_ctrl_valid,
   input wire write_ctrl_ready,
@@ -24,39 +31,46 @@ parameter DESIGN_SIZE = 16
 
   output wire write_chnl_valid,
   input wire write_chnl_ready,
-  output wire [DMA_DATA_WIDTH-1 : 0] write_chnl_data,
-  output done
+  output wire [DMA_DATA_WIDTH-1 : 0] write_chnl_data
 );
 
+  localparam OUT_WORD_PER_DMA_BEAT = DMA_DATA_WIDTH / DATA_WIDTH;
+  localparam BEATS_PER_ROW = DESIGN_SIZE / OUT_WORD_PER_DMA_BEAT;
+  localparam LANE_BITS = $clog2(BEATS_PER_ROW);
+  localparam LOG2_BEAT_BYTES = $clog2(DMA_DATA_WIDTH / 8);
+
   localparam idle = 0;
   localparam snd_wr_req = 1;
   localparam wr_data = 2;
 
   wire [31 : 0] out_data_length;
-  wire [31 : 0] out_data_index;
-  wire [1 : 0] out_data_size;
+  wire [2 : 0] out_data_size;
+
+  reg [1:0] state_reg;
+  reg [1:0] state_next;
 
-  reg [3:0] state_reg;
-  reg [3:0] state_next;
-  
   reg [31:0] snd_data;
   reg [ADDR_WIDTH-1 : 0] rd_addr_int;
-
-  reg dma_write_chnl_valid_int;
-  reg dma_write_ctrl_valid_int;
-  reg [DMA_DATA_WIDTH-1 : 0] dma_write_chnl_data_int;
-  reg [31 : 0] dma_write_ctrl_data_index_int;
-  reg [31 : 0] dma_write_ctrl_data_length_int;
-  reg [2 : 0] dma_write_ctrl_data_size_int;
-  reg increment_snd_data;
-  reg incr_rd_buff_addr;
-  reg read_in_buff;
+  reg rd_ok;
+  reg [DESIGN_SIZE*DATA_WIDTH-1 : 0] word;
+  reg word_valid;
+  reg [LANE_BITS-1 : 0] lane;
   reg done_int;
 
+  wire chnl_fire;
+  wire last_lane;
+  wire refill;
+
+  assign chnl_fire = write_chnl_valid & write_chnl_ready;
+  assign last_lane = (lane == BEATS_PER_ROW - 1);
+  // rd_ok says mem_data holds word rd_addr_int, i.e. the address did not
+  // move on the last edge and the port was ours
+  assign refill = (state_reg == wr_data) && rd_ok && (!word_valid || (chnl_fire && last_lane));
+
   // State register
   always @(posedge clk) begin
-    if(rst == 1'b0) begin
-      state_reg <= 0;
+    if (rst == 1'b0) begin
+      state_reg <= idle;
     end
     else begin
       state_reg <= state_next;
@@ -64,83 +78,84 @@ parameter DESIGN_SIZE = 16
   end
 
   always @(posedge clk) begin
-    if(rst == 1'b0) begin
+    if (rst == 1'b0) begin
+      snd_data <= 0;
+      rd_addr_int <= 0;
+      rd_ok <= 1'b0;
+      word <= 0;
+      word_valid <= 1'b0;
+      lane <= 0;
+    end
+    else if (state_reg == idle) begin
       snd_data <= 0;
       rd_addr_int <= 0;
+      rd_ok <= 1'b0;
+      word_valid <= 1'b0;
+      lane <= 0;
     end
     else begin
-      if (increment_snd_data == 1'b1) begin
-        snd_data <= snd_data + 1;
-      end
-      if(incr_rd_buff_addr == 1'b1) begin
+      rd_ok <= !refill && mem_gnt;
+      if (refill == 1'b1) begin
+        word <= mem_data;
         rd_addr_int <= rd_addr_int + 1;
       end
+      if (refill == 1'b1)
+        word_valid <= 1'b1;
+      else if (chnl_fire == 1'b1 && last_lane == 1'b1)
+        word_valid <= 1'b0;
+      if (chnl_fire == 1'b1) begin
+        snd_data <= snd_data + 1;
+        lane <= last_lane ? 0 : lane + 1;
+      end
     end
   end
 
   // Next state logic
   always @(*) begin
-    dma_write_chnl_valid_int = 1'b0;
-    dma_write_chnl_data_int = 0;
-    dma_write_ctrl_valid_int = 1'b0;
-    dma_write_ctrl_data_index_int = 32'h00000000;
-    dma_write_ctrl_data_length_int = 32'h00000010;
-    dma_write_ctrl_data_size_int = 2'b01;
-    increment_snd_data = 1'b0;
-    incr_rd_buff_addr = 1'b0;
-    read_in_buff = 1'b0;
     done_int = 1'b0;
     state_next = state_reg;
 
     case (state_reg)
       idle: begin
-        if (in_valid) begin
-           state_next = snd_wr_req;
+        if (start_store) begin
+          if (out_data_length == 0)
+            done_int = 1'b1;
+          else
+            state_next = snd_wr_req;
         end
       end
 
       snd_wr_req: begin
-        dma_write_ctrl_valid_int = 1'b1;
-        dma_write_ctrl_data_length_int = out_data_length;
-        dma_write_ctrl_data_size_int = out_data_size;
-        dma_write_ctrl_data_index_int = out_data_index;
         if (write_ctrl_ready == 1'b1) begin
-          incr_rd_buff_addr = 1'b1;
-          read_in_buff = 1'b1;
           state_next = wr_data;
         end
       end
 
       wr_data: begin
-        dma_write_chnl_data_int = in_data;
-        dma_write_chnl_valid_int = 1'b1;
-        if (write_chnl_ready == 1'b1) begin
-          if (in_valid == 1'b1) begin
-            increment_snd_data = 1'b1;
-            incr_rd_buff_addr = 1'b1;
-            read_in_buff = 1'b1;
-          end
-        end 
-        if (snd_data == out_data_length - 1) begin
+        if (chnl_fire == 1'b1 && snd_data == out_data_length - 1) begin
             state_next = idle;
             done_int = 1'b1;
         end
       end
+
+      default: begin
+        state_next = idle;
+      end
     endcase
   end
 
-  assign write_ctrl_valid = dma_write_ctrl_valid_int;
-  assign write_ctrl_data = {dma_write_ctrl_data_size_int, dma_write_ctrl_data_length_int, dma_write_ctrl_data_index_int};
-  
-  assign write_chnl_valid = dma_write_chnl_valid_int;
-  assign write_chnl_data = dma_write_chnl_data_int;
+  // a partial last beat is still written whole, and an empty store is done at once
+  assign out_data_length = (data_out_reg + (1 << LOG2_BEAT_BYTES) - 1) >> LOG2_BEAT_BYTES;
+  assign out_data_size = (DMA_DATA_WIDTH == 64) ? 3'b011 : 3'b010;
+
+  assign write_ctrl_valid = (state_reg == snd_wr_req);
+  assign write_ctrl_data = {out_data_size, out_data_length, data_out_offset >> LOG2_BEAT_BYTES};
 
-  assign out_data_length = conf_regs[95 : 64];
-  assign out_data_index = conf_regs[31 : 0];
-  assign out_data_size = 2'b01; // 32-bit
+  assign write_chnl_valid = (state_reg == wr_data) && word_valid;
+  assign write_chnl_data = word[lane*DMA_DATA_WIDTH +: DMA_DATA_WIDTH];
 
-  assign in_ready = read_in_buff;
-  assign in_addr = rd_addr_int;
+  assign mem_addr = rd_addr_int;
+  assign storing = (state_reg != idle);
   assign done = done_int;
 
-endmodule
\ No newline at end of file
+endmodule
@@ -4680,16 +4680,28 @@ reg [`DWIDTH-1:0] b_flopped;
 wire [2*`DWIDTH-1:0] mul_out_temp;
 reg [2*`DWIDTH-1:0] mul_out_temp_reg;
 
+//reset (global reset or pe_reset) starts a new product
 always @(posedge clk) begin
+  if (reset) begin
+    a_flopped <= 0;
+    b_flopped <= 0;
+  end
+  else begin
     a_flopped <= a;
     b_flopped <= b;
+  end
 end
 
 //assign mul_out = a * b;
 qmult mult_u1(.i_multiplicand(a_flopped), .i_multiplier(b_flopped), .o_result(mul_out_temp));
 
 always @(posedge clk) begin
+  if (reset) begin
+    mul_out_temp_reg <= 0;
+  end
+  else begin
     mul_out_temp_reg <= mul_out_temp;
+  end
 end
 
 //we just truncate the higher bits of the product
@@ -4697,7 +4709,12 @@ end
 qadd add_u1(.a(out_temp), .b(mul_out_temp_reg), .c(add_out));
 
 always @(posedge clk) begin
+  if (reset) begin
+    out_temp <= 0;
+  end
+  else begin
     out_temp <= add_out;
+  end
 end
 
 //down cast the result
@@ -5073,10 +5090,16 @@ always @(posedge clk) begin
         end
 
         //Out data is available starting with the second clock cycle because 
-        //in the first cycle, we only apply the mean.
-        if(cycle_count==2) begin
+        //in the first cycle, we only apply the mean. The first column leaves
+        //the variance stage on the edge with cycle_count==1.
+        if(cycle_count==1) begin
             out_data_available_internal <= 1;
         end
+        //done_norm_internal holds until the next column comes in, so that
+        //the control block sees it whenever it gets to STATE_NORM
+        else if(cycle_count==0) begin
+            done_norm_internal <= 0;
+        end
 
         //When we've normalized values N times, where N is the matmul
         //size, that means we're done. But there is one additional cycle
@@ -5086,6 +5109,7 @@ always @(posedge clk) begin
         if(cycle_count==(`DESIGN_SIZE+1)) begin
             done_norm_internal <= 1'b1;
             norm_in_progress <= 0;
+            out_data_available_internal <= 0;
         end
         else begin
             norm_in_progress <= 1;
@@ -5096,7 +5120,6 @@ always @(posedge clk) begin
         variance_applied_data <= 0;
         out_data_available_internal <= 0;
         cycle_count <= 0;
-        done_norm_internal <= 0;
         norm_in_progress <= 0;
     end
 end
@@ -5360,8 +5383,10 @@ reg out_data_available_temp;
 reg [31:0] i,j;
 reg [31:0] cycle_count;
 
+//done_pool_temp holds from the last column until the next one comes in, so
+//that the control block sees it whenever it gets to STATE_POOL
 always @(posedge clk) begin
-	if (reset || ~enable_pool || ~in_data_available) begin
+	if (reset || ~enable_pool) begin
 		out_data_temp <= 0;
 		done_pool_temp <= 0;
 		out_data_available_temp <= 0;
@@ -5370,6 +5395,12 @@ always @(posedge clk) begin
     inp_data_flopped <= inp_data;
 	end
 
+	else if (~in_data_available) begin
+		out_data_temp <= 0;
+		out_data_available_temp <= 0;
+		cycle_count <= 0;
+	end
+
 	else if (in_data_available) begin
     cycle_count <= cycle_count + 1;
 		out_data_available_temp <= 1;
@@ -5391,9 +5422,13 @@ always @(posedge clk) begin
 			end
 		endcase			
 
-        if(cycle_count==`DESIGN_SIZE) begin	 
+        //The input is available for DESIGN_SIZE cycles, one per column
+        if(cycle_count==`DESIGN_SIZE-1) begin	 
             done_pool_temp <= 1'b1;	      
         end	  
+        else if(cycle_count==0) begin
+            done_pool_temp <= 1'b0;
+        end
 	end
 end
 
@@ -5481,26 +5516,34 @@ always @(posedge clk) begin
             data_intercept_delayed[i*8 +: 8] <= data_intercept_flopped[i*8 +: 8];
             intercept_applied_data_internal[i*`DWIDTH +:`DWIDTH] <= slope_applied_data_internal[i*`DWIDTH +:`DWIDTH] + data_intercept_delayed[i*8 +: 8];
          end else begin // ReLU
-            relu_applied_data_internal[i*`DWIDTH +:`DWIDTH] <= inp_data[i*`DWIDTH] ? {`DWIDTH{1'b0}} : inp_data[i*`DWIDTH +:`DWIDTH];
+            relu_applied_data_internal[i*`DWIDTH +:`DWIDTH] <= inp_data_flopped[i*`DWIDTH] ? {`DWIDTH{1'b0}} : inp_data_flopped[i*`DWIDTH +:`DWIDTH];
          end
       end   
 
-      //TANH needs 1 extra cycle
+      //Both work on inp_data_flopped, so the first column comes out of
+      //ReLU on the edge with cycle_count==1. TANH needs 1 extra cycle.
       if (activation_type==1'b1) begin
-         if (cycle_count==3) begin
+         if (cycle_count==2) begin
             out_data_available_internal <= 1;
          end
       end else begin
-         if (cycle_count==2) begin
+         if (cycle_count==1) begin
            out_data_available_internal <= 1;
          end
       end
 
+      //done_activation_internal holds until the next column comes in, so
+      //that the control block sees it whenever it gets to STATE_ACTIVATION
+      if (cycle_count==0) begin
+         done_activation_internal <= 1'b0;
+      end
+
       //TANH needs 1 extra cycle
       if (activation_type==1'b1) begin
         if(cycle_count==(`DESIGN_SIZE+2)) begin
            done_activation_internal <= 1'b1;
            activation_in_progress <= 0;
+           out_data_available_internal <= 0;
         end
         else begin
            activation_in_progress <= 1;
@@ -5509,6 +5552,7 @@ always @(posedge clk) begin
         if(cycle_count==(`DESIGN_SIZE+1)) begin
            done_activation_internal <= 1'b1;
            activation_in_progress <= 0;
+           out_data_available_internal <= 0;
         end
         else begin
            activation_in_progress <= 1;
@@ -5521,7 +5565,6 @@ always @(posedge clk) begin
       relu_applied_data_internal      <= 0; 
       data_intercept_delayed      <= 0;
       data_intercept_flopped      <= 0;
-      done_activation_internal    <= 0;
       out_data_available_internal <= 0;
       cycle_count                 <= 0;
       activation_in_progress      <= 0;
@@ -0,0 +1 @@
+../tpu_rtl_basic_dma32/esp_tpu_datapath.v
\ No newline at end of file
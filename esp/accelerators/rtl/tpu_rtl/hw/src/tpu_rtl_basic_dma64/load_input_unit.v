@@ -0,0 +1 @@
+../tpu_rtl_basic_dma32/load_input_unit.v
\ No newline at end of file
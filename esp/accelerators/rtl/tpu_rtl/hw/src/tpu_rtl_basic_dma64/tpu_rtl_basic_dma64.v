@@ -0,0 +1,121 @@
+module tpu_rtl_basic_dma64 (
+    clk,
+    rst,
+    dma_read_chnl_valid,
+    dma_read_chnl_data,
+    dma_read_chnl_ready,
+    data_in_reg,        // Bytes of A and B to load
+    data_out_reg,       // Bytes of C to store
+    activation_reg,     // Selects activation function (none/ReLU/TanH)
+    pooling_reg,        // Configures pooling operation (1x1, 2x2, 4x4)
+    norm_reg,           // Enables and configures normalization mode
+    tiles_reg,          // Tiles per invocation, double buffered, and K accumulation
+    ws_reg,             // Weight-stationary mode and weight load
+    im2col_reg,         // On-chip im2col enable, feature map load and geometry
+    fm_size_reg,        // Feature map height and width
+    conv_pos_reg,       // im2col row and column of the first tile
+    conv_out_reg,       // Output height and width
+    conf_done,
+    acc_done,
+    debug,
+    dma_read_ctrl_valid,
+    dma_read_ctrl_data_index,
+    dma_read_ctrl_data_length,
+    dma_read_ctrl_data_size,
+    dma_read_ctrl_data_user,
+    dma_read_ctrl_ready,
+    dma_write_ctrl_valid,
+    dma_write_ctrl_data_index,
+    dma_write_ctrl_data_length,
+    dma_write_ctrl_data_size,
+    dma_write_ctrl_data_user,
+    dma_write_ctrl_ready,
+    dma_write_chnl_valid,
+    dma_write_chnl_data,
+    dma_write_chnl_ready
+);
+
+    input clk;
+    input rst;
+
+    // Configuration registers with descriptive names
+    input [31:0]  data_in_reg;      // Bytes of A and B to load
+    input [31:0]  data_out_reg;     // Bytes of C to store
+    input [31:0]  activation_reg;   // Selects activation function (none/ReLU/TanH)
+    input [31:0]  pooling_reg;      // Configures pooling operation (1x1, 2x2, 4x4)
+    input [31:0]  norm_reg;         // Enables and configures normalization mode
+    input [31:0]  tiles_reg;        // Tiles per invocation, double buffered, and K accumulation
+    input [31:0]  ws_reg;           // Weight-stationary mode and weight load
+    input [31:0]  im2col_reg;       // On-chip im2col enable, feature map load and geometry
+    input [31:0]  fm_size_reg;      // Feature map height and width
+    input [31:0]  conv_pos_reg;     // im2col row and column of the first tile
+    input [31:0]  conv_out_reg;     // Output height and width
+    input         conf_done;
+
+    input         dma_read_ctrl_ready;
+    output        dma_read_ctrl_valid;
+    output [31:0] dma_read_ctrl_data_index;
+    output [31:0] dma_read_ctrl_data_length;
+    output [2:0]  dma_read_ctrl_data_size;
+    output [5:0]  dma_read_ctrl_data_user;
+
+    output        dma_read_chnl_ready;
+    input         dma_read_chnl_valid;
+    input [63:0]  dma_read_chnl_data;
+
+    input         dma_write_ctrl_ready;
+    output        dma_write_ctrl_valid;
+    output [31:0] dma_write_ctrl_data_index;
+    output [31:0] dma_write_ctrl_data_length;
+    output [2:0]  dma_write_ctrl_data_size;
+    output [5:0]  dma_write_ctrl_data_user;
+
+    input         dma_write_chnl_ready;
+    output        dma_write_chnl_valid;
+    output [63:0] dma_write_chnl_data;
+
+    output        acc_done;
+    output [31:0] debug;
+
+    // 8 int8 operands per DMA beat, see esp_tpu_datapath.v
+    esp_tpu_datapath #(
+        .DMA_DATA_WIDTH(64),
+        .DMA_USER_WIDTH(6)
+    ) esp_tpu_datapath_inst (
+        .clk(clk),
+        .rst(rst),
+        .data_in_reg(data_in_reg),
+        .data_out_reg(data_out_reg),
+        .activation_reg(activation_reg),
+        .pooling_reg(pooling_reg),
+        .norm_reg(norm_reg),
+        .tiles_reg(tiles_reg),
+        .ws_reg(ws_reg),
+        .im2col_reg(im2col_reg),
+        .fm_size_reg(fm_size_reg),
+        .conv_pos_reg(conv_pos_reg),
+        .conv_out_reg(conv_out_reg),
+        .conf_done(conf_done),
+        .acc_done(acc_done),
+        .debug(debug),
+        .dma_read_ctrl_ready(dma_read_ctrl_ready),
+        .dma_read_ctrl_valid(dma_read_ctrl_valid),
+        .dma_read_ctrl_data_index(dma_read_ctrl_data_index),
+        .dma_read_ctrl_data_length(dma_read_ctrl_data_length),
+        .dma_read_ctrl_data_size(dma_read_ctrl_data_size),
+        .dma_read_ctrl_data_user(dma_read_ctrl_data_user),
+        .dma_read_chnl_ready(dma_read_chnl_ready),
+        .dma_read_chnl_valid(dma_read_chnl_valid),
+        .dma_read_chnl_data(dma_read_chnl_data),
+        .dma_write_ctrl_ready(dma_write_ctrl_ready),
+        .dma_write_ctrl_valid(dma_write_ctrl_valid),
+        .dma_write_ctrl_data_index(dma_write_ctrl_data_index),
+        .dma_write_ctrl_data_length(dma_write_ctrl_data_length),
+        .dma_write_ctrl_data_size(dma_write_ctrl_data_size),
+        .dma_write_ctrl_data_user(dma_write_ctrl_data_user),
+        .dma_write_chnl_ready(dma_write_chnl_ready),
+        .dma_write_chnl_valid(dma_write_chnl_valid),
+        .dma_write_chnl_data(dma_write_chnl_data)
+    );
+
+endmodule
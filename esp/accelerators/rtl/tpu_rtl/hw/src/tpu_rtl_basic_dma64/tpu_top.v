@@ -0,0 +1 @@
+../tpu_rtl_basic_dma32/tpu_top.v
\ No newline at end of file
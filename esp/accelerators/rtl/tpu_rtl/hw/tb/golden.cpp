@@ -0,0 +1,332 @@
+// Copyright (c) 2011-2024 Columbia University, System Level Design Group
+// SPDX-License-Identifier: Apache-2.0
+
+#include "golden.hpp"
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+void tpu_cfg_reset(tpu_cfg *cfg)
+{
+    cfg->enable_norm       = false;
+    cfg->enable_pool       = false;
+    cfg->enable_activation = false;
+    cfg->activation_type   = true;
+    cfg->mean              = 0;
+    cfg->inv_var           = 0;
+    cfg->pool_window       = 1;
+    cfg->mask_a_rows       = 0xffff;
+    cfg->mask_a_cols       = 0xffff;
+    cfg->mask_b_rows       = 0xffff;
+    cfg->mask_b_cols       = 0xffff;
+}
+
+void tpu_state_reset(tpu_state *st) { memset(st->acc, 0, sizeof(st->acc)); }
+
+uint8_t tpu_downcast(uint16_t acc)
+{
+    // Bits 14:7 decide saturation for both signs. Note that a negative value with
+    // any of those bits set keeps its low 7 bits, and only the all-zero pattern
+    // saturates to 0x80.
+    bool overflow = (acc & 0x7f80) != 0;
+
+    if (!(acc & 0x8000)) return overflow ? 0x7f : (acc & 0x7f);
+    return overflow ? (0x80 | (acc & 0x7f)) : 0x80;
+}
+
+uint8_t tpu_norm(uint8_t x, uint8_t mean, uint8_t inv_var)
+{
+    uint8_t mean_applied = x - mean;
+    return (uint8_t)(mean_applied * inv_var);
+}
+
+uint8_t tpu_relu(uint8_t x)
+{
+    // The activation block tests inp_data_flopped[i*DWIDTH], i.e. the LSB of each lane
+    return (x & 1) ? 0 : x;
+}
+
+uint8_t tpu_tanh(uint8_t x)
+{
+    // Piecewise linear tanh (Y = A * X + B). The LUT address is computed with
+    // unsigned comparisons, so the negative ranges of the RTL are unreachable and
+    // every value >= 90 (including 0x80-0xff) selects the first segment.
+    uint8_t slope, intercept;
+
+    if (x >= 90) { slope = 0, intercept = 127; }
+    else if (x >= 39) { slope = 0, intercept = 99; }
+    else if (x >= 28) { slope = 2, intercept = 46; }
+    else if (x >= 16) { slope = 3, intercept = 18; }
+    else if (x >= 1) { slope = 4, intercept = 0; }
+    else { slope = 0, intercept = 0; }
+
+    return (uint8_t)(slope * x + intercept);
+}
+
+void tpu_pool(const uint8_t in[TPU_SIZE], uint8_t out[TPU_SIZE], unsigned window)
+{
+    // The pooling loops in the RTL only ever execute their first iteration, so a
+    // 2x2 or 4x4 window reduces lanes 0..window-1 into lane 0 and the other lanes
+    // keep the zeros they were reset to. Sums wrap at 8 bits before the shift.
+    memset(out, 0, TPU_SIZE);
+
+    switch (window) {
+        case 1: memcpy(out, in, TPU_SIZE); break;
+        case 2: out[0] = (uint8_t)(in[0] + in[1]) >> 1; break;
+        case 4: out[0] = (uint8_t)(in[0] + in[1] + in[2] + in[3]) >> 2; break;
+        default: break;
+    }
+}
+
+// Apply the validity masks the way systolic_data_setup does: A rows and B columns
+// gate individual lanes, A columns and B rows gate whole BRAM reads. Either way,
+// element [r][c] of the row-major operand survives iff bit r of row_mask and bit c
+// of col_mask are set.
+static const uint8_t *mask_operand(const int8_t *m, uint16_t row_mask, uint16_t col_mask,
+                                   uint8_t out[TPU_SIZE][TPU_SIZE])
+{
+    uint8_t col_bytes[TPU_SIZE];
+
+    if (row_mask == 0xffff && col_mask == 0xffff) return (const uint8_t *)m;
+
+    for (unsigned c = 0; c < TPU_SIZE; c++)
+        col_bytes[c] = ((col_mask >> c) & 1) ? 0xff : 0;
+
+    for (unsigned r = 0; r < TPU_SIZE; r++) {
+        uint8_t row_byte = ((row_mask >> r) & 1) ? 0xff : 0;
+        for (unsigned c = 0; c < TPU_SIZE; c++)
+            out[r][c] = (uint8_t)m[r * TPU_SIZE + c] & col_bytes[c] & row_byte;
+    }
+
+    return &out[0][0];
+}
+
+void tpu_matmul_16x16_systolic(tpu_state *st, const tpu_cfg *cfg, const int8_t *a,
+                               const int8_t *b)
+{
+    uint8_t buf_a[TPU_SIZE][TPU_SIZE];
+    uint8_t buf_b[TPU_SIZE][TPU_SIZE];
+    const uint8_t(*ma)[TPU_SIZE] = (const uint8_t(*)[TPU_SIZE])mask_operand(
+        a, cfg->mask_a_rows, cfg->mask_a_cols, buf_a);
+    const uint8_t(*mb)[TPU_SIZE] = (const uint8_t(*)[TPU_SIZE])mask_operand(
+        b, cfg->mask_b_rows, cfg->mask_b_cols, buf_b);
+
+    // Each PE (i, j) sees A[i][k] and B[k][j] for k = 0..15, in order
+    for (unsigned i = 0; i < TPU_SIZE; i++)
+        for (unsigned j = 0; j < TPU_SIZE; j++)
+            for (unsigned k = 0; k < TPU_SIZE; k++)
+                st->acc[i][j] = tpu_qadd(st->acc[i][j], tpu_qmult(ma[i][k], mb[k][j]));
+}
+
+void tpu_matmul_16x16_systolic_simd(tpu_state *st, const tpu_cfg *cfg, const int8_t *a,
+                                    const int8_t *b)
+{
+    uint8_t buf_a[TPU_SIZE][TPU_SIZE];
+    uint8_t buf_b[TPU_SIZE][TPU_SIZE];
+    const uint8_t(*ma)[TPU_SIZE] = (const uint8_t(*)[TPU_SIZE])mask_operand(
+        a, cfg->mask_a_rows, cfg->mask_a_cols, buf_a);
+    const uint8_t(*mb)[TPU_SIZE] = (const uint8_t(*)[TPU_SIZE])mask_operand(
+        b, cfg->mask_b_rows, cfg->mask_b_cols, buf_b);
+
+    // qadd wraps at 16 bits, so the order of the accumulation does not matter and a
+    // row of the PE array maps onto 16 lanes of u16 multiply-add.
+#if defined(__AVX2__)
+    __m256i vb[TPU_SIZE];
+
+    for (unsigned k = 0; k < TPU_SIZE; k++)
+        vb[k] = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)mb[k]));
+
+    for (unsigned i = 0; i < TPU_SIZE; i++) {
+        __m256i acc = _mm256_loadu_si256((const __m256i *)st->acc[i]);
+        for (unsigned k = 0; k < TPU_SIZE; k++) {
+            __m256i va = _mm256_set1_epi16(ma[i][k]);
+            acc        = _mm256_add_epi16(acc, _mm256_mullo_epi16(va, vb[k]));
+        }
+        _mm256_storeu_si256((__m256i *)st->acc[i], acc);
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t vb[TPU_SIZE];
+
+    for (unsigned k = 0; k < TPU_SIZE; k++)
+        vb[k] = vld1q_u8(mb[k]);
+
+    for (unsigned i = 0; i < TPU_SIZE; i++) {
+        uint16x8_t lo = vld1q_u16(&st->acc[i][0]);
+        uint16x8_t hi = vld1q_u16(&st->acc[i][8]);
+        for (unsigned k = 0; k < TPU_SIZE; k++) {
+            uint8x8_t va = vdup_n_u8(ma[i][k]);
+            lo           = vmlal_u8(lo, va, vget_low_u8(vb[k]));
+            hi           = vmlal_u8(hi, va, vget_high_u8(vb[k]));
+        }
+        vst1q_u16(&st->acc[i][0], lo);
+        vst1q_u16(&st->acc[i][8], hi);
+    }
+#else
+    for (unsigned i = 0; i < TPU_SIZE; i++)
+        for (unsigned k = 0; k < TPU_SIZE; k++)
+            for (unsigned j = 0; j < TPU_SIZE; j++)
+                st->acc[i][j] = tpu_qadd(st->acc[i][j], tpu_qmult(ma[i][k], mb[k][j]));
+#endif
+}
+
+// Activation tables, indexed by the 8-bit lane value
+static struct activation_luts {
+    uint8_t relu[256];
+    uint8_t tanh[256];
+    activation_luts()
+    {
+        for (unsigned x = 0; x < 256; x++) {
+            relu[x] = tpu_relu(x);
+            tanh[x] = tpu_tanh(x);
+        }
+    }
+} act_luts;
+
+void tpu_output_logic(const tpu_state *st, const tpu_cfg *cfg, int8_t *c)
+{
+    // The output pipeline consumes one column of C per cycle with lane i = row i.
+    // Every stage but pooling is lane-wise, so the array is walked row by row here.
+    uint8_t out[TPU_SIZE][TPU_SIZE];
+
+    for (unsigned i = 0; i < TPU_SIZE; i++) {
+        bool norm = cfg->enable_norm && ((cfg->mask_a_rows >> i) & 1);
+        for (unsigned j = 0; j < TPU_SIZE; j++) {
+            out[i][j] = tpu_downcast(st->acc[i][j]);
+            if (norm) out[i][j] = tpu_norm(out[i][j], cfg->mean, cfg->inv_var);
+        }
+    }
+
+    if (cfg->enable_pool) {
+        for (unsigned j = 0; j < TPU_SIZE; j++) {
+            uint8_t col[TPU_SIZE];
+            uint8_t pooled[TPU_SIZE];
+
+            for (unsigned i = 0; i < TPU_SIZE; i++)
+                col[i] = out[i][j];
+            tpu_pool(col, pooled, cfg->pool_window & 0x7);
+            for (unsigned i = 0; i < TPU_SIZE; i++)
+                out[i][j] = pooled[i];
+        }
+    }
+
+    if (cfg->enable_activation) {
+        const uint8_t *lut = cfg->activation_type ? act_luts.tanh : act_luts.relu;
+        for (unsigned i = 0; i < TPU_SIZE; i++)
+            for (unsigned j = 0; j < TPU_SIZE; j++)
+                out[i][j] = lut[out[i][j]];
+    }
+
+    memcpy(c, out, sizeof(out));
+}
+
+#if defined(__AVX2__)
+// tpu_downcast on 16 lanes
+static inline __m256i downcast_avx2(__m256i acc)
+{
+    __m256i low = _mm256_and_si256(acc, _mm256_set1_epi16(0x7f));
+    __m256i ok  = _mm256_cmpeq_epi16(_mm256_and_si256(acc, _mm256_set1_epi16(0x7f80)),
+                                     _mm256_setzero_si256());
+    __m256i pos = _mm256_blendv_epi8(_mm256_set1_epi16(0x7f), low, ok);
+    __m256i neg = _mm256_or_si256(_mm256_set1_epi16(0x80), _mm256_andnot_si256(ok, low));
+
+    return _mm256_blendv_epi8(pos, neg, _mm256_srai_epi16(acc, 15));
+}
+
+// tpu_tanh on 16 lanes holding 0..255, segments from the lowest up
+static inline __m256i tanh_avx2(__m256i x)
+{
+    __m256i y = _mm256_slli_epi16(x, 2);
+
+    y = _mm256_blendv_epi8(
+        y, _mm256_add_epi16(_mm256_mullo_epi16(x, _mm256_set1_epi16(3)), _mm256_set1_epi16(18)),
+        _mm256_cmpgt_epi16(x, _mm256_set1_epi16(15)));
+    y = _mm256_blendv_epi8(y, _mm256_add_epi16(_mm256_add_epi16(x, x), _mm256_set1_epi16(46)),
+                           _mm256_cmpgt_epi16(x, _mm256_set1_epi16(27)));
+    y = _mm256_blendv_epi8(y, _mm256_set1_epi16(99), _mm256_cmpgt_epi16(x, _mm256_set1_epi16(38)));
+    y = _mm256_blendv_epi8(y, _mm256_set1_epi16(127), _mm256_cmpgt_epi16(x, _mm256_set1_epi16(89)));
+
+    return _mm256_and_si256(y, _mm256_set1_epi16(0xff));
+}
+#endif
+
+void tpu_output_logic_simd(const tpu_state *st, const tpu_cfg *cfg, int8_t *c)
+{
+    // Same pipeline as tpu_output_logic with a row of C in 16 lanes of u16. Lanes
+    // hold 0..255 between stages and 8-bit wraparound is applied where it matters.
+#if defined(__AVX2__)
+    const __m256i byte = _mm256_set1_epi16(0xff);
+    __m256i row[TPU_SIZE];
+
+    for (unsigned i = 0; i < TPU_SIZE; i++) {
+        row[i] = downcast_avx2(_mm256_loadu_si256((const __m256i *)st->acc[i]));
+        if (cfg->enable_norm && ((cfg->mask_a_rows >> i) & 1)) {
+            __m256i x = _mm256_and_si256(_mm256_sub_epi16(row[i], _mm256_set1_epi16(cfg->mean)),
+                                         byte);
+            row[i]    = _mm256_and_si256(_mm256_mullo_epi16(x, _mm256_set1_epi16(cfg->inv_var)),
+                                         byte);
+        }
+    }
+
+    // tpu_pool down every column at once: only row 0 can be nonzero unless the
+    // window is 1x1
+    if (cfg->enable_pool && (cfg->pool_window & 0x7) != 1) {
+        __m256i sum = _mm256_setzero_si256();
+        unsigned shift;
+
+        switch (cfg->pool_window & 0x7) {
+            case 2: sum = _mm256_add_epi16(row[0], row[1]); shift = 1; break;
+            case 4:
+                sum   = _mm256_add_epi16(_mm256_add_epi16(row[0], row[1]),
+                                         _mm256_add_epi16(row[2], row[3]));
+                shift = 2;
+                break;
+            default: shift = 0; break;
+        }
+        row[0] = _mm256_srl_epi16(_mm256_and_si256(sum, byte), _mm_cvtsi32_si128(shift));
+        for (unsigned i = 1; i < TPU_SIZE; i++)
+            row[i] = _mm256_setzero_si256();
+    }
+
+    if (cfg->enable_activation) {
+        for (unsigned i = 0; i < TPU_SIZE; i++) {
+            if (cfg->activation_type) row[i] = tanh_avx2(row[i]);
+            else
+                row[i] = _mm256_andnot_si256(
+                    _mm256_cmpeq_epi16(_mm256_and_si256(row[i], _mm256_set1_epi16(1)),
+                                       _mm256_set1_epi16(1)),
+                    row[i]);
+        }
+    }
+
+    // packus interleaves the 128-bit halves of its operands, the permute puts
+    // rows i and i + 1 back in order
+    for (unsigned i = 0; i < TPU_SIZE; i += 2)
+        _mm256_storeu_si256((__m256i *)&c[i * TPU_SIZE],
+                            _mm256_permute4x64_epi64(_mm256_packus_epi16(row[i], row[i + 1]),
+                                                     0xd8));
+#else
+    tpu_output_logic(st, cfg, c);
+#endif
+}
+
+void tpu_top_run(tpu_state *st, const tpu_cfg *cfg, const int8_t *a, const int8_t *b,
+                 int8_t *c)
+{
+    tpu_matmul_16x16_systolic_simd(st, cfg, a, b);
+    tpu_output_logic_simd(st, cfg, c);
+}
+
+const char *tpu_golden_simd_path()
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__ARM_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2011-2024 Columbia University, System Level Design Group
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __TPU_GOLDEN_HPP__
+#define __TPU_GOLDEN_HPP__
+
+#include <stdint.h>
+
+//
+// Cycle-free, bit-exact model of tpu_top (hw/src/tpu_rtl_basic_dma32/tpu_top.v).
+//
+// Operand layout follows the BRAMs of tpu_top:
+//   - BRAM A word (address_mat_a + k * stride_a) holds column k of A, byte i = A[i][k]
+//   - BRAM B word (address_mat_b + k * stride_b) holds row k of B, byte j = B[k][j]
+//   - output_logic shifts C out one column at a time, starting from column 15, and
+//     tpu_top writes it back to BRAM A at address_mat_c, address_mat_c - stride_c, ...
+//   - norm, pool and activation raise their valid on the cycle the first column
+//     leaves them, so every stage keeps the column order of output_logic
+// The functions below take and return plain row-major 16x16 int8 matrices; lane i of
+// an output column vector is returned as c[i * TPU_SIZE + j].
+//
+
+#define TPU_SIZE 16
+
+struct tpu_cfg {
+    bool enable_norm;       // REG_ENABLES[1]
+    bool enable_pool;       // REG_ENABLES[2]
+    bool enable_activation; // REG_ENABLES[3]
+    bool activation_type;   // REG_ACTIVATION_CSR[0]: 0 = ReLU, 1 = TanH
+    uint8_t mean;           // REG_MEAN
+    uint8_t inv_var;        // REG_INV_VAR
+    uint8_t pool_window;    // REG_POOL_WINDOW[2:0]
+    uint16_t mask_a_rows;   // REG_VALID_MASK_A_ROWS (also the norm validity mask)
+    uint16_t mask_a_cols;   // REG_VALID_MASK_A_COLS
+    uint16_t mask_b_rows;   // REG_VALID_MASK_B_ROWS
+    uint16_t mask_b_cols;   // REG_VALID_MASK_B_COLS
+};
+
+// seq_mac keeps its 16-bit accumulator (out_temp) across runs until reset or
+// pe_reset clears it, so consecutive runs sum their products like the K tiles
+// of one C tile. tpu_state_reset() is that clear. pe_reset also empties the
+// operand and product flops in front of the adder, so nothing of the previous
+// run leaks into the first product of the new one.
+struct tpu_state {
+    uint16_t acc[TPU_SIZE][TPU_SIZE];
+};
+
+// Values loaded by the reset branch of the cfg block
+void tpu_cfg_reset(tpu_cfg *cfg);
+void tpu_state_reset(tpu_state *st);
+
+// qmult: unsigned 8x8 product on a 16-bit port
+static inline uint16_t tpu_qmult(uint8_t a, uint8_t b) { return (uint16_t)((unsigned)a * b); }
+
+// qadd: 16-bit add, carry out dropped
+static inline uint16_t tpu_qadd(uint16_t a, uint16_t b) { return (uint16_t)(a + b); }
+
+// seq_mac down cast of the accumulator to 8 bits
+uint8_t tpu_downcast(uint16_t acc);
+
+// Per-lane stages of the output pipeline
+uint8_t tpu_norm(uint8_t x, uint8_t mean, uint8_t inv_var);
+uint8_t tpu_relu(uint8_t x);
+uint8_t tpu_tanh(uint8_t x);
+void tpu_pool(const uint8_t in[TPU_SIZE], uint8_t out[TPU_SIZE], unsigned window);
+
+// Accumulate A * B into the PE array. The _simd flavor uses AVX2 or NEON when the
+// compiler targets them and falls back to the scalar loop otherwise.
+void tpu_matmul_16x16_systolic(tpu_state *st, const tpu_cfg *cfg, const int8_t *a,
+                               const int8_t *b);
+void tpu_matmul_16x16_systolic_simd(tpu_state *st, const tpu_cfg *cfg, const int8_t *a,
+                                    const int8_t *b);
+
+// Down cast the PE array and run it through norm -> pool -> activation. The _simd
+// flavor uses AVX2 when the compiler targets it and the scalar stages otherwise.
+void tpu_output_logic(const tpu_state *st, const tpu_cfg *cfg, int8_t *c);
+void tpu_output_logic_simd(const tpu_state *st, const tpu_cfg *cfg, int8_t *c);
+
+// One start_tpu: matmul followed by the output pipeline
+void tpu_top_run(tpu_state *st, const tpu_cfg *cfg, const int8_t *a, const int8_t *b,
+                 int8_t *c);
+
+// Name of the SIMD path selected at compile time ("avx2", "neon" or "scalar")
+const char *tpu_golden_simd_path();
+
+#endif // __TPU_GOLDEN_HPP__
@@ -0,0 +1,627 @@
+// Copyright (c) 2011-2024 Columbia University, System Level Design Group
+// SPDX-License-Identifier: Apache-2.0
+
+// Verilator regression of the ESP wrappers of tpu_top. The model is built with
+// --prefix Vtpu from either tpu_rtl_basic_dma32 or tpu_rtl_basic_dma64, and the
+// DMA beat width is taken from the generated port. A zero-latency model of the
+// ESP DMA serves the input buffer and collects the output, and every tile is
+// checked against the golden model. Tiles are run in batches of tiles_reg per
+// conf_done to exercise the double-buffered schedule of esp_tpu_datapath, and
+// with -w every reuse tiles share one A that is loaded only by the first batch
+// of them (weight-stationary mode). Like a row of B tiles in tpu_tile, batches
+// do not cross such a row, so a row that is not a multiple of the batch ends in
+// a short one. With -c the B tiles are built by the on-chip
+// im2col from a random feature map that is loaded once. With -k every k
+// consecutive tiles are the K tiles of one C tile: the PEs add them up, and
+// only the first clears what the previous C tile left in them.
+//
+// The DMA model has no latency and a beat per cycle by default. -l adds
+// cycles between a read request and its first beat, and -B caps the bytes
+// per cycle of each direction. With -S the harness runs a sweep of GEMM sizes
+// and norm, pooling and activation settings instead, scheduled like tpu_tile
+// does, and prints one CSV line per point with cycles per tile, PE
+// utilization and DMA stall cycles.
+
+#include "Vtpu.h"
+#include "golden.hpp"
+#include "verilated.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <type_traits>
+#include <vector>
+
+// Verilator 5 exposes ports as references
+typedef std::remove_reference<decltype(Vtpu::dma_read_chnl_data)>::type beat_t;
+static const unsigned BEAT_BYTES = sizeof(beat_t);
+
+#define TILE_BYTES  (TPU_SIZE * TPU_SIZE)
+#define MAX_CYCLES  100000
+
+struct dma_model {
+    std::vector<uint8_t> mem;
+    uint32_t src_offset; // bytes
+    uint32_t dst_offset; // bytes
+    uint32_t latency;    // cycles from a read request to its first beat
+    uint32_t bandwidth;  // bytes per cycle and direction, 0 for a beat per cycle
+
+    bool rd_active;
+    uint32_t rd_pos; // beats from src_offset
+    uint32_t rd_left;
+    uint32_t rd_wait;   // latency cycles left
+    uint32_t rd_credit; // bytes
+    bool wr_active;
+    uint32_t wr_pos; // beats from dst_offset
+    uint32_t wr_left;
+    uint32_t wr_credit;
+
+    uint64_t rd_beats;
+    uint64_t wr_beats;
+    uint64_t rd_stall; // cycles with a read in flight and no beat offered
+    uint64_t wr_stall; // cycles with a beat from the accelerator not taken
+};
+
+struct sim {
+    Vtpu *top;
+    dma_model dma;
+    uint64_t cycles;
+};
+
+static bool dma_can_beat(const dma_model *dma, uint32_t credit)
+{
+    return dma->bandwidth == 0 || credit >= BEAT_BYTES;
+}
+
+// Credit accrues bandwidth bytes per cycle, a beat spends BEAT_BYTES of it.
+// At most one beat is banked while the channel waits.
+static void dma_spend(const dma_model *dma, uint32_t *credit, bool beat)
+{
+    if (dma->bandwidth == 0) return;
+    if (beat) *credit -= BEAT_BYTES;
+    *credit += dma->bandwidth;
+    if (*credit > BEAT_BYTES + dma->bandwidth) *credit = BEAT_BYTES + dma->bandwidth;
+}
+
+static void dma_drive(Vtpu *top, const dma_model *dma)
+{
+    bool rd_valid = dma->rd_active && dma->rd_wait == 0 && dma_can_beat(dma, dma->rd_credit);
+    beat_t beat   = 0;
+
+    top->dma_read_ctrl_ready  = !dma->rd_active;
+    top->dma_write_ctrl_ready = !dma->wr_active;
+    top->dma_read_chnl_valid  = rd_valid;
+    if (rd_valid)
+        memcpy(&beat, &dma->mem[dma->src_offset + dma->rd_pos * BEAT_BYTES], BEAT_BYTES);
+    top->dma_read_chnl_data   = beat;
+    top->dma_write_chnl_ready = dma->wr_active && dma_can_beat(dma, dma->wr_credit);
+}
+
+static void tick(sim *s)
+{
+    Vtpu *top      = s->top;
+    dma_model *dma = &s->dma;
+
+    dma_drive(top, dma);
+    top->clk = 0;
+    top->eval();
+
+    bool rd_ctrl = top->dma_read_ctrl_valid && top->dma_read_ctrl_ready;
+    bool rd_chnl = top->dma_read_chnl_valid && top->dma_read_chnl_ready;
+    bool wr_ctrl = top->dma_write_ctrl_valid && top->dma_write_ctrl_ready;
+    bool wr_chnl = top->dma_write_chnl_valid && top->dma_write_chnl_ready;
+    uint32_t rd_index  = top->dma_read_ctrl_data_index;
+    uint32_t rd_length = top->dma_read_ctrl_data_length;
+    uint32_t wr_index  = top->dma_write_ctrl_data_index;
+    uint32_t wr_length = top->dma_write_ctrl_data_length;
+    beat_t wr_data     = top->dma_write_chnl_data;
+
+    if (dma->rd_active && !top->dma_read_chnl_valid) dma->rd_stall++;
+    if (top->dma_write_chnl_valid && !top->dma_write_chnl_ready) dma->wr_stall++;
+
+    top->clk = 1;
+    top->eval();
+    s->cycles++;
+
+    dma_spend(dma, &dma->rd_credit, rd_chnl);
+    dma_spend(dma, &dma->wr_credit, wr_chnl);
+    if (dma->rd_wait > 0) dma->rd_wait--;
+
+    if (rd_ctrl) {
+        dma->rd_active = rd_length != 0;
+        dma->rd_pos    = rd_index;
+        dma->rd_left   = rd_length;
+        dma->rd_wait   = dma->latency;
+    }
+    if (rd_chnl) {
+        dma->rd_pos++;
+        dma->rd_beats++;
+        if (--dma->rd_left == 0) dma->rd_active = false;
+    }
+    if (wr_ctrl) {
+        dma->wr_active = wr_length != 0;
+        dma->wr_pos    = wr_index;
+        dma->wr_left   = wr_length;
+    }
+    if (wr_chnl) {
+        memcpy(&dma->mem[dma->dst_offset + dma->wr_pos * BEAT_BYTES], &wr_data, BEAT_BYTES);
+        dma->wr_pos++;
+        dma->wr_beats++;
+        if (--dma->wr_left == 0) dma->wr_active = false;
+    }
+}
+
+// Configuration registers of the wrapper, see esp_tpu_controller.v
+struct tile_regs {
+    uint32_t activation; // 0 none, 1 ReLU, 2 TanH
+    uint32_t pooling;    // 1, 2 or 4
+    uint32_t norm;       // bit 0 enable, 15:8 mean, 23:16 inv_var
+    uint32_t ws;         // bit 0 weight-stationary, bit 1 load weights
+    uint32_t k_acc;      // tiles_reg 31:12, K tiles per C tile and K index of the first
+    uint32_t im2col;     // see esp_tpu_datapath.v
+    uint32_t fm_size;
+    uint32_t conv_pos;
+    uint32_t conv_out;
+};
+
+// Convolution for -c, the feature map is chans x height x width
+struct conv_geom {
+    unsigned chans, height, width, kernel, stride, pad;
+    unsigned out_h, out_w;
+    unsigned rows, cols; // of the im2col matrix
+    std::vector<uint8_t> fm;
+};
+
+static void conv_init(conv_geom *g)
+{
+    static const unsigned kernels[] = {1, 3, 3, 5};
+
+    g->chans  = 1 + rand() % 4;
+    g->height = 4 + rand() % 17;
+    g->width  = 4 + rand() % 17;
+    g->kernel = kernels[rand() & 3];
+    g->stride = 1 + rand() % 2;
+    g->pad    = rand() % (g->kernel / 2 + 1);
+    g->out_h  = (g->height + 2 * g->pad - g->kernel) / g->stride + 1;
+    g->out_w  = (g->width + 2 * g->pad - g->kernel) / g->stride + 1;
+    g->rows   = g->chans * g->kernel * g->kernel;
+    g->cols   = g->out_h * g->out_w;
+    g->fm.resize(g->chans * g->height * g->width);
+    for (unsigned i = 0; i < g->fm.size(); i++)
+        g->fm[i] = rand();
+}
+
+static int8_t im2col_at(const conv_geom *g, unsigned r, unsigned c)
+{
+    unsigned ch = r / (g->kernel * g->kernel);
+    unsigned ky = r / g->kernel % g->kernel;
+    unsigned kx = r % g->kernel;
+    int y       = (int)((c / g->out_w) * g->stride + ky) - (int)g->pad;
+    int x       = (int)((c % g->out_w) * g->stride + kx) - (int)g->pad;
+
+    if (r >= g->rows || c >= g->cols || y < 0 || y >= (int)g->height || x < 0 ||
+        x >= (int)g->width)
+        return 0;
+    return g->fm[(ch * g->height + y) * g->width + x];
+}
+
+static void regs_to_cfg(const tile_regs *r, tpu_cfg *cfg)
+{
+    tpu_cfg_reset(cfg);
+    cfg->enable_norm       = r->norm & 1;
+    cfg->mean              = r->norm >> 8;
+    cfg->inv_var           = r->norm >> 16;
+    cfg->enable_pool       = r->pooling > 1;
+    cfg->pool_window       = r->pooling & 7;
+    cfg->enable_activation = r->activation != 0;
+    cfg->activation_type   = r->activation == 2;
+}
+
+static void pack_a(uint8_t *dst, const int8_t *a)
+{
+    for (unsigned k = 0; k < TPU_SIZE; k++)
+        for (unsigned i = 0; i < TPU_SIZE; i++)
+            dst[k * TPU_SIZE + i] = a[i * TPU_SIZE + k];
+}
+
+// Run a batch of tiles through the wrapper, returns false on timeout. In
+// weight-stationary mode every tile uses a[0], and with im2col b is only used
+// by the golden model.
+static bool run_batch(sim *s, const tile_regs *r, const conv_geom *g, unsigned batch,
+                      const int8_t (*a)[TILE_BYTES], const int8_t (*b)[TILE_BYTES],
+                      int8_t (*c)[TILE_BYTES])
+{
+    uint8_t *in  = &s->dma.mem[s->dma.src_offset];
+    uint8_t *out = &s->dma.mem[s->dma.dst_offset];
+    Vtpu *top    = s->top;
+    unsigned tile_bytes;
+
+    // BRAM A takes one column of A per word, BRAM B one row of B per word
+    if (r->im2col & 1) {
+        if (r->ws & 2) {
+            pack_a(in, a[0]);
+            in += TILE_BYTES;
+        }
+        if (r->im2col & 2)
+            memcpy(in, g->fm.data(), g->fm.size());
+        tile_bytes = g->fm.size();
+    } else if (r->ws & 1) {
+        if (r->ws & 2) {
+            pack_a(in, a[0]);
+            in += TILE_BYTES;
+        }
+        for (unsigned t = 0; t < batch; t++)
+            memcpy(in + t * TILE_BYTES, b[t], TILE_BYTES);
+        tile_bytes = TILE_BYTES;
+    } else {
+        for (unsigned t = 0; t < batch; t++) {
+            pack_a(in + t * 2 * TILE_BYTES, a[t]);
+            memcpy(in + t * 2 * TILE_BYTES + TILE_BYTES, b[t], TILE_BYTES);
+        }
+        tile_bytes = 2 * TILE_BYTES;
+    }
+
+    top->data_in_reg    = tile_bytes;
+    top->data_out_reg   = TILE_BYTES;
+    top->activation_reg = r->activation;
+    top->pooling_reg    = r->pooling;
+    top->norm_reg       = r->norm;
+    top->tiles_reg      = batch | r->k_acc;
+    top->ws_reg         = r->ws;
+    top->im2col_reg     = r->im2col;
+    top->fm_size_reg    = r->fm_size;
+    top->conv_pos_reg   = r->conv_pos;
+    top->conv_out_reg   = r->conv_out;
+
+    top->conf_done = 1;
+    tick(s);
+    top->conf_done = 0;
+
+    for (unsigned n = 0; n < batch * MAX_CYCLES; n++) {
+        tick(s);
+        if (top->acc_done) {
+            // C comes back one column per word as well
+            for (unsigned t = 0; t < batch; t++)
+                for (unsigned j = 0; j < TPU_SIZE; j++)
+                    for (unsigned i = 0; i < TPU_SIZE; i++)
+                        c[t][i * TPU_SIZE + j] = out[t * TILE_BYTES + j * TPU_SIZE + i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// A run of tiles. Batches hold up to batch tiles and do not cross a row, and
+// with a weight-stationary row the first batch of each row loads its A.
+struct job {
+    unsigned tiles;
+    unsigned batch;
+    unsigned row;     // tiles sharing one A, 0 for a new A every tile
+    unsigned k_tiles; // tiles summed into one C tile, 0 or 1 for none
+    bool conv;        // B from the on-chip im2col, a row per row of B tiles
+    int activation;   // fixed settings, or random per batch when negative
+    int pooling;
+    int norm;
+};
+
+struct job_stats {
+    uint64_t cycles;
+    uint64_t rd_beats;
+    uint64_t wr_beats;
+    uint64_t rd_stall;
+    uint64_t wr_stall;
+    unsigned failed;
+    unsigned errors;
+};
+
+// Returns false on timeout. The golden state st follows the PE accumulators,
+// it is cleared before every tile that starts a C tile.
+static bool run_job(sim *s, tpu_state *st, const job *j, const conv_geom *g, job_stats *js)
+{
+    static const uint32_t pools[] = {1, 2, 4, 1};
+    std::vector<int8_t> a(j->batch * TILE_BYTES), b(j->batch * TILE_BYTES),
+        c(j->batch * TILE_BYTES);
+    int8_t (*a_tiles)[TILE_BYTES] = (int8_t (*)[TILE_BYTES])a.data();
+    int8_t (*b_tiles)[TILE_BYTES] = (int8_t (*)[TILE_BYTES])b.data();
+    int8_t (*c_tiles)[TILE_BYTES] = (int8_t (*)[TILE_BYTES])c.data();
+    unsigned n;
+
+    memset(js, 0, sizeof(*js));
+    js->cycles   = s->cycles;
+    js->rd_beats = s->dma.rd_beats;
+    js->wr_beats = s->dma.wr_beats;
+    js->rd_stall = s->dma.rd_stall;
+    js->wr_stall = s->dma.wr_stall;
+
+    for (unsigned t0 = 0; t0 < j->tiles; t0 += n) {
+        bool load = j->row == 0 || t0 % j->row == 0;
+        tile_regs r;
+        tpu_cfg cfg;
+
+        n = j->tiles - t0 < j->batch ? j->tiles - t0 : j->batch;
+        if (j->row && n > j->row - t0 % j->row) n = j->row - t0 % j->row;
+
+        r.k_acc    = 0;
+        r.im2col   = 0;
+        r.fm_size  = 0;
+        r.conv_pos = 0;
+        r.conv_out = 0;
+        if (j->conv) {
+            // A changes every batch and the feature map is loaded once
+            unsigned row_tiles = (g->rows + TPU_SIZE - 1) / TPU_SIZE;
+            unsigned row0      = (t0 / j->row % row_tiles) * TPU_SIZE;
+            unsigned col0      = (t0 % j->row) * TPU_SIZE;
+
+            for (unsigned i = 0; i < TILE_BYTES; i++)
+                a[i] = rand();
+            for (unsigned t = 0; t < n; t++) {
+                memcpy(a_tiles[t], a_tiles[0], TILE_BYTES);
+                for (unsigned k = 0; k < TPU_SIZE; k++)
+                    for (unsigned i = 0; i < TPU_SIZE; i++)
+                        b_tiles[t][k * TPU_SIZE + i] =
+                            im2col_at(g, row0 + k, col0 + t * TPU_SIZE + i);
+            }
+            r.ws       = 3;
+            r.im2col   = 1 | (t0 == 0 ? 2 : 0) | g->kernel << 4 | g->stride << 8 |
+                         g->pad << 12 | g->chans << 16;
+            r.fm_size  = g->height | g->width << 16;
+            r.conv_pos = row0 | col0 << 16;
+            r.conv_out = g->out_h | g->out_w << 16;
+        } else if (j->row) {
+            if (load)
+                for (unsigned i = 0; i < TILE_BYTES; i++)
+                    a[i] = rand();
+            for (unsigned t = 1; t < n; t++)
+                memcpy(a_tiles[t], a_tiles[0], TILE_BYTES);
+            r.ws = load ? 3 : 1;
+        } else {
+            for (unsigned i = 0; i < n * TILE_BYTES; i++)
+                a[i] = rand();
+            r.ws = 0;
+            if (j->k_tiles > 1) r.k_acc = j->k_tiles << 12 | (t0 % j->k_tiles) << 22;
+        }
+        if (!j->conv)
+            for (unsigned i = 0; i < n * TILE_BYTES; i++)
+                b[i] = rand();
+        r.activation = j->activation < 0 ? rand() % 3 : j->activation;
+        r.pooling    = j->pooling < 0 ? pools[rand() & 3] : j->pooling;
+        r.norm       = j->norm < 0 ? rand() & 0xffff01 : j->norm;
+
+        if (!run_batch(s, &r, g, n, a_tiles, b_tiles, c_tiles)) {
+            fprintf(stderr, "tiles %u-%u: no acc_done after %u cycles\n", t0, t0 + n - 1,
+                    n * MAX_CYCLES);
+            return false;
+        }
+
+        regs_to_cfg(&r, &cfg);
+        for (unsigned t = 0; t < n; t++) {
+            int8_t gold[TILE_BYTES];
+            unsigned tile_errors = 0;
+
+            if (j->k_tiles <= 1 || (t0 + t) % j->k_tiles == 0) tpu_state_reset(st);
+            tpu_top_run(st, &cfg, a_tiles[t], b_tiles[t], gold);
+
+            for (unsigned i = 0; i < TILE_BYTES; i++) {
+                if (c_tiles[t][i] != gold[i]) {
+                    if (js->errors + tile_errors < 10)
+                        fprintf(stderr, "tile %u C[%u][%u]: got %d, expected %d\n", t0 + t,
+                                i / TPU_SIZE, i % TPU_SIZE, c_tiles[t][i], gold[i]);
+                    tile_errors++;
+                }
+            }
+            js->errors += tile_errors;
+            js->failed += tile_errors != 0;
+        }
+    }
+
+    js->cycles   = s->cycles - js->cycles;
+    js->rd_beats = s->dma.rd_beats - js->rd_beats;
+    js->wr_beats = s->dma.wr_beats - js->wr_beats;
+    js->rd_stall = s->dma.rd_stall - js->rd_stall;
+    js->wr_stall = s->dma.wr_stall - js->wr_stall;
+
+    return true;
+}
+
+// Useful MACs over the peak of the TPU_SIZE x TPU_SIZE array, a tile is
+// TPU_SIZE^3 MACs
+static double pe_util(const job *j, const job_stats *js)
+{
+    return js->cycles ? (double)j->tiles * TPU_SIZE / js->cycles : 0;
+}
+
+// GEMM sizes and norm/pooling/activation settings of the -S sweep
+static const unsigned sweep_gemms[][3] = {
+    {16, 16, 16}, {64, 64, 64}, {128, 128, 128}, {16, 256, 16}, {256, 16, 256},
+};
+
+static const int sweep_post[][3] = {
+    // activation, pooling, norm
+    {0, 1, 0}, {1, 1, 0}, {2, 1, 0}, {1, 2, 0}, {1, 4, 0}, {1, 2, 0x401001},
+};
+
+// One CSV line per point on stdout, returns the number of failed tiles or -1
+// on timeout
+static int sweep(sim *s, tpu_state *st, unsigned batch)
+{
+    unsigned failed = 0;
+
+    printf("dma_bits,latency,bandwidth,m,k,n,tiles,batch,ws,activation,pooling,norm,"
+           "cycles,cycles_per_tile,pe_util,rd_beats,wr_beats,rd_stall,wr_stall,failed\n");
+
+    for (auto &gemm : sweep_gemms) {
+        for (auto &post : sweep_post) {
+            unsigned m_tiles = (gemm[0] + TPU_SIZE - 1) / TPU_SIZE;
+            unsigned k_tiles = (gemm[1] + TPU_SIZE - 1) / TPU_SIZE;
+            unsigned n_tiles = (gemm[2] + TPU_SIZE - 1) / TPU_SIZE;
+            job_stats js;
+            job j;
+
+            // tpu_tile order: K innermost when a C tile takes several K tiles,
+            // otherwise N innermost and weight-stationary across N
+            j.tiles      = m_tiles * k_tiles * n_tiles;
+            j.batch      = batch;
+            j.row        = k_tiles == 1 && n_tiles > 1 ? n_tiles : 0;
+            j.k_tiles    = k_tiles;
+            j.conv       = false;
+            j.activation = post[0];
+            j.pooling    = post[1];
+            j.norm       = post[2];
+
+            if (!run_job(s, st, &j, NULL, &js)) return -1;
+
+            printf("%u,%u,%u,%u,%u,%u,%u,%u,%u,%d,%d,%d,%llu,%.2f,%.4f,%llu,%llu,%llu,%llu,%u\n",
+                   BEAT_BYTES * 8, s->dma.latency, s->dma.bandwidth, gemm[0], gemm[1], gemm[2],
+                   j.tiles, j.batch, j.row != 0, j.activation, j.pooling, j.norm,
+                   (unsigned long long)js.cycles, (double)js.cycles / j.tiles,
+                   pe_util(&j, &js), (unsigned long long)js.rd_beats,
+                   (unsigned long long)js.wr_beats, (unsigned long long)js.rd_stall,
+                   (unsigned long long)js.wr_stall, js.failed);
+            failed += js.failed;
+        }
+    }
+
+    return failed;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n tiles] [-b batch] [-w reuse] [-c] [-k ktiles] [-s seed] [-f] "
+            "[-l latency] [-B bandwidth] [-S]\n",
+            name);
+    fprintf(stderr, "  -b  tiles per invocation (tiles_reg)\n");
+    fprintf(stderr, "  -w  weight-stationary, one A per reuse tiles\n");
+    fprintf(stderr, "  -c  convolution through the on-chip im2col\n");
+    fprintf(stderr, "  -k  sum ktiles consecutive tiles into one C tile\n");
+    fprintf(stderr, "  -f  keep norm, pooling and activation off\n");
+    fprintf(stderr, "  -l  DMA read latency in cycles\n");
+    fprintf(stderr, "  -B  DMA bytes per cycle and direction, 0 for a beat per cycle\n");
+    fprintf(stderr, "  -S  benchmark sweep, CSV on stdout\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned tiles     = 64;
+    unsigned batch     = 4;
+    unsigned reuse     = 0;
+    unsigned ktiles    = 0;
+    unsigned seed      = 1;
+    unsigned latency   = 0;
+    unsigned bandwidth = 0;
+    bool plain         = false;
+    bool conv          = false;
+    bool bench         = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:w:ck:s:fl:B:S")) != -1) {
+        switch (opt) {
+        case 'n': tiles = strtoul(optarg, NULL, 0); break;
+        case 'b': batch = strtoul(optarg, NULL, 0); break;
+        case 'w': reuse = strtoul(optarg, NULL, 0); break;
+        case 'c': conv = true; break;
+        case 'k': ktiles = strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        case 'f': plain = true; break;
+        case 'l': latency = strtoul(optarg, NULL, 0); break;
+        case 'B': bandwidth = strtoul(optarg, NULL, 0); break;
+        case 'S': bench = true; break;
+        default: usage(argv[0]);
+        }
+    }
+
+    // K accumulation needs a new A every tile
+    if (batch == 0 || ktiles >= 1024 || (ktiles > 1 && (reuse || conv))) usage(argv[0]);
+
+    Verilated::randReset(0);
+    srand(seed);
+
+    conv_geom g;
+    if (conv) conv_init(&g);
+
+    unsigned in_bytes = (batch * 2 + 1) * TILE_BYTES;
+    if (conv && in_bytes < TILE_BYTES + g.fm.size() + BEAT_BYTES)
+        in_bytes = TILE_BYTES + g.fm.size() + BEAT_BYTES;
+
+    sim s;
+    s.top            = new Vtpu;
+    s.cycles         = 0;
+    s.dma.mem        = std::vector<uint8_t>(in_bytes + batch * TILE_BYTES);
+    s.dma.src_offset = 0;
+    s.dma.dst_offset = in_bytes;
+    s.dma.latency    = latency;
+    s.dma.bandwidth  = bandwidth;
+    s.dma.rd_active  = false;
+    s.dma.rd_pos     = 0;
+    s.dma.rd_left    = 0;
+    s.dma.rd_wait    = 0;
+    s.dma.rd_credit  = 0;
+    s.dma.wr_active  = false;
+    s.dma.wr_pos     = 0;
+    s.dma.wr_left    = 0;
+    s.dma.wr_credit  = 0;
+    s.dma.rd_beats   = 0;
+    s.dma.wr_beats   = 0;
+    s.dma.rd_stall   = 0;
+    s.dma.wr_stall   = 0;
+
+    // ESP accelerator reset is active low
+    s.top->rst       = 0;
+    s.top->conf_done = 0;
+    for (unsigned n = 0; n < 8; n++)
+        tick(&s);
+    s.top->rst = 1;
+    tick(&s);
+
+    tpu_state st;
+    tpu_state_reset(&st);
+
+    if (bench) {
+        int failed = sweep(&s, &st, batch);
+
+        s.top->final();
+        delete s.top;
+        return failed != 0;
+    }
+
+    job j;
+    job_stats js;
+
+    j.tiles      = tiles;
+    j.batch      = batch;
+    j.row        = conv ? (g.cols + TPU_SIZE - 1) / TPU_SIZE : reuse;
+    j.k_tiles    = ktiles;
+    j.conv       = conv;
+    j.activation = plain ? 0 : -1;
+    j.pooling    = plain ? 1 : -1;
+    j.norm       = plain ? 0 : -1;
+
+    if (!run_job(&s, &st, &j, &g, &js)) {
+        delete s.top;
+        return 1;
+    }
+
+    printf("%u-bit DMA: %u tiles in batches of %u%s, %u failed (%u errors)\n", BEAT_BYTES * 8,
+           tiles, batch,
+           conv ? ", im2col" : reuse ? ", weight-stationary" : ktiles > 1 ? ", K accumulation" : "",
+           js.failed, js.errors);
+    if (conv)
+        printf("  conv %ux%ux%u, kernel %u, stride %u, pad %u\n", g.chans, g.height, g.width,
+               g.kernel, g.stride, g.pad);
+    if (latency || bandwidth)
+        printf("  DMA latency %u cycles, %u bytes/cycle\n", latency, bandwidth);
+    printf("  %.1f cycles/tile, %.1f read beats/tile, %.1f write beats/tile\n",
+           (double)js.cycles / tiles, (double)js.rd_beats / tiles, (double)js.wr_beats / tiles);
+    printf("  PE utilization %.1f%%, DMA stalls %llu read, %llu write cycles\n",
+           100 * pe_util(&j, &js), (unsigned long long)js.rd_stall,
+           (unsigned long long)js.wr_stall);
+
+    s.top->final();
+    delete s.top;
+
+    return js.errors ? 1 : 0;
+}
@@ -10,22 +10,27 @@
 #include <esp_probe.h>
 #include <fixed_point.h>
 
-typedef int32_t token_t;  // TPU uses 32-bit data
+typedef int8_t token_t;  // TPU operands and results are int8
 
 static unsigned DMA_WORD_PER_BEAT(unsigned _st) { return (sizeof(void *) / _st); }
 
-#define SLD_TPU_BASIC_DMA32 0x04b  // Unique device ID for TPU
-#define DEV_NAME            "sld,tpu_rtl_basic_dma32"
+#define SLD_TPU_RTL 0x04b           // device_id in hw/tpu.xml, shared by the DMA32 and DMA64 wrappers
+#define DEV_NAME    "sld,tpu_rtl"
 
 /* Configuration parameters for the TPU */
-const int32_t data_in_size = 128;   // Number of input elements
-const int32_t data_out_size = 128;  // Number of output elements
+const int32_t data_in_size = 512;   // Input bytes: 16 words of A^T, then 16 words of B
+const int32_t data_out_size = 256;  // Output bytes: 16 words, one column of C each
 const int32_t activation_type = 1;  // 0: None, 1: ReLU, 2: TanH
-const int32_t pooling_size = 2;     // 1: 1x1 (no pooling), 2: 2x2, 4: 4x4
+const int32_t pooling_size = 1;     // 1: no pooling, 2 or 4: reduce into row 0 of each column
 const int32_t norm_enable = 1;      // 0: Disabled, 1: Enabled
+const int32_t norm_mean = 1;        // Subtracted from every byte by norm
+const int32_t norm_inv_var = 3;     // Multiplies every byte after the mean
+const int32_t tiles = 1;            // Tiles per invocation, double buffered when > 1
+const int32_t ws_mode = 0;          // bit 0: weight-stationary, bit 1: load weights
+const int32_t im2col_mode = 0;      // bit 0: im2col, bit 1: load feature map
 
-/* Matrix dimensions for test */
-#define MATRIX_DIM 8 // 8x8 matrix (64 elements)
+/* Matrix dimensions for test, one 16x16 tile */
+#define MATRIX_DIM 16
 
 static unsigned in_words_adj;
 static unsigned out_words_adj;
@@ -47,63 +52,95 @@ static unsigned mem_size;
 #define TPU_ACTIVATION_REG      0x48
 #define TPU_POOLING_REG         0x4C
 #define TPU_NORM_REG            0x50
+#define TPU_TILES_REG           0x54
+#define TPU_WS_REG              0x58
+#define TPU_IM2COL_REG          0x5C
+#define TPU_FM_SIZE_REG         0x60
+#define TPU_CONV_POS_REG        0x64
+#define TPU_CONV_OUT_REG        0x68
 #define TPU_CONF_DONE_REG       0x34
 
-/* Simple matrix multiplication to generate gold output */
+/*
+ * Gold output, computed the way tpu_top does it (see hw/tb/golden.cpp, the
+ * bit-exact model this follows):
+ *   - each PE sums unsigned byte products in 16 bits, and the result is
+ *     saturated to int8;
+ *   - norm works lane-wise on bytes: (x - mean) * inv_var, wrapping at 8 bits;
+ *   - pooling works down a column of C: a window of 2 or 4 averages rows
+ *     0..window-1 into row 0, and the other rows read 0;
+ *   - ReLU zeroes a lane when its LSB is set (that is the bit the RTL tests),
+ *     and TanH is the piecewise linear table of the activation block.
+ * The tiles register leaves the K fields at 0, so the accumulators are cleared
+ * before every run and the coherence modes below do not add onto each other.
+ */
+static uint8_t downcast(uint16_t acc) {
+    int overflow = (acc & 0x7f80) != 0;
+
+    if (!(acc & 0x8000)) return overflow ? 0x7f : (acc & 0x7f);
+    return overflow ? (0x80 | (acc & 0x7f)) : 0x80;
+}
+
+static uint8_t tanh_lut(uint8_t x) {
+    uint8_t slope, intercept;
+
+    if (x >= 90) { slope = 0; intercept = 127; }
+    else if (x >= 39) { slope = 0; intercept = 99; }
+    else if (x >= 28) { slope = 2; intercept = 46; }
+    else if (x >= 16) { slope = 3; intercept = 18; }
+    else if (x >= 1) { slope = 4; intercept = 0; }
+    else { slope = 0; intercept = 0; }
+
+    return (uint8_t)(slope * x + intercept);
+}
+
 static void matrix_multiply(token_t *a, token_t *b, token_t *c, int dim) {
+    uint8_t out[MATRIX_DIM][MATRIX_DIM];
+
     for (int i = 0; i < dim; i++) {
         for (int j = 0; j < dim; j++) {
-            c[i * dim + j] = 0;
+            uint16_t acc = 0;
             for (int k = 0; k < dim; k++) {
-                c[i * dim + j] += a[i * dim + k] * b[k * dim + j];
-            }
-            
-            // Apply ReLU activation if enabled
-            if (activation_type == 1 && c[i * dim + j] < 0) {
-                c[i * dim + j] = 0;
-            }
-            // Apply TanH activation if enabled (simplified tanh approximation)
-            else if (activation_type == 2) {
-                if (c[i * dim + j] > 127) c[i * dim + j] = 127;
-                else if (c[i * dim + j] < -127) c[i * dim + j] = -127;
+                acc += (uint8_t)a[i * dim + k] * (uint8_t)b[k * dim + j];
             }
+            out[i][j] = downcast(acc);
+            if (norm_enable)
+                out[i][j] = (uint8_t)((uint8_t)(out[i][j] - norm_mean) * norm_inv_var);
         }
     }
-    
-    // Apply pooling if enabled (simple 2x2 max pooling)
-    if (pooling_size > 1) {
-        int pool_dim = dim / pooling_size;
-        token_t *temp = (token_t *) malloc(dim * dim * sizeof(token_t));
-        memcpy(temp, c, dim * dim * sizeof(token_t));
-        
-        for (int i = 0; i < pool_dim; i++) {
-            for (int j = 0; j < pool_dim; j++) {
-                token_t max_val = temp[i * 2 * dim + j * 2];
-                for (int pi = 0; pi < pooling_size; pi++) {
-                    for (int pj = 0; pj < pooling_size; pj++) {
-                        token_t val = temp[(i * 2 + pi) * dim + (j * 2 + pj)];
-                        if (val > max_val) max_val = val;
-                    }
-                }
-                c[i * pool_dim + j] = max_val;
-            }
+
+    if (pooling_size == 2 || pooling_size == 4) {
+        for (int j = 0; j < dim; j++) {
+            uint8_t sum = 0;
+            for (int i = 0; i < pooling_size; i++)
+                sum += out[i][j];
+            for (int i = 0; i < dim; i++)
+                out[i][j] = 0;
+            out[0][j] = sum >> (pooling_size == 2 ? 1 : 2);
+        }
+    }
+
+    for (int i = 0; i < dim; i++) {
+        for (int j = 0; j < dim; j++) {
+            if (activation_type == 1 && (out[i][j] & 1))
+                out[i][j] = 0;
+            else if (activation_type == 2)
+                out[i][j] = tanh_lut(out[i][j]);
+            c[i * dim + j] = (token_t)out[i][j];
         }
-        free(temp);
     }
 }
 
+/* The store unit writes C one column per BRAM word: out[j * MATRIX_DIM + i] = C[i][j] */
 static int validate_buf(token_t *out, token_t *gold) {
     int errors = 0;
-    int output_size = data_out_size;
-    
-    // If pooling is enabled, the output size is reduced
-    if (pooling_size > 1) {
-        output_size = data_out_size / (pooling_size * pooling_size);
-    }
-    
-    for (int i = 0; i < output_size; i++) {
-        if (gold[i] != out[i]) {
-            printf("Error at index %d: expected %d, got %d\n", i, gold[i], out[i]);
+
+    for (int i = 0; i < MATRIX_DIM * MATRIX_DIM; i++) {
+        int row = i / MATRIX_DIM;
+        int col = i % MATRIX_DIM;
+
+        if (gold[i] != out[col * MATRIX_DIM + row]) {
+            printf("Error at C[%d][%d]: expected %d, got %d\n", row, col, gold[i],
+                   out[col * MATRIX_DIM + row]);
             errors++;
             // Limit error reporting to avoid flood
             if (errors > 10) {
@@ -117,24 +154,25 @@ static int validate_buf(token_t *out, token_t *gold) {
 }
 
 static void init_buf(token_t *in, token_t *gold) {
-    // Split input buffer into matrix A and matrix B
-    token_t *matrix_a = in;
-    token_t *matrix_b = in + MATRIX_DIM * MATRIX_DIM;
-    
-    // Initialize matrix A with incrementing values
+    static token_t matrix_a[MATRIX_DIM * MATRIX_DIM];
+    static token_t matrix_b[MATRIX_DIM * MATRIX_DIM];
+
+    // Small operands, so the dot products stay below the int8 saturation point
     for (int i = 0; i < MATRIX_DIM; i++) {
         for (int j = 0; j < MATRIX_DIM; j++) {
-            matrix_a[i * MATRIX_DIM + j] = i + j;
+            matrix_a[i * MATRIX_DIM + j] = (i + j) & 3;
+            matrix_b[i * MATRIX_DIM + j] = (i == j) ? 3 : ((i + j) & 1);
         }
     }
-    
-    // Initialize matrix B with some pattern
-    for (int i = 0; i < MATRIX_DIM; i++) {
-        for (int j = 0; j < MATRIX_DIM; j++) {
-            matrix_b[i * MATRIX_DIM + j] = (i == j) ? 2 : 1; // Simple identity matrix with offset
+
+    // BRAM A word k holds column k of A, BRAM B word k holds row k of B
+    for (int k = 0; k < MATRIX_DIM; k++) {
+        for (int i = 0; i < MATRIX_DIM; i++) {
+            in[k * MATRIX_DIM + i] = matrix_a[i * MATRIX_DIM + k];
+            in[(MATRIX_DIM + k) * MATRIX_DIM + i] = matrix_b[k * MATRIX_DIM + i];
         }
     }
-    
+
     // Calculate expected output for validation
     matrix_multiply(matrix_a, matrix_b, gold, MATRIX_DIM);
     
@@ -196,7 +234,7 @@ int main(int argc, char *argv[]) {
     // Search for the device
     printf("Scanning device tree for %s...\n", DEV_NAME);
 
-    ndev = probe(&espdevs, VENDOR_SLD, SLD_TPU_BASIC_DMA32, DEV_NAME);
+    ndev = probe(&espdevs, VENDOR_SLD, SLD_TPU_RTL, DEV_NAME);
     if (ndev == 0) {
         printf("TPU accelerator not found\n");
         return 0;
@@ -253,12 +291,18 @@ int main(int argc, char *argv[]) {
             iowrite32(dev, SRC_OFFSET_REG, 0x0);
             iowrite32(dev, DST_OFFSET_REG, out_offset * sizeof(token_t));
 
-            // Pass TPU-specific configuration parameters
-            iowrite32(dev, TPU_DATA_IN_REG, data_in_size);
-            iowrite32(dev, TPU_DATA_OUT_REG, data_out_size);
+            // Pass TPU-specific configuration parameters, sizes in bytes
+            iowrite32(dev, TPU_DATA_IN_REG, in_size);
+            iowrite32(dev, TPU_DATA_OUT_REG, out_size);
             iowrite32(dev, TPU_ACTIVATION_REG, activation_type);
             iowrite32(dev, TPU_POOLING_REG, pooling_size);
-            iowrite32(dev, TPU_NORM_REG, norm_enable);
+            iowrite32(dev, TPU_NORM_REG, norm_enable | norm_mean << 8 | norm_inv_var << 16);
+            iowrite32(dev, TPU_TILES_REG, tiles);
+            iowrite32(dev, TPU_WS_REG, ws_mode);
+            iowrite32(dev, TPU_IM2COL_REG, im2col_mode);
+            iowrite32(dev, TPU_FM_SIZE_REG, 0);
+            iowrite32(dev, TPU_CONV_POS_REG, 0);
+            iowrite32(dev, TPU_CONV_OUT_REG, 0);
 
             // Flush (customize coherence model here)
             esp_flush(coherence);
@@ -12,8 +12,8 @@ typedef int8_t token_t;
 #define REG8 1
 #define REG9 1
 #define REG4 1
-#define REG5 1
-#define REG6 1
+#define REG5 0
+#define REG6 0
 #define REG7 1
 #define REG0 1
 #define REG1 1
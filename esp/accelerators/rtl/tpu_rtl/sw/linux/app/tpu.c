@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "libesp.h"
 #include "cfg.h"
+#include "tpu_tile.h"
 
 static unsigned in_words_adj;
 static unsigned out_words_adj;
@@ -60,6 +61,164 @@ static void init_parameters()
     size       = (out_offset * sizeof(token_t)) + out_size;
 }
 
+/* Tiled GEMM over several 16x16 tiles, including partial edge tiles */
+#define GEMM_M 40
+#define GEMM_K 72
+#define GEMM_N 24
+
+/* One output of the PEs: the 16-bit sum of unsigned products, saturated to int8 */
+static int32_t pe_saturate(uint16_t acc)
+{
+    if (!(acc & 0x8000)) return (acc & 0x7f80) ? 127 : (acc & 0x7f);
+    return (int8_t)((acc & 0x7f80) ? (0x80 | (acc & 0x7f)) : 0x80);
+}
+
+static int32_t gemm_gold(const int8_t *a, const int8_t *b, int i, int j)
+{
+    uint16_t acc = 0;
+    int k;
+
+    for (k = 0; k < GEMM_K; k++)
+        acc += (uint8_t)a[i * GEMM_K + k] * (uint8_t)b[k * GEMM_N + j];
+
+    return pe_saturate(acc);
+}
+
+/*
+ * Two passes over 5 K tiles: 0/1 operands that stay within int8, then 0..3
+ * operands whose sums saturate. The second pass starts with the PE accumulators
+ * holding the last C tile of the first, so it also checks that they are cleared.
+ */
+static int run_tiled_gemm()
+{
+    struct tpu_tile_ctx *ctx;
+    int8_t *a, *b;
+    int32_t *c;
+    int i, j, pass;
+    int errors = 0;
+
+    ctx = tpu_tile_open(cfg_000[0].devname, tpu_cfg_000[0].esp.coherence);
+    if (ctx == NULL) return 1;
+
+    a = malloc(GEMM_M * GEMM_K);
+    b = malloc(GEMM_K * GEMM_N);
+    c = malloc(GEMM_M * GEMM_N * sizeof(int32_t));
+
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < GEMM_M * GEMM_K; i++)
+            a[i] = pass ? i % 4 : (i % 3) == 0;
+        for (i = 0; i < GEMM_K * GEMM_N; i++)
+            b[i] = pass ? (i % 7) % 4 : (i % 5) < 2;
+
+        if (tpu_gemm(ctx, GEMM_M, GEMM_K, GEMM_N, a, GEMM_K, b, GEMM_N, c, GEMM_N)) errors++;
+
+        for (i = 0; i < GEMM_M; i++)
+            for (j = 0; j < GEMM_N; j++)
+                if (gemm_gold(a, b, i, j) != c[i * GEMM_N + j]) errors++;
+    }
+
+    printf("  > Tiled GEMM %dx%dx%d, 2 passes: %llu tiles, %llu ns waiting on the TPU\n",
+           GEMM_M, GEMM_K, GEMM_N, tpu_tile_count(ctx), tpu_tile_wait_ns(ctx));
+
+    free(a);
+    free(b);
+    free(c);
+    tpu_tile_close(ctx);
+
+    return errors;
+}
+
+/* Convolutions through tpu_conv2d, one per im2col path of tpu_tile.c */
+struct conv_case {
+    unsigned chans;
+    unsigned height;
+    unsigned width;
+    unsigned filters;
+    unsigned kernel;
+    unsigned stride;
+    unsigned pad;
+};
+
+static const struct conv_case conv_cases[] = {
+    {1, 12, 12, 20, 3, 1, 1}, /* K = 9: the TPU builds the B tiles on chip */
+    {3, 8, 8, 6, 3, 1, 1},    /* K = 27: B tiles gathered on the host */
+};
+
+static int32_t conv_gold(const int8_t *in, const int8_t *w, const struct conv_case *cc,
+                         unsigned f, unsigned y, unsigned x)
+{
+    uint16_t acc = 0;
+    unsigned ch, ky, kx;
+
+    for (ch = 0; ch < cc->chans; ch++)
+        for (ky = 0; ky < cc->kernel; ky++)
+            for (kx = 0; kx < cc->kernel; kx++) {
+                int iy = (int)(y * cc->stride + ky) - (int)cc->pad;
+                int ix = (int)(x * cc->stride + kx) - (int)cc->pad;
+
+                if (iy < 0 || iy >= (int)cc->height || ix < 0 || ix >= (int)cc->width) continue;
+                acc += (uint8_t)in[(ch * cc->height + iy) * cc->width + ix] *
+                       (uint8_t)w[((f * cc->chans + ch) * cc->kernel + ky) * cc->kernel + kx];
+            }
+
+    return pe_saturate(acc);
+}
+
+static int run_tiled_conv()
+{
+    struct tpu_tile_ctx *ctx;
+    int errors = 0;
+    unsigned n;
+
+    ctx = tpu_tile_open(cfg_000[0].devname, tpu_cfg_000[0].esp.coherence);
+    if (ctx == NULL) return 1;
+
+    for (n = 0; n < sizeof(conv_cases) / sizeof(conv_cases[0]); n++) {
+        const struct conv_case *cc = &conv_cases[n];
+        unsigned out_h = (cc->height + 2 * cc->pad - cc->kernel) / cc->stride + 1;
+        unsigned out_w = (cc->width + 2 * cc->pad - cc->kernel) / cc->stride + 1;
+        unsigned in_len = cc->chans * cc->height * cc->width;
+        unsigned w_len  = cc->filters * cc->chans * cc->kernel * cc->kernel;
+        unsigned f, y, x, i;
+        int8_t *in, *w;
+        int32_t *out;
+
+        in  = malloc(in_len);
+        w   = malloc(w_len);
+        out = malloc(cc->filters * out_h * out_w * sizeof(int32_t));
+
+        /* 0..3 operands, so the larger dot products saturate */
+        for (i = 0; i < in_len; i++)
+            in[i] = (i % 11) % 4;
+        for (i = 0; i < w_len; i++)
+            w[i] = (i % 5) % 4;
+
+        if (tpu_conv2d(ctx, in, cc->chans, cc->height, cc->width, w, cc->filters, cc->kernel,
+                       cc->stride, cc->pad, out))
+            errors++;
+
+        for (f = 0; f < cc->filters; f++)
+            for (y = 0; y < out_h; y++)
+                for (x = 0; x < out_w; x++)
+                    if (conv_gold(in, w, cc, f, y, x) != out[(f * out_h + y) * out_w + x])
+                        errors++;
+
+        printf("  > Tiled conv2d %ux%ux%u, %u filters %ux%u, stride %u, pad %u\n", cc->chans,
+               cc->height, cc->width, cc->filters, cc->kernel, cc->kernel, cc->stride, cc->pad);
+
+        free(in);
+        free(w);
+        free(out);
+    }
+
+    printf("  > %llu tiles, %llu ns waiting on the TPU\n", tpu_tile_count(ctx),
+           tpu_tile_wait_ns(ctx));
+
+    tpu_tile_close(ctx);
+
+    return errors;
+}
+
 int main(int argc, char **argv)
 {
     int errors;
@@ -100,6 +259,14 @@ int main(int argc, char **argv)
     free(gold);
     esp_free(buf);
 
+    printf("\n  ** TILED GEMM **\n");
+
+    errors += run_tiled_gemm();
+
+    printf("\n  ** TILED CONV2D **\n");
+
+    errors += run_tiled_conv();
+
     if (!errors) printf("+ Test PASSED\n");
     else
         printf("+ Test FAILED\n");
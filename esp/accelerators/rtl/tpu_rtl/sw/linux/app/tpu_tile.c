@@ -0,0 +1,425 @@
+// Copyright (c) 2011-2024 Columbia University, System Level Design Group
+// SPDX-License-Identifier: Apache-2.0
+#include "tpu_tile.h"
+
+struct tpu_tile_ctx {
+    esp_queue_t *queue; /* two entries, one per half */
+    contig_handle_t handle;
+    int8_t *buf;
+    struct tpu_rtl_access desc[2];
+    unsigned index[2]; /* sq index of the last descriptor queued for each half */
+
+    unsigned long long tiles;
+    unsigned long long wait_ns;
+};
+
+/* Fills a zero padded 16x16 row-major tile starting at (r0, c0) of an operand */
+typedef void (*tile_load_fn)(const void *src, unsigned r0, unsigned c0,
+                             int8_t tile[TPU_TILE_DIM][TPU_TILE_DIM]);
+
+struct matrix_src {
+    const int8_t *p;
+    unsigned rows;
+    unsigned cols;
+    unsigned ld;
+};
+
+struct im2col_src {
+    const int8_t *in;
+    unsigned chans;
+    unsigned height;
+    unsigned width;
+    unsigned kernel;
+    unsigned stride;
+    unsigned pad;
+    unsigned out_h;
+    unsigned out_w;
+    unsigned rows; /* chans * kernel * kernel */
+    unsigned cols; /* out_h * out_w */
+};
+
+static int tile_submit(struct tpu_tile_ctx *ctx, int half)
+{
+    return esp_queue_submit(ctx->queue, &ctx->desc[half], &ctx->index[half]);
+}
+
+static int tile_wait(struct tpu_tile_ctx *ctx, int half, unsigned tiles)
+{
+    struct timespec th_start;
+    struct timespec th_end;
+    int rc;
+
+    gettime(&th_start);
+    rc = esp_queue_wait(ctx->queue, ctx->index[half]);
+    gettime(&th_end);
+    if (rc < 0) fprintf(stderr, "tpu_tile: invocation failed: %s\n", strerror(-rc));
+
+    ctx->wait_ns += ts_subtract(&th_start, &th_end);
+    ctx->tiles += tiles;
+
+    return rc;
+}
+
+struct tpu_tile_ctx *tpu_tile_open(const char *devname, enum accelerator_coherence coherence)
+{
+    struct tpu_tile_ctx *ctx;
+    int i;
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL) return NULL;
+
+    ctx->queue = esp_queue_open(devname, 2);
+    if (ctx->queue == NULL) {
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->buf = contig_alloc(TPU_TILE_BUF_SIZE, &ctx->handle);
+    if (ctx->buf == NULL) {
+        esp_queue_close(ctx->queue);
+        free(ctx);
+        return NULL;
+    }
+
+    for (i = 0; i < 2; i++) {
+        struct tpu_rtl_access *desc = &ctx->desc[i];
+
+        desc->esp.contig       = contig_to_khandle(ctx->handle);
+        desc->esp.ddr_node     = contig_to_most_allocated(ctx->handle);
+        desc->esp.alloc_policy = CONTIG_ALLOC_PREFERRED;
+        desc->esp.coherence    = coherence;
+        desc->esp.run          = true;
+
+        /* Wrapper registers, see sw/baremetal/tpu.c. Sizes are in bytes so the
+         * same values work for the 32-bit and 64-bit DMA variants. */
+        desc->reg10      = TPU_TILE_IN_SIZE;  /* data_in, per tile */
+        desc->reg3       = TPU_TILE_OUT_SIZE; /* data_out, per tile */
+        desc->reg2       = 0;                 /* activation: none */
+        desc->reg1       = 1;                 /* pooling: 1x1 */
+        desc->reg0       = 0;                 /* norm: off */
+        desc->reg7       = TPU_TILE_BATCH;    /* tiles, set per batch */
+        desc->reg6       = 0;                 /* ws, set per batch */
+        desc->src_offset = i * TPU_TILE_HALF_SIZE;
+        desc->dst_offset = i * TPU_TILE_HALF_SIZE + TPU_TILE_OUT_OFFSET;
+    }
+
+    return ctx;
+}
+
+void tpu_tile_close(struct tpu_tile_ctx *ctx)
+{
+    esp_queue_close(ctx->queue);
+    contig_free(ctx->handle);
+    free(ctx);
+}
+
+unsigned long long tpu_tile_count(const struct tpu_tile_ctx *ctx) { return ctx->tiles; }
+
+unsigned long long tpu_tile_wait_ns(const struct tpu_tile_ctx *ctx) { return ctx->wait_ns; }
+
+static void matrix_load(const void *ptr, unsigned r0, unsigned c0,
+                        int8_t tile[TPU_TILE_DIM][TPU_TILE_DIM])
+{
+    const struct matrix_src *src = ptr;
+    unsigned rows                = src->rows - r0;
+    unsigned cols                = src->cols - c0;
+    unsigned i;
+
+    if (rows > TPU_TILE_DIM) rows = TPU_TILE_DIM;
+    if (cols > TPU_TILE_DIM) cols = TPU_TILE_DIM;
+
+    if (rows < TPU_TILE_DIM || cols < TPU_TILE_DIM) memset(tile, 0, TPU_TILE_DIM * TPU_TILE_DIM);
+
+    for (i = 0; i < rows; i++)
+        memcpy(tile[i], &src->p[(r0 + i) * src->ld + c0], cols);
+}
+
+static void im2col_load(const void *ptr, unsigned r0, unsigned c0,
+                        int8_t tile[TPU_TILE_DIM][TPU_TILE_DIM])
+{
+    const struct im2col_src *src = ptr;
+    unsigned i, j;
+
+    for (i = 0; i < TPU_TILE_DIM; i++) {
+        unsigned row = r0 + i;
+        unsigned kx  = row % src->kernel;
+        unsigned ky  = (row / src->kernel) % src->kernel;
+        unsigned ch  = row / (src->kernel * src->kernel);
+
+        for (j = 0; j < TPU_TILE_DIM; j++) {
+            unsigned col = c0 + j;
+            int y        = (int)((col / src->out_w) * src->stride + ky) - (int)src->pad;
+            int x        = (int)((col % src->out_w) * src->stride + kx) - (int)src->pad;
+
+            if (row >= src->rows || col >= src->cols || y < 0 || y >= (int)src->height ||
+                x < 0 || x >= (int)src->width)
+                tile[i][j] = 0;
+            else
+                tile[i][j] = src->in[(ch * src->height + y) * src->width + x];
+        }
+    }
+}
+
+/* Tile t of the schedule */
+struct tile_pos {
+    unsigned m0;
+    unsigned n0;
+    unsigned k0;
+};
+
+struct tile_sched {
+    unsigned ntiles;
+    unsigned n_tiles;
+    unsigned k_tiles;
+    bool ws; /* N innermost, otherwise K innermost so one C tile is finished at a time */
+    const struct im2col_src *im2col; /* B built on chip from this feature map */
+};
+
+static void tile_locate(const struct tile_sched *sched, unsigned t, struct tile_pos *pos)
+{
+    if (sched->ws) {
+        pos->n0 = (t % sched->n_tiles) * TPU_TILE_DIM;
+        pos->k0 = ((t / sched->n_tiles) % sched->k_tiles) * TPU_TILE_DIM;
+    } else {
+        pos->k0 = (t % sched->k_tiles) * TPU_TILE_DIM;
+        pos->n0 = ((t / sched->k_tiles) % sched->n_tiles) * TPU_TILE_DIM;
+    }
+    pos->m0 = (t / sched->k_tiles / sched->n_tiles) * TPU_TILE_DIM;
+}
+
+/* BRAM A takes A one column per word, so A is stored transposed */
+static void tile_pack_a(int8_t *dst, const struct tile_pos *pos, tile_load_fn a_load,
+                        const void *a_src)
+{
+    int8_t a_tile[TPU_TILE_DIM][TPU_TILE_DIM];
+    unsigned i, k;
+
+    a_load(a_src, pos->m0, pos->k0, a_tile);
+    for (k = 0; k < TPU_TILE_DIM; k++)
+        for (i = 0; i < TPU_TILE_DIM; i++)
+            dst[k * TPU_TILE_DIM + i] = a_tile[i][k];
+}
+
+/*
+ * C comes back from BRAM A one column per word, like A goes in. The PEs sum the
+ * K tiles of a C tile themselves, so only the output of the last one is kept:
+ * the int8 result of the whole K sum, which C only widens.
+ */
+static void tile_store(struct tpu_tile_ctx *ctx, int half, unsigned slot,
+                       const struct tile_pos *pos, unsigned m, unsigned k, unsigned n,
+                       int32_t *c, unsigned ldc)
+{
+    const int8_t *out = ctx->buf + half * TPU_TILE_HALF_SIZE + TPU_TILE_OUT_OFFSET +
+                        slot * TPU_TILE_OUT_SIZE;
+    unsigned rows     = m - pos->m0;
+    unsigned cols     = n - pos->n0;
+    unsigned i, j;
+
+    if (pos->k0 + TPU_TILE_DIM < k) return;
+
+    if (rows > TPU_TILE_DIM) rows = TPU_TILE_DIM;
+    if (cols > TPU_TILE_DIM) cols = TPU_TILE_DIM;
+
+    for (i = 0; i < rows; i++)
+        for (j = 0; j < cols; j++)
+            c[(pos->m0 + i) * ldc + pos->n0 + j] = out[j * TPU_TILE_DIM + i];
+}
+
+/* A batch of up to TPU_TILE_BATCH consecutive tiles of the schedule */
+struct tile_batch {
+    unsigned count;
+    struct tile_pos pos[TPU_TILE_BATCH];
+};
+
+/*
+ * Pack the batch starting at tile t0 into a half of the contig buffer and set up
+ * its invocation. BRAM B takes B one row per word. In weight-stationary order a
+ * batch does not cross a row of B tiles, and only the first batch of a row sends
+ * A (wrapper register ws, bit 0 mode, bit 1 load). Otherwise the tiles register
+ * also tells the PEs how many K tiles make up a C tile and where in the K loop
+ * the batch starts, so they clear their accumulators before each first K tile.
+ */
+static void batch_pack(struct tpu_tile_ctx *ctx, int half, unsigned t0,
+                       const struct tile_sched *sched, struct tile_batch *batch,
+                       tile_load_fn a_load, const void *a_src, tile_load_fn b_load,
+                       const void *b_src)
+{
+    struct tpu_rtl_access *desc = &ctx->desc[half];
+    int8_t *in                  = ctx->buf + half * TPU_TILE_HALF_SIZE;
+    unsigned s;
+
+    batch->count = sched->ntiles - t0;
+    if (sched->ws && batch->count > sched->n_tiles - t0 % sched->n_tiles)
+        batch->count = sched->n_tiles - t0 % sched->n_tiles;
+    if (batch->count > TPU_TILE_BATCH) batch->count = TPU_TILE_BATCH;
+
+    for (s = 0; s < batch->count; s++)
+        tile_locate(sched, t0 + s, &batch->pos[s]);
+
+    desc->reg5 = 0;
+    if (sched->im2col) {
+        const struct im2col_src *src = sched->im2col;
+        unsigned fm_size             = src->chans * src->height * src->width;
+        bool load                    = t0 % sched->n_tiles == 0;
+
+        /* The first batch also sends the feature map, from its own area */
+        if (t0 == 0) {
+            in = ctx->buf + TPU_TILE_FM_OFFSET;
+            memcpy(in + TPU_TILE_B_OFFSET, src->in, fm_size);
+        }
+        if (load) tile_pack_a(in + TPU_TILE_A_OFFSET, &batch->pos[0], a_load, a_src);
+
+        desc->reg10      = fm_size;
+        desc->reg6       = load ? 3 : 1;
+        desc->reg5       = 1 | (t0 == 0) << 1 | src->kernel << 4 | src->stride << 8 |
+                           src->pad << 12 | src->chans << 16;
+        desc->reg4       = src->height | src->width << 16;
+        desc->reg9       = batch->pos[0].k0 | batch->pos[0].n0 << 16;
+        desc->reg8       = src->out_h | src->out_w << 16;
+        desc->src_offset = in - ctx->buf;
+    } else if (sched->ws) {
+        bool load = t0 % sched->n_tiles == 0;
+
+        if (load) tile_pack_a(in + TPU_TILE_A_OFFSET, &batch->pos[0], a_load, a_src);
+        for (s = 0; s < batch->count; s++)
+            b_load(b_src, batch->pos[s].k0, batch->pos[s].n0,
+                   (int8_t(*)[TPU_TILE_DIM])(in + TPU_TILE_B_OFFSET + s * TPU_TILE_OUT_SIZE));
+
+        desc->reg10      = TPU_TILE_OUT_SIZE; /* B only */
+        desc->reg6       = load ? 3 : 1;
+        desc->src_offset = half * TPU_TILE_HALF_SIZE + (load ? 0 : TPU_TILE_B_OFFSET);
+    } else {
+        for (s = 0; s < batch->count; s++) {
+            int8_t *slot = in + s * TPU_TILE_IN_SIZE;
+
+            tile_pack_a(slot + TPU_TILE_A_OFFSET, &batch->pos[s], a_load, a_src);
+            b_load(b_src, batch->pos[s].k0, batch->pos[s].n0,
+                   (int8_t(*)[TPU_TILE_DIM])(slot + TPU_TILE_B_OFFSET));
+        }
+
+        desc->reg10      = TPU_TILE_IN_SIZE;
+        desc->reg6       = 0;
+        desc->src_offset = half * TPU_TILE_HALF_SIZE;
+    }
+    desc->reg7 = batch->count;
+    if (!sched->ws && sched->k_tiles > 1)
+        desc->reg7 |= sched->k_tiles << 12 | (t0 % sched->k_tiles) << 22;
+}
+
+static void batch_store(struct tpu_tile_ctx *ctx, int half, const struct tile_batch *batch,
+                        unsigned m, unsigned k, unsigned n, int32_t *c, unsigned ldc)
+{
+    unsigned s;
+
+    for (s = 0; s < batch->count; s++)
+        tile_store(ctx, half, s, &batch->pos[s], m, k, n, c, ldc);
+}
+
+static int tile_run(struct tpu_tile_ctx *ctx, unsigned m, unsigned k, unsigned n,
+                    tile_load_fn a_load, const void *a_src, tile_load_fn b_load,
+                    const void *b_src, const struct im2col_src *im2col, int32_t *c,
+                    unsigned ldc)
+{
+    unsigned m_tiles = (m + TPU_TILE_DIM - 1) / TPU_TILE_DIM;
+    struct tile_sched sched;
+    struct tile_batch batch[2];
+    unsigned i, t, next;
+    int half   = 0;
+    int errors = 0;
+
+    sched.k_tiles = (k + TPU_TILE_DIM - 1) / TPU_TILE_DIM;
+    sched.n_tiles = (n + TPU_TILE_DIM - 1) / TPU_TILE_DIM;
+    sched.ntiles  = m_tiles * sched.k_tiles * sched.n_tiles;
+    sched.ws      = sched.k_tiles == 1 && (sched.n_tiles > 1 || im2col != NULL);
+    sched.im2col  = im2col;
+
+    if (sched.k_tiles > TPU_TILE_K_MAX / TPU_TILE_DIM) {
+        fprintf(stderr, "tpu_gemm: K = %u exceeds %u\n", k, TPU_TILE_K_MAX);
+        return -1;
+    }
+
+    for (i = 0; i < m; i++)
+        memset(&c[i * ldc], 0, n * sizeof(int32_t));
+
+    if (sched.ntiles == 0) return 0;
+
+    batch_pack(ctx, half, 0, &sched, &batch[half], a_load, a_src, b_load, b_src);
+    if (tile_submit(ctx, half) < 0) return -1;
+
+    /*
+     * Batches alternate between the two halves. The next batch is packed and
+     * queued before the host waits for the current one, so the driver starts it
+     * as soon as the current one completes. The outputs of the current batch are
+     * stored while the next one runs, before its half is packed again.
+     */
+    for (t = 0; t < sched.ntiles; t = next, half ^= 1) {
+        next = t + batch[half].count;
+        if (next < sched.ntiles) {
+            batch_pack(ctx, half ^ 1, next, &sched, &batch[half ^ 1], a_load, a_src, b_load,
+                       b_src);
+            if (tile_submit(ctx, half ^ 1) < 0) {
+                errors++;
+                next = sched.ntiles;
+            }
+        }
+
+        if (tile_wait(ctx, half, batch[half].count) < 0) errors++;
+        batch_store(ctx, half, &batch[half], m, k, n, c, ldc);
+    }
+
+    return errors ? -1 : 0;
+}
+
+int tpu_gemm(struct tpu_tile_ctx *ctx, unsigned m, unsigned k, unsigned n, const int8_t *a,
+             unsigned lda, const int8_t *b, unsigned ldb, int32_t *c, unsigned ldc)
+{
+    struct matrix_src a_src = {a, m, k, lda};
+    struct matrix_src b_src = {b, k, n, ldb};
+
+    return tile_run(ctx, m, k, n, matrix_load, &a_src, matrix_load, &b_src, NULL, c, ldc);
+}
+
+int tpu_conv2d(struct tpu_tile_ctx *ctx, const int8_t *in, unsigned chans, unsigned height,
+               unsigned width, const int8_t *weights, unsigned filters, unsigned kernel,
+               unsigned stride, unsigned pad, int32_t *out)
+{
+    unsigned out_h, out_w, k;
+    struct matrix_src a_src;
+    struct im2col_src b_src;
+    bool on_chip;
+
+    if (kernel == 0 || stride == 0 || height + 2 * pad < kernel || width + 2 * pad < kernel) {
+        fprintf(stderr, "tpu_conv2d: invalid geometry\n");
+        return -1;
+    }
+
+    out_h = (height + 2 * pad - kernel) / stride + 1;
+    out_w = (width + 2 * pad - kernel) / stride + 1;
+    k     = chans * kernel * kernel;
+
+    a_src.p    = weights;
+    a_src.rows = filters;
+    a_src.cols = k;
+    a_src.ld   = k;
+
+    b_src.in     = in;
+    b_src.chans  = chans;
+    b_src.height = height;
+    b_src.width  = width;
+    b_src.kernel = kernel;
+    b_src.stride = stride;
+    b_src.pad    = pad;
+    b_src.out_h  = out_h;
+    b_src.out_w  = out_w;
+    b_src.rows   = k;
+    b_src.cols   = out_h * out_w;
+
+    /* Limits of the im2col stage of the accelerator, see esp_tpu_datapath.v. It runs
+     * in weight-stationary order, which needs a single K tile. */
+    on_chip = chans * height * width <= TPU_TILE_FM_MAX && kernel < 16 && stride < 16 &&
+              pad < 16 && k <= TPU_TILE_DIM && b_src.cols < 0x10000;
+
+    return tile_run(ctx, filters, k, out_h * out_w, matrix_load, &a_src, im2col_load, &b_src,
+                    on_chip ? &b_src : NULL,
+                    out, out_h * out_w);
+}
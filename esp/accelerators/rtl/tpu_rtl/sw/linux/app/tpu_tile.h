@@ -0,0 +1,121 @@
+// Copyright (c) 2011-2024 Columbia University, System Level Design Group
+// SPDX-License-Identifier: Apache-2.0
+#ifndef __TPU_TILE_H__
+#define __TPU_TILE_H__
+
+#include "libesp.h"
+#include "tpu_rtl.h"
+
+/*
+ * Tiled GEMM and convolution on top of the 16x16 TPU.
+ *
+ * Every CMD_REG start of tpu_rtl consumes up to TPU_TILE_BATCH pairs of 16x16 A
+ * and B tiles and returns one 16x16 C tile per pair. Within a start the wrapper
+ * loads the next tile while the current one computes. Larger problems are split
+ * into MxKxN tiles and run K innermost. The PEs keep their accumulators from one
+ * tile to the next and clear them before the first K tile of every C tile, so the
+ * host only reads the C tile that comes back with the last K tile.
+ *
+ * The PEs multiply unsigned bytes and accumulate into 16 bits, and C is
+ * saturated to int8. Results are exact for operands in [0, 127] and dot products
+ * up to 127; larger ones read 127 as long as they stay below 32768.
+ *
+ * With a single K tile and more than one N tile, tiles are run in
+ * weight-stationary order:
+ * N innermost, so one A tile serves a whole row of B tiles. The A tile is sent
+ * once with the first batch of the row and stays resident in the accelerator,
+ * and later batches carry B only. The device must not be shared with another
+ * process during a call.
+ *
+ * The contig buffer is split in two halves, each holding the inputs and outputs
+ * of one batch. While the TPU works on batch i out of one half, batch i+1 is
+ * packed into the other half and queued on the descriptor queue of the device,
+ * which starts it from the completion interrupt of batch i, so the accelerator
+ * does not wait for the host between two starts.
+ */
+
+#define TPU_TILE_DIM   16
+#define TPU_TILE_BATCH 8 /* tiles per invocation */
+#define TPU_TILE_K_MAX (1023 * TPU_TILE_DIM) /* K tiles per C tile fit in 10 bits */
+
+/* Layout of one half of the contig buffer (bytes): the inputs of every tile of
+ * the batch, then the outputs. In weight-stationary order the inputs are one A
+ * tile followed by the B tile of every slot. */
+#define TPU_TILE_A_OFFSET   0
+#define TPU_TILE_B_OFFSET   (TPU_TILE_DIM * TPU_TILE_DIM)
+#define TPU_TILE_IN_SIZE    (2 * TPU_TILE_DIM * TPU_TILE_DIM)
+#define TPU_TILE_OUT_OFFSET (TPU_TILE_BATCH * TPU_TILE_IN_SIZE)
+#define TPU_TILE_OUT_SIZE   (TPU_TILE_DIM * TPU_TILE_DIM)
+#define TPU_TILE_HALF_SIZE  (TPU_TILE_BATCH * (TPU_TILE_IN_SIZE + TPU_TILE_OUT_SIZE))
+
+/* Feature map for the on-chip im2col, after the two halves: one A tile, then
+ * up to TPU_TILE_FM_MAX bytes of feature map */
+#define TPU_TILE_FM_MAX     16384
+#define TPU_TILE_FM_OFFSET  (2 * TPU_TILE_HALF_SIZE)
+#define TPU_TILE_BUF_SIZE   (TPU_TILE_FM_OFFSET + TPU_TILE_B_OFFSET + TPU_TILE_FM_MAX)
+
+struct tpu_tile_ctx;
+
+/**
+ * tpu_tile_open - open a TPU instance for tiled execution
+ * @devname: device name under /dev, e.g. "tpu_rtl.0"
+ * @coherence: coherence mode used for every tile
+ *
+ * Allocates the double-buffered contig buffer and sets up a two-entry descriptor
+ * queue on the device, see esp_queue_open().
+ *
+ * Returns NULL on error.
+ */
+struct tpu_tile_ctx *tpu_tile_open(const char *devname, enum accelerator_coherence coherence);
+
+/**
+ * tpu_tile_close - release a context returned by tpu_tile_open
+ * @ctx: the context
+ */
+void tpu_tile_close(struct tpu_tile_ctx *ctx);
+
+/**
+ * tpu_gemm - C = A * B
+ * @ctx: TPU context
+ * @m, @k, @n: problem size
+ * @a: row-major M x K matrix, leading dimension @lda
+ * @b: row-major K x N matrix, leading dimension @ldb
+ * @c: row-major M x N matrix, leading dimension @ldc
+ *
+ * Edge tiles are zero padded. Norm, pooling and activation are disabled on the
+ * TPU: they do not distribute over partial sums and are left to the caller.
+ *
+ * C is not an int32 accumulation: every element is the int8 result of the
+ * full K sum, saturated by the PEs as described above, widened to int32.
+ *
+ * Returns 0 on success, or -1 if K exceeds TPU_TILE_K_MAX or an invocation
+ * failed.
+ */
+int tpu_gemm(struct tpu_tile_ctx *ctx, unsigned m, unsigned k, unsigned n, const int8_t *a,
+             unsigned lda, const int8_t *b, unsigned ldb, int32_t *c, unsigned ldc);
+
+/**
+ * tpu_conv2d - 2D convolution lowered to GEMM through im2col
+ * @ctx: TPU context
+ * @in: input feature map, @chans x @height x @width
+ * @weights: filters, @filters x @chans x @kernel x @kernel
+ * @out: output feature map, @filters x out_h x out_w, saturated int8 results
+ *       widened to int32 like C of tpu_gemm()
+ *
+ * out_h = (height + 2 * pad - kernel) / stride + 1, and likewise for out_w.
+ * The im2col matrix is never materialized. When the feature map fits in
+ * TPU_TILE_FM_MAX bytes and chans * kernel * kernel is at most TPU_TILE_DIM, it
+ * is sent once and the accelerator builds the B tiles on chip; otherwise B tiles
+ * are gathered from it on the host when they are packed.
+ *
+ * Returns 0 on success or -1 if an invocation failed.
+ */
+int tpu_conv2d(struct tpu_tile_ctx *ctx, const int8_t *in, unsigned chans, unsigned height,
+               unsigned width, const int8_t *weights, unsigned filters, unsigned kernel,
+               unsigned stride, unsigned pad, int32_t *out);
+
+/* Number of tiles run and time spent waiting on the accelerator since tpu_tile_open */
+unsigned long long tpu_tile_count(const struct tpu_tile_ctx *ctx);
+unsigned long long tpu_tile_wait_ns(const struct tpu_tile_ctx *ctx);
+
+#endif /* __TPU_TILE_H__ */
@@ -36,7 +36,7 @@ static struct of_device_id tpu_device_ids[] = {
         .name = "SLD_TPU_RTL",
     },
     {
-        .name = "eb_04a",
+        .name = "eb_04b",
     },
     {
         .compatible = "sld,tpu_rtl",
@@ -24,8 +24,13 @@ module dromajo_bootrom (
     localparam int RomSize = 4096;
     logic [63:0] mem[RomSize-1:0];
 
+`ifdef DROMAJO
+    import "DPI-C" function int dromajo_ckpt_open(string ckpt_f_name, string region);
+    import "DPI-C" function int dromajo_ckpt_next(int handle, output longint index, output longint value);
+`endif
+
     initial begin
-      integer hex_file, num_bytes;
+      integer hex_file, num_bytes, ckpt;
       longint address, value;
       string f_name;
       // init to 0
@@ -35,12 +40,22 @@ module dromajo_bootrom (
 
       // sync with dromajo
       if ($value$plusargs("checkpoint=%s", f_name)) begin
-        hex_file = $fopen({f_name,".bootram.hex"}, "r");
-        while (!$feof(hex_file)) begin
-          num_bytes = $fscanf(hex_file, "%d %h\n", address, value);
-          //$display("%d %h", address, value);
+        // compact checkpoint (dromajo --save_format 2) if there is one
+        ckpt = 0;
+`ifdef DROMAJO
+        ckpt = dromajo_ckpt_open({f_name,".ckpt"}, "bootram");
+        while (ckpt != 0 && dromajo_ckpt_next(ckpt, address, value) != 0) begin
           mem[address] = value;
         end
+`endif
+        if (ckpt == 0) begin
+          hex_file = $fopen({f_name,".bootram.hex"}, "r");
+          while (!$feof(hex_file)) begin
+            num_bytes = $fscanf(hex_file, "%d %h\n", address, value);
+            //$display("%d %h", address, value);
+            mem[address] = value;
+          end
+        end
         $display("Done syncing boot ROM with dromajo...\n");
       end else begin
         $display("Failed syncing boot ROM: provide path to a checkpoint.\n");
@@ -44,12 +44,17 @@ module dromajo_ram
 
   logic [DATA_BYTES*8-1:0] Mem_DP[DATA_DEPTH-1:0];
 
+`ifdef DROMAJO
+  import "DPI-C" function int dromajo_ckpt_open(string ckpt_f_name, string region);
+  import "DPI-C" function int dromajo_ckpt_next(int handle, output longint index, output longint value);
+`endif
+
   ////////////////////////////
   // DROMAJO COSIM OPTION
   // sync rams
   ////////////////////////////\
   initial begin
-    integer hex_file, num_bytes;
+    integer hex_file, num_bytes, ckpt;
     longint address, value;
     string f_name;
     // init to 0
@@ -59,12 +64,22 @@ module dromajo_ram
 
     // sync with dromajo
     if ($value$plusargs("checkpoint=%s", f_name)) begin
-      hex_file = $fopen({f_name,".mainram.hex"}, "r");
-      while (!$feof(hex_file)) begin
-        num_bytes = $fscanf(hex_file, "%d %h\n", address, value);
-        //$display("%d %h", address, value);
+      // compact checkpoint (dromajo --save_format 2) if there is one
+      ckpt = 0;
+`ifdef DROMAJO
+      ckpt = dromajo_ckpt_open({f_name,".ckpt"}, "mainram");
+      while (ckpt != 0 && dromajo_ckpt_next(ckpt, address, value) != 0) begin
         Mem_DP[address] = value;
       end
+`endif
+      if (ckpt == 0) begin
+        hex_file = $fopen({f_name,".mainram.hex"}, "r");
+        while (!$feof(hex_file)) begin
+          num_bytes = $fscanf(hex_file, "%d %h\n", address, value);
+          //$display("%d %h", address, value);
+          Mem_DP[address] = value;
+        end
+      end
       $display("Done syncing RAM with dromajo...\n");
     end else begin
       $display("Failed syncing RAM: provide path to a checkpoint.\n");
@@ -34,6 +34,12 @@ dromajo_cosim_state_t* dromajo_pointer;
 bool kill_soon = false;
 uint32_t counter = 0;
 
+/**
+ * checkpoint regions being read into RTL memories,
+ * see dromajo_ckpt_open
+ */
+std::vector<dromajo_cosim_ckpt_t*> ckpt_regions;
+
 /**
  * Initialize dromajo emulator
  *
@@ -100,3 +106,51 @@ extern "C" void dromajo_trap(int      hart_id,
   std::cout << "Dromajo trapping. Cause = " << cause << std::endl;
   dromajo_cosim_raise_trap(dromajo_pointer, hart_id, cause);
 }
+
+/**
+ * Open a memory region of a compact checkpoint
+ *
+ * Lets the RTL memories load the checkpoint (dromajo --save_format 2)
+ * that dromajo itself is started from with "load" in its config.
+ *
+ * @param ckpt_f_name - the .ckpt file
+ * @param region      - "bootram" or "mainram"
+ * @return handle for dromajo_ckpt_next, 0 if there is no such checkpoint
+ */
+extern "C" int dromajo_ckpt_open(const char* ckpt_f_name,
+                                 const char* region) {
+  dromajo_cosim_ckpt_t* ckpt = dromajo_cosim_ckpt_open(ckpt_f_name, region);
+  if (!ckpt)
+    return 0;
+
+  ckpt_regions.push_back(ckpt);
+  return ckpt_regions.size();
+}
+
+/**
+ * Get the next non-zero 64-bit word of a checkpoint region
+ *
+ * @param handle - from dromajo_ckpt_open
+ * @param index  - word index from the start of the region
+ * @param value  - the word
+ * @return 0 once the region has been read, and closes it
+ */
+extern "C" int dromajo_ckpt_next(int        handle,
+                                 long long* index,
+                                 long long* value) {
+  dromajo_cosim_ckpt_t*& ckpt = ckpt_regions[handle - 1];
+  uint64_t i, v;
+
+  if (!ckpt)
+    return 0;
+
+  if (!dromajo_cosim_ckpt_next(ckpt, &i, &v)) {
+    dromajo_cosim_ckpt_close(ckpt);
+    ckpt = NULL;
+    return 0;
+  }
+
+  *index = i;
+  *value = v;
+  return 1;
+}
@@ -0,0 +1,222 @@
+/*
+ * Compact checkpoint files
+ *
+ * Copyright (C) 2018,2019, Esperanto Technologies Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "checkpoint.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct CheckpointFile {
+    const uint8_t *base;
+    size_t         size;
+};
+
+static uint64_t block_size(uint64_t size, uint64_t i)
+{
+    uint64_t left = size - i * CHECKPOINT_BLOCK_SIZE;
+
+    return left < CHECKPOINT_BLOCK_SIZE ? left : CHECKPOINT_BLOCK_SIZE;
+}
+
+static bool is_zero(const uint8_t *p, uint64_t size)
+{
+    for (; size >= 8; p += 8, size -= 8)
+        if (*(const uint64_t *)p)
+            return false;
+    for (; size; ++p, --size)
+        if (*p)
+            return false;
+
+    return true;
+}
+
+static void pwrite_all(int fd, const void *buf, uint64_t size, uint64_t offset, const char *file)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    while (size) {
+        ssize_t written = pwrite(fd, p, size, offset);
+        if (written <= 0)
+            err(-3, "while writing %s", file);
+        p      += written;
+        offset += written;
+        size   -= written;
+    }
+}
+
+void checkpoint_save(const char *file, const CheckpointMemory *mem, int n)
+{
+    int fd = open(file, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+
+    if (fd < 0)
+        err(-3, "trying to write %s", file);
+
+    CheckpointHeader  header;
+    CheckpointRegion *region = (CheckpointRegion *)calloc(n, sizeof *region);
+    uint64_t        **blocks = (uint64_t **)calloc(n, sizeof *blocks);
+    uint64_t          offset = sizeof header + n * sizeof *region;
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof header.magic);
+    header.version   = CHECKPOINT_VERSION;
+    header.n_regions = n;
+
+    for (int i = 0; i < n; ++i) {
+        uint64_t n_blocks = (mem[i].size + CHECKPOINT_BLOCK_SIZE - 1) / CHECKPOINT_BLOCK_SIZE;
+
+        strncpy(region[i].name, mem[i].name, sizeof region[i].name - 1);
+        region[i].addr = mem[i].addr;
+        region[i].size = mem[i].size;
+
+        blocks[i] = (uint64_t *)malloc(n_blocks * sizeof *blocks[i] + 1);
+        for (uint64_t b = 0; b < n_blocks; ++b)
+            if (!is_zero(mem[i].mem + b * CHECKPOINT_BLOCK_SIZE, block_size(mem[i].size, b)))
+                blocks[i][region[i].n_blocks++] = b;
+
+        region[i].index_offset = offset;
+        offset += region[i].n_blocks * sizeof *blocks[i];
+    }
+
+    for (int i = 0; i < n; ++i) {
+        offset = (offset + CHECKPOINT_BLOCK_SIZE - 1) & ~(uint64_t)(CHECKPOINT_BLOCK_SIZE - 1);
+        region[i].data_offset = offset;
+        offset += region[i].n_blocks * CHECKPOINT_BLOCK_SIZE;
+    }
+
+    pwrite_all(fd, &header, sizeof header, 0, file);
+    pwrite_all(fd, region, n * sizeof *region, sizeof header, file);
+
+    for (int i = 0; i < n; ++i) {
+        pwrite_all(fd, blocks[i], region[i].n_blocks * sizeof *blocks[i], region[i].index_offset, file);
+
+        /* The last block may be short, the file keeps it full size */
+        for (uint64_t j = 0; j < region[i].n_blocks; ++j)
+            pwrite_all(fd, mem[i].mem + blocks[i][j] * CHECKPOINT_BLOCK_SIZE,
+                       block_size(mem[i].size, blocks[i][j]),
+                       region[i].data_offset + j * CHECKPOINT_BLOCK_SIZE, file);
+        free(blocks[i]);
+    }
+
+    if (ftruncate(fd, offset) < 0)
+        err(-3, "while writing %s", file);
+
+    close(fd);
+    free(blocks);
+    free(region);
+}
+
+CheckpointFile *checkpoint_open(const char *file)
+{
+    int fd = open(file, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    void       *base = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CheckpointHeader))
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        return NULL;
+
+    CheckpointFile         *c      = (CheckpointFile *)malloc(sizeof *c);
+    const CheckpointHeader *header = (const CheckpointHeader *)base;
+
+    c->base = (const uint8_t *)base;
+    c->size = st.st_size;
+
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof header->magic) != 0 ||
+        header->version != CHECKPOINT_VERSION ||
+        c->size < sizeof *header + header->n_regions * sizeof(CheckpointRegion))
+        goto invalid;
+
+    for (uint32_t i = 0; i < header->n_regions; ++i) {
+        const CheckpointRegion *r = (const CheckpointRegion *)(header + 1) + i;
+
+        if (r->n_blocks > (r->size + CHECKPOINT_BLOCK_SIZE - 1) / CHECKPOINT_BLOCK_SIZE ||
+            r->index_offset + r->n_blocks * sizeof(uint64_t) > c->size ||
+            r->data_offset % CHECKPOINT_BLOCK_SIZE != 0 ||
+            r->data_offset + r->n_blocks * CHECKPOINT_BLOCK_SIZE > c->size)
+            goto invalid;
+    }
+
+    return c;
+
+ invalid:
+    checkpoint_close(c);
+    return NULL;
+}
+
+void checkpoint_close(CheckpointFile *c)
+{
+    munmap((void *)c->base, c->size);
+    free(c);
+}
+
+const CheckpointRegion *checkpoint_find(const CheckpointFile *c, const char *name)
+{
+    const CheckpointHeader *header = (const CheckpointHeader *)c->base;
+    const CheckpointRegion *r      = (const CheckpointRegion *)(header + 1);
+
+    for (uint32_t i = 0; i < header->n_regions; ++i, ++r)
+        if (strncmp(r->name, name, sizeof r->name) == 0)
+            return r;
+
+    return NULL;
+}
+
+const uint64_t *checkpoint_blocks(const CheckpointFile *c, const CheckpointRegion *r)
+{
+    return (const uint64_t *)(c->base + r->index_offset);
+}
+
+const uint8_t *checkpoint_block_data(const CheckpointFile *c, const CheckpointRegion *r, uint64_t i)
+{
+    return c->base + r->data_offset + i * CHECKPOINT_BLOCK_SIZE;
+}
+
+bool checkpoint_load(const CheckpointFile *c, const char *name, uint8_t *mem, uint64_t size)
+{
+    const CheckpointRegion *r = checkpoint_find(c, name);
+
+    if (!r || r->size != size)
+        return false;
+
+    const uint64_t *blocks   = checkpoint_blocks(c, r);
+    uint64_t        n_blocks = (size + CHECKPOINT_BLOCK_SIZE - 1) / CHECKPOINT_BLOCK_SIZE;
+    uint64_t        j        = 0;
+
+    /* Checking before clearing keeps untouched RAM unallocated */
+    for (uint64_t b = 0; b < n_blocks; ++b) {
+        uint8_t *p  = mem + b * CHECKPOINT_BLOCK_SIZE;
+        uint64_t sz = block_size(size, b);
+
+        if (j < r->n_blocks && blocks[j] == b)
+            memcpy(p, checkpoint_block_data(c, r, j++), sz);
+        else if (!is_zero(p, sz))
+            memset(p, 0, sz);
+    }
+
+    return j == r->n_blocks;
+}
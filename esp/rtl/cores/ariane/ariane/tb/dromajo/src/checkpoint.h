@@ -0,0 +1,78 @@
+/*
+ * Compact checkpoint files
+ *
+ * Copyright (C) 2018,2019, Esperanto Technologies Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A checkpoint saved with --save_format 2 holds the memory regions of
+ * the machine, the boot ROM that restores the CPU and CLINT state among
+ * them, in one file. Regions are cut in blocks, blocks that are all zero
+ * are left out, and the others are stored page aligned so that a loader
+ * can use them in place after mmap(). The layout, little endian, is
+ *
+ *   CheckpointHeader
+ *   CheckpointRegion  [n_regions]
+ *   uint64_t          block numbers of each region, ascending
+ *   uint8_t           blocks of each region, from a page boundary
+ */
+#define CHECKPOINT_MAGIC      "DROMCKPT"
+#define CHECKPOINT_VERSION    1
+#define CHECKPOINT_BLOCK_SIZE 4096
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t n_regions;
+} CheckpointHeader;
+
+typedef struct {
+    char     name[16]; /* "bootram", "mainram" */
+    uint64_t addr;
+    uint64_t size;
+    uint64_t n_blocks;
+    uint64_t index_offset;
+    uint64_t data_offset;
+} CheckpointRegion;
+
+typedef struct {
+    const char    *name;
+    uint64_t       addr;
+    const uint8_t *mem;
+    uint64_t       size;
+} CheckpointMemory;
+
+typedef struct CheckpointFile CheckpointFile;
+
+void checkpoint_save(const char *file, const CheckpointMemory *mem, int n);
+
+/* NULL if the file does not exist or is not a checkpoint */
+CheckpointFile *checkpoint_open(const char *file);
+void checkpoint_close(CheckpointFile *c);
+
+const CheckpointRegion *checkpoint_find(const CheckpointFile *c, const char *name);
+const uint64_t *checkpoint_blocks(const CheckpointFile *c, const CheckpointRegion *r);
+const uint8_t *checkpoint_block_data(const CheckpointFile *c, const CheckpointRegion *r, uint64_t i);
+
+/* Copy region name into mem, zeroing what the checkpoint left out */
+bool checkpoint_load(const CheckpointFile *c, const char *name, uint8_t *mem, uint64_t size);
+
+#endif
@@ -46,6 +46,26 @@
 
 int iterate_core(RISCVMachine *m, int hartid)
 {
+    /* Nothing is printed before the trace starts, so run whole quanta up
+     * to there. A quantum that ends where it started may be a jump to
+     * itself, which only the single step below can tell. */
+    uint64_t n = m->common.quantum;
+    if (n > m->common.trace)
+        n = m->common.trace;
+    if (n > m->common.maxinsns)
+        n = m->common.maxinsns;
+
+    if (n > 1) {
+        uint64_t start_pc = virt_machine_get_pc(m, hartid);
+        uint64_t executed;
+        int      keep_going = virt_machine_run_quantum(m, hartid, n, &executed);
+
+        m->common.maxinsns -= executed;
+        m->common.trace    -= executed;
+        if (!keep_going || start_pc != virt_machine_get_pc(m, hartid))
+            return keep_going && m->common.maxinsns > 0;
+    }
+
     if (m->common.maxinsns-- <= 0)
         /* Succeed after N instructions without failure. */
         return 0;
@@ -88,6 +108,33 @@ int iterate_core(RISCVMachine *m, int hartid)
     return keep_going;
 }
 
+/* With --parallel the harts run their quanta at once, each on a host
+ * thread of its own, until the trace starts; from there on they take turns
+ * as below. */
+static int run_parallel(RISCVMachine *m)
+{
+    int keep_going = 1;
+
+    while (keep_going) {
+        uint64_t left    = m->common.trace < m->common.maxinsns ? m->common.trace : m->common.maxinsns;
+        uint64_t reserve = (uint64_t)m->ncpus * PARALLEL_SERIAL_STEPS;
+        uint64_t n       = left > reserve ? (left - reserve) / m->ncpus : 0;
+        uint64_t executed;
+
+        if (n > m->common.quantum)
+            n = m->common.quantum;
+        if (n <= 1)
+            break;
+
+        keep_going = virt_machine_run_parallel(m, n, &executed);
+        m->common.maxinsns -= executed;
+        m->common.trace    -= executed;
+    }
+    virt_machine_end_parallel(m);
+
+    return keep_going;
+}
+
 int main(int argc, char **argv)
 {
 #ifdef REGRESS_COSIM
@@ -110,12 +157,15 @@ int main(int argc, char **argv)
     if (!m)
         return 1;
 
-    int keep_going;
-    do {
+    int keep_going = 1;
+    if (m->common.parallel && m->ncpus > 1)
+        keep_going = run_parallel(m);
+
+    while (keep_going) {
         keep_going = 0;
         for (int i = 0; i < m->ncpus; ++i)
             keep_going |= iterate_core(m, i);
-    } while (keep_going);
+    }
 
     for (int i = 0; i < m->ncpus; ++i) {
         int benchmark_exit_code = riscv_benchmark_exit_code(m->cpu_state[i]);
@@ -20,6 +20,7 @@
 #include "cutils.h"
 #include "iomem.h"
 #include "riscv_machine.h"
+#include "checkpoint.h"
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -399,3 +400,57 @@ int dromajo_cosim_step(dromajo_cosim_state_t *state,
 
     return exit_code;
 }
+
+struct dromajo_cosim_ckpt_st {
+    CheckpointFile         *file;
+    const CheckpointRegion *region;
+    const uint64_t         *blocks;
+    uint64_t                block; /* next block, word and index */
+    uint64_t                word;
+};
+
+dromajo_cosim_ckpt_t *dromajo_cosim_ckpt_open(const char *ckpt_file, const char *region)
+{
+    CheckpointFile *file = checkpoint_open(ckpt_file);
+    if (!file)
+        return NULL;
+
+    const CheckpointRegion *r = checkpoint_find(file, region);
+    if (!r) {
+        checkpoint_close(file);
+        return NULL;
+    }
+
+    dromajo_cosim_ckpt_t *ckpt = (dromajo_cosim_ckpt_t *)mallocz(sizeof *ckpt);
+    ckpt->file   = file;
+    ckpt->region = r;
+    ckpt->blocks = checkpoint_blocks(file, r);
+
+    return ckpt;
+}
+
+bool dromajo_cosim_ckpt_next(dromajo_cosim_ckpt_t *ckpt, uint64_t *index, uint64_t *value)
+{
+    const uint64_t words = CHECKPOINT_BLOCK_SIZE / sizeof(uint64_t);
+
+    for (; ckpt->block < ckpt->region->n_blocks; ++ckpt->block, ckpt->word = 0) {
+        const uint64_t *data = (const uint64_t *)checkpoint_block_data(ckpt->file, ckpt->region, ckpt->block);
+
+        while (ckpt->word < words) {
+            uint64_t w = ckpt->word++;
+            if (data[w]) {
+                *index = ckpt->blocks[ckpt->block] * words + w;
+                *value = data[w];
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void dromajo_cosim_ckpt_close(dromajo_cosim_ckpt_t *ckpt)
+{
+    checkpoint_close(ckpt->file);
+    free(ckpt);
+}
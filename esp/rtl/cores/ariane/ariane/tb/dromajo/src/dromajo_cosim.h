@@ -74,6 +74,31 @@ int dromajo_cosim_step(dromajo_cosim_state_t *state,
 void dromajo_cosim_raise_trap(dromajo_cosim_state_t *state,
                               int                   hartid,
                               int64_t               cause);
+
+typedef struct dromajo_cosim_ckpt_st dromajo_cosim_ckpt_t;
+
+/*
+ * dromajo_cosim_ckpt_open --
+ *
+ * Opens a memory region, "bootram" or "mainram", of a checkpoint saved
+ * with --save_format 2, to initialize the DUT memories from the same
+ * checkpoint that the model is started from with --load.
+ * Returns NULL upon failure.
+ */
+dromajo_cosim_ckpt_t *dromajo_cosim_ckpt_open(const char *ckpt_file,
+                                              const char *region);
+
+/*
+ * dromajo_cosim_ckpt_next --
+ *
+ * Returns the next non-zero 64-bit word of the region and its index
+ * from the start of the region, or false once there are no more.
+ */
+bool dromajo_cosim_ckpt_next(dromajo_cosim_ckpt_t *ckpt,
+                             uint64_t             *index,
+                             uint64_t             *value);
+
+void dromajo_cosim_ckpt_close(dromajo_cosim_ckpt_t *ckpt);
 #ifdef __cplusplus
 } // extern C
 #endif
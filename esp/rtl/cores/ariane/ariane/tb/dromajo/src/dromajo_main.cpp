@@ -45,6 +45,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <assert.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -60,6 +61,8 @@
 #include <sys/stat.h>
 #include <signal.h>
 #include <err.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "cutils.h"
 #include "iomem.h"
@@ -341,6 +344,7 @@ static BlockDevice *block_device_init(const char *filename,
 
 #define MAX_EXEC_CYCLE 1
 #define MAX_SLEEP_TIME 10 /* in ms */
+#define DEFAULT_RUN_QUANTUM 4096 /* instructions */
 
 #if !defined(__APPLE__)
 typedef struct {
@@ -543,6 +547,182 @@ BOOL virt_machine_run(RISCVMachine *s, int hartid)
     return !riscv_terminated(s->cpu_state[hartid]) && s->common.maxinsns > 0;
 }
 
+/* Run up to n instructions, stopping early only on termination or a store
+ * to tohost, and return the number run in *executed (an instruction that
+ * traps counts as one). Unlike virt_machine_run(), the timer is only
+ * updated, and with it interrupts taken, at the start of the quantum. */
+BOOL virt_machine_run_quantum(RISCVMachine *s, int hartid, uint64_t n, uint64_t *executed)
+{
+    RISCVCPUState *cpu  = s->cpu_state[hartid];
+    uint64_t       done = 0;
+
+    (void) virt_machine_get_sleep_duration(s, hartid, MAX_SLEEP_TIME);
+
+    while (done < n && !riscv_terminated(cpu) && !s->htif_tohost_written) {
+        int chunk = n - done < INT_MAX ? n - done : INT_MAX;
+        int ran   = riscv_cpu_interp64(cpu, chunk);
+        done += ran > 0 ? ran : 1;
+    }
+    *executed = done;
+
+    if (s->htif_tohost_written) {
+        uint32_t tohost;
+        bool fail = true;
+        tohost = riscv_phys_read_u32(cpu, s->htif_tohost_addr, &fail);
+        if (!fail && tohost & 1)
+            return false;
+        s->htif_tohost_written = FALSE;
+    }
+
+    return !riscv_terminated(cpu);
+}
+
+/* With --parallel, hart i > 0 runs its quanta on host thread i and hart 0
+ * on the caller's. The threads meet at a barrier before and after each
+ * quantum; it spins, as a quantum takes about as long as a futex wakeup. */
+static struct {
+    RISCVMachine *machine;
+    pthread_t     thread[MAX_CPUS];
+    uint64_t      executed[MAX_CPUS];
+    uint64_t      n;
+    BOOL          stop;
+    int           nthreads;
+    int           arrived;
+    int           generation;
+} parallel;
+
+static void parallel_barrier(void)
+{
+    int generation = __atomic_load_n(&parallel.generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_add_fetch(&parallel.arrived, 1, __ATOMIC_ACQ_REL) == parallel.nthreads) {
+        __atomic_store_n(&parallel.arrived, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&parallel.generation, generation + 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    for (int spins = 0; __atomic_load_n(&parallel.generation, __ATOMIC_ACQUIRE) == generation; ++spins)
+        if (spins > 1000)
+            sched_yield();
+}
+
+/* Stop at the first instruction that must wait for the other harts */
+static void parallel_run_hart(int hartid)
+{
+    RISCVCPUState *cpu  = parallel.machine->cpu_state[hartid];
+    uint64_t       n    = parallel.n;
+    uint64_t       done = 0;
+
+    while (done < n && !riscv_terminated(cpu) && !cpu->defer_insn) {
+        int chunk = n - done < INT_MAX ? n - done : INT_MAX;
+        int ran   = riscv_cpu_interp64(cpu, chunk);
+        done += ran > 0 || cpu->defer_insn ? ran : 1;
+    }
+    parallel.executed[hartid] = done;
+}
+
+static void *parallel_thread(void *opaque)
+{
+    int hartid = (int)(intptr_t)opaque;
+
+    for (;;) {
+        parallel_barrier();
+        if (parallel.stop)
+            return NULL;
+        parallel_run_hart(hartid);
+        parallel_barrier();
+    }
+}
+
+/* Run up to n instructions on every hart at once, each on its own host
+ * thread, and return the total run in *executed. The instructions a hart
+ * deferred are then run in hart order with the others stopped, an LR
+ * together with the instructions up to its SC, and a hart that ended
+ * where it started is stepped once to tell a jump to itself. Returns
+ * FALSE once tohost is set or no hart can make progress. */
+BOOL virt_machine_run_parallel(RISCVMachine *s, uint64_t n, uint64_t *executed)
+{
+    uint64_t start_pc[MAX_CPUS];
+    uint64_t done       = 0;
+    BOOL     keep_going = FALSE;
+
+    if (!parallel.nthreads) {
+        parallel.machine  = s;
+        parallel.nthreads = s->ncpus;
+        for (int i = 1; i < s->ncpus; ++i)
+            if (pthread_create(&parallel.thread[i], NULL, parallel_thread, (void *)(intptr_t)i))
+                err(EXIT_FAILURE, "pthread_create");
+    }
+
+    for (int i = 0; i < s->ncpus; ++i) {
+        RISCVCPUState *cpu = s->cpu_state[i];
+
+        (void) virt_machine_get_sleep_duration(s, i, MAX_SLEEP_TIME);
+        start_pc[i]       = virt_machine_get_pc(s, i);
+        cpu->run_parallel = TRUE;
+        cpu->host_atomics = !s->common.deterministic;
+    }
+
+    parallel.n = n;
+    parallel_barrier();
+    parallel_run_hart(0);
+    parallel_barrier();
+
+    for (int i = 0; i < s->ncpus; ++i) {
+        RISCVCPUState *cpu        = s->cpu_state[i];
+        BOOL           hart_going = !riscv_terminated(cpu);
+
+        /* A reservation taken with host atomics is only good for an SC
+           run with them, so drop them all */
+        cpu->run_parallel = FALSE;
+        cpu->load_res     = ~0;
+        done += parallel.executed[i];
+
+        if (cpu->defer_insn) {
+            int steps = 0;
+
+            cpu->defer_insn = FALSE;
+            do {
+                hart_going = virt_machine_run(s, i);
+                ++done;
+            } while (hart_going && cpu->load_res != (target_ulong)~0 && ++steps < PARALLEL_SERIAL_STEPS);
+            cpu->load_res = ~0;
+        } else if (hart_going && start_pc[i] == virt_machine_get_pc(s, i)) {
+            (void) virt_machine_run(s, i);
+            ++done;
+            hart_going = start_pc[i] != virt_machine_get_pc(s, i);
+        }
+
+        keep_going |= hart_going;
+    }
+    *executed = done;
+
+    if (s->htif_tohost_written) {
+        uint32_t tohost;
+        bool fail = true;
+        tohost = riscv_phys_read_u32(s->cpu_state[0], s->htif_tohost_addr, &fail);
+        if (!fail && tohost & 1)
+            return false;
+        s->htif_tohost_written = FALSE;
+    }
+
+    return keep_going;
+}
+
+/* Stop the threads of virt_machine_run_parallel() */
+void virt_machine_end_parallel(RISCVMachine *s)
+{
+    if (!parallel.nthreads)
+        return;
+
+    parallel.stop = TRUE;
+    parallel_barrier();
+    for (int i = 1; i < parallel.nthreads; ++i)
+        pthread_join(parallel.thread[i], NULL);
+    parallel.nthreads = 0;
+    parallel.stop     = FALSE;
+}
+
 void launch_alternate_executable(char **argv)
 {
     char filename[1024];
@@ -599,10 +779,13 @@ static void usage(const char *prog, const char *msg)
             "       --ncpus number of cpus to simulate (default 1)\n"
             "       --load resumes a previously saved snapshot\n"
             "       --save saves a snapshot upon exit\n"
-            "       --save_format [0(default)=bin, 1=hex]\n"
+            "       --save_format [0(default)=bin, 1=hex, 2=compact .ckpt that --load and RTL memories read]\n"
             "       --maxinsns terminates execution after a number of instructions\n"
             "       --terminate-event name of the validate event to terminate execution\n"
             "       --trace start trace dump after a number of instructions. Trace disabled by default\n"
+            "       --quantum instructions run between timer and interrupt checks (default %d, 1 steps exactly)\n"
+            "       --parallel run each hart on its own host thread until the trace starts\n"
+            "       --deterministic with --parallel, run AMOs and LR/SC in hart order between quanta\n"
             "       --ignore_sbi_shutdown continue simulation even upon seeing the SBI_SHUTDOWN call\n"
             "       --dump_memories dump memories that could be used to load a cosimulation\n"
             "       --memory_size sets the memory size in MiB (default 256 MiB)\n"
@@ -617,6 +800,7 @@ static void usage(const char *prog, const char *msg)
             "       --custom_extension add X extension to isa\n",
             msg,
             prog,
+            DEFAULT_RUN_QUANTUM,
             (long)BOOT_BASE_ADDR, (long)RAM_BASE_ADDR,
             (long)PLIC_BASE_ADDR, (long)PLIC_SIZE,
             (long)CLINT_BASE_ADDR, (long)CLINT_SIZE);
@@ -658,6 +842,9 @@ RISCVMachine *virt_machine_main(int argc, char **argv)
     long        ncpus                    = 0;
     uint64_t    maxinsns                 = 0;
     uint64_t    trace                    = UINT64_MAX;
+    uint64_t    quantum                  = 0;
+    bool        parallel                 = false;
+    bool        deterministic            = false;
     long        memory_size_override     = 0;
     uint64_t    memory_addr_override     = 0;
     bool        ignore_sbi_shutdown      = false;
@@ -689,6 +876,9 @@ RISCVMachine *virt_machine_main(int argc, char **argv)
             {"save_format",             required_argument, 0,  'f' },
             {"maxinsns",                required_argument, 0,  'm' }, // CFG
             {"trace   ",                required_argument, 0,  't' },
+            {"quantum",                 required_argument, 0,  'q' },
+            {"parallel",                      no_argument, 0,  'j' },
+            {"deterministic",                 no_argument, 0,  'e' },
             {"ignore_sbi_shutdown",     required_argument, 0,  'P' }, // CFG
             {"dump_memories",           required_argument, 0,  'D' }, // CFG
             {"memory_size",             required_argument, 0,  'M' }, // CFG
@@ -751,6 +941,25 @@ RISCVMachine *virt_machine_main(int argc, char **argv)
             trace = (uint64_t) atoll(optarg);
             break;
 
+        case 'q':
+            if (quantum)
+                usage(prog, "already had a quantum set");
+            quantum = (uint64_t) atoll(optarg);
+            if (quantum == 0)
+                usage(prog, "the quantum must be at least 1");
+            break;
+
+        case 'j':
+#ifdef LIVECACHE
+            usage(prog, "--parallel is not supported with LIVECACHE");
+#endif
+            parallel = true;
+            break;
+
+        case 'e':
+            deterministic = true;
+            break;
+
         case 'P':
             ignore_sbi_shutdown = true;
             break;
@@ -1024,6 +1233,9 @@ RISCVMachine *virt_machine_main(int argc, char **argv)
     s->common.snapshot_save_name = snapshot_save_name;
     s->common.save_format        = save_format;
     s->common.trace              = trace;
+    s->common.quantum            = quantum ? quantum : DEFAULT_RUN_QUANTUM;
+    s->common.parallel           = parallel;
+    s->common.deterministic      = deterministic;
 
     // Allow the command option argument to overwrite the value
     // specified in the configuration file
@@ -251,8 +251,18 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
 #if FLEN > 0
     uint32_t rs3;
     int32_t rm;
+#endif
+#if XLEN == 64
+    DecodedInsn *decoded = NULL; /* of the page code_ptr points into */
+    uint8_t *decoded_page_ptr = NULL;
 #endif
     int insn_executed = 0;
+    /* mask and pattern of the instruction triggers: the privilege level
+       does not change until we return, and trigger writes end the block */
+    target_ulong t_mctl  = MCONTROL_EXECUTE | (MCONTROL_U << s->priv);
+    target_ulong t_mask  = ((target_ulong)0xF << 60) | t_mctl;
+    target_ulong t_match = ((target_ulong)0x2 << 60) | t_mctl;
+    BOOL check_triggers = FALSE; /* on every instruction of the page */
     s->most_recently_written_reg = -1;
     s->most_recently_written_fp_reg = -1;
     s->info = ctf_nop;
@@ -285,21 +295,18 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
 
         ++insn_executed;
 
-        /* Handled any breakpoint triggers in order (note, we
-         * precompute the mask and pattern to lower some of the
-         * cost). */
-        target_ulong t_mctl  = MCONTROL_EXECUTE | (MCONTROL_U << s->priv);
-        target_ulong t_mask  = ((target_ulong)0xF << 60) | t_mctl;
-        target_ulong t_match = ((target_ulong)0x2 << 60) | t_mctl;
-
-        for (int i = 0; i < MAX_TRIGGERS; ++i)
-            if ((s->tdata1[i] & t_mask) != t_match && s->tdata2[i] == s->pc) {
-                --insn_counter_addend;
-                s->pending_exception = CAUSE_BREAKPOINT;
-                s->pending_tval = 0;
-                raise_exception2(s, s->pending_exception, s->pending_tval);
-                goto done_interp;
-            }
+        /* Handled any breakpoint triggers in order. Only needed on the
+         * pages a trigger address falls in, see the page refill below. */
+        if (unlikely(check_triggers || code_ptr >= code_end)) {
+            for (int i = 0; i < MAX_TRIGGERS; ++i)
+                if ((s->tdata1[i] & t_mask) != t_match && s->tdata2[i] == s->pc) {
+                    --insn_counter_addend;
+                    s->pending_exception = CAUSE_BREAKPOINT;
+                    s->pending_tval = 0;
+                    raise_exception2(s, s->pending_exception, s->pending_tval);
+                    goto done_interp;
+                }
+        }
 
         if (unlikely(code_ptr >= code_end)) {
             uint32_t tlb_idx;
@@ -323,6 +330,11 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
                 code_end = (uint8_t *)(mem_addend +
                                        (uintptr_t)((addr & ~PG_MASK) + PG_MASK - 1));
                 code_to_pc_addend = addr - (uintptr_t)code_ptr;
+                check_triggers = FALSE;
+                for (int i = 0; i < MAX_TRIGGERS; ++i)
+                    if ((s->tdata1[i] & t_mask) != t_match &&
+                        (s->tdata2[i] & ~PG_MASK) == (addr & ~PG_MASK))
+                        check_triggers = TRUE;
                 if (unlikely(code_ptr >= code_end)) {
                     /* instruction is potentially half way between two
                        pages ? */
@@ -334,6 +346,10 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
                         insn |= insn_high << 16;
                     }
                 } else {
+#if XLEN == 64
+                    decoded_page_ptr = code_ptr - (addr & PG_MASK);
+                    decoded = decoded_page(s, decoded_page_ptr);
+#endif
                     insn = get_insn32(code_ptr);
                 }
 
@@ -346,6 +362,295 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
             insn = get_insn32(code_ptr);
         }
 
+#if XLEN == 64
+        /* Common instructions run from their decoded form, dispatched
+           straight to one another while execution stays in the page */
+        if (likely(code_ptr < code_end)) {
+            /* in DOP_* order */
+            static const void *const decoded_ops[] = {
+                &&decode,
+                &&decoded_lui, &&decoded_auipc, &&decoded_jal, &&decoded_jalr,
+                &&decoded_beq, &&decoded_bne, &&decoded_blt, &&decoded_bge,
+                &&decoded_bltu, &&decoded_bgeu, &&decoded_lb, &&decoded_lh, &&decoded_lw,
+                &&decoded_ld, &&decoded_lbu, &&decoded_lhu, &&decoded_lwu, &&decoded_sb,
+                &&decoded_sh, &&decoded_sw, &&decoded_sd, &&decoded_addi, &&decoded_slti,
+                &&decoded_sltiu, &&decoded_xori, &&decoded_ori, &&decoded_andi,
+                &&decoded_slli, &&decoded_srli, &&decoded_srai, &&decoded_addiw,
+                &&decoded_slliw, &&decoded_srliw, &&decoded_sraiw, &&decoded_add,
+                &&decoded_sub, &&decoded_sll, &&decoded_slt, &&decoded_sltu,
+                &&decoded_xor, &&decoded_srl, &&decoded_sra, &&decoded_or, &&decoded_and,
+                &&decoded_mul, &&decoded_addw, &&decoded_subw, &&decoded_sllw,
+                &&decoded_srlw, &&decoded_sraw, &&decoded_mulw,
+            };
+            DecodedInsn *di;
+            uint32_t tlb_idx;
+
+        decoded_dispatch:
+            di = &decoded[(code_ptr - decoded_page_ptr) >> 1];
+            if (unlikely(di->bits != insn))
+                decode_insn(di, insn);
+            rd = di->rd;
+            rs1 = di->rs1;
+            rs2 = di->rs2;
+            imm = di->imm;
+            goto *decoded_ops[di->op];
+        decoded_lui:
+            val = imm;
+            goto decoded_write;
+        decoded_auipc:
+            val = (intx_t)(GET_PC() + imm);
+            goto decoded_write;
+        decoded_jal:
+            addr = (intx_t)(GET_PC() + imm);
+            if (di->size == 4 && !(s->misa & MCPUID_C) && (addr & 3) != 0) {
+                s->pending_exception = CAUSE_MISALIGNED_FETCH;
+                s->pending_tval = 0;
+                goto exception;
+            }
+            if (rd != 0)
+                write_reg(rd, GET_PC() + di->size);
+            s->info = ctf_taken_jump;
+            goto decoded_jump;
+        decoded_jalr:
+            val = GET_PC() + di->size;
+            addr = (intx_t)(read_reg(rs1) + imm) & ~1;
+            if (di->size == 4 && !(s->misa & MCPUID_C) && (addr & 3) != 0) {
+                s->pending_exception = CAUSE_MISALIGNED_FETCH;
+                s->pending_tval = 0;
+                goto exception;
+            }
+            if (rd != 0)
+                write_reg(rd, val);
+            s->info = ctf_compute_hint(rd, rs1);
+            goto decoded_jump;
+        decoded_beq:
+            cond = read_reg(rs1) == read_reg(rs2);
+            goto decoded_branch;
+        decoded_bne:
+            cond = read_reg(rs1) != read_reg(rs2);
+            goto decoded_branch;
+        decoded_blt:
+            cond = (target_long)read_reg(rs1) < (target_long)read_reg(rs2);
+            goto decoded_branch;
+        decoded_bge:
+            cond = (target_long)read_reg(rs1) >= (target_long)read_reg(rs2);
+            goto decoded_branch;
+        decoded_bltu:
+            cond = read_reg(rs1) < read_reg(rs2);
+            goto decoded_branch;
+        decoded_bgeu:
+            cond = read_reg(rs1) >= read_reg(rs2);
+            goto decoded_branch;
+        decoded_lb:
+            {
+                uint8_t rval;
+                if (target_read_u8(s, &rval, read_reg(rs1) + imm))
+                    goto mmu_exception;
+                val = (int8_t)rval;
+            }
+            goto decoded_write;
+        decoded_lh:
+            {
+                uint16_t rval;
+                if (target_read_u16(s, &rval, read_reg(rs1) + imm))
+                    goto mmu_exception;
+                val = (int16_t)rval;
+            }
+            goto decoded_write;
+        decoded_lw:
+            {
+                uint32_t rval;
+                if (target_read_u32(s, &rval, read_reg(rs1) + imm))
+                    goto mmu_exception;
+                val = (int32_t)rval;
+            }
+            goto decoded_write;
+        decoded_ld:
+            {
+                uint64_t rval;
+                if (target_read_u64(s, &rval, read_reg(rs1) + imm))
+                    goto mmu_exception;
+                val = (int64_t)rval;
+            }
+            goto decoded_write;
+        decoded_lbu:
+            {
+                uint8_t rval;
+                if (target_read_u8(s, &rval, read_reg(rs1) + imm))
+                    goto mmu_exception;
+                val = rval;
+            }
+            goto decoded_write;
+        decoded_lhu:
+            {
+                uint16_t rval;
+                if (target_read_u16(s, &rval, read_reg(rs1) + imm))
+                    goto mmu_exception;
+                val = rval;
+            }
+            goto decoded_write;
+        decoded_lwu:
+            {
+                uint32_t rval;
+                if (target_read_u32(s, &rval, read_reg(rs1) + imm))
+                    goto mmu_exception;
+                val = rval;
+            }
+            goto decoded_write;
+        decoded_sb:
+            if (target_write_u8(s, read_reg(rs1) + imm, read_reg(rs2)))
+                goto mmu_exception;
+            goto decoded_next;
+        decoded_sh:
+            if (target_write_u16(s, read_reg(rs1) + imm, read_reg(rs2)))
+                goto mmu_exception;
+            goto decoded_next;
+        decoded_sw:
+            if (target_write_u32(s, read_reg(rs1) + imm, read_reg(rs2)))
+                goto mmu_exception;
+            goto decoded_next;
+        decoded_sd:
+            if (target_write_u64(s, read_reg(rs1) + imm, read_reg(rs2)))
+                goto mmu_exception;
+            goto decoded_next;
+        decoded_addi:
+            val = (intx_t)(read_reg(rs1) + imm);
+            goto decoded_write;
+        decoded_slti:
+            val = (target_long)read_reg(rs1) < (target_long)imm;
+            goto decoded_write;
+        decoded_sltiu:
+            val = read_reg(rs1) < (target_ulong)imm;
+            goto decoded_write;
+        decoded_xori:
+            val = read_reg(rs1) ^ imm;
+            goto decoded_write;
+        decoded_ori:
+            val = read_reg(rs1) | imm;
+            goto decoded_write;
+        decoded_andi:
+            val = read_reg(rs1) & imm;
+            goto decoded_write;
+        decoded_slli:
+            val = (intx_t)(read_reg(rs1) << imm);
+            goto decoded_write;
+        decoded_srli:
+            val = (intx_t)((uintx_t)read_reg(rs1) >> imm);
+            goto decoded_write;
+        decoded_srai:
+            val = (intx_t)read_reg(rs1) >> imm;
+            goto decoded_write;
+        decoded_addiw:
+            val = (int32_t)(read_reg(rs1) + imm);
+            goto decoded_write;
+        decoded_slliw:
+            val = (int32_t)(read_reg(rs1) << imm);
+            goto decoded_write;
+        decoded_srliw:
+            val = (int32_t)((uint32_t)read_reg(rs1) >> imm);
+            goto decoded_write;
+        decoded_sraiw:
+            val = (int32_t)read_reg(rs1) >> imm;
+            goto decoded_write;
+        decoded_add:
+            val = (intx_t)(read_reg(rs1) + read_reg(rs2));
+            goto decoded_write;
+        decoded_sub:
+            val = (intx_t)(read_reg(rs1) - read_reg(rs2));
+            goto decoded_write;
+        decoded_sll:
+            val = (intx_t)(read_reg(rs1) << (read_reg(rs2) & (XLEN - 1)));
+            goto decoded_write;
+        decoded_slt:
+            val = (target_long)read_reg(rs1) < (target_long)read_reg(rs2);
+            goto decoded_write;
+        decoded_sltu:
+            val = read_reg(rs1) < read_reg(rs2);
+            goto decoded_write;
+        decoded_xor:
+            val = read_reg(rs1) ^ read_reg(rs2);
+            goto decoded_write;
+        decoded_srl:
+            val = (intx_t)((uintx_t)read_reg(rs1) >> (read_reg(rs2) & (XLEN - 1)));
+            goto decoded_write;
+        decoded_sra:
+            val = (intx_t)read_reg(rs1) >> (read_reg(rs2) & (XLEN - 1));
+            goto decoded_write;
+        decoded_or:
+            val = read_reg(rs1) | read_reg(rs2);
+            goto decoded_write;
+        decoded_and:
+            val = read_reg(rs1) & read_reg(rs2);
+            goto decoded_write;
+        decoded_mul:
+            val = (intx_t)((intx_t)read_reg(rs1) * (intx_t)read_reg(rs2));
+            goto decoded_write;
+        decoded_addw:
+            val = (int32_t)(read_reg(rs1) + read_reg(rs2));
+            goto decoded_write;
+        decoded_subw:
+            val = (int32_t)(read_reg(rs1) - read_reg(rs2));
+            goto decoded_write;
+        decoded_sllw:
+            val = (int32_t)((uint32_t)read_reg(rs1) << (read_reg(rs2) & 31));
+            goto decoded_write;
+        decoded_srlw:
+            val = (int32_t)((uint32_t)read_reg(rs1) >> (read_reg(rs2) & 31));
+            goto decoded_write;
+        decoded_sraw:
+            val = (int32_t)read_reg(rs1) >> (read_reg(rs2) & 31);
+            goto decoded_write;
+        decoded_mulw:
+            val = (int32_t)((int32_t)read_reg(rs1) * (int32_t)read_reg(rs2));
+            goto decoded_write;
+        decoded_branch:
+            if (!cond)
+                goto decoded_next;
+            addr = (intx_t)(GET_PC() + imm);
+            if (di->size == 4 && !(s->misa & MCPUID_C) && (addr & 3) != 0) {
+                s->pending_exception = CAUSE_MISALIGNED_FETCH;
+                s->pending_tval = 0;
+                goto exception;
+            }
+            s->info = ctf_taken_branch;
+        decoded_jump:
+            /* Jumps within the page skip the refill unless an interrupt
+               may be pending or the page was unmapped */
+            tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
+            if (likely(((addr ^ s->pc) & ~PG_MASK) == 0 && (s->mip & s->mie) == 0 &&
+                       s->tlb_code[tlb_idx].vaddr == (addr & ~PG_MASK))) {
+                uint8_t *target = (uint8_t *)(s->tlb_code[tlb_idx].mem_addend + (uintptr_t)addr);
+                if (likely(target >= decoded_page_ptr && target < code_end)) {
+                    s->pc = addr;
+                    s->next_addr = addr;
+                    code_ptr = target;
+                    goto decoded_continue;
+                }
+            }
+            s->pc = addr;
+            s->next_addr = addr;
+            code_ptr = NULL;
+            code_end = NULL;
+            code_to_pc_addend = addr;
+            goto jump_insn;
+        decoded_write:
+            if (rd != 0)
+                write_reg(rd, val);
+        decoded_next:
+            code_ptr += di->size;
+        decoded_continue:
+            /* the head of the main loop, when there is nothing else to do */
+            if (likely(code_ptr < code_end && !check_triggers && n_cycles > 1)) {
+                s->pc = GET_PC();
+                --n_cycles;
+                ++insn_executed;
+                insn = get_insn32(code_ptr);
+                goto decoded_dispatch;
+            }
+            continue;
+        }
+    decode:
+#endif
         opcode = insn & 0x7f;
         rd = (insn >> 7) & 0x1f;
         rs1 = (insn >> 15) & 0x1f;
@@ -1315,6 +1620,8 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
                   s->mcycle += delta;
                   s->minstret += delta;
                 }
+                /* counted up to here, the_end adds only the rest */
+                insn_counter_start = s->insn_counter;
                 if (csr_read(s, &val2, imm, TRUE))
                     goto illegal_insn;
                 val2 = (intx_t)val2;
@@ -1343,6 +1650,8 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
                   s->mcycle += delta;
                   s->minstret += delta;
                 }
+                /* counted up to here, the_end adds only the rest */
+                insn_counter_start = s->insn_counter;
                 if (csr_read(s, &val2, imm, (rs1 != 0)))
                     goto illegal_insn;
                 val2 = (intx_t)val2;
@@ -1418,6 +1727,10 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
                         if (s->priv < PRV_M) // FIXME: It should be illegal even in M, but this is the only that we have now
                             goto illegal_insn;
                         s->pc = GET_PC();
+                        /* the counters restart with the dret itself, not
+                           with the stopped instructions before it */
+                        if (s->stop_the_counter)
+                            insn_counter_start = GET_INSN_COUNTER();
                         handle_dret(s);
                         goto done_interp;
                     }
@@ -1475,6 +1788,8 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
             case 0: /* fence */
                 if (insn & 0xf00fff80)
                     goto illegal_insn;
+                if (s->run_parallel)
+                    __atomic_thread_fence(__ATOMIC_SEQ_CST);
                 break;
             case 1: /* fence.i */
                 if (insn != 0x0000100f)
@@ -1495,6 +1810,19 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
             }
             NEXT_INSN;
         case 0x2f:
+            if (unlikely(s->run_parallel)) {
+                /* the other harts run concurrently: use host atomics, or
+                   run the instruction when they have stopped */
+                uint64_t rval;
+                if (!s->host_atomics ||
+                    !amo_host(s, insn, XLEN, read_reg(rs1), read_reg(rs2), &rval)) {
+                    s->defer_insn = TRUE;
+                    goto mmu_exception;
+                }
+                if (rd != 0)
+                    write_reg(rd, rval);
+                NEXT_INSN;
+            }
             funct3 = (insn >> 12) & 7;
 #define OP_A(size)                                                      \
             {                                                           \
@@ -1521,7 +1849,7 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
                     }                                                   \
                                                                         \
                     if (s->load_res == addr) {                          \
-                        if (target_write_u ## size(s, addr, read_reg(rs2))) \
+                        if (target_write_u ## size(s, addr, read_reg(rs2)) < 0) \
                             goto mmu_exception;                         \
                         val = 0;                                        \
                         s->load_res = ~0;                               \
@@ -1578,7 +1906,7 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
                     default:                                            \
                         goto illegal_insn;                              \
                     }                                                   \
-                    if (target_write_u ## size(s, addr, val2))          \
+                    if (target_write_u ## size(s, addr, val2) < 0)      \
                         goto mmu_exception;                             \
                     break;                                              \
                 default:                                                \
@@ -1605,6 +1933,8 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
             }
             if (rd != 0)
                 write_reg(rd, val);
+            if (unlikely(s->stop_after_insn))
+                goto mmu_exception;
             NEXT_INSN;
 #if FLEN > 0
             /* FPU */
@@ -1861,6 +2191,14 @@ int no_inline glue(riscv_cpu_interp, XLEN)(RISCVCPUState *s, int n_cycles)
         }
 
         raise_exception2(s, s->pending_exception, s->pending_tval);
+    } else if (s->defer_insn) {
+        /* not run yet, see run_parallel */
+        --insn_counter_addend;
+        --insn_executed;
+    } else if (s->stop_after_insn) {
+        /* a store to tohost, which has completed */
+        s->stop_after_insn = FALSE;
+        s->pc += (insn & 3) == 3 ? 4 : 2;
     }
     /* we exit because XLEN may have changed */
 
@@ -204,6 +204,9 @@ typedef struct VirtMachine {
     uint32_t    save_format;
     uint64_t    maxinsns;
     uint64_t    trace;
+    uint64_t    quantum; /* instructions per timer/interrupt poll, 1 = single step */
+    bool        parallel;      /* one host thread per hart, see virt_machine_run_parallel() */
+    bool        deterministic; /* parallel, but AMOs and LR/SC run in hart order */
 
     /* For co-simulation only, they are -1 if nothing is pending. */
     bool        cosim;
@@ -255,6 +258,10 @@ BlockDevice *block_device_init_http(const char *url,
                                     int max_cache_size_kb,
                                     void (*start_cb)(void *opaque),
                                     void *start_opaque);
+
+/* most instructions virt_machine_run_parallel() runs per hart past n */
+#define PARALLEL_SERIAL_STEPS 256
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -263,6 +270,9 @@ void         virt_machine_end        (RISCVMachine *s);
 void         virt_machine_serialize  (RISCVMachine *m, const char *dump_name);
 void         virt_machine_deserialize(RISCVMachine *m, const char *dump_name);
 BOOL         virt_machine_run        (RISCVMachine *m, int hartid);
+BOOL         virt_machine_run_quantum(RISCVMachine *m, int hartid, uint64_t n, uint64_t *executed);
+BOOL         virt_machine_run_parallel(RISCVMachine *m, uint64_t n, uint64_t *executed);
+void         virt_machine_end_parallel(RISCVMachine *m);
 uint64_t     virt_machine_get_pc     (RISCVMachine *m, int hartid);
 uint64_t     virt_machine_get_reg    (RISCVMachine *m, int hartid, int rn);
 uint64_t     virt_machine_get_fpreg  (RISCVMachine *m, int hartid, int rn);
@@ -54,6 +54,7 @@
 #include "cutils.h"
 #include "iomem.h"
 #include "riscv_machine.h"
+#include "checkpoint.h"
 #include "LiveCacheCore.h"
 
 // NOTE: Use GET_INSN_COUNTER not mcycle because this is just to track advancement of simulation
@@ -584,6 +585,10 @@ no_inline int riscv_cpu_read_memory(RISCVCPUState *s, mem_uint_t *pval,
                 abort();
             }
         } else {
+            if (s->run_parallel) {
+                s->defer_insn = TRUE;
+                return -1;
+            }
             offset = paddr - pr->addr;
             if (((pr->devio_flags >> size_log2) & 1) != 0) {
                 ret = pr->read_func(pr->opaque, offset, size_log2);
@@ -609,11 +614,13 @@ no_inline int riscv_cpu_read_memory(RISCVCPUState *s, mem_uint_t *pval,
     return 0;
 }
 
-/* return 0 if OK, != 0 if exception */
+/* return 0 if OK, < 0 if exception, and 1 after a store to tohost, which
+   ends the block so that the run loop sees it before the next instruction */
 no_inline int riscv_cpu_write_memory(RISCVCPUState *s, target_ulong addr,
                                 mem_uint_t val, int size_log2)
 {
     int size, i, tlb_idx, err;
+    int ret = 0;
     target_ulong paddr, offset;
     uint8_t *ptr;
     PhysMemoryRange *pr;
@@ -627,8 +634,9 @@ no_inline int riscv_cpu_write_memory(RISCVCPUState *s, target_ulong addr,
     } else if ((addr & (size - 1)) != 0) {
         for (i = 0; i < size; i++) {
             err = target_write_u8(s, addr + i, (val >> (8 * i)) & 0xff);
-            if (err)
+            if (err < 0)
                 return err;
+            ret |= err;
         }
         paddr = addr;
     } else {
@@ -651,16 +659,32 @@ no_inline int riscv_cpu_write_memory(RISCVCPUState *s, target_ulong addr,
             s->pending_exception = CAUSE_FAULT_STORE;
             return -1;
         } else if (pr->is_ram) {
+            target_ulong tohost = s->machine->htif_tohost_addr;
+            if (tohost && (paddr & ~PG_MASK) == (tohost & ~PG_MASK) &&
+                s->run_parallel) {
+                s->defer_insn = TRUE;
+                return -1;
+            }
             phys_mem_set_dirty_bit(pr, paddr - pr->addr);
-            tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
             ptr = pr->phys_mem + (uintptr_t)(paddr - pr->addr);
-            s->tlb_write[tlb_idx].vaddr        = addr & ~PG_MASK;
+            if (tohost && (paddr & ~PG_MASK) == (tohost & ~PG_MASK)) {
+                /* Keep stores to the tohost page on this slow path so
+                   that the run loop need not poll tohost */
+                if (paddr < tohost + 4 && tohost < paddr + size) {
+                    s->machine->htif_tohost_written = TRUE;
+                    s->stop_after_insn = TRUE;
+                    ret = 1;
+                }
+            } else {
+                tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
+                s->tlb_write[tlb_idx].vaddr        = addr & ~PG_MASK;
 #ifdef PADDR_INLINE
-            s->tlb_write[tlb_idx].paddr_addend = paddr - addr;
+                s->tlb_write[tlb_idx].paddr_addend = paddr - addr;
 #else
-            s->tlb_write_paddr_addend[tlb_idx] = paddr - addr;
+                s->tlb_write_paddr_addend[tlb_idx] = paddr - addr;
 #endif
-            s->tlb_write[tlb_idx].mem_addend   = (uintptr_t)ptr - addr;
+                s->tlb_write[tlb_idx].mem_addend   = (uintptr_t)ptr - addr;
+            }
             switch (size_log2) {
             case 0:
                 *(uint8_t *)ptr = val;
@@ -685,6 +709,10 @@ no_inline int riscv_cpu_write_memory(RISCVCPUState *s, target_ulong addr,
                 abort();
             }
         } else {
+            if (s->run_parallel) {
+                s->defer_insn = TRUE;
+                return -1;
+            }
             offset = paddr - pr->addr;
             if (((pr->devio_flags >> size_log2) & 1) != 0) {
                 pr->write_func(pr->opaque, offset, val, size_log2);
@@ -708,7 +736,7 @@ no_inline int riscv_cpu_write_memory(RISCVCPUState *s, target_ulong addr,
         }
     }
     track_write(s, addr, paddr, val, size);
-    return 0;
+    return ret;
 }
 
 struct __attribute__((packed)) unaligned_u32 {
@@ -1303,7 +1331,7 @@ static void unpack_pmpaddrs(RISCVCPUState *s)
 }
 
 /* return -1 if invalid CSR, 0 if OK, -2 if CSR raised an exception,
- * 2 if TLBs have been flushed. */
+ * 2 if TLBs have been flushed or triggers changed. */
 static int csr_write(RISCVCPUState *s, uint32_t csr, target_ulong val)
 {
     target_ulong mask;
@@ -1435,11 +1463,11 @@ static int csr_write(RISCVCPUState *s, uint32_t csr, target_ulong val)
             mask = ((target_ulong)15 << 60) | MCONTROL_M | MCONTROL_EXECUTE;
             s->tdata1[s->tselect] = s->tdata1[s->tselect] & ~mask | val & mask;
         }
-        break;
+        return 2; // the interpreter only checks the triggers on page refills
 
     case 0x7a2: // tdata2
         s->tdata2[s->tselect] = val;
-        break;
+        return 2;
 
     case 0x7a3: // tdata3
         s->tdata3[s->tselect] = val;
@@ -1833,6 +1861,396 @@ static sfloat64 f_unbox64(sfloat64 r)
     return r;
 }
 
+/* Operations of the instructions that riscv_cpu_interp64() runs from
+   decoded code pages. Compressed instructions decode to the equivalent
+   32-bit operation, everything else to DOP_INTERP and the full decoder. */
+enum {
+    DOP_INTERP, /* also what a zeroed record holds */
+    DOP_LUI, DOP_AUIPC, DOP_JAL, DOP_JALR,
+    DOP_BEQ, DOP_BNE, DOP_BLT, DOP_BGE, DOP_BLTU, DOP_BGEU,
+    DOP_LB, DOP_LH, DOP_LW, DOP_LD, DOP_LBU, DOP_LHU, DOP_LWU,
+    DOP_SB, DOP_SH, DOP_SW, DOP_SD,
+    DOP_ADDI, DOP_SLTI, DOP_SLTIU, DOP_XORI, DOP_ORI, DOP_ANDI,
+    DOP_SLLI, DOP_SRLI, DOP_SRAI,
+    DOP_ADDIW, DOP_SLLIW, DOP_SRLIW, DOP_SRAIW,
+    DOP_ADD, DOP_SUB, DOP_SLL, DOP_SLT, DOP_SLTU, DOP_XOR,
+    DOP_SRL, DOP_SRA, DOP_OR, DOP_AND, DOP_MUL,
+    DOP_ADDW, DOP_SUBW, DOP_SLLW, DOP_SRLW, DOP_SRAW, DOP_MULW,
+};
+
+static void decode_cinsn(DecodedInsn *d, uint32_t insn)
+{
+    uint8_t rd   = (insn >> 7) & 0x1f;
+    uint8_t rs2  = (insn >> 2) & 0x1f;
+    uint8_t rd_c = ((insn >> 7) & 7) | 8; /* rd'/rs1' */
+    uint8_t rs_c = ((insn >> 2) & 7) | 8; /* rs2'/rd' */
+    int32_t imm6 = sext(get_field1(insn, 12, 5, 5) | get_field1(insn, 2, 0, 4), 6);
+
+    d->size = 2;
+    switch (((insn & 3) << 3) | ((insn >> 13) & 7)) {
+    case 0: /* c.addi4spn */
+        d->imm = get_field1(insn, 11, 4, 5) | get_field1(insn, 7, 6, 9) |
+            get_field1(insn, 6, 2, 2) | get_field1(insn, 5, 3, 3);
+        if (d->imm != 0) {
+            d->op  = DOP_ADDI;
+            d->rd  = rs_c;
+            d->rs1 = 2;
+        }
+        break;
+    case 2: /* c.lw */
+    case 3: /* c.ld */
+    case 6: /* c.sw */
+    case 7: /* c.sd */
+        if (insn & (1 << 13))
+            d->imm = get_field1(insn, 10, 3, 5) | get_field1(insn, 5, 6, 7);
+        else
+            d->imm = get_field1(insn, 10, 3, 5) | get_field1(insn, 6, 2, 2) |
+                get_field1(insn, 5, 6, 6);
+        d->op  = (insn & (1 << 15)) ? ((insn & (1 << 13)) ? DOP_SD : DOP_SW) :
+                                      ((insn & (1 << 13)) ? DOP_LD : DOP_LW);
+        d->rd  = rs_c;
+        d->rs1 = rd_c;
+        d->rs2 = rs_c;
+        break;
+    case 8 + 0: /* c.addi/c.nop */
+    case 8 + 2: /* c.li */
+        d->op  = DOP_ADDI;
+        d->rd  = rd;
+        d->rs1 = (insn & (1 << 14)) ? 0 : rd;
+        d->imm = imm6;
+        break;
+    case 8 + 1: /* c.addiw */
+        if (rd != 0) {
+            d->op  = DOP_ADDIW;
+            d->rd  = d->rs1 = rd;
+            d->imm = imm6;
+        }
+        break;
+    case 8 + 3:
+        if (rd == 2) { /* c.addi16sp */
+            d->imm = sext(get_field1(insn, 12, 9, 9) | get_field1(insn, 6, 4, 4) |
+                          get_field1(insn, 5, 6, 6) | get_field1(insn, 3, 7, 8) |
+                          get_field1(insn, 2, 5, 5), 10);
+            if (d->imm != 0) {
+                d->op = DOP_ADDI;
+                d->rd = d->rs1 = 2;
+            }
+        } else if (rd != 0) { /* c.lui */
+            d->imm = sext(get_field1(insn, 12, 17, 17) | get_field1(insn, 2, 12, 16), 18);
+            if (d->imm != 0) {
+                d->op = DOP_LUI;
+                d->rd = rd;
+            }
+        }
+        break;
+    case 8 + 4:
+        d->rd = d->rs1 = rd_c;
+        switch ((insn >> 10) & 3) {
+        case 0: /* c.srli */
+            d->op  = DOP_SRLI;
+            d->imm = imm6 & 63;
+            break;
+        case 1: /* c.srai */
+            d->op  = DOP_SRAI;
+            d->imm = imm6 & 63;
+            break;
+        case 2: /* c.andi */
+            d->op  = DOP_ANDI;
+            d->imm = imm6;
+            break;
+        case 3: {
+            static const uint8_t ops[8] = {
+                DOP_SUB, DOP_XOR, DOP_OR, DOP_AND, DOP_SUBW, DOP_ADDW, DOP_INTERP, DOP_INTERP
+            };
+            d->op  = ops[((insn >> 5) & 3) | ((insn >> (12 - 2)) & 4)];
+            d->rs2 = rs_c;
+            break;
+        }
+        }
+        break;
+    case 8 + 5: /* c.j */
+        d->op  = DOP_JAL;
+        d->rd  = 0;
+        d->imm = sext(get_field1(insn, 12, 11, 11) | get_field1(insn, 11, 4, 4) |
+                      get_field1(insn, 9, 8, 9) | get_field1(insn, 8, 10, 10) |
+                      get_field1(insn, 7, 6, 6) | get_field1(insn, 6, 7, 7) |
+                      get_field1(insn, 3, 1, 3) | get_field1(insn, 2, 5, 5), 12);
+        break;
+    case 8 + 6: /* c.beqz */
+    case 8 + 7: /* c.bnez */
+        d->op  = (insn & (1 << 13)) ? DOP_BNE : DOP_BEQ;
+        d->rs1 = rd_c;
+        d->rs2 = 0;
+        d->imm = sext(get_field1(insn, 12, 8, 8) | get_field1(insn, 10, 3, 4) |
+                      get_field1(insn, 5, 6, 7) | get_field1(insn, 3, 1, 2) |
+                      get_field1(insn, 2, 5, 5), 9);
+        break;
+    case 16 + 0: /* c.slli */
+        d->op  = DOP_SLLI;
+        d->rd  = d->rs1 = rd;
+        d->imm = imm6 & 63;
+        break;
+    case 16 + 2: /* c.lwsp */
+    case 16 + 3: /* c.ldsp */
+        if (rd != 0) {
+            if (insn & (1 << 13)) {
+                d->op  = DOP_LD;
+                d->imm = get_field1(insn, 12, 5, 5) | (rs2 & (3 << 3)) |
+                    get_field1(insn, 2, 6, 8);
+            } else {
+                d->op  = DOP_LW;
+                d->imm = get_field1(insn, 12, 5, 5) | (rs2 & (7 << 2)) |
+                    get_field1(insn, 2, 6, 7);
+            }
+            d->rd  = rd;
+            d->rs1 = 2;
+        }
+        break;
+    case 16 + 4:
+        if (rs2 != 0) { /* c.mv/c.add */
+            d->op  = DOP_ADD;
+            d->rd  = rd;
+            d->rs1 = (insn & (1 << 12)) ? rd : 0;
+            d->rs2 = rs2;
+        } else if (rd != 0) { /* c.jr/c.jalr */
+            d->op  = DOP_JALR;
+            d->rd  = (insn >> 12) & 1;
+            d->rs1 = rd;
+            d->imm = 0;
+        }
+        break;
+    case 16 + 6: /* c.swsp */
+        d->op  = DOP_SW;
+        d->rs1 = 2;
+        d->rs2 = rs2;
+        d->imm = get_field1(insn, 9, 2, 5) | get_field1(insn, 7, 6, 7);
+        break;
+    case 16 + 7: /* c.sdsp */
+        d->op  = DOP_SD;
+        d->rs1 = 2;
+        d->rs2 = rs2;
+        d->imm = get_field1(insn, 10, 3, 5) | get_field1(insn, 7, 6, 8);
+        break;
+    }
+}
+
+/* RV64 only: riscv_cpu_interp32() does not use decoded pages */
+static void decode_insn(DecodedInsn *d, uint32_t insn)
+{
+    static const uint8_t branch_ops[8] = {
+        DOP_BEQ, DOP_BNE, DOP_INTERP, DOP_INTERP, DOP_BLT, DOP_BGE, DOP_BLTU, DOP_BGEU
+    };
+    static const uint8_t load_ops[8] = {
+        DOP_LB, DOP_LH, DOP_LW, DOP_LD, DOP_LBU, DOP_LHU, DOP_LWU, DOP_INTERP
+    };
+    static const uint8_t store_ops[8] = {
+        DOP_SB, DOP_SH, DOP_SW, DOP_SD, DOP_INTERP, DOP_INTERP, DOP_INTERP, DOP_INTERP
+    };
+    static const uint8_t op_imm_ops[8] = {
+        DOP_ADDI, DOP_SLLI, DOP_SLTI, DOP_SLTIU, DOP_XORI, DOP_SRLI, DOP_ORI, DOP_ANDI
+    };
+    static const uint8_t op_ops[16] = {
+        DOP_ADD, DOP_SLL, DOP_SLT, DOP_SLTU, DOP_XOR, DOP_SRL, DOP_OR, DOP_AND,
+        DOP_SUB, DOP_INTERP, DOP_INTERP, DOP_INTERP, DOP_INTERP, DOP_SRA, DOP_INTERP, DOP_INTERP
+    };
+    static const uint8_t op_32_ops[16] = {
+        DOP_ADDW, DOP_SLLW, DOP_INTERP, DOP_INTERP, DOP_INTERP, DOP_SRLW, DOP_INTERP, DOP_INTERP,
+        DOP_SUBW, DOP_INTERP, DOP_INTERP, DOP_INTERP, DOP_INTERP, DOP_SRAW, DOP_INTERP, DOP_INTERP
+    };
+    uint32_t funct3 = (insn >> 12) & 7;
+    uint32_t funct7 = insn >> 25;
+
+    d->bits = insn;
+    d->op   = DOP_INTERP;
+    d->size = 4;
+    d->rd   = (insn >> 7) & 0x1f;
+    d->rs1  = (insn >> 15) & 0x1f;
+    d->rs2  = (insn >> 20) & 0x1f;
+    d->imm  = (int32_t)insn >> 20;
+
+    if ((insn & 3) != 3) {
+        decode_cinsn(d, insn & 0xffff);
+        return;
+    }
+
+    switch (insn & 0x7f) {
+    case 0x37: /* lui */
+    case 0x17: /* auipc */
+        d->op  = (insn & 0x20) ? DOP_LUI : DOP_AUIPC;
+        d->imm = (int32_t)(insn & 0xfffff000);
+        break;
+    case 0x6f: /* jal */
+        d->op  = DOP_JAL;
+        d->imm = ((insn >> (31 - 20)) & (1 << 20)) | ((insn >> (21 - 1)) & 0x7fe) |
+            ((insn >> (20 - 11)) & (1 << 11)) | (insn & 0xff000);
+        d->imm = (d->imm << 11) >> 11;
+        break;
+    case 0x67: /* jalr */
+        if (funct3 == 0)
+            d->op = DOP_JALR;
+        break;
+    case 0x63:
+        d->op  = branch_ops[funct3];
+        d->imm = ((insn >> (31 - 12)) & (1 << 12)) | ((insn >> (25 - 5)) & 0x7e0) |
+            ((insn >> (8 - 1)) & 0x1e) | ((insn << (11 - 7)) & (1 << 11));
+        d->imm = (d->imm << 19) >> 19;
+        break;
+    case 0x03: /* load */
+        d->op = load_ops[funct3];
+        break;
+    case 0x23: /* store */
+        d->op  = store_ops[funct3];
+        d->imm = d->rd | ((insn >> (25 - 5)) & 0xfe0);
+        d->imm = (d->imm << 20) >> 20;
+        break;
+    case 0x13: /* OP-IMM */
+        d->op = op_imm_ops[funct3];
+        if (funct3 == 1 || funct3 == 5) {
+            if ((d->imm & ~(63 | (funct3 == 5 ? 0x400 : 0))) != 0)
+                d->op = DOP_INTERP;
+            else if (d->imm & 0x400)
+                d->op = DOP_SRAI;
+            d->imm &= 63;
+        }
+        break;
+    case 0x1b: /* OP-IMM-32 */
+        if (funct3 == 0) {
+            d->op = DOP_ADDIW;
+        } else if (funct3 == 1 || funct3 == 5) {
+            if ((d->imm & ~(31 | (funct3 == 5 ? 0x400 : 0))) == 0)
+                d->op = funct3 == 1 ? DOP_SLLIW : (d->imm & 0x400) ? DOP_SRAIW : DOP_SRLIW;
+            d->imm &= 31;
+        }
+        break;
+    case 0x33:
+        if (funct7 == 1)
+            d->op = funct3 == 0 ? DOP_MUL : DOP_INTERP;
+        else if ((funct7 & ~0x20) == 0)
+            d->op = op_ops[funct3 | (funct7 >> 2)];
+        break;
+    case 0x3b: /* OP-32 */
+        if (funct7 == 1)
+            d->op = funct3 == 0 ? DOP_MULW : DOP_INTERP;
+        else if ((funct7 & ~0x20) == 0)
+            d->op = op_32_ops[funct3 | (funct7 >> 2)];
+        break;
+    }
+}
+
+static no_inline DecodedInsn *decoded_page_miss(RISCVCPUState *s, DecodedPage **set,
+                                                uint8_t *page)
+{
+    DecodedPage *dp = set[1];
+
+    if (!dp) {
+        dp = (DecodedPage *)calloc(1, sizeof *dp);
+        if (!dp)
+            abort();
+    }
+    /* Replace the least recently used way. Its records can stay: they
+       are checked against the instruction bits before use. */
+    dp->page = page;
+    set[1] = set[0];
+    set[0] = dp;
+
+    return dp->insn;
+}
+
+/* Decoded instructions of the code page at host address page */
+static inline DecodedInsn *decoded_page(RISCVCPUState *s, uint8_t *page)
+{
+    DecodedPage **set = s->decoded_pages[((uintptr_t)page >> PG_SHIFT) & (DECODED_SETS - 1)];
+
+    if (likely(set[0] && set[0]->page == page))
+        return set[0]->insn;
+
+    return decoded_page_miss(s, set, page);
+}
+
+/* Run the LR, SC or AMO insn of a hart running in parallel with host
+   atomic operations, returning the value for rd in *pval. Only aligned
+   accesses to RAM that both data TLBs map are done here: otherwise
+   nothing is done and FALSE returned, so that the instruction can run
+   once the other harts have stopped. */
+#define AMO_HOST(size)                                                  \
+    {                                                                   \
+        uint ## size ## _t *ptr = (uint ## size ## _t *)host_ptr;       \
+        uint ## size ## _t old, val = src;                              \
+        switch (funct5) {                                               \
+        case 2: /* lr */                                                \
+            old = __atomic_load_n(ptr, __ATOMIC_SEQ_CST);               \
+            s->load_res     = addr;                                     \
+            s->load_res_val = old;                                      \
+            break;                                                      \
+        case 3: /* sc, fails if the location changed since the lr */    \
+            old = s->load_res_val;                                      \
+            *pval = s->load_res != addr ||                              \
+                !__atomic_compare_exchange_n(ptr, &old, val, FALSE,     \
+                                             __ATOMIC_SEQ_CST,          \
+                                             __ATOMIC_SEQ_CST);         \
+            s->load_res = ~0;                                           \
+            return TRUE;                                                \
+        case 1: /* amoswap */                                           \
+            old = __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);      \
+            break;                                                      \
+        case 0: /* amoadd */                                            \
+            old = __atomic_fetch_add(ptr, val, __ATOMIC_SEQ_CST);       \
+            break;                                                      \
+        case 4: /* amoxor */                                            \
+            old = __atomic_fetch_xor(ptr, val, __ATOMIC_SEQ_CST);       \
+            break;                                                      \
+        case 0xc: /* amoand */                                          \
+            old = __atomic_fetch_and(ptr, val, __ATOMIC_SEQ_CST);       \
+            break;                                                      \
+        case 0x8: /* amoor */                                           \
+            old = __atomic_fetch_or(ptr, val, __ATOMIC_SEQ_CST);        \
+            break;                                                      \
+        case 0x10: /* amomin */                                         \
+        case 0x14: /* amomax */                                         \
+        case 0x18: /* amominu */                                        \
+        case 0x1c: /* amomaxu */                                        \
+            old = __atomic_load_n(ptr, __ATOMIC_SEQ_CST);               \
+            do {                                                        \
+                BOOL lt = funct5 & 8 ? old < (uint ## size ## _t)src :  \
+                    (int ## size ## _t)old < (int ## size ## _t)src;    \
+                val = lt == !(funct5 & 4) ? old : src;                  \
+            } while (!__atomic_compare_exchange_n(ptr, &old, val, TRUE, \
+                                                  __ATOMIC_SEQ_CST,     \
+                                                  __ATOMIC_SEQ_CST));   \
+            break;                                                      \
+        default:                                                        \
+            return FALSE;                                               \
+        }                                                               \
+        *pval = (int ## size ## _t)old;                                 \
+    }
+
+static BOOL amo_host(RISCVCPUState *s, uint32_t insn, int xlen,
+                     uint64_t addr, uint64_t src, uint64_t *pval)
+{
+    uint32_t funct3 = (insn >> 12) & 7;
+    uint32_t funct5 = insn >> 27;
+    int size = funct3 == 3 ? 8 : 4;
+    uint32_t tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
+    uint8_t *host_ptr;
+
+    if ((funct3 != 2 && (funct3 != 3 || xlen < 64)) || (addr & (size - 1)) != 0 ||
+        s->tlb_read[tlb_idx].vaddr != (addr & ~PG_MASK) ||
+        s->tlb_write[tlb_idx].vaddr != (addr & ~PG_MASK))
+        return FALSE;
+    if (funct5 == 2 && ((insn >> 20) & 0x1f) != 0)
+        return FALSE; /* illegal lr */
+
+    host_ptr = (uint8_t *)(s->tlb_write[tlb_idx].mem_addend + (uintptr_t)addr);
+    if (size == 4)
+        AMO_HOST(32)
+    else
+        AMO_HOST(64)
+
+    return TRUE;
+}
+
+#undef AMO_HOST
+
 #define XLEN 32
 #include "dromajo_template.h"
 
@@ -1922,6 +2340,10 @@ RISCVCPUState *riscv_cpu_init(RISCVMachine *machine, int hartid)
 
 void riscv_cpu_end(RISCVCPUState *s)
 {
+    for (int i = 0; i < DECODED_SETS; i++) {
+        free(s->decoded_pages[i][0]);
+        free(s->decoded_pages[i][1]);
+    }
     free(s);
 }
 
@@ -2275,10 +2697,9 @@ static void create_hang_nonzero_hart(uint32_t *rom, uint32_t *code_pos, uint32_t
                                       // 1:
 }
 
-static void create_boot_rom(RISCVCPUState *s, const char *file, const uint64_t clint_base_addr)
+static void create_boot_rom(RISCVCPUState *s, uint32_t rom[ROM_SIZE / 4], const uint64_t clint_base_addr)
 {
-    uint32_t rom[ROM_SIZE / 4];
-    memset(rom, 0, sizeof rom);
+    memset(rom, 0, ROM_SIZE);
 
     // ROM organization
     // 0000..003F wasted
@@ -2418,19 +2839,11 @@ static void create_boot_rom(RISCVCPUState *s, const char *file, const uint64_t c
     // dret 0x7b200073
     rom[code_pos++] = 0x7b200073;
 
-    if (sizeof rom / sizeof *rom <= data_pos || data_pos_start <= code_pos) {
+    if (ROM_SIZE / sizeof *rom <= data_pos || data_pos_start <= code_pos) {
         fprintf(dromajo_stderr, "ERROR: ROM is too small. ROM_SIZE should increase.  "
                 "Current code_pos=%d data_pos=%d\n", code_pos, data_pos);
         exit(-6);
     }
-
-    serialize_memory(rom, ROM_SIZE, file);
-    if (s->machine->common.save_format > 0) {
-        char *f_name = (char *)alloca(strlen(file)+32);
-        sprintf(f_name, "%s.hex", file);
-
-        dump_hex_memory(rom, ROM_SIZE, f_name);
-    }
 }
 
 void riscv_cpu_serialize(RISCVCPUState *s, const char *dump_name, const uint64_t clint_base_addr)
@@ -2496,7 +2909,7 @@ void riscv_cpu_serialize(RISCVCPUState *s, const char *dump_name, const uint64_t
         fprintf(conf_fd, "pmpaddr%d:%llx\n", i, (unsigned long long)s->csr_pmpaddr[i]);
 
     PhysMemoryRange *boot_ram = 0;
-    int main_ram_found = 0;
+    PhysMemoryRange *main_ram = 0;
 
     for (int i = s->mem_map->n_phys_mem_range-1; i >= 0; --i) {
         PhysMemoryRange *pr = &s->mem_map->phys_mem_range[i];
@@ -2511,49 +2924,81 @@ void riscv_cpu_serialize(RISCVCPUState *s, const char *dump_name, const uint64_t
 
         } else if (pr->is_ram && pr->addr == s->machine->ram_base_addr) {
 
-            assert(!main_ram_found);
-            main_ram_found = 1;
-
-            char *f_name = (char *)alloca(strlen(dump_name)+64);
-            sprintf(f_name, "%s.mainram", dump_name);
-
-            serialize_memory(pr->phys_mem, pr->size, f_name);
-
-            if (s->machine->common.save_format > 0) {
-                char *f_name_hex = (char *)alloca(strlen(dump_name)+96);
-                sprintf(f_name_hex, "%s.mainram.hex", dump_name);
-
-                dump_hex_memory(pr->phys_mem, pr->size, f_name_hex);
-            }
+            assert(!main_ram);
+            main_ram = pr;
         }
     }
 
-    if (!boot_ram || !main_ram_found) {
+    if (!boot_ram || !main_ram) {
         fprintf(dromajo_stderr, "ERROR: could not find boot and main ram???\n");
         exit(-3);
     }
 
-    n = strlen(dump_name) + 64;
-    char *f_name = (char *)alloca(n);
-    snprintf(f_name, n, "%s.bootram", dump_name);
+    uint32_t rom[ROM_SIZE / 4];
 
+    assert(boot_ram->size == ROM_SIZE);
     if (s->priv != 3 || ROM_BASE_ADDR + ROM_SIZE < s->pc) {
         fprintf(dromajo_stderr, "NOTE: creating a new boot rom\n");
-        create_boot_rom(s, f_name, clint_base_addr);
+        create_boot_rom(s, rom, clint_base_addr);
     } else if (BOOT_BASE_ADDR < s->pc) {
         fprintf(dromajo_stderr, "ERROR: could not checkpoint when running inside the ROM\n");
         exit(-4);
     } else if (s->pc == BOOT_BASE_ADDR && boot_ram) {
         fprintf(dromajo_stderr, "NOTE: using the default dromajo ROM\n");
-        serialize_memory(boot_ram->phys_mem, boot_ram->size, f_name);
+        memcpy(rom, boot_ram->phys_mem, ROM_SIZE);
     } else {
         fprintf(dromajo_stderr, "ERROR: unexpected PC address 0x%llx\n", (long long)s->pc);
         exit(-4);
     }
+
+    n = strlen(dump_name) + 64;
+    char *f_name = (char *)alloca(n);
+
+    if (s->machine->common.save_format == 2) {
+        CheckpointMemory mem[] = {
+            { "bootram", ROM_BASE_ADDR,  (const uint8_t *)rom, ROM_SIZE       },
+            { "mainram", main_ram->addr, main_ram->phys_mem,   main_ram->size },
+        };
+
+        snprintf(f_name, n, "%s.ckpt", dump_name);
+        checkpoint_save(f_name, mem, 2);
+        return;
+    }
+
+    snprintf(f_name, n, "%s.mainram", dump_name);
+    serialize_memory(main_ram->phys_mem, main_ram->size, f_name);
+    snprintf(f_name, n, "%s.bootram", dump_name);
+    serialize_memory(rom, ROM_SIZE, f_name);
+
+    if (s->machine->common.save_format > 0) {
+        snprintf(f_name, n, "%s.mainram.hex", dump_name);
+        dump_hex_memory(main_ram->phys_mem, main_ram->size, f_name);
+        snprintf(f_name, n, "%s.bootram.hex", dump_name);
+        dump_hex_memory(rom, ROM_SIZE, f_name);
+    }
 }
 
 void riscv_cpu_deserialize(RISCVCPUState *s, const char *dump_name)
 {
+    size_t n = strlen(dump_name) + 64;
+    char *ckpt_name = (char *)alloca(n);
+    snprintf(ckpt_name, n, "%s.ckpt", dump_name);
+
+    CheckpointFile *ckpt = checkpoint_open(ckpt_name);
+    if (ckpt) {
+        for (int i = s->mem_map->n_phys_mem_range - 1; i >= 0; --i) {
+            PhysMemoryRange *pr = &s->mem_map->phys_mem_range[i];
+            const char *name = !pr->is_ram ? 0 :
+                pr->addr == ROM_BASE_ADDR ? "bootram" :
+                pr->addr == s->machine->ram_base_addr ? "mainram" : 0;
+
+            if (name && !checkpoint_load(ckpt, name, pr->phys_mem, pr->size))
+                errx(-3, "%s: no %s of size %lld", ckpt_name, name, (long long)pr->size);
+        }
+        checkpoint_close(ckpt);
+        return;
+    }
+
     for (int i = s->mem_map->n_phys_mem_range - 1; i >= 0; --i) {
         PhysMemoryRange *pr = &s->mem_map->phys_mem_range[i];
 
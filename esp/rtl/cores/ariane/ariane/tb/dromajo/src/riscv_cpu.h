@@ -147,6 +147,26 @@ typedef struct {
     uintptr_t mem_addend;
 } TLBEntry;
 
+/* An instruction of a code page decoded ahead of time by
+   riscv_cpu_interp64(), see decode_insn(). It is only used while the
+   code still holds the bits it was decoded from. */
+typedef struct {
+    uint32_t bits;
+    int32_t  imm;
+    uint8_t  op;
+    uint8_t  size; /* in bytes */
+    uint8_t  rd;
+    uint8_t  rs1;
+    uint8_t  rs2;
+} DecodedInsn;
+
+typedef struct {
+    uint8_t    *page; /* host address of the code page */
+    DecodedInsn insn[1 << (PG_SHIFT - 1)];
+} DecodedPage;
+
+#define DECODED_SETS 256 /* two code pages each */
+
 /* Control-flow summary information */
 typedef enum {
     ctf_nop = 1,
@@ -189,6 +209,20 @@ typedef struct RISCVCPUState {
                            * interrupts, does NOT mean terminate
                            * simulation */
     BOOL terminate_simulation;
+
+    /* Set while the hart runs alongside the others on its own host
+     * thread (dromajo --parallel). Instructions that touch state shared
+     * with other harts, device accesses, stores to the tohost page and
+     * AMOs, then end the block before they execute, setting defer_insn,
+     * and are run once all harts are stopped. With host_atomics, AMOs and LR/SC on RAM run in
+     * place with host atomic operations instead. */
+    BOOL run_parallel;
+    BOOL host_atomics;
+    BOOL defer_insn;
+    /* A store hit tohost: the instruction is done and the interpreter
+     * returns right after it, see riscv_cpu_write_memory() */
+    BOOL stop_after_insn;
+
     int pending_exception; /* used during MMU exception handling */
     target_ulong pending_tval;
 
@@ -242,6 +276,7 @@ typedef struct RISCVCPUState {
     uint32_t plic_enable_irq;
 
     target_ulong load_res; /* for atomic LR/SC */
+    uint64_t load_res_val; /* value read by LR, for SC with host_atomics */
 
     PhysMemoryMap *mem_map;
     int physical_addr_len;
@@ -255,6 +290,10 @@ typedef struct RISCVCPUState {
     target_ulong tlb_code_paddr_addend[TLB_SIZE];
 #endif
 
+    /* Decoded code pages, tagged by host address and allocated on first
+       use */
+    DecodedPage *decoded_pages[DECODED_SETS][2];
+
     // Benchmark return value
     uint64_t benchmark_exit_code;
 
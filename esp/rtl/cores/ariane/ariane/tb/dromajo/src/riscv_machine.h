@@ -75,6 +75,7 @@ struct RISCVMachine {
 
     /* HTIF */
     uint64_t htif_tohost_addr;
+    BOOL     htif_tohost_written; /* a store hit tohost since the last check */
 
     VIRTIODevice *keyboard_dev;
     VIRTIODevice *mouse_dev;
@@ -2,10 +2,15 @@
 #include "svdpi.h"
 #endif
 #include "memory_system.h"
+#include "checkpoint.h"
 #include <string>
+#include <algorithm>
+#include <deque>
+#include <vector>
 #include <memory>
 #include <cassert>
 #include <cstdio>
+#include <fstream>
 #include <inttypes.h>
 
 #define __stringify(x)                          \
@@ -31,10 +36,25 @@ using dramsim3::Address;
 using addr_t = long long;
 
 static MemorySystem *_memory_system = nullptr;
-static bool         *_read_done = nullptr;
-static addr_t       *_read_done_addr = nullptr;
-static bool         *_write_done = nullptr;
-static addr_t       *_write_done_addr = nullptr;
+
+/*
+ * Completed requests, one FIFO per channel. DRAMSim3 can complete several
+ * requests on a channel in the same cycle, so nothing is dropped here.
+ *
+ * The get_*_done() interface keeps its original semantics: a completion is
+ * presented only in the cycle it happens, and the next tick clears it. It can
+ * show one address per channel and cycle, so of simultaneous completions it
+ * shows the last one. A testbench that must see all of them calls
+ * bsg_dramsim3_pop_*_done() instead; from the first call it owns the FIFOs of
+ * that direction and ticks no longer clear them.
+ */
+struct done_queue {
+    vector<deque<addr_t>> q;
+    bool popped = false;
+};
+
+static done_queue _read_done;
+static done_queue _write_done;
 
 static constexpr bool WRITE = true;
 static constexpr bool READ  = false;
@@ -73,25 +93,68 @@ extern "C" bool bsg_dramsim3_send_write_req(addr_t addr)
     }
 }
 
+static void clear_presented(done_queue &done)
+{
+    if (done.popped)
+        return;
+
+    for (auto &q : done.q)
+        q.clear();
+}
+
 /**
  * Execute a single clock tick in the memory system.
  */
 extern "C" void bsg_dramsim3_tick()
 {
-    for (int ch = 0; ch < _memory_system->GetConfig()->channels; ch++) {
-        _read_done[ch] = false;
-        _write_done[ch] = false;
-    }
+    clear_presented(_read_done);
+    clear_presented(_write_done);
     _memory_system->ClockTick();
 }
 
+/**
+ * Get the current clock cycle of the memory system.
+ */
+extern "C" long long bsg_dramsim3_get_cycle()
+{
+    return _memory_system->GetClock();
+}
+
+/**
+ * Get the first cycle at which a tick can change the state of the memory
+ * system or complete a request. Until then, ticks only count idle cycles and
+ * can be replaced by bsg_dramsim3_skip_cycles().
+ * @return the next event cycle; the current cycle if the next tick is busy
+ */
+extern "C" long long bsg_dramsim3_next_event_cycle()
+{
+    return _memory_system->NextEventCycle();
+}
+
+/**
+ * Advance the memory system by up to cycles idle cycles at once. Statistics
+ * are accounted as if each cycle had been ticked.
+ * @param[in] cycles The number of cycles to skip
+ * @return the number of cycles skipped, clamped to the next event cycle
+ */
+extern "C" long long bsg_dramsim3_skip_cycles(long long cycles)
+{
+    uint64_t idle = _memory_system->NextEventCycle() - _memory_system->GetClock();
+    uint64_t skip = cycles < 0 ? 0 : std::min(idle, static_cast<uint64_t>(cycles));
+
+    clear_presented(_read_done);
+    clear_presented(_write_done);
+    _memory_system->SkipIdleCycles(skip);
+    return skip;
+}
+
 /**
  * Check if the channel has complete a read request.
  * @param[in] ch The channel to check for completion.
  */
 extern "C" bool bsg_dramsim3_get_read_done(int ch)
 {
-    return _read_done[ch];
+    return !_read_done.q[ch].empty();
 }
 
 /**
@@ -100,7 +163,7 @@ extern "C" bool bsg_dramsim3_get_read_done(int ch)
  */
 extern "C" bool bsg_dramsim3_get_write_done(int ch)
 {
-    return _write_done[ch];
+    return !_write_done.q[ch].empty();
 }
 
 /**
@@ -109,7 +172,7 @@ extern "C" bool bsg_dramsim3_get_write_done(int ch)
  */
 extern "C" addr_t bsg_dramsim3_get_read_done_addr(int ch)
 {
-    return _read_done_addr[ch];
+    return _read_done.q[ch].empty() ? 0 : _read_done.q[ch].back();
 }
 
 /**
@@ -118,9 +181,120 @@ extern "C" addr_t bsg_dramsim3_get_read_done_addr(int ch)
  */
 extern "C" addr_t bsg_dramsim3_get_write_done_addr(int ch)
 {
-    return _write_done_addr[ch];
+    return _write_done.q[ch].empty() ? 0 : _write_done.q[ch].back();
 }
 
+static int pop_done(done_queue &done, int ch, addr_t *addrs, int max)
+{
+    auto &q = done.q[ch];
+    int n = 0;
+
+    done.popped = true;
+    while (n < max && !q.empty()) {
+        addrs[n++] = q.front();
+        q.pop_front();
+    }
+    return n;
+}
+
+/**
+ * Pop the addresses of completed read requests, oldest first.
+ * @param[in]  ch    The channel to pop from
+ * @param[out] addrs Buffer for at least max addresses
+ * @param[in]  max   The maximum number of addresses to pop
+ * @return the number of addresses written to addrs
+ */
+extern "C" int bsg_dramsim3_pop_read_done(int ch, addr_t *addrs, int max)
+{
+    return pop_done(_read_done, ch, addrs, max);
+}
+
+/**
+ * Pop the addresses of completed write requests, oldest first.
+ * @param[in]  ch    The channel to pop from
+ * @param[out] addrs Buffer for at least max addresses
+ * @param[in]  max   The maximum number of addresses to pop
+ * @return the number of addresses written to addrs
+ */
+extern "C" int bsg_dramsim3_pop_write_done(int ch, addr_t *addrs, int max)
+{
+    return pop_done(_write_done, ch, addrs, max);
+}
+
+static void save_done(dramsim3::CheckpointWriter &out, const done_queue &done)
+{
+    out.Put(done.popped);
+    out.Put<uint64_t>(done.q.size());
+    for (const auto &q : done.q)
+        out.Put(vector<addr_t>(q.begin(), q.end()));
+}
+
+static void load_done(dramsim3::CheckpointReader &in, done_queue &done)
+{
+    uint64_t channels = 0;
+    in.Get(done.popped);
+    in.Get(channels);
+    if (channels != done.q.size()) {
+        in.Fail();
+        return;
+    }
+    for (auto &q : done.q) {
+        vector<addr_t> addrs;
+        in.Get(addrs);
+        q.assign(addrs.begin(), addrs.end());
+    }
+}
+
+/**
+ * Save the state of the memory system to a checkpoint file: bank and row
+ * state, refresh counters, queues, statistics, and the completions not yet
+ * presented. Call it between ticks. The data in memory is not part of it.
+ * @param[in] path The checkpoint file to write
+ * @return true if the checkpoint was written
+ */
+extern "C" bool bsg_dramsim3_save(const char *path)
+{
+    ofstream file(path, ios::binary | ios::trunc);
+    dramsim3::CheckpointWriter out(file);
+
+    if (!_memory_system->SaveCheckpoint(file)) {
+        pr_err("failed to save checkpoint %s\n", path);
+        return false;
+    }
+    save_done(out, _read_done);
+    save_done(out, _write_done);
+    file.flush();
+    if (!out.Ok()) {
+        pr_err("failed to save checkpoint %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Restore the memory system from a checkpoint file written by
+ * bsg_dramsim3_save() with the same config. The cycle count continues from
+ * the checkpoint.
+ * @param[in] path The checkpoint file to read
+ * @return true if the checkpoint was restored
+ */
+extern "C" bool bsg_dramsim3_restore(const char *path)
+{
+    ifstream file(path, ios::binary);
+    dramsim3::CheckpointReader in(file);
+
+    if (!file.is_open() || !_memory_system->LoadCheckpoint(file)) {
+        pr_err("failed to restore checkpoint %s\n", path);
+        return false;
+    }
+    load_done(in, _read_done);
+    load_done(in, _write_done);
+    if (!in.Ok() || file.peek() != ifstream::traits_type::eof()) {
+        pr_err("failed to restore checkpoint %s\n", path);
+        return false;
+    }
+    return true;
+}
 
 /**
  * Cleanup code for the memory system.
@@ -128,10 +302,8 @@ extern "C" addr_t bsg_dramsim3_get_write_done_addr(int ch)
 extern "C" void bsg_dramsim3_exit(void)
 {
     delete _memory_system;
-    delete [] _read_done;
-    delete [] _read_done_addr;
-    delete [] _write_done;
-    delete [] _write_done_addr;
+    _read_done = done_queue();
+    _write_done = done_queue();
 }
 
 /**
@@ -157,35 +329,21 @@ extern "C" bool bsg_dramsim3_init(
     pr_dbg("config_file='%s'\n", config_file.c_str());
     
     /* initialize book keeping structures */
-    _read_done      = new bool [num_channels_p];
-    _read_done_addr = new addr_t [num_channels_p];
-    _write_done      = new bool [num_channels_p];
-    _write_done_addr = new addr_t [num_channels_p];
-
-    for (int i = 0; i < num_channels_p; i++) {
-        _read_done[i] = false;
-        _read_done_addr[i] = 0;
-        _write_done[i] = false;
-        _write_done_addr[i] = 0;
-    }
+    _read_done.q.assign(num_channels_p, deque<addr_t>());
+    _write_done.q.assign(num_channels_p, deque<addr_t>());
 
     /* called when read completes */
     auto read_done  = [](uint64_t addr) {
         int ch = _memory_system->GetConfig()->AddressMapping(addr).channel;
         pr_dbg("read_done called: ch=%d, addr=0x%010" PRIx64 "\n", ch, addr);
-        if (_read_done[ch]) {
-          pr_dbg("ERROR: read done called twice in the same cycle. ch=%d\n", ch);
-        }
-        _read_done[ch] = true;
-        _read_done_addr[ch] = addr;
+        _read_done.q[ch].push_back(addr);
     };
 
     /* called when write completes */
     auto write_done = [](uint64_t addr) {
         int ch = _memory_system->GetConfig()->AddressMapping(addr).channel;
         pr_dbg("write_done called: ch=%d, addr=0x%010" PRIx64 "\n", ch, addr);
-        _write_done[ch] = true;
-        _write_done_addr[ch] = addr;
+        _write_done.q[ch].push_back(addr);
     };
 
     _memory_system = new MemorySystem(config_file, output_dir, read_done, write_done);
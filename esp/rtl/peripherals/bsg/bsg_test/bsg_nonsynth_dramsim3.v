@@ -76,16 +76,54 @@ module bsg_nonsynth_dramsim3
   
   import "DPI-C" context function 
     longint bsg_dramsim3_get_write_done_addr(int ch);
+
+  // Batched alternative to the get_*_done functions above: drain up to
+  // done_batch_lp completions of a channel at once, including those that
+  // finish in the same cycle. Once called, ticks stop clearing completions
+  // of that direction, so do not mix the two styles. This module uses these.
+  localparam done_batch_lp = 16;
+
+  import "DPI-C" context function
+    int     bsg_dramsim3_pop_read_done(input int ch,
+                                       output longint addrs[done_batch_lp],
+                                       input int max);
+
+  import "DPI-C" context function
+    int     bsg_dramsim3_pop_write_done(input int ch,
+                                        output longint addrs[done_batch_lp],
+                                        input int max);
   
   import "DPI-C" context function
     void    bsg_dramsim3_tick();
+
+  import "DPI-C" context function
+    longint bsg_dramsim3_get_cycle();
+
+  import "DPI-C" context function
+    longint bsg_dramsim3_next_event_cycle();
+
+  import "DPI-C" context function
+    longint bsg_dramsim3_skip_cycles(input longint cycles);
+  
+  // Checkpoints of the memory system state (not of the data in memory).
+  // +dramsim3_restore=<file> restores one right after init, and
+  // +dramsim3_save=<file> saves one at the end of the simulation.
+  import "DPI-C" context function
+    bit     bsg_dramsim3_save(string path);
+
+  import "DPI-C" context function
+    bit     bsg_dramsim3_restore(string path);
   
   import "DPI-C" context function 
     void    bsg_dramsim3_exit();
      bit    init;
+     string checkpoint_file;
 
   initial begin
     init = bsg_dramsim3_init(num_channels_p, data_width_p, size_in_bits_p, num_columns_p, config_p);
+    if ($value$plusargs("dramsim3_restore=%s", checkpoint_file))
+      if (!bsg_dramsim3_restore(checkpoint_file))
+        $fatal(1, "cannot restore DRAMSim3 checkpoint %s", checkpoint_file);
   end
 
   // memory addr
@@ -163,24 +201,44 @@ module bsg_nonsynth_dramsim3
   end
 
 
+  // Completions popped from DRAMSim3 but not yet presented. A channel has
+  // one read port, so a completion is presented in the cycle it happens and
+  // any others of the same cycle follow on the next cycles.
+  longint read_pending [num_channels_p-1:0][$];
+  longint write_pending [num_channels_p-1:0][$];
+  longint done_addrs [done_batch_lp];
+  int     n_done;
+
   always_ff @ (posedge clk_i) begin
     if (reset_i) begin
       read_done <= '0;
       read_done_addr <= '0;
       write_done_o <= '0;
       write_done_addr <= '0;
+      for (integer i = 0; i < num_channels_p; i++) begin
+        read_pending[i].delete();
+        write_pending[i].delete();
+      end
     end
     else begin
 
       // getting read/write done
       for (integer i = 0; i < num_channels_p; i++) begin
-        read_done[i] <= bsg_dramsim3_get_read_done(i);
-        if (bsg_dramsim3_get_read_done(i))
-          read_done_addr[i] <= bsg_dramsim3_get_read_done_addr(i);
+        n_done = bsg_dramsim3_pop_read_done(i, done_addrs, done_batch_lp);
+        for (integer j = 0; j < n_done; j++)
+          read_pending[i].push_back(done_addrs[j]);
+
+        n_done = bsg_dramsim3_pop_write_done(i, done_addrs, done_batch_lp);
+        for (integer j = 0; j < n_done; j++)
+          write_pending[i].push_back(done_addrs[j]);
+
+        read_done[i] <= (read_pending[i].size() != 0);
+        if (read_pending[i].size() != 0)
+          read_done_addr[i] <= read_pending[i].pop_front();
 
-        write_done_o[i] <= bsg_dramsim3_get_write_done(i);
-        if (bsg_dramsim3_get_write_done(i))
-          write_done_addr[i] <= bsg_dramsim3_get_write_done_addr(i);
+        write_done_o[i] <= (write_pending[i].size() != 0);
+        if (write_pending[i].size() != 0)
+          write_done_addr[i] <= write_pending[i].pop_front();
       end
 
       // tick
@@ -295,6 +353,8 @@ module bsg_nonsynth_dramsim3
 
   // final
   final begin
+    if ($value$plusargs("dramsim3_save=%s", checkpoint_file))
+      void'(bsg_dramsim3_save(checkpoint_file));
     bsg_dramsim3_exit();
     $fclose(file);
   end
@@ -46,8 +46,19 @@ module bsg_nonsynth_ramulator_hbm
   import "DPI-C" context function void tick();
   import "DPI-C" context function void finish_hbm();
 
+  // Checkpoints of the memory state (not of the data in memory).
+  // +ramulator_restore=<file> restores one right after init, and
+  // +ramulator_save=<file> saves one at the end of the simulation.
+  import "DPI-C" context function bit save_hbm(string path);
+  import "DPI-C" context function bit restore_hbm(string path);
+
+  string checkpoint_file;
+
   initial begin
     init_hbm();
+    if ($value$plusargs("ramulator_restore=%s", checkpoint_file))
+      if (!restore_hbm(checkpoint_file))
+        $fatal(1, "cannot restore ramulator checkpoint %s", checkpoint_file);
   end
 
   // memory addr
@@ -191,6 +202,8 @@ module bsg_nonsynth_ramulator_hbm
 
   // final
   final begin
+    if ($value$plusargs("ramulator_save=%s", checkpoint_file))
+      void'(save_hbm(checkpoint_file));
     finish_hbm();
     $fclose(file);
   end
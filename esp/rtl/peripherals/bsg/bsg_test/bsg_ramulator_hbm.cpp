@@ -6,6 +6,7 @@
 
 
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <map>
 #ifdef SV_TEST
@@ -13,6 +14,7 @@
 #endif
 #include "HBM.h"
 #include "Controller.h"
+#include "Checkpoint.h"
 #include "Config.h"
 #include "Memory.h"
 #include "StatType.h"
@@ -36,6 +38,14 @@ static bool _read_done[NUM_CHANNEL];
 static long _read_done_addr[NUM_CHANNEL];
 
 
+static void read_complete(Request& r)
+{
+  int ch = r.addr_vec[0];
+  _read_done[ch] = true;
+  _read_done_addr[ch] = r.addr;
+}
+
+
 // Init
 //
 extern "C" void init_hbm()
@@ -88,12 +98,6 @@ extern "C" bool send_write_req(long addr)
 // Send Read Request
 extern "C" bool send_read_req(long addr)
 {
-  auto read_complete = [](Request& r) {
-    int ch = r.addr_vec[0];
-    _read_done[ch] = true;
-    _read_done_addr[ch] = r.addr;
-  };
-   
   Request req(addr, Request::Type::READ, read_complete);
   return _memory->send(req);
 }
@@ -121,6 +125,42 @@ extern "C" void tick()
 }
 
 
+// Save the memory state (banks, rows, refresh, queues, stats) between ticks.
+// The data in memory is not part of it.
+extern "C" bool save_hbm(const char* path)
+{
+  ofstream file(path, ios::binary | ios::trunc);
+  CheckpointOut out(file);
+
+  bool ok = _memory->save(file);
+  out.put(_read_done);
+  out.put(_read_done_addr);
+  file.flush();
+  if (!ok || !out.ok()) {
+    cerr << "[RAMULATOR] Failed to save checkpoint " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+
+// Restore a checkpoint of save_hbm() into a memory with the same config.
+extern "C" bool restore_hbm(const char* path)
+{
+  ifstream file(path, ios::binary);
+  CheckpointIn in(file);
+
+  bool ok = file.is_open() && _memory->load(file, read_complete);
+  in.get(_read_done);
+  in.get(_read_done_addr);
+  if (!ok || !in.ok() || file.peek() != ifstream::traits_type::eof()) {
+    cerr << "[RAMULATOR] Failed to restore checkpoint " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+
 // Finish
 extern "C" void finish_hbm()
 {
@@ -18,8 +18,21 @@ BankState::BankState()
     cmd_timing_[static_cast<int>(CommandType::SREF_EXIT)] = 0;
 }
 
+void BankState::Save(CheckpointWriter& out) const {
+    out.Put(state_);
+    out.Put(cmd_timing_);
+    out.Put(open_row_);
+    out.Put(row_hit_count_);
+}
 
-Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
+void BankState::Load(CheckpointReader& in) {
+    in.Get(state_);
+    in.GetFixed(cmd_timing_);
+    in.Get(open_row_);
+    in.Get(row_hit_count_);
+}
+
+CommandType BankState::RequiredCommand(const Command& cmd) const {
     CommandType required_type = CommandType::SIZE;
     switch (state_) {
         case State::CLOSED:
@@ -85,6 +98,11 @@ Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
             break;
     }
 
+    return required_type;
+}
+
+Command BankState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
+    CommandType required_type = RequiredCommand(cmd);
     if (required_type != CommandType::SIZE) {
         if (clk >= cmd_timing_[static_cast<int>(required_type)]) {
             return Command(required_type, cmd.addr, cmd.hex_addr);
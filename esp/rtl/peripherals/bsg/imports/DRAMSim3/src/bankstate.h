@@ -2,6 +2,7 @@
 #define __BANKSTATE_H
 
 #include <vector>
+#include "checkpoint.h"
 #include "common.h"
 
 namespace dramsim3 {
@@ -13,6 +14,14 @@ class BankState {
     enum class State { OPEN, CLOSED, SREF, PD, SIZE };
     Command GetReadyCommand(const Command& cmd, uint64_t clk) const;
 
+    // The command that has to be issued next in order to serve cmd, and the
+    // earliest cycle at which it can be. Neither changes until a command is
+    // issued to the bank.
+    CommandType RequiredCommand(const Command& cmd) const;
+    uint64_t ReadyCycle(CommandType required_type) const {
+        return cmd_timing_[static_cast<int>(required_type)];
+    }
+
     // Update the state of the bank resulting after the execution of the command
     void UpdateState(const Command& cmd);
 
@@ -23,6 +32,9 @@ class BankState {
     int OpenRow() const { return open_row_; }
     int RowHitCount() const { return row_hit_count_; }
 
+    void Save(CheckpointWriter& out) const;
+    void Load(CheckpointReader& in);
+
    private:
     // Current state of the Bank
     // Apriori or instantaneously transitions on a command.
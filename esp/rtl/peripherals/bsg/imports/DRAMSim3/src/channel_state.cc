@@ -1,4 +1,6 @@
 #include "channel_state.h"
+#include <algorithm>
+#include <limits>
 
 namespace dramsim3 {
 ChannelState::ChannelState(const Config& config, const Timing& timing)
@@ -21,6 +23,36 @@ ChannelState::ChannelState(const Config& config, const Timing& timing)
     }
 }
 
+void ChannelState::Save(CheckpointWriter& out) const {
+    out.Put(rank_idle_cycles);
+    out.Put(rank_is_sref_);
+    for (const auto& rank_states : bank_states_) {
+        for (const auto& bg_states : rank_states) {
+            for (const auto& bank_state : bg_states) {
+                bank_state.Save(out);
+            }
+        }
+    }
+    out.Put(refresh_q_);
+    out.Put(four_aw_);
+    out.Put(thirty_two_aw_);
+}
+
+void ChannelState::Load(CheckpointReader& in) {
+    in.GetFixed(rank_idle_cycles);
+    in.GetFixed(rank_is_sref_);
+    for (auto& rank_states : bank_states_) {
+        for (auto& bg_states : rank_states) {
+            for (auto& bank_state : bg_states) {
+                bank_state.Load(in);
+            }
+        }
+    }
+    in.Get(refresh_q_);
+    in.GetFixed(four_aw_);
+    in.GetFixed(thirty_two_aw_);
+}
+
 bool ChannelState::IsAllBankIdleInRank(int rank) const {
     for (int j = 0; j < config_.bankgroups; j++) {
         for (int k = 0; k < config_.banks_per_group; k++) {
@@ -114,6 +146,44 @@ Command ChannelState::GetReadyCommand(const Command& cmd, uint64_t clk) const {
     }
 }
 
+uint64_t ChannelState::ReadyCycle(const Command& cmd) const {
+    if (cmd.IsRankCMD()) {
+        // a rank command goes out once every bank is ready for it, unless a
+        // bank needs something else first (likely PRECHARGE)
+        uint64_t all_ready = 0;
+        uint64_t other_ready = std::numeric_limits<uint64_t>::max();
+        for (auto j = 0; j < config_.bankgroups; j++) {
+            for (auto k = 0; k < config_.banks_per_group; k++) {
+                const auto& bank = bank_states_[cmd.Rank()][j][k];
+                auto required_type = bank.RequiredCommand(cmd);
+                uint64_t ready = bank.ReadyCycle(required_type);
+                if (required_type != cmd.cmd_type) {
+                    other_ready = std::min(other_ready, ready);
+                } else {
+                    all_ready = std::max(all_ready, ready);
+                }
+            }
+        }
+        return std::min(all_ready, other_ready);
+    } else {
+        const auto& bank =
+            bank_states_[cmd.Rank()][cmd.Bankgroup()][cmd.Bank()];
+        auto required_type = bank.RequiredCommand(cmd);
+        uint64_t ready = bank.ReadyCycle(required_type);
+        if (required_type == CommandType::ACTIVATE) {
+            const auto& faw = four_aw_[cmd.Rank()];
+            if (faw.size() >= 4) {
+                ready = std::max(ready, faw[0]);
+            }
+            const auto& aw32 = thirty_two_aw_[cmd.Rank()];
+            if (config_.IsGDDR() && aw32.size() >= 32) {
+                ready = std::max(ready, aw32[0]);
+            }
+        }
+        return ready;
+    }
+}
+
 void ChannelState::UpdateState(const Command& cmd) {
     if (cmd.IsRankCMD()) {
         for (auto j = 0; j < config_.bankgroups; j++) {
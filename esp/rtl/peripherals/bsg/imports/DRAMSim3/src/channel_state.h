@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "bankstate.h"
+#include "checkpoint.h"
 #include "common.h"
 #include "configuration.h"
 #include "timing.h"
@@ -13,6 +14,8 @@ class ChannelState {
    public:
     ChannelState(const Config& config, const Timing& timing);
     Command GetReadyCommand(const Command& cmd, uint64_t clk) const;
+    // Lower bound on the first cycle at which GetReadyCommand(cmd) is valid
+    uint64_t ReadyCycle(const Command& cmd) const;
     void UpdateState(const Command& cmd);
     void UpdateTiming(const Command& cmd, uint64_t clk);
     void UpdateTimingAndStates(const Command& cmd, uint64_t clk);
@@ -35,6 +38,9 @@ class ChannelState {
         return bank_states_[rank][bankgroup][bank].RowHitCount();
     };
 
+    void Save(CheckpointWriter& out) const;
+    void Load(CheckpointReader& in);
+
     std::vector<int> rank_idle_cycles;
 
    private:
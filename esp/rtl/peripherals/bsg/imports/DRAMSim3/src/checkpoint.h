@@ -0,0 +1,192 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+#include "common.h"
+
+namespace dramsim3 {
+
+// Binary checkpoint streams. Values are stored raw, in host byte order, and
+// containers as a 64-bit length followed by their elements, so a checkpoint
+// is only meant to be restored by the same build with the same config.
+// Errors are sticky: once a read or write fails every later one is a no-op
+// and Ok() returns false, so callers check once at the end.
+class CheckpointWriter {
+   public:
+    explicit CheckpointWriter(std::ostream &out) : out_(out) {}
+    bool Ok() const { return out_.good(); }
+
+    template <class T>
+    void Put(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "only plain values can be written raw");
+        out_.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <class T>
+    void Put(const std::vector<T> &values) {
+        Put<uint64_t>(values.size());
+        for (const auto &value : values) {
+            Put(value);
+        }
+    }
+
+    void Put(const std::vector<bool> &values) {
+        Put<uint64_t>(values.size());
+        for (bool value : values) {
+            Put(value);
+        }
+    }
+
+    template <class K, class V>
+    void Put(const std::multimap<K, V> &values) {
+        Put<uint64_t>(values.size());
+        for (const auto &it : values) {
+            Put(it.first);
+            Put(it.second);
+        }
+    }
+
+    // sorted, so that equal sets give equal checkpoints
+    void Put(const std::unordered_set<int> &values) {
+        std::vector<int> sorted(values.begin(), values.end());
+        std::sort(sorted.begin(), sorted.end());
+        Put(sorted);
+    }
+
+    void Put(const Address &addr) {
+        Put(addr.channel);
+        Put(addr.rank);
+        Put(addr.bankgroup);
+        Put(addr.bank);
+        Put(addr.row);
+        Put(addr.column);
+    }
+
+    void Put(const Command &cmd) {
+        Put(cmd.cmd_type);
+        Put(cmd.addr);
+        Put(cmd.hex_addr);
+    }
+
+    void Put(const Transaction &trans) {
+        Put(trans.addr);
+        Put(trans.added_cycle);
+        Put(trans.complete_cycle);
+        Put(trans.is_write);
+    }
+
+   private:
+    std::ostream &out_;
+};
+
+class CheckpointReader {
+   public:
+    explicit CheckpointReader(std::istream &in) : in_(in) {}
+    bool Ok() const { return in_.good(); }
+    void Fail() { in_.setstate(std::ios::failbit); }
+
+    template <class T>
+    void Get(T &value) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "only plain values can be read raw");
+        in_.read(reinterpret_cast<char *>(&value), sizeof(T));
+    }
+
+    // Existing elements are read in place and new ones appended one at a
+    // time: reserved capacities survive a load (the controllers size their
+    // queues by capacity), and a corrupt length runs into the end of the
+    // file instead of a huge allocation.
+    template <class T>
+    void Get(std::vector<T> &values) {
+        uint64_t size = 0;
+        Get(size);
+        uint64_t i = 0;
+        for (; i < size && i < values.size() && Ok(); i++) {
+            Get(values[i]);
+        }
+        values.erase(values.begin() + i, values.end());
+        for (; i < size && Ok(); i++) {
+            T value;
+            Get(value);
+            values.push_back(value);
+        }
+    }
+
+    void Get(std::vector<bool> &values) {
+        uint64_t size = 0;
+        Get(size);
+        values.clear();
+        for (uint64_t i = 0; i < size && Ok(); i++) {
+            bool value = false;
+            Get(value);
+            values.push_back(value);
+        }
+    }
+
+    template <class K, class V>
+    void Get(std::multimap<K, V> &values) {
+        uint64_t size = 0;
+        Get(size);
+        values.clear();
+        for (uint64_t i = 0; i < size && Ok(); i++) {
+            K key;
+            V value;
+            Get(key);
+            Get(value);
+            values.emplace(key, value);
+        }
+    }
+
+    void Get(std::unordered_set<int> &values) {
+        std::vector<int> sorted;
+        Get(sorted);
+        values.clear();
+        values.insert(sorted.begin(), sorted.end());
+    }
+
+    // For containers whose shape comes from the config: the stored length
+    // has to match the current one.
+    template <class T>
+    void GetFixed(std::vector<T> &values) {
+        size_t size = values.size();
+        Get(values);
+        if (values.size() != size) {
+            Fail();
+            values.resize(size);
+        }
+    }
+
+    void Get(Address &addr) {
+        Get(addr.channel);
+        Get(addr.rank);
+        Get(addr.bankgroup);
+        Get(addr.bank);
+        Get(addr.row);
+        Get(addr.column);
+    }
+
+    void Get(Command &cmd) {
+        Get(cmd.cmd_type);
+        Get(cmd.addr);
+        Get(cmd.hex_addr);
+    }
+
+    void Get(Transaction &trans) {
+        Get(trans.addr);
+        Get(trans.added_cycle);
+        Get(trans.complete_cycle);
+        Get(trans.is_write);
+    }
+
+   private:
+    std::istream &in_;
+};
+
+}  // namespace dramsim3
+#endif
@@ -1,4 +1,6 @@
 #include "command_queue.h"
+#include <algorithm>
+#include <limits>
 
 namespace dramsim3 {
 
@@ -33,6 +35,24 @@ CommandQueue::CommandQueue(int channel_id, const Config& config,
     }
 }
 
+void CommandQueue::Save(CheckpointWriter& out) const {
+    out.Put(rank_q_empty);
+    out.Put(queues_);
+    out.Put(ref_q_indices_);
+    out.Put(is_in_ref_);
+    out.Put(queue_idx_);
+    out.Put(clk_);
+}
+
+void CommandQueue::Load(CheckpointReader& in) {
+    in.GetFixed(rank_q_empty);
+    in.GetFixed(queues_);
+    in.Get(ref_q_indices_);
+    in.Get(is_in_ref_);
+    in.Get(queue_idx_);
+    in.Get(clk_);
+}
+
 Command CommandQueue::GetCommandToIssue() {
     for (int i = 0; i < num_queues_; i++) {
         auto& queue = GetNextQueue();
@@ -103,7 +123,7 @@ bool CommandQueue::ArbitratePrecharge(const CMDIterator& cmd_it,
         channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(), cmd.Bank()) >=
         4;
     if (!pending_row_hits_exist || rowhit_limit_reached) {
-        simple_stats_.Increment("num_ondemand_pres");
+        simple_stats_.Increment(StatCounter::NUM_ONDEMAND_PRES);
         return true;
     }
     return false;
@@ -124,6 +144,16 @@ bool CommandQueue::QueueEmpty() const {
 }
 
 
+uint64_t CommandQueue::NextReadyCycle() const {
+    uint64_t next = std::numeric_limits<uint64_t>::max();
+    for (const auto& q : queues_) {
+        for (const auto& cmd : q) {
+            next = std::min(next, channel_state_.ReadyCycle(cmd));
+        }
+    }
+    return next;
+}
+
 bool CommandQueue::AddCommand(Command cmd) {
     auto& queue = GetQueue(cmd.Rank(), cmd.Bankgroup(), cmd.Bank());
     if (queue.size() < queue_size_) {
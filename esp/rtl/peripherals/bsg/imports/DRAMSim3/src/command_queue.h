@@ -4,6 +4,7 @@
 #include <unordered_set>
 #include <vector>
 #include "channel_state.h"
+#include "checkpoint.h"
 #include "common.h"
 #include "configuration.h"
 #include "simple_stats.h"
@@ -21,10 +22,15 @@ class CommandQueue {
     Command GetCommandToIssue();
     Command FinishRefresh();
     void ClockTick() { clk_ += 1; };
+    void SkipCycles(uint64_t cycles) { clk_ += cycles; }
+    // lower bound on the cycle at which a queued command can be issued
+    uint64_t NextReadyCycle() const;
     bool WillAcceptCommand(int rank, int bankgroup, int bank) const;
     bool AddCommand(Command cmd);
     bool QueueEmpty() const;
     int QueueUsage() const;
+    void Save(CheckpointWriter& out) const;
+    void Load(CheckpointReader& in);
     std::vector<bool> rank_q_empty;
 
    private:
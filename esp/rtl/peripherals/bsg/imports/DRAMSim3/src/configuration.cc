@@ -160,6 +160,16 @@ void Config::InitOtherParams() {
     // 1: default value, adds epoch CSV output on level 0
     // 2: adds histogram outputs in a different CSV format
     output_level = reader.GetInteger("other", "output_level", 1);
+    // number of threads ticking the channels, 0 or 1 keeps the serial engine.
+    // Threads only pay off for runs of many cycles without new transactions,
+    // such as sparse traces, and with several channels per thread: at most
+    // channels / 4 threads and one per CPU are used, and single ClockTick()s
+    // stay serial.
+    sim_threads = reader.GetInteger("other", "sim_threads", 0);
+#ifdef THERMAL
+    // the thermal model is shared by all channels
+    sim_threads = 0;
+#endif  // THERMAL
     // Other Parameters
     // give a prefix instead of specify the output name one by one...
     // this would allow outputing to a directory and you can always override
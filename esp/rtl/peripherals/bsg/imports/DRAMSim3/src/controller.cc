@@ -1,4 +1,5 @@
 #include "controller.h"
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -48,10 +49,11 @@ std::pair<uint64_t, int> Controller::ReturnDoneTrans(uint64_t clk) {
     while (it != return_queue_.end()) {
         if (clk >= it->complete_cycle) {
             if (it->is_write) {
-                simple_stats_.Increment("num_writes_done");
+                simple_stats_.Increment(StatCounter::NUM_WRITES_DONE);
             } else {
-                simple_stats_.Increment("num_reads_done");
-                simple_stats_.AddValue("read_latency", clk_ - it->added_cycle);
+                simple_stats_.Increment(StatCounter::NUM_READS_DONE);
+                simple_stats_.AddValue(StatHisto::READ_LATENCY,
+                                       clk_ - it->added_cycle);
             }
             auto pair = std::make_pair(it->addr, it->is_write);
             it = return_queue_.erase(it);
@@ -87,7 +89,7 @@ void Controller::ClockTick() {
             if (second_cmd.IsValid()) {
                 if (second_cmd.IsReadWrite() != cmd.IsReadWrite()) {
                     IssueCommand(second_cmd);
-                    simple_stats_.Increment("hbm_dual_cmds");
+                    simple_stats_.Increment(StatCounter::HBM_DUAL_CMDS);
                 }
             }
         }
@@ -96,14 +98,16 @@ void Controller::ClockTick() {
     // power updates pt 1
     for (int i = 0; i < config_.ranks; i++) {
         if (channel_state_.IsRankSelfRefreshing(i)) {
-            simple_stats_.IncrementVec("sref_cycles", i);
+            simple_stats_.IncrementVec(StatVecCounter::SREF_CYCLES, i);
         } else {
             bool all_idle = channel_state_.IsAllBankIdleInRank(i);
             if (all_idle) {
-                simple_stats_.IncrementVec("all_bank_idle_cycles", i);
+                simple_stats_.IncrementVec(
+                    StatVecCounter::ALL_BANK_IDLE_CYCLES, i);
                 channel_state_.rank_idle_cycles[i] += 1;
             } else {
-                simple_stats_.IncrementVec("rank_active_cycles", i);
+                simple_stats_.IncrementVec(StatVecCounter::RANK_ACTIVE_CYCLES,
+                                           i);
                 // reset
                 channel_state_.rank_idle_cycles[i] = 0;
             }
@@ -145,10 +149,81 @@ void Controller::ClockTick() {
     ScheduleTransaction();
     clk_++;
     cmd_queue_.ClockTick();
-    simple_stats_.Increment("num_cycles");
+    simple_stats_.Increment(StatCounter::NUM_CYCLES);
     return;
 }
 
+uint64_t Controller::NextEventCycle() const {
+    // a waiting refresh makes progress on every tick
+    if (channel_state_.IsRefreshWaiting() || force_reads_) {
+        return clk_;
+    }
+
+    // Pending transactions are scheduled on the next tick. The exception is
+    // a few writes held in the write buffer until it starts draining, see
+    // ScheduleTransaction().
+    if (is_unified_queue_) {
+        if (!unified_queue_.empty()) {
+            return clk_;
+        }
+    } else if (write_draining_ > 0) {
+        if (!write_buffer_.empty()) {
+            return clk_;
+        }
+    } else if (!read_queue_.empty() ||
+               write_buffer_.size() >= write_buffer_.capacity() ||
+               (write_buffer_.size() > 8 && cmd_queue_.QueueEmpty())) {
+        return clk_;
+    }
+
+    uint64_t next = std::min(refresh_.NextRefreshCycle(),
+                             cmd_queue_.NextReadyCycle());
+    for (const auto &trans : return_queue_) {
+        next = std::min(next, trans.complete_cycle);
+    }
+
+    if (config_.enable_self_refresh) {
+        for (int i = 0; i < config_.ranks; i++) {
+            if (channel_state_.IsRankSelfRefreshing(i)) {
+                if (!cmd_queue_.rank_q_empty[i]) {
+                    return clk_;
+                }
+            } else if (cmd_queue_.rank_q_empty[i] &&
+                       channel_state_.IsAllBankIdleInRank(i)) {
+                // the tick at which rank_idle_cycles reaches the threshold
+                int to_go = config_.sref_threshold - 1 -
+                            channel_state_.rank_idle_cycles[i];
+                next = std::min(next, clk_ + std::max(to_go, 0));
+            }
+        }
+    }
+
+    return std::max(next, clk_);
+}
+
+void Controller::SkipIdleCycles(uint64_t cycles) {
+    // batched version of the power updates in ClockTick()
+    for (int i = 0; i < config_.ranks; i++) {
+        if (channel_state_.IsRankSelfRefreshing(i)) {
+            simple_stats_.IncrementVecBy(StatVecCounter::SREF_CYCLES, i,
+                                         cycles);
+        } else if (channel_state_.IsAllBankIdleInRank(i)) {
+            simple_stats_.IncrementVecBy(StatVecCounter::ALL_BANK_IDLE_CYCLES,
+                                         i, cycles);
+            channel_state_.rank_idle_cycles[i] += cycles;
+        } else {
+            simple_stats_.IncrementVecBy(StatVecCounter::RANK_ACTIVE_CYCLES, i,
+                                         cycles);
+            channel_state_.rank_idle_cycles[i] = 0;
+        }
+    }
+
+    refresh_.SkipCycles(cycles);
+    cmd_queue_.SkipCycles(cycles);
+    clk_ += cycles;
+    simple_stats_.IncrementBy(StatCounter::NUM_CYCLES, cycles);
+}
+
 bool Controller::WillAcceptTransaction(uint64_t hex_addr, bool is_write) const {
     if (is_unified_queue_) {
         return unified_queue_.size() < unified_queue_.capacity();
@@ -161,7 +236,8 @@ bool Controller::WillAcceptTransaction(uint64_t hex_addr, bool is_write) const {
 
 bool Controller::AddTransaction(Transaction trans) {
     trans.added_cycle = clk_;
-    simple_stats_.AddValue("interarrival_latency", clk_ - last_trans_clk_);
+    simple_stats_.AddValue(StatHisto::INTERARRIVAL_LATENCY,
+                           clk_ - last_trans_clk_);
     last_trans_clk_ = clk_;
 
     if (trans.is_write) {
@@ -260,7 +336,7 @@ void Controller::IssueCommand(const Command &cmd) {
             exit(1);
         }
         auto wr_lat = clk_ - it->second.added_cycle + config_.write_delay;
-        simple_stats_.AddValue("write_latency", wr_lat);
+        simple_stats_.AddValue(StatHisto::WRITE_LATENCY, wr_lat);
         pending_wr_q_.erase(it);
     }
     // must update stats before states (for row hits)
@@ -282,8 +358,48 @@ Command Controller::TransToCommand(const Transaction &trans) {
 
 int Controller::QueueUsage() const { return cmd_queue_.QueueUsage(); }
 
+void Controller::Save(CheckpointWriter &out) const {
+    out.Put(clk_);
+    simple_stats_.Save(out);
+    channel_state_.Save(out);
+    cmd_queue_.Save(out);
+    refresh_.Save(out);
+    out.Put(unified_queue_);
+    out.Put(read_queue_);
+    out.Put(write_buffer_);
+    out.Put(pending_rd_q_);
+    out.Put(pending_wr_q_);
+    out.Put(return_queue_);
+    out.Put(last_trans_clk_);
+    out.Put(write_draining_);
+    out.Put(force_reads_);
+}
+
+void Controller::Load(CheckpointReader &in) {
+    in.Get(clk_);
+    simple_stats_.Load(in);
+    channel_state_.Load(in);
+    cmd_queue_.Load(in);
+    refresh_.Load(in);
+    in.Get(unified_queue_);
+    in.Get(read_queue_);
+    in.Get(write_buffer_);
+    in.Get(pending_rd_q_);
+    in.Get(pending_wr_q_);
+    in.Get(return_queue_);
+    in.Get(last_trans_clk_);
+    in.Get(write_draining_);
+    in.Get(force_reads_);
+    // the queues must still fit their reserved capacity
+    if (unified_queue_.size() > unified_queue_.capacity() ||
+        read_queue_.size() > read_queue_.capacity() ||
+        write_buffer_.size() > write_buffer_.capacity()) {
+        in.Fail();
+    }
+}
+
 void Controller::PrintEpochStats() {
-    simple_stats_.Increment("epoch_num");
+    simple_stats_.Increment(StatCounter::EPOCH_NUM);
     simple_stats_.PrintEpochStats();
 #ifdef THERMAL
     for (int r = 0; r < config_.ranks; r++) {
@@ -310,37 +426,37 @@ void Controller::UpdateCommandStats(const Command &cmd) {
     switch (cmd.cmd_type) {
         case CommandType::READ:
         case CommandType::READ_PRECHARGE:
-            simple_stats_.Increment("num_read_cmds");
+            simple_stats_.Increment(StatCounter::NUM_READ_CMDS);
             if (channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(),
                                            cmd.Bank()) != 0) {
-                simple_stats_.Increment("num_read_row_hits");
+                simple_stats_.Increment(StatCounter::NUM_READ_ROW_HITS);
             }
             break;
         case CommandType::WRITE:
         case CommandType::WRITE_PRECHARGE:
-            simple_stats_.Increment("num_write_cmds");
+            simple_stats_.Increment(StatCounter::NUM_WRITE_CMDS);
             if (channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(),
                                            cmd.Bank()) != 0) {
-                simple_stats_.Increment("num_write_row_hits");
+                simple_stats_.Increment(StatCounter::NUM_WRITE_ROW_HITS);
             }
             break;
         case CommandType::ACTIVATE:
-            simple_stats_.Increment("num_act_cmds");
+            simple_stats_.Increment(StatCounter::NUM_ACT_CMDS);
             break;
         case CommandType::PRECHARGE:
-            simple_stats_.Increment("num_pre_cmds");
+            simple_stats_.Increment(StatCounter::NUM_PRE_CMDS);
             break;
         case CommandType::REFRESH:
-            simple_stats_.Increment("num_ref_cmds");
+            simple_stats_.Increment(StatCounter::NUM_REF_CMDS);
             break;
         case CommandType::REFRESH_BANK:
-            simple_stats_.Increment("num_refb_cmds");
+            simple_stats_.Increment(StatCounter::NUM_REFB_CMDS);
             break;
         case CommandType::SREF_ENTER:
-            simple_stats_.Increment("num_srefe_cmds");
+            simple_stats_.Increment(StatCounter::NUM_SREFE_CMDS);
             break;
         case CommandType::SREF_EXIT:
-            simple_stats_.Increment("num_srefx_cmds");
+            simple_stats_.Increment(StatCounter::NUM_SREFX_CMDS);
             break;
         default:
             AbruptExit(__FILE__, __LINE__);
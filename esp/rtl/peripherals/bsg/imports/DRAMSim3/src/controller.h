@@ -6,6 +6,7 @@
 #include <unordered_set>
 #include <vector>
 #include "channel_state.h"
+#include "checkpoint.h"
 #include "command_queue.h"
 #include "common.h"
 #include "refresh.h"
@@ -28,6 +29,11 @@ class Controller {
     Controller(int channel, const Config &config, const Timing &timing);
 #endif  // THERMAL
     void ClockTick();
+    // Earliest cycle at which ClockTick() or ReturnDoneTrans() can do more
+    // than count idle cycles. SkipIdleCycles() may advance the controller up
+    // to that cycle, with the same stats as ticking it.
+    uint64_t NextEventCycle() const;
+    void SkipIdleCycles(uint64_t cycles);
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(Transaction trans);
     int QueueUsage() const;
@@ -36,6 +42,10 @@ class Controller {
     void PrintFinalStats();
     void ResetStats() { simple_stats_.Reset(); }
     std::pair<uint64_t, int> ReturnDoneTrans(uint64_t clock);
+    // Checkpoint of the channel: bank and refresh state, all queues and
+    // stats. Thermal state is not part of it.
+    void Save(CheckpointWriter &out) const;
+    void Load(CheckpointReader &in);
 
     int channel_id_;
 
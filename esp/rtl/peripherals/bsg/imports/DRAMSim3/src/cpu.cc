@@ -1,4 +1,5 @@
 #include "cpu.h"
+#include <algorithm>
 
 namespace dramsim3 {
 
@@ -89,4 +90,30 @@ void TraceBasedCPU::ClockTick() {
     return;
 }
 
+uint64_t TraceBasedCPU::SkipIdleCycles(uint64_t max_cycles) {
+    // the next tick reads the trace or has a transaction to insert
+    if (!trace_file_.eof() && (get_next_ || trans_.added_cycle <= clk_)) {
+        return 0;
+    }
+
+    uint64_t quiet = max_cycles;
+    if (!trace_file_.eof()) {
+        quiet = std::min(quiet, trans_.added_cycle - clk_);
+    }
+    uint64_t idle =
+        memory_system_.NextEventCycle() - memory_system_.GetClock();
+    if (idle > 0) {
+        idle = std::min(idle, quiet);
+        memory_system_.SkipIdleCycles(idle);
+        clk_ += idle;
+        return idle;
+    }
+
+    // the memory system is busy, but nothing is added until the next trace
+    // entry, so the memory system may run up to there in one batch
+    memory_system_.ClockTicks(quiet);
+    clk_ += quiet;
+    return quiet;
+}
+
 }  // namespace dramsim3
@@ -18,6 +18,9 @@ class CPU {
               std::bind(&CPU::WriteCallBack, this, std::placeholders::_1)),
           clk_(0) {}
     virtual void ClockTick() = 0;
+    // Run up to max_cycles upcoming ticks in which the CPU issues nothing,
+    // in bulk, returns the number of ticks run
+    virtual uint64_t SkipIdleCycles(uint64_t max_cycles) { return 0; }
     void ReadCallBack(uint64_t addr) { return; }
     void WriteCallBack(uint64_t addr) { return; }
     void PrintStats() { memory_system_.PrintStats(); }
@@ -60,6 +63,7 @@ class TraceBasedCPU : public CPU {
                   const std::string& trace_file);
     ~TraceBasedCPU() { trace_file_.close(); }
     void ClockTick() override;
+    uint64_t SkipIdleCycles(uint64_t max_cycles) override;
 
    private:
     std::ifstream trace_file_;
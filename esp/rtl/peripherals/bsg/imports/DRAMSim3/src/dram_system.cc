@@ -1,6 +1,8 @@
 #include "dram_system.h"
 
 #include <assert.h>
+#include <algorithm>
+#include <thread>
 
 namespace dramsim3 {
 
@@ -8,6 +10,12 @@ namespace dramsim3 {
 // destructive
 int BaseDRAMSystem::total_channels_ = 0;
 
+// Every batch run on the worker pool ends in a barrier. With short batches or
+// few channels per thread the threads mostly wait on it and the serial engine
+// is faster, so the pool is only used past both of these sizes.
+static const int kMinChannelsPerWorker = 4;
+static const uint64_t kMinThreadedBatch = 256;
+
 BaseDRAMSystem::BaseDRAMSystem(Config &config, const std::string &output_dir,
                                std::function<void(uint64_t)> read_callback,
                                std::function<void(uint64_t)> write_callback)
@@ -85,6 +93,40 @@ void BaseDRAMSystem::ResetStats() {
     }
 }
 
+void BaseDRAMSystem::ClockTicks(uint64_t cycles) {
+    for (uint64_t i = 0; i < cycles; i++) {
+        ClockTick();
+    }
+}
+
+void BaseDRAMSystem::SkipIdleCycles(uint64_t cycles) {
+    assert(cycles <= NextEventCycle() - clk_);
+    clk_ += cycles;
+}
+
+void BaseDRAMSystem::Save(CheckpointWriter &out) const {
+    out.Put(clk_);
+    out.Put(last_req_clk_);
+    out.Put<uint64_t>(ctrls_.size());
+    for (const auto ctrl : ctrls_) {
+        ctrl->Save(out);
+    }
+}
+
+void BaseDRAMSystem::Load(CheckpointReader &in) {
+    uint64_t num_ctrls = 0;
+    in.Get(clk_);
+    in.Get(last_req_clk_);
+    in.Get(num_ctrls);
+    if (num_ctrls != ctrls_.size()) {
+        in.Fail();
+        return;
+    }
+    for (auto ctrl : ctrls_) {
+        ctrl->Load(in);
+    }
+}
+
 void BaseDRAMSystem::RegisterCallbacks(
     std::function<void(uint64_t)> read_callback,
     std::function<void(uint64_t)> write_callback) {
@@ -96,7 +138,8 @@ void BaseDRAMSystem::RegisterCallbacks(
 JedecDRAMSystem::JedecDRAMSystem(Config &config, const std::string &output_dir,
                                  std::function<void(uint64_t)> read_callback,
                                  std::function<void(uint64_t)> write_callback)
-    : BaseDRAMSystem(config, output_dir, read_callback, write_callback) {
+    : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
+      workers_(nullptr) {
     if (config_.IsHMC()) {
         std::cerr << "Initialized a memory system with an HMC config file!"
                   << std::endl;
@@ -111,9 +154,22 @@ JedecDRAMSystem::JedecDRAMSystem(Config &config, const std::string &output_dir,
         ctrls_.push_back(new Controller(i, config_, timing_));
 #endif  // THERMAL
     }
+
+    int num_workers = std::min(config_.sim_threads,
+                               config_.channels / kMinChannelsPerWorker);
+    int num_cpus = static_cast<int>(std::thread::hardware_concurrency());
+    if (num_cpus > 0) {
+        num_workers = std::min(num_workers, num_cpus);
+    }
+    if (num_workers > 1) {
+        workers_ = new WorkerPool(num_workers);
+    }
+    done_trans_.resize(ctrls_.size());
+    done_pos_.resize(ctrls_.size());
 }
 
 JedecDRAMSystem::~JedecDRAMSystem() {
+    delete workers_;
     for (auto it = ctrls_.begin(); it != ctrls_.end(); it++) {
         delete (*it);
     }
@@ -144,7 +200,7 @@ bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
     return ok;
 }
 
-void JedecDRAMSystem::ClockTick() {
+void JedecDRAMSystem::ReturnDoneTrans() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         // look ahead and return earlier
         while (true) {
@@ -158,6 +214,10 @@ void JedecDRAMSystem::ClockTick() {
             }
         }
     }
+}
+
+void JedecDRAMSystem::ClockTick() {
+    ReturnDoneTrans();
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->ClockTick();
     }
@@ -169,6 +229,121 @@ void JedecDRAMSystem::ClockTick() {
     return;
 }
 
+void JedecDRAMSystem::ClockTicks(uint64_t cycles) {
+    while (cycles > 0) {
+        // a batch ends with the epoch so that its stats are printed in time
+        uint64_t epoch_left =
+            config_.epoch_period - clk_ % config_.epoch_period;
+        uint64_t batch = std::min(cycles, epoch_left);
+        RunBatch(batch);
+        cycles -= batch;
+    }
+}
+
+bool JedecDRAMSystem::UseWorkers(uint64_t cycles) const {
+    return workers_ != nullptr && cycles >= kMinThreadedBatch;
+}
+
+void JedecDRAMSystem::RunChannels(int worker, uint64_t cycles) {
+    uint64_t start = clk_;
+    uint64_t end = clk_ + cycles;
+
+    size_t stride = UseWorkers(cycles) ? workers_->NumWorkers() : 1;
+
+    for (size_t i = worker; i < ctrls_.size(); i += stride) {
+        Controller *ctrl = ctrls_[i];
+        auto &done = done_trans_[i];
+        uint64_t clk = start;
+        while (clk < end) {
+            if (clk != start) {
+                while (true) {
+                    auto pair = ctrl->ReturnDoneTrans(clk);
+                    if (pair.second < 0) {
+                        break;
+                    }
+                    done.push_back({clk, pair.first, pair.second == 1});
+                }
+            }
+            // channels are independent, so each one skips its own idle
+            // cycles
+            uint64_t idle = std::min(ctrl->NextEventCycle(), end) - clk;
+            if (idle > 0) {
+                ctrl->SkipIdleCycles(idle);
+                clk += idle;
+            } else {
+                ctrl->ClockTick();
+                clk++;
+            }
+        }
+    }
+}
+
+void JedecDRAMSystem::RunBatch(uint64_t cycles) {
+    // Completions due now go out before any controller ticks, as in the
+    // serial ClockTick(), so callbacks can still add transactions to this
+    // cycle.
+    ReturnDoneTrans();
+    if (UseWorkers(cycles)) {
+        workers_->Run(
+            [this, cycles](int worker) { RunChannels(worker, cycles); });
+    } else {
+        RunChannels(0, cycles);
+    }
+    clk_ += cycles;
+
+    // deliver the buffered completions by cycle, then channel
+    std::fill(done_pos_.begin(), done_pos_.end(), 0);
+    while (true) {
+        size_t ch = ctrls_.size();
+        for (size_t i = 0; i < ctrls_.size(); i++) {
+            if (done_pos_[i] < done_trans_[i].size() &&
+                (ch == ctrls_.size() ||
+                 done_trans_[i][done_pos_[i]].clk <
+                     done_trans_[ch][done_pos_[ch]].clk)) {
+                ch = i;
+            }
+        }
+        if (ch == ctrls_.size()) {
+            break;
+        }
+        uint64_t clk = done_trans_[ch][done_pos_[ch]].clk;
+        while (done_pos_[ch] < done_trans_[ch].size() &&
+               done_trans_[ch][done_pos_[ch]].clk == clk) {
+            const DoneTrans &trans = done_trans_[ch][done_pos_[ch]++];
+            if (trans.is_write) {
+                write_callback_(trans.addr);
+            } else {
+                read_callback_(trans.addr);
+            }
+        }
+    }
+    for (auto &done : done_trans_) {
+        done.clear();
+    }
+
+    if (clk_ % config_.epoch_period == 0) {
+        PrintEpochStats();
+    }
+}
+
+uint64_t JedecDRAMSystem::NextEventCycle() const {
+    // the tick that ends an epoch prints its stats
+    uint64_t next =
+        (clk_ / config_.epoch_period + 1) * config_.epoch_period - 1;
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        next = std::min(next, ctrls_[i]->NextEventCycle());
+    }
+    return std::max(next, clk_);
+}
+
+void JedecDRAMSystem::SkipIdleCycles(uint64_t cycles) {
+    assert(cycles <= NextEventCycle() - clk_);
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        ctrls_[i]->SkipIdleCycles(cycles);
+    }
+    clk_ += cycles;
+}
+
 IdealDRAMSystem::IdealDRAMSystem(Config &config, const std::string &output_dir,
                                  std::function<void(uint64_t)> read_callback,
                                  std::function<void(uint64_t)> write_callback)
@@ -204,4 +379,14 @@ void IdealDRAMSystem::ClockTick() {
     return;
 }
 
+void IdealDRAMSystem::Save(CheckpointWriter &out) const {
+    BaseDRAMSystem::Save(out);
+    out.Put(infinite_buffer_q_);
+}
+
+void IdealDRAMSystem::Load(CheckpointReader &in) {
+    BaseDRAMSystem::Load(in);
+    in.Get(infinite_buffer_q_);
+}
+
 }  // namespace dramsim3
@@ -5,10 +5,12 @@
 #include <string>
 #include <vector>
 
+#include "checkpoint.h"
 #include "common.h"
 #include "configuration.h"
 #include "controller.h"
 #include "timing.h"
+#include "worker_pool.h"
 
 #ifdef THERMAL
 #include "thermal.h"
@@ -32,7 +34,22 @@ class BaseDRAMSystem {
                                        bool is_write) const = 0;
     virtual bool AddTransaction(uint64_t hex_addr, bool is_write) = 0;
     virtual void ClockTick() = 0;
+    // Same as calling ClockTick() cycles times with no transactions added in
+    // between. Systems may run the cycles in one go and deliver the callbacks
+    // of later cycles at the end, in the order ClockTick() would.
+    virtual void ClockTicks(uint64_t cycles);
+    // Idle-cycle skipping: every ClockTick() before NextEventCycle() only
+    // counts cycles, and SkipIdleCycles() does that in bulk. Systems that do
+    // not track their next event report the current cycle and never skip.
+    virtual uint64_t NextEventCycle() const { return clk_; }
+    virtual void SkipIdleCycles(uint64_t cycles);
+    uint64_t GetClock() const { return clk_; }
     int GetChannel(uint64_t hex_addr) const;
+    // Checkpoint of the cycle and every channel controller, taken between
+    // ticks. Callbacks are not part of it: completions after a restore go to
+    // the callbacks of the restoring system.
+    virtual void Save(CheckpointWriter &out) const;
+    virtual void Load(CheckpointReader &in);
 
     std::function<void(uint64_t req_id)> read_callback_, write_callback_;
     static int total_channels_;
@@ -67,6 +84,30 @@ class JedecDRAMSystem : public BaseDRAMSystem {
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
     bool AddTransaction(uint64_t hex_addr, bool is_write) override;
     void ClockTick() override;
+    void ClockTicks(uint64_t cycles) override;
+    uint64_t NextEventCycle() const override;
+    void SkipIdleCycles(uint64_t cycles) override;
+
+   private:
+    struct DoneTrans {
+        uint64_t clk;
+        uint64_t addr;
+        bool is_write;
+    };
+
+    void ReturnDoneTrans();
+    bool UseWorkers(uint64_t cycles) const;
+    void RunChannels(int worker, uint64_t cycles);
+    void RunBatch(uint64_t cycles);
+
+    // ClockTicks() runs each channel through the whole batch on its own.
+    // Completions past the first cycle of a batch are buffered per channel and
+    // delivered once the batch is over. With sim_threads > 1 the channels of
+    // long batches are split over a worker pool; ClockTick() always stays
+    // serial (see kMinThreadedBatch in dram_system.cc).
+    WorkerPool *workers_;
+    std::vector<std::vector<DoneTrans>> done_trans_;
+    std::vector<size_t> done_pos_;
 };
 
 // Model a memorysystem with an infinite bandwidth and a fixed latency (possibly
@@ -84,6 +125,8 @@ class IdealDRAMSystem : public BaseDRAMSystem {
     };
     bool AddTransaction(uint64_t hex_addr, bool is_write) override;
     void ClockTick() override;
+    void Save(CheckpointWriter &out) const override;
+    void Load(CheckpointReader &in) override;
 
    private:
     int latency_;
@@ -61,8 +61,14 @@ int main(int argc, const char **argv) {
         }
     }
 
-    for (uint64_t clk = 0; clk < cycles; clk++) {
-        cpu->ClockTick();
+    uint64_t clk = 0;
+    while (clk < cycles) {
+        // idle stretches, e.g. between trace entries, are skipped in bulk
+        clk += cpu->SkipIdleCycles(cycles - clk);
+        if (clk < cycles) {
+            cpu->ClockTick();
+            clk++;
+        }
     }
     cpu->PrintStats();
 
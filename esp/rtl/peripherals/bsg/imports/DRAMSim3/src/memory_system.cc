@@ -1,5 +1,8 @@
 #include "memory_system.h"
 
+#include <algorithm>
+#include <fstream>
+
 namespace dramsim3 {
 MemorySystem::MemorySystem(const std::string &config_file,
                            const std::string &output_dir,
@@ -23,6 +26,20 @@ MemorySystem::~MemorySystem() {
 
 void MemorySystem::ClockTick() { dram_system_->ClockTick(); }
 
+void MemorySystem::ClockTicks(uint64_t cycles) {
+    dram_system_->ClockTicks(cycles);
+}
+
+uint64_t MemorySystem::GetClock() const { return dram_system_->GetClock(); }
+
+uint64_t MemorySystem::NextEventCycle() const {
+    return dram_system_->NextEventCycle();
+}
+
+void MemorySystem::SkipIdleCycles(uint64_t cycles) {
+    dram_system_->SkipIdleCycles(cycles);
+}
+
 double MemorySystem::GetTCK() const { return config_->tCK; }
 
 int MemorySystem::GetBusBits() const { return config_->bus_width; }
@@ -46,6 +63,80 @@ bool MemorySystem::AddTransaction(uint64_t hex_addr, bool is_write) {
     return dram_system_->AddTransaction(hex_addr, is_write);
 }
 
+namespace {
+
+const char kCheckpointMagic[8] = {'D', 'R', 'S', 'I', 'M', '3', 'C', 'P'};
+const uint32_t kCheckpointVersion = 1;
+
+// Config values that decide the shape of the saved state. A checkpoint
+// only loads into a system where all of them match.
+std::vector<int64_t> CheckpointShape(const Config &config) {
+    return {config.channels,         config.ranks,
+            config.bankgroups,       config.banks_per_group,
+            config.rows,             config.columns,
+            config.trans_queue_size, config.cmd_queue_size,
+            config.unified_queue,    config.epoch_period,
+            static_cast<int64_t>(config.refresh_policy)};
+}
+
+}  // namespace
+
+bool MemorySystem::SaveCheckpoint(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    bool ok = SaveCheckpoint(file);
+    file.flush();
+    return ok && file.good();
+}
+
+bool MemorySystem::LoadCheckpoint(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Cannot open checkpoint " << path << std::endl;
+        return false;
+    }
+    // the checkpoint has to end exactly at the end of the file
+    return LoadCheckpoint(file) &&
+           file.peek() == std::ifstream::traits_type::eof();
+}
+
+bool MemorySystem::SaveCheckpoint(std::ostream &file) const {
+    if (config_->IsHMC()) {
+        std::cerr << "Checkpoints of HMC systems are not supported"
+                  << std::endl;
+        return false;
+    }
+    CheckpointWriter out(file);
+    out.Put(kCheckpointMagic);
+    out.Put(kCheckpointVersion);
+    out.Put(CheckpointShape(*config_));
+    dram_system_->Save(out);
+    return out.Ok();
+}
+
+bool MemorySystem::LoadCheckpoint(std::istream &file) {
+    if (config_->IsHMC()) {
+        std::cerr << "Checkpoints of HMC systems are not supported"
+                  << std::endl;
+        return false;
+    }
+    CheckpointReader in(file);
+    char magic[sizeof(kCheckpointMagic)] = {};
+    uint32_t version = 0;
+    std::vector<int64_t> shape;
+    in.Get(magic);
+    in.Get(version);
+    in.Get(shape);
+    bool ours = std::equal(magic, magic + sizeof(magic), kCheckpointMagic) &&
+                version == kCheckpointVersion &&
+                shape == CheckpointShape(*config_);
+    if (!in.Ok() || !ours) {
+        std::cerr << "Not a checkpoint of this memory system" << std::endl;
+        return false;
+    }
+    dram_system_->Load(in);
+    return in.Ok();
+}
+
 void MemorySystem::PrintStats() const { dram_system_->PrintStats(); }
 
 void MemorySystem::ResetStats() { dram_system_->ResetStats(); }
@@ -18,6 +18,15 @@ class MemorySystem {
                  std::function<void(uint64_t)> write_callback);
     ~MemorySystem();
     void ClockTick();
+    // ClockTick() cycles times, with the callbacks of the later cycles
+    // possibly held back until the end (see [other] sim_threads)
+    void ClockTicks(uint64_t cycles);
+    // Current cycle, and the first cycle at which a tick can do more than
+    // count idle cycles. The ticks in between can be replaced by a single
+    // SkipIdleCycles(NextEventCycle() - GetClock()).
+    uint64_t GetClock() const;
+    uint64_t NextEventCycle() const;
+    void SkipIdleCycles(uint64_t cycles);
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
     double GetTCK() const;
@@ -30,6 +39,18 @@ class MemorySystem {
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(uint64_t hex_addr, bool is_write);
 
+    // Dump the state of the memory system (bank and row state, refresh
+    // counters, queues and stats) to a binary file between two ticks, and
+    // restore it into a system built from the same config. Returns false on
+    // an I/O error, a foreign checkpoint or an HMC system; a failed restore
+    // leaves the system in an unspecified state. The stream versions leave
+    // the stream right after the checkpoint, so that callers can append
+    // state of their own.
+    bool SaveCheckpoint(const std::string &path) const;
+    bool LoadCheckpoint(const std::string &path);
+    bool SaveCheckpoint(std::ostream &out) const;
+    bool LoadCheckpoint(std::istream &in);
+
     const Config * GetConfig() const { return config_; }
     
    private:
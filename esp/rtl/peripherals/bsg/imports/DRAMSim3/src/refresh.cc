@@ -26,6 +26,28 @@ void Refresh::ClockTick() {
     return;
 }
 
+uint64_t Refresh::NextRefreshCycle() const {
+    uint64_t interval = static_cast<uint64_t>(refresh_interval_);
+    if (clk_ == 0) {
+        return interval;
+    }
+    return (clk_ + interval - 1) / interval * interval;
+}
+
+void Refresh::Save(CheckpointWriter& out) const {
+    out.Put(clk_);
+    out.Put(next_rank_);
+    out.Put(next_bg_);
+    out.Put(next_bank_);
+}
+
+void Refresh::Load(CheckpointReader& in) {
+    in.Get(clk_);
+    in.Get(next_rank_);
+    in.Get(next_bg_);
+    in.Get(next_bank_);
+}
+
 void Refresh::InsertRefresh() {
     switch (refresh_policy_) {
         // Simultaneous all rank refresh
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "channel_state.h"
+#include "checkpoint.h"
 #include "common.h"
 #include "configuration.h"
 
@@ -12,6 +13,11 @@ class Refresh {
    public:
     Refresh(const Config& config, ChannelState& channel_state);
     void ClockTick();
+    // cycle of the next ClockTick that inserts a refresh
+    uint64_t NextRefreshCycle() const;
+    void SkipCycles(uint64_t cycles) { clk_ += cycles; }
+    void Save(CheckpointWriter& out) const;
+    void Load(CheckpointReader& in);
 
    private:
     uint64_t clk_;
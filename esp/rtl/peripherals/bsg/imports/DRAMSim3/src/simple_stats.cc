@@ -16,73 +16,183 @@ void PrintStatText(std::ostream& where, std::string name, T value,
     return;
 }
 
+// The text output used to walk std::unordered_map<std::string, ...> tables
+// filled in constructor order. Replay those insertions to get the same
+// iteration order, so that new stats.txt files diff cleanly against old ones.
+template <class Names>
+std::vector<size_t> HashMapOrder(const Names& names) {
+    std::unordered_map<std::string, size_t> table;
+    for (size_t i = 0; i < names.size(); i++) {
+        table.emplace(names[i], i);
+    }
+    std::vector<size_t> order;
+    for (const auto& it : table) {
+        order.push_back(it.second);
+    }
+    return order;
+}
+
 SimpleStats::SimpleStats(const Config& config, int channel_id)
     : config_(config), channel_id_(channel_id) {
     // counter stats
-    InitStat("num_cycles", "counter", "Number of DRAM cycles");
-    InitStat("epoch_num", "counter", "Number of epochs");
-    InitStat("num_reads_done", "counter", "Number of read requests issued");
-    InitStat("num_writes_done", "counter", "Number of read requests issued");
-    InitStat("num_write_buf_hits", "counter", "Number of write buffer hits");
-    InitStat("num_read_row_hits", "counter", "Number of read row buffer hits");
-    InitStat("num_write_row_hits", "counter",
+    InitStat(StatCounter::NUM_CYCLES, "num_cycles", "Number of DRAM cycles");
+    InitStat(StatCounter::EPOCH_NUM, "epoch_num", "Number of epochs");
+    InitStat(StatCounter::NUM_READS_DONE, "num_reads_done",
+             "Number of read requests issued");
+    InitStat(StatCounter::NUM_WRITES_DONE, "num_writes_done",
+             "Number of read requests issued");
+    InitStat(StatCounter::NUM_WRITE_BUF_HITS, "num_write_buf_hits",
+             "Number of write buffer hits");
+    InitStat(StatCounter::NUM_READ_ROW_HITS, "num_read_row_hits",
+             "Number of read row buffer hits");
+    InitStat(StatCounter::NUM_WRITE_ROW_HITS, "num_write_row_hits",
              "Number of write row buffer hits");
-    InitStat("num_read_cmds", "counter", "Number of READ/READP commands");
-    InitStat("num_write_cmds", "counter", "Number of WRITE/WRITEP commands");
-    InitStat("num_act_cmds", "counter", "Number of ACT commands");
-    InitStat("num_pre_cmds", "counter", "Number of PRE commands");
-    InitStat("num_ondemand_pres", "counter", "Number of ondemend PRE commands");
-    InitStat("num_ref_cmds", "counter", "Number of REF commands");
-    InitStat("num_refb_cmds", "counter", "Number of REFb commands");
-    InitStat("num_srefe_cmds", "counter", "Number of SREFE commands");
-    InitStat("num_srefx_cmds", "counter", "Number of SREFX commands");
-    InitStat("hbm_dual_cmds", "counter", "Number of cycles dual cmds issued");
+    InitStat(StatCounter::NUM_READ_CMDS, "num_read_cmds",
+             "Number of READ/READP commands");
+    InitStat(StatCounter::NUM_WRITE_CMDS, "num_write_cmds",
+             "Number of WRITE/WRITEP commands");
+    InitStat(StatCounter::NUM_ACT_CMDS, "num_act_cmds",
+             "Number of ACT commands");
+    InitStat(StatCounter::NUM_PRE_CMDS, "num_pre_cmds",
+             "Number of PRE commands");
+    InitStat(StatCounter::NUM_ONDEMAND_PRES, "num_ondemand_pres",
+             "Number of ondemend PRE commands");
+    InitStat(StatCounter::NUM_REF_CMDS, "num_ref_cmds",
+             "Number of REF commands");
+    InitStat(StatCounter::NUM_REFB_CMDS, "num_refb_cmds",
+             "Number of REFb commands");
+    InitStat(StatCounter::NUM_SREFE_CMDS, "num_srefe_cmds",
+             "Number of SREFE commands");
+    InitStat(StatCounter::NUM_SREFX_CMDS, "num_srefx_cmds",
+             "Number of SREFX commands");
+    InitStat(StatCounter::HBM_DUAL_CMDS, "hbm_dual_cmds",
+             "Number of cycles dual cmds issued");
 
     // double stats
-    InitStat("act_energy", "double", "Activation energy");
-    InitStat("read_energy", "double", "Read energy");
-    InitStat("write_energy", "double", "Write energy");
-    InitStat("ref_energy", "double", "Refresh energy");
-    InitStat("refb_energy", "double", "Refresh-bank energy");
+    InitStat(StatDouble::ACT_ENERGY, "act_energy", "Activation energy");
+    InitStat(StatDouble::READ_ENERGY, "read_energy", "Read energy");
+    InitStat(StatDouble::WRITE_ENERGY, "write_energy", "Write energy");
+    InitStat(StatDouble::REF_ENERGY, "ref_energy", "Refresh energy");
+    InitStat(StatDouble::REFB_ENERGY, "refb_energy", "Refresh-bank energy");
 
     // Vector counter stats
-    InitVecStat("all_bank_idle_cycles", "vec_counter",
-                "Cyles of all bank idle in rank", "rank", config_.ranks);
-    InitVecStat("rank_active_cycles", "vec_counter", "Cyles of rank active",
-                "rank", config_.ranks);
-    InitVecStat("sref_cycles", "vec_counter", "Cyles of rank in SREF mode",
-                "rank", config_.ranks);
+    InitVecStat(StatVecCounter::ALL_BANK_IDLE_CYCLES, "all_bank_idle_cycles",
+                "Cyles of all bank idle in rank", "rank");
+    InitVecStat(StatVecCounter::RANK_ACTIVE_CYCLES, "rank_active_cycles",
+                "Cyles of rank active", "rank");
+    InitVecStat(StatVecCounter::SREF_CYCLES, "sref_cycles",
+                "Cyles of rank in SREF mode", "rank");
 
     // Vector of double stats
-    InitVecStat("act_stb_energy", "vec_double", "Active standby energy", "rank",
-                config_.ranks);
-    InitVecStat("pre_stb_energy", "vec_double", "Precharge standby energy",
-                "rank", config_.ranks);
-    InitVecStat("sref_energy", "vec_double", "SREF energy", "rank",
-                config_.ranks);
+    InitVecStat(StatVecDouble::ACT_STB_ENERGY, "act_stb_energy",
+                "Active standby energy", "rank");
+    InitVecStat(StatVecDouble::PRE_STB_ENERGY, "pre_stb_energy",
+                "Precharge standby energy", "rank");
+    InitVecStat(StatVecDouble::SREF_ENERGY, "sref_energy", "SREF energy",
+                "rank");
 
     // Histogram stats
-    InitHistoStat("read_latency", "Read request latency (cycles)", 0, 200, 10);
-    InitHistoStat("write_latency", "Write cmd latency (cycles)", 0, 200, 10);
-    InitHistoStat("interarrival_latency",
+    InitHistoStat(StatHisto::READ_LATENCY, "read_latency",
+                  "Read request latency (cycles)", 0, 200, 10);
+    InitHistoStat(StatHisto::WRITE_LATENCY, "write_latency",
+                  "Write cmd latency (cycles)", 0, 200, 10);
+    InitHistoStat(StatHisto::INTERARRIVAL_LATENCY, "interarrival_latency",
                   "Request interarrival latency (cycles)", 0, 100, 10);
 
     // some irregular stats
-    InitStat("average_bandwidth", "calculated", "Average bandwidth");
-    InitStat("total_energy", "calculated", "Total energy (pJ)");
-    InitStat("average_power", "calculated", "Average power (mW)");
-    InitStat("average_read_latency", "calculated",
+    InitStat(StatCalculated::AVERAGE_BANDWIDTH, "average_bandwidth",
+             "Average bandwidth");
+    InitStat(StatCalculated::TOTAL_ENERGY, "total_energy",
+             "Total energy (pJ)");
+    InitStat(StatCalculated::AVERAGE_POWER, "average_power",
+             "Average power (mW)");
+    InitStat(StatCalculated::AVERAGE_READ_LATENCY, "average_read_latency",
              "Average read request latency (cycles)");
-    InitStat("average_interarrival", "calculated",
+    InitStat(StatCalculated::AVERAGE_INTERARRIVAL, "average_interarrival",
              "Average request interarrival latency (cycles)");
+
+    std::vector<std::string> histo_names;
+    for (const auto& histo : histos_) {
+        histo_names.push_back(histo.name);
+    }
+    counter_order_ = HashMapOrder(counter_names_);
+    vec_counter_order_ = HashMapOrder(vec_counter_names_);
+    histo_order_ = HashMapOrder(histo_names);
+    double_order_ = HashMapOrder(double_names_);
+    vec_double_order_ = HashMapOrder(vec_double_names_);
+    calculated_order_ = HashMapOrder(calculated_names_);
+
+    Reset();
+}
+
+void SimpleStats::HistoCount::Merge(const HistoCount& other) {
+    if (other.dense_.size() > dense_.size()) {
+        dense_.resize(other.dense_.size(), 0);
+    }
+    for (size_t i = 0; i < other.dense_.size(); i++) {
+        dense_[i] += other.dense_[i];
+    }
+    for (const auto& it : other.sparse_) {
+        sparse_[it.first] += it.second;
+    }
+}
+
+void SimpleStats::HistoCount::Clear() {
+    std::fill(dense_.begin(), dense_.end(), 0);
+    sparse_.clear();
+}
+
+// only the values seen, as (value, count) pairs
+void SimpleStats::HistoCount::Save(CheckpointWriter& out) const {
+    std::vector<int> values;
+    std::vector<uint64_t> counts;
+    ForEach([&](int value, uint64_t count) {
+        values.push_back(value);
+        counts.push_back(count);
+    });
+    out.Put(values);
+    out.Put(counts);
+}
+
+void SimpleStats::HistoCount::Load(CheckpointReader& in) {
+    std::vector<int> values;
+    std::vector<uint64_t> counts;
+    in.Get(values);
+    in.Get(counts);
+    if (values.size() != counts.size()) {
+        in.Fail();
+        return;
+    }
+    Clear();
+    for (size_t i = 0; i < values.size(); i++) {
+        Add(values[i]);
+        if (values[i] >= 0 && values[i] < kMaxDense) {
+            dense_[values[i]] = counts[i];
+        } else {
+            sparse_[values[i]] = counts[i];
+        }
+    }
+}
+
+void SimpleStats::Save(CheckpointWriter& out) const {
+    out.Put(epoch_counters_);
+    out.Put(counters_);
+    out.Put(epoch_vec_counters_);
+    out.Put(vec_counters_);
+    for (const auto& histo : histos_) {
+        histo.counts.Save(out);
+        histo.epoch_counts.Save(out);
+    }
 }
 
-void SimpleStats::AddValue(const std::string name, const int value) {
-    auto& epoch_counts = epoch_histo_counts_[name];
-    if (epoch_counts.count(value) <= 0) {
-        epoch_counts[value] = 1;
-    } else {
-        epoch_counts[value] += 1;
+void SimpleStats::Load(CheckpointReader& in) {
+    in.Get(epoch_counters_);
+    in.Get(counters_);
+    in.GetFixed(epoch_vec_counters_);
+    in.GetFixed(vec_counters_);
+    for (auto& histo : histos_) {
+        histo.counts.Load(in);
+        histo.epoch_counts.Load(in);
     }
 }
 
@@ -92,7 +202,8 @@ std::string SimpleStats::GetTextHeader(bool is_final) const {
         "Channel " +
         std::to_string(channel_id_);
     if (!is_final) {
-        header += " of epoch " + std::to_string(counters_.at("epoch_num"));
+        header += " of epoch " +
+                  std::to_string(counters_[Slot(StatCounter::EPOCH_NUM)]);
     }
     header += "\n###########################################\n";
     return header;
@@ -138,143 +249,121 @@ void SimpleStats::PrintFinalStats() {
 }
 
 void SimpleStats::Reset() {
-    for (auto& it : counters_) {
-        it.second = 0;
-    }
-    for (auto& it : epoch_counters_) {
-        it.second = 0;
-    }
-    for (auto& vec : vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
-    for (auto& vec : epoch_vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
-    for (auto& it : doubles_) {
-        it.second = 0.0;
-    }
-    for (auto& vec : vec_doubles_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0.0);
-    }
-    for (auto& it : calculated_) {
-        it.second = 0.0;
-    }
-    for (auto& it : histo_counts_) {
-        it.second.clear();
-    }
-    for (auto& it : epoch_histo_counts_) {
-        it.second.clear();
+    counters_.fill(0);
+    epoch_counters_.fill(0);
+    std::fill(vec_counters_.begin(), vec_counters_.end(), 0);
+    std::fill(epoch_vec_counters_.begin(), epoch_vec_counters_.end(), 0);
+    doubles_.fill(0.0);
+    std::fill(vec_doubles_.begin(), vec_doubles_.end(), 0.0);
+    calculated_.fill(0.0);
+    for (auto& histo : histos_) {
+        histo.counts.Clear();
+        histo.epoch_counts.Clear();
     }
 }
 
-void SimpleStats::InitStat(std::string name, std::string stat_type,
+void SimpleStats::InitStat(StatCounter stat, std::string name,
                            std::string description) {
     header_descs_.emplace(name, description);
-    if (stat_type == "counter") {
-        counters_.emplace(name, 0);
-        epoch_counters_.emplace(name, 0);
-    } else if (stat_type == "double") {
-        doubles_.emplace(name, 0.0);
-    } else if (stat_type == "calculated") {
-        calculated_.emplace(name, 0.0);
-    }
+    counter_names_[Slot(stat)] = name;
+}
+
+void SimpleStats::InitStat(StatDouble stat, std::string name,
+                           std::string description) {
+    header_descs_.emplace(name, description);
+    double_names_[Slot(stat)] = name;
+}
+
+void SimpleStats::InitStat(StatCalculated stat, std::string name,
+                           std::string description) {
+    header_descs_.emplace(name, description);
+    calculated_names_[Slot(stat)] = name;
 }
 
-void SimpleStats::InitVecStat(std::string name, std::string stat_type,
-                              std::string description, std::string part_name,
-                              int vec_len) {
-    for (int i = 0; i < vec_len; i++) {
+void SimpleStats::InitVecNames(std::string name, std::string description,
+                               std::string part_name) {
+    for (int i = 0; i < config_.ranks; i++) {
         std::string trailing = "." + std::to_string(i);
         std::string actual_name = name + trailing;
         std::string actual_desc = description + " " + part_name + trailing;
         header_descs_.emplace(actual_name, actual_desc);
     }
-    if (stat_type == "vec_counter") {
-        vec_counters_.emplace(name, std::vector<uint64_t>(vec_len, 0));
-        epoch_vec_counters_.emplace(name, std::vector<uint64_t>(vec_len, 0));
-    } else if (stat_type == "vec_double") {
-        vec_doubles_.emplace(name, std::vector<double>(vec_len, 0));
-    }
 }
 
-void SimpleStats::InitHistoStat(std::string name, std::string description,
-                                int start_val, int end_val, int num_bins) {
+void SimpleStats::InitVecStat(StatVecCounter stat, std::string name,
+                              std::string description, std::string part_name) {
+    InitVecNames(name, description, part_name);
+    vec_counter_names_[Slot(stat)] = name;
+    vec_counters_.resize(Slot(StatVecCounter::SIZE) * config_.ranks, 0);
+    epoch_vec_counters_.resize(vec_counters_.size(), 0);
+}
+
+void SimpleStats::InitVecStat(StatVecDouble stat, std::string name,
+                              std::string description, std::string part_name) {
+    InitVecNames(name, description, part_name);
+    vec_double_names_[Slot(stat)] = name;
+    vec_doubles_.resize(Slot(StatVecDouble::SIZE) * config_.ranks, 0.0);
+}
+
+void SimpleStats::InitHistoStat(StatHisto stat, std::string name,
+                                std::string description, int start_val,
+                                int end_val, int num_bins) {
+    Histo& histo = histos_[Slot(stat)];
     int bin_width = (end_val - start_val) / num_bins;
-    bin_widths_.emplace(name, bin_width);
-    histo_bounds_.emplace(name, std::make_pair(start_val, end_val));
-    histo_counts_.emplace(name, std::unordered_map<int, uint64_t>());
-    epoch_histo_counts_.emplace(name, std::unordered_map<int, uint64_t>());
+    histo.name = name;
+    histo.start_val = start_val;
+    histo.end_val = end_val;
+    histo.bin_width = bin_width;
 
     // initialize headers, descriptions
-    std::vector<std::string> headers;
     auto header = fmt::format("{}[-{}]", name, start_val);
-    headers.push_back(header);
+    histo.headers.push_back(header);
     header_descs_.emplace(header, description);
     for (int i = 1; i < num_bins + 1; i++) {
         int bucket_start = start_val + (i - 1) * bin_width;
         int bucket_end = start_val + i * bin_width - 1;
         header = fmt::format("{}[{}-{}]", name, bucket_start, bucket_end);
-        headers.push_back(header);
+        histo.headers.push_back(header);
         header_descs_.emplace(header, description);
     }
     header = fmt::format("{}[{}-]", name, end_val);
-    headers.push_back(header);
+    histo.headers.push_back(header);
     header_descs_.emplace(header, description);
 
-    histo_headers_.emplace(name, headers);
-
     // +2 for front and end
-    histo_bins_.emplace(name, std::vector<uint64_t>(num_bins + 2, 0));
-    epoch_histo_bins_.emplace(name, std::vector<uint64_t>(num_bins + 2, 0));
+    histo.bins.assign(num_bins + 2, 0);
+    histo.epoch_bins.assign(num_bins + 2, 0);
 }
 
 void SimpleStats::UpdateCounters() {
-    for (const auto& it : epoch_counters_) {
-        counters_[it.first] += it.second;
+    for (size_t i = 0; i < counters_.size(); i++) {
+        counters_[i] += epoch_counters_[i];
     }
-    for (const auto& vec : epoch_vec_counters_) {
-        for (size_t i = 0; i < vec.second.size(); i++) {
-            vec_counters_[vec.first][i] += vec.second[i];
-        }
+    for (size_t i = 0; i < vec_counters_.size(); i++) {
+        vec_counters_[i] += epoch_vec_counters_[i];
     }
 }
 
 void SimpleStats::UpdateHistoBins() {
-    for (auto& name_bins : epoch_histo_bins_) {
-        const auto& name = name_bins.first;
-        auto& bins = name_bins.second;
+    for (auto& histo : histos_) {
+        auto& bins = histo.epoch_bins;
         std::fill(bins.begin(), bins.end(), 0);
-        for (const auto it : epoch_histo_counts_[name]) {
-            int value = it.first;
-            uint64_t count = it.second;
+        histo.epoch_counts.ForEach([&](int value, uint64_t count) {
             int bin_idx = 0;
-            if (value < histo_bounds_[name].first) {
+            if (value < histo.start_val) {
                 bin_idx = 0;
-            } else if (value > histo_bounds_[name].second) {
+            } else if (value > histo.end_val) {
                 bin_idx = bins.size() - 1;
             } else {
-                bin_idx =
-                    (value - histo_bounds_[name].first) / bin_widths_[name] + 1;
+                bin_idx = (value - histo.start_val) / histo.bin_width + 1;
             }
             bins[bin_idx] += count;
-        }
-    }
+        });
 
-    // update overall histogram counts based on epoch histo counts
-    for (auto& name_counts : epoch_histo_counts_) {
-        const auto& name = name_counts.first;
-        auto& epoch_counts = name_counts.second;
-        auto& final_counts = histo_counts_[name];
-        for (const auto& val_cnt : epoch_counts) {
-            if (final_counts.count(val_cnt.first) <= 0) {
-                final_counts[val_cnt.first] = val_cnt.second;
-            } else {
-                final_counts[val_cnt.first] += val_cnt.second;
-            }
-        }
-        auto& final_bins = histo_bins_[name];
-        for (size_t i = 0; i < final_bins.size(); i++) {
-            final_bins[i] += epoch_histo_bins_[name][i];
+        // update overall histogram counts based on epoch histo counts
+        histo.counts.Merge(histo.epoch_counts);
+        for (size_t i = 0; i < histo.bins.size(); i++) {
+            histo.bins[i] += bins[i];
         }
     }
 }
@@ -282,10 +371,10 @@ void SimpleStats::UpdateHistoBins() {
 double SimpleStats::GetHistoAvg(const HistoCount& hist_counts) const {
     uint64_t accu_sum = 0;
     uint64_t count = 0;
-    for (auto i = hist_counts.begin(); i != hist_counts.end(); i++) {
-        accu_sum += i->first * i->second;
-        count += i->second;
-    }
+    hist_counts.ForEach([&](int value, uint64_t num) {
+        accu_sum += value * num;
+        count += num;
+    });
     return count == 0
                ? 0.0
                : static_cast<double>(accu_sum) / static_cast<double>(count);
@@ -294,30 +383,33 @@ double SimpleStats::GetHistoAvg(const HistoCount& hist_counts) const {
 void SimpleStats::UpdatePrints(bool epoch) {
     j_data_["channel"] = channel_id_;
 
-    std::unordered_map<std::string, uint64_t>& ref_counters =
-        epoch ? epoch_counters_ : counters_;
-    for (const auto& it : ref_counters) {
-        print_pairs_.emplace_back(it.first, std::to_string(it.second));
-        j_data_[it.first] = it.second;
+    const CounterArray& ref_counters = epoch ? epoch_counters_ : counters_;
+    for (size_t i : counter_order_) {
+        const auto& name = counter_names_[i];
+        print_pairs_.emplace_back(name, std::to_string(ref_counters[i]));
+        j_data_[name] = ref_counters[i];
     }
-    j_data_["epoch_num"] = counters_["epoch_num"];
+    j_data_["epoch_num"] = counters_[Slot(StatCounter::EPOCH_NUM)];
 
-    VecStat& ref_vcounter = epoch ? epoch_vec_counters_ : vec_counters_;
-    for (const auto& it : ref_vcounter) {
+    const auto& ref_vcounter = epoch ? epoch_vec_counters_ : vec_counters_;
+    for (size_t s : vec_counter_order_) {
+        const auto& vec_name = vec_counter_names_[s];
         Json j_list;
-        for (size_t i = 0; i < it.second.size(); i++) {
-            std::string name = it.first + "." + std::to_string(i);
-            print_pairs_.emplace_back(name, std::to_string(it.second[i]));
-            j_list[std::to_string(i)] = it.second[i];
+        for (int i = 0; i < config_.ranks; i++) {
+            uint64_t value = ref_vcounter[s * config_.ranks + i];
+            std::string name = vec_name + "." + std::to_string(i);
+            print_pairs_.emplace_back(name, std::to_string(value));
+            j_list[std::to_string(i)] = value;
         }
-        j_data_[it.first] = j_list;
-    }
-    VecStat& ref_hbins = epoch ? epoch_histo_bins_ : histo_bins_;
-    for (const auto& it : ref_hbins) {
-        const auto& names = histo_headers_[it.first];
-        for (size_t i = 0; i < it.second.size(); i++) {
-            print_pairs_.emplace_back(names[i], std::to_string(it.second[i]));
-            j_data_[names[i]] = it.second[i];
+        j_data_[vec_name] = j_list;
+    }
+    for (size_t h : histo_order_) {
+        const auto& histo = histos_[h];
+        const auto& bins = epoch ? histo.epoch_bins : histo.bins;
+        for (size_t i = 0; i < bins.size(); i++) {
+            print_pairs_.emplace_back(histo.headers[i],
+                                      std::to_string(bins[i]));
+            j_data_[histo.headers[i]] = bins[i];
         }
     }
 
@@ -325,149 +417,122 @@ void SimpleStats::UpdatePrints(bool epoch) {
     // huge therefore we only put aggregated histo in each epoch but
     // complete data at the end
     if (!epoch) {
-        for (const auto& name_hist : histo_counts_) {
+        for (const auto& histo : histos_) {
             Json j_list;
-            for (const auto& it : name_hist.second) {
-                j_list[std::to_string(it.first)] = it.second;
-            }
-            j_data_[name_hist.first] = j_list;
+            histo.counts.ForEach([&](int value, uint64_t count) {
+                j_list[std::to_string(value)] = count;
+            });
+            j_data_[histo.name] = j_list;
         }
     }
 
-    for (const auto& it : doubles_) {
-        print_pairs_.emplace_back(it.first, fmt::format("{}", it.second));
-        j_data_[it.first] = it.second;
+    for (size_t i : double_order_) {
+        print_pairs_.emplace_back(double_names_[i],
+                                  fmt::format("{}", doubles_[i]));
+        j_data_[double_names_[i]] = doubles_[i];
     }
 
-    for (const auto& it : vec_doubles_) {
+    for (size_t s : vec_double_order_) {
+        const auto& vec_name = vec_double_names_[s];
         Json j_list;
-        for (size_t i = 0; i < it.second.size(); i++) {
-            std::string name = it.first + "." + std::to_string(i);
-            print_pairs_.emplace_back(name, fmt::format("{}", it.second[i]));
-            j_list[std::to_string(i)] = it.second[i];
+        for (int i = 0; i < config_.ranks; i++) {
+            double value = vec_doubles_[s * config_.ranks + i];
+            std::string name = vec_name + "." + std::to_string(i);
+            print_pairs_.emplace_back(name, fmt::format("{}", value));
+            j_list[std::to_string(i)] = value;
         }
-        j_data_[it.first] = j_list;
+        j_data_[vec_name] = j_list;
     }
-    for (const auto& it : calculated_) {
-        print_pairs_.emplace_back(it.first, fmt::format("{}", it.second));
-        j_data_[it.first] = it.second;
+    for (size_t i : calculated_order_) {
+        print_pairs_.emplace_back(calculated_names_[i],
+                                  fmt::format("{}", calculated_[i]));
+        j_data_[calculated_names_[i]] = calculated_[i];
     }
 }
 
-void SimpleStats::UpdateEpochStats() {
-    // push counter values as is
-    UpdateCounters();
+// Derive energy, bandwidth and latency stats from either the epoch or the
+// overall counters
+void SimpleStats::UpdateComputedStats(bool epoch) {
+    const CounterArray& ctr = epoch ? epoch_counters_ : counters_;
+    const auto& vec_ctr = epoch ? epoch_vec_counters_ : vec_counters_;
 
     // update computed stats
-    doubles_["act_energy"] =
-        epoch_counters_["num_act_cmds"] * config_.act_energy_inc;
-    doubles_["read_energy"] =
-        epoch_counters_["num_read_cmds"] * config_.read_energy_inc;
-    doubles_["write_energy"] =
-        epoch_counters_["num_write_cmds"] * config_.write_energy_inc;
-    doubles_["ref_energy"] =
-        epoch_counters_["num_ref_cmds"] * config_.ref_energy_inc;
-    doubles_["refb_energy"] =
-        epoch_counters_["num_refb_cmds"] * config_.refb_energy_inc;
+    doubles_[Slot(StatDouble::ACT_ENERGY)] =
+        ctr[Slot(StatCounter::NUM_ACT_CMDS)] * config_.act_energy_inc;
+    doubles_[Slot(StatDouble::READ_ENERGY)] =
+        ctr[Slot(StatCounter::NUM_READ_CMDS)] * config_.read_energy_inc;
+    doubles_[Slot(StatDouble::WRITE_ENERGY)] =
+        ctr[Slot(StatCounter::NUM_WRITE_CMDS)] * config_.write_energy_inc;
+    doubles_[Slot(StatDouble::REF_ENERGY)] =
+        ctr[Slot(StatCounter::NUM_REF_CMDS)] * config_.ref_energy_inc;
+    doubles_[Slot(StatDouble::REFB_ENERGY)] =
+        ctr[Slot(StatCounter::NUM_REFB_CMDS)] * config_.refb_energy_inc;
 
     // vector doubles, update first, then push
     double background_energy = 0.0;
     for (int i = 0; i < config_.ranks; i++) {
-        double act_stb = epoch_vec_counters_["rank_active_cycles"][i] *
-                         config_.act_stb_energy_inc;
-        double pre_stb = epoch_vec_counters_["all_bank_idle_cycles"][i] *
-                         config_.pre_stb_energy_inc;
-        double sref_energy =
-            epoch_vec_counters_["sref_cycles"][i] * config_.sref_energy_inc;
-        vec_doubles_["act_stb_energy"][i] = act_stb;
-        vec_doubles_["pre_stb_energy"][i] = pre_stb;
-        vec_doubles_["sref_energy"][i] = sref_energy;
+        double act_stb =
+            vec_ctr[VecSlot(StatVecCounter::RANK_ACTIVE_CYCLES, i)] *
+            config_.act_stb_energy_inc;
+        double pre_stb =
+            vec_ctr[VecSlot(StatVecCounter::ALL_BANK_IDLE_CYCLES, i)] *
+            config_.pre_stb_energy_inc;
+        double sref_energy = vec_ctr[VecSlot(StatVecCounter::SREF_CYCLES, i)] *
+                             config_.sref_energy_inc;
+        vec_doubles_[VecSlot(StatVecDouble::ACT_STB_ENERGY, i)] = act_stb;
+        vec_doubles_[VecSlot(StatVecDouble::PRE_STB_ENERGY, i)] = pre_stb;
+        vec_doubles_[VecSlot(StatVecDouble::SREF_ENERGY, i)] = sref_energy;
         background_energy += act_stb + pre_stb + sref_energy;
     }
 
+    // histograms
     UpdateHistoBins();
 
     // calculated stats
-    uint64_t total_reqs =
-        epoch_counters_["num_reads_done"] + epoch_counters_["num_writes_done"];
-    double total_time = epoch_counters_["num_cycles"] * config_.tCK;
+    uint64_t total_reqs = ctr[Slot(StatCounter::NUM_READS_DONE)] +
+                          ctr[Slot(StatCounter::NUM_WRITES_DONE)];
+    double total_time = ctr[Slot(StatCounter::NUM_CYCLES)] * config_.tCK;
     double avg_bw = total_reqs * config_.request_size_bytes / total_time;
-    calculated_["average_bandwidth"] = avg_bw;
-
-    double total_energy = doubles_["act_energy"] + doubles_["read_energy"] +
-                          doubles_["write_energy"] + doubles_["ref_energy"] +
-                          doubles_["refb_energy"] + background_energy;
-    calculated_["total_energy"] = total_energy;
-    calculated_["average_power"] = total_energy / epoch_counters_["num_cycles"];
-    calculated_["average_read_latency"] =
-        GetHistoAvg(epoch_histo_counts_.at("read_latency"));
-    calculated_["average_interarrival"] =
-        GetHistoAvg(epoch_histo_counts_.at("interarrival_latency"));
+    calculated_[Slot(StatCalculated::AVERAGE_BANDWIDTH)] = avg_bw;
+
+    double total_energy = doubles_[Slot(StatDouble::ACT_ENERGY)] +
+                          doubles_[Slot(StatDouble::READ_ENERGY)] +
+                          doubles_[Slot(StatDouble::WRITE_ENERGY)] +
+                          doubles_[Slot(StatDouble::REF_ENERGY)] +
+                          doubles_[Slot(StatDouble::REFB_ENERGY)] +
+                          background_energy;
+    calculated_[Slot(StatCalculated::TOTAL_ENERGY)] = total_energy;
+    calculated_[Slot(StatCalculated::AVERAGE_POWER)] =
+        total_energy / ctr[Slot(StatCounter::NUM_CYCLES)];
+
+    const auto& read_lat = histos_[Slot(StatHisto::READ_LATENCY)];
+    const auto& interarrival = histos_[Slot(StatHisto::INTERARRIVAL_LATENCY)];
+    calculated_[Slot(StatCalculated::AVERAGE_READ_LATENCY)] =
+        GetHistoAvg(epoch ? read_lat.epoch_counts : read_lat.counts);
+    calculated_[Slot(StatCalculated::AVERAGE_INTERARRIVAL)] =
+        GetHistoAvg(epoch ? interarrival.epoch_counts : interarrival.counts);
+}
+
+void SimpleStats::UpdateEpochStats() {
+    // push counter values as is
+    UpdateCounters();
+    UpdateComputedStats(true);
 
     UpdatePrints(true);
-    for (auto& it : epoch_counters_) {
-        it.second = 0;
-    }
-    for (auto& vec : epoch_vec_counters_) {
-        std::fill(vec.second.begin(), vec.second.end(), 0);
-    }
-    for (auto& it : epoch_histo_counts_) {
-        it.second.clear();
+    epoch_counters_.fill(0);
+    std::fill(epoch_vec_counters_.begin(), epoch_vec_counters_.end(), 0);
+    for (auto& histo : histos_) {
+        histo.epoch_counts.Clear();
     }
     return;
 }
 
 void SimpleStats::UpdateFinalStats() {
     UpdateCounters();
-
-    // update computed stats
-    doubles_["act_energy"] = counters_["num_act_cmds"] * config_.act_energy_inc;
-    doubles_["read_energy"] =
-        counters_["num_read_cmds"] * config_.read_energy_inc;
-    doubles_["write_energy"] =
-        counters_["num_write_cmds"] * config_.write_energy_inc;
-    doubles_["ref_energy"] = counters_["num_ref_cmds"] * config_.ref_energy_inc;
-    doubles_["refb_energy"] =
-        counters_["num_refb_cmds"] * config_.refb_energy_inc;
-
-    // vector doubles, update first, then push
-    double background_energy = 0.0;
-    for (int i = 0; i < config_.ranks; i++) {
-        double act_stb =
-            vec_counters_["rank_active_cycles"][i] * config_.act_stb_energy_inc;
-        double pre_stb = vec_counters_["all_bank_idle_cycles"][i] *
-                         config_.pre_stb_energy_inc;
-        double sref_energy =
-            vec_counters_["sref_cycles"][i] * config_.sref_energy_inc;
-        vec_doubles_["act_stb_energy"][i] = act_stb;
-        vec_doubles_["pre_stb_energy"][i] = pre_stb;
-        vec_doubles_["sref_energy"][i] = sref_energy;
-        background_energy += act_stb + pre_stb + sref_energy;
-    }
-
-    // histograms
-    UpdateHistoBins();
-
-    // calculated stats
-    uint64_t total_reqs =
-        counters_["num_reads_done"] + counters_["num_writes_done"];
-    double total_time = counters_["num_cycles"] * config_.tCK;
-    double avg_bw = total_reqs * config_.request_size_bytes / total_time;
-    calculated_["average_bandwidth"] = avg_bw;
-
-    double total_energy = doubles_["act_energy"] + doubles_["read_energy"] +
-                          doubles_["write_energy"] + doubles_["ref_energy"] +
-                          doubles_["refb_energy"] + background_energy;
-    calculated_["total_energy"] = total_energy;
-    calculated_["average_power"] = total_energy / counters_["num_cycles"];
-    // calculated_["average_read_latency"] = GetHistoAvg("read_latency");
-    calculated_["average_read_latency"] =
-        GetHistoAvg(histo_counts_.at("read_latency"));
-    calculated_["average_interarrival"] =
-        GetHistoAvg(histo_counts_.at("interarrival_latency"));
+    UpdateComputedStats(false);
 
     UpdatePrints(false);
     return;
 }
 
-}  // namespace dramsim3
\ No newline at end of file
+}  // namespace dramsim3
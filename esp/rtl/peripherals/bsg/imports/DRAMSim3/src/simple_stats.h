@@ -1,34 +1,82 @@
 #ifndef __SIMPLE_STATS_
 #define __SIMPLE_STATS_
 
+#include <array>
 #include <fstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "checkpoint.h"
 #include "configuration.h"
 #include "json.hpp"
 
 namespace dramsim3 {
 
+// Stats are addressed by dense handles rather than by name so that the
+// per-cycle updates are plain array accesses. Names are attached to the
+// handles once, in the SimpleStats constructor, and only used for output.
+enum class StatCounter {
+    NUM_CYCLES,
+    EPOCH_NUM,
+    NUM_READS_DONE,
+    NUM_WRITES_DONE,
+    NUM_WRITE_BUF_HITS,
+    NUM_READ_ROW_HITS,
+    NUM_WRITE_ROW_HITS,
+    NUM_READ_CMDS,
+    NUM_WRITE_CMDS,
+    NUM_ACT_CMDS,
+    NUM_PRE_CMDS,
+    NUM_ONDEMAND_PRES,
+    NUM_REF_CMDS,
+    NUM_REFB_CMDS,
+    NUM_SREFE_CMDS,
+    NUM_SREFX_CMDS,
+    HBM_DUAL_CMDS,
+    SIZE
+};
+
+// per-rank counters
+enum class StatVecCounter {
+    ALL_BANK_IDLE_CYCLES,
+    RANK_ACTIVE_CYCLES,
+    SREF_CYCLES,
+    SIZE
+};
+
+enum class StatHisto {
+    READ_LATENCY,
+    WRITE_LATENCY,
+    INTERARRIVAL_LATENCY,
+    SIZE
+};
+
 class SimpleStats {
    public:
     SimpleStats(const Config& config, int channel_id);
     // incrementing counter
-    void Increment(const std::string name) { epoch_counters_[name] += 1; }
+    void Increment(StatCounter stat) { epoch_counters_[Slot(stat)] += 1; }
+
+    // increment counter by number
+    void IncrementBy(StatCounter stat, uint64_t num) {
+        epoch_counters_[Slot(stat)] += num;
+    }
 
     // incrementing for vec counter
-    void IncrementVec(const std::string name, int pos) {
-        epoch_vec_counters_[name][pos] += 1;
+    void IncrementVec(StatVecCounter stat, int pos) {
+        epoch_vec_counters_[VecSlot(stat, pos)] += 1;
     }
 
     // increment vec counter by number
-    void IncrementVecBy(const std::string name, int pos, int num) {
-        epoch_vec_counters_[name][pos] += num;
+    void IncrementVecBy(StatVecCounter stat, int pos, uint64_t num) {
+        epoch_vec_counters_[VecSlot(stat, pos)] += num;
     }
 
     // add historgram value
-    void AddValue(const std::string name, const int value);
+    void AddValue(StatHisto stat, const int value) {
+        histos_[Slot(stat)].epoch_counts.Add(value);
+    }
 
     // Epoch update
     void PrintEpochStats();
@@ -39,23 +87,116 @@ class SimpleStats {
     // Reset (usually after one phase of simulation)
     void Reset();
 
+    // Counters and histograms; the energy and calculated stats are derived
+    // from them whenever stats are printed.
+    void Save(CheckpointWriter& out) const;
+    void Load(CheckpointReader& in);
+
    private:
-    using VecStat = std::unordered_map<std::string, std::vector<uint64_t> >;
-    using HistoCount = std::unordered_map<int, uint64_t>;
+    enum class StatDouble {
+        ACT_ENERGY,
+        READ_ENERGY,
+        WRITE_ENERGY,
+        REF_ENERGY,
+        REFB_ENERGY,
+        SIZE
+    };
+    enum class StatVecDouble {
+        ACT_STB_ENERGY,
+        PRE_STB_ENERGY,
+        SREF_ENERGY,
+        SIZE
+    };
+    enum class StatCalculated {
+        AVERAGE_BANDWIDTH,
+        TOTAL_ENERGY,
+        AVERAGE_POWER,
+        AVERAGE_READ_LATENCY,
+        AVERAGE_INTERARRIVAL,
+        SIZE
+    };
+
+    // Number of occurrences of each histogram value. Latencies are small and
+    // non-negative, so they are counted in a flat array indexed by value; only
+    // outliers go to the map.
+    class HistoCount {
+       public:
+        void Add(int value) {
+            if (value >= 0 && value < kMaxDense) {
+                if (static_cast<size_t>(value) >= dense_.size()) {
+                    dense_.resize(value + 1, 0);
+                }
+                dense_[value] += 1;
+            } else {
+                sparse_[value] += 1;
+            }
+        }
+        void Merge(const HistoCount& other);
+        void Clear();
+        void Save(CheckpointWriter& out) const;
+        void Load(CheckpointReader& in);
+        // calls f(value, count) for every value seen at least once
+        template <class F>
+        void ForEach(F f) const {
+            for (size_t i = 0; i < dense_.size(); i++) {
+                if (dense_[i] != 0) f(static_cast<int>(i), dense_[i]);
+            }
+            for (const auto& it : sparse_) f(it.first, it.second);
+        }
+
+       private:
+        static constexpr int kMaxDense = 4096;
+        std::vector<uint64_t> dense_;
+        std::unordered_map<int, uint64_t> sparse_;
+    };
+
+    struct Histo {
+        std::string name;
+        int start_val;
+        int end_val;
+        int bin_width;
+        std::vector<std::string> headers;
+        HistoCount counts;
+        HistoCount epoch_counts;
+        std::vector<uint64_t> bins;
+        std::vector<uint64_t> epoch_bins;
+    };
+
     using Json = nlohmann::json;
-    void InitStat(std::string name, std::string stat_type,
+    using CounterArray =
+        std::array<uint64_t, static_cast<size_t>(StatCounter::SIZE)>;
+
+    template <class T>
+    static constexpr size_t Slot(T stat) {
+        return static_cast<size_t>(stat);
+    }
+    size_t VecSlot(StatVecCounter stat, int pos) const {
+        return Slot(stat) * config_.ranks + pos;
+    }
+    size_t VecSlot(StatVecDouble stat, int pos) const {
+        return Slot(stat) * config_.ranks + pos;
+    }
+
+    void InitStat(StatCounter stat, std::string name, std::string description);
+    void InitStat(StatDouble stat, std::string name, std::string description);
+    void InitStat(StatCalculated stat, std::string name,
                   std::string description);
-    void InitVecStat(std::string name, std::string stat_type,
-                     std::string description, std::string part_name,
-                     int vec_len);
-    void InitHistoStat(std::string name, std::string description, int start_val,
-                       int end_val, int num_bins);
+    void InitVecStat(StatVecCounter stat, std::string name,
+                     std::string description, std::string part_name);
+    void InitVecStat(StatVecDouble stat, std::string name,
+                     std::string description, std::string part_name);
+    void InitVecNames(std::string name, std::string description,
+                      std::string part_name);
+    void InitHistoStat(StatHisto stat, std::string name,
+                       std::string description, int start_val, int end_val,
+                       int num_bins);
 
     void UpdateCounters();
     void UpdateHistoBins();
     void UpdatePrints(bool epoch);
     double GetHistoAvg(const HistoCount& histo_counts) const;
     std::string GetTextHeader(bool is_final) const;
+    void UpdateComputedStats(bool epoch);
     void UpdateEpochStats();
     void UpdateFinalStats();
 
@@ -65,33 +206,46 @@ class SimpleStats {
     // map names to descriptions
     std::unordered_map<std::string, std::string> header_descs_;
 
-    // counter stats, indexed by their name
-    std::unordered_map<std::string, uint64_t> counters_;
-    std::unordered_map<std::string, uint64_t> epoch_counters_;
+    // Counter stats, indexed by handle. The epoch counters are bumped every
+    // cycle, the totals only once per epoch.
+    CounterArray epoch_counters_;
+    CounterArray counters_;
+    std::array<std::string, static_cast<size_t>(StatCounter::SIZE)>
+        counter_names_;
 
-    // vectored counter stats, first indexed by name then by index
-    VecStat vec_counters_;
-    VecStat epoch_vec_counters_;
+    // vectored counter stats, indexed by handle * ranks + rank
+    std::vector<uint64_t> vec_counters_;
+    std::vector<uint64_t> epoch_vec_counters_;
+    std::array<std::string, static_cast<size_t>(StatVecCounter::SIZE)>
+        vec_counter_names_;
 
     // NOTE: doubles_ vec_doubles_ and calculated_ are basically one time
     // placeholders after each epoch they store the value for that epoch
     // (different from the counters) and in the end updated to the overall value
-    std::unordered_map<std::string, double> doubles_;
+    std::array<double, static_cast<size_t>(StatDouble::SIZE)> doubles_;
+    std::array<std::string, static_cast<size_t>(StatDouble::SIZE)>
+        double_names_;
 
-    std::unordered_map<std::string, std::vector<double> > vec_doubles_;
+    std::vector<double> vec_doubles_;
+    std::array<std::string, static_cast<size_t>(StatVecDouble::SIZE)>
+        vec_double_names_;
 
     // calculated stats, similar to double, but not the same
-    std::unordered_map<std::string, double> calculated_;
+    std::array<double, static_cast<size_t>(StatCalculated::SIZE)> calculated_;
+    std::array<std::string, static_cast<size_t>(StatCalculated::SIZE)>
+        calculated_names_;
 
     // histogram stats
-    std::unordered_map<std::string, std::vector<std::string> > histo_headers_;
+    std::array<Histo, static_cast<size_t>(StatHisto::SIZE)> histos_;
 
-    std::unordered_map<std::string, std::pair<int, int> > histo_bounds_;
-    std::unordered_map<std::string, int> bin_widths_;
-    std::unordered_map<std::string, HistoCount> histo_counts_;
-    std::unordered_map<std::string, HistoCount> epoch_histo_counts_;
-    VecStat histo_bins_;
-    VecStat epoch_histo_bins_;
+    // text output order of each kind of stat, as indices into the arrays
+    // above; see HashMapOrder()
+    std::vector<size_t> counter_order_;
+    std::vector<size_t> vec_counter_order_;
+    std::vector<size_t> histo_order_;
+    std::vector<size_t> double_order_;
+    std::vector<size_t> vec_double_order_;
+    std::vector<size_t> calculated_order_;
 
     // outputs
     Json j_data_;
@@ -99,4 +253,4 @@ class SimpleStats {
 };
 
 }  // namespace dramsim3
-#endif
\ No newline at end of file
+#endif
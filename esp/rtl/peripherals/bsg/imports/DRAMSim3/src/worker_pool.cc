@@ -0,0 +1,89 @@
+#include "worker_pool.h"
+
+namespace dramsim3 {
+
+namespace {
+// number of polls before a waiting thread goes to sleep
+constexpr int kSpinPolls = 2000;
+}  // namespace
+
+WorkerPool::WorkerPool(int num_workers)
+    : job_(nullptr), generation_(0), pending_(0), stop_(false) {
+    for (int i = 1; i < num_workers; i++) {
+        threads_.emplace_back(&WorkerPool::WorkerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+    start_cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Run(const std::function<void(int)>& job) {
+    if (threads_.empty()) {
+        job(0);
+        return;
+    }
+
+    job_ = &job;
+    pending_.store(static_cast<int>(threads_.size()),
+                   std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+    start_cv_.notify_all();
+
+    job(0);
+
+    for (int i = 0; pending_.load(std::memory_order_acquire) != 0; i++) {
+        if (i < kSpinPolls) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] {
+            return pending_.load(std::memory_order_acquire) == 0;
+        });
+    }
+    job_ = nullptr;
+}
+
+void WorkerPool::WorkerLoop(int id) {
+    uint64_t seen = 0;
+    while (true) {
+        for (int i = 0; generation_.load(std::memory_order_acquire) == seen;
+             i++) {
+            if (i < kSpinPolls) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock, [this, seen] {
+                return generation_.load(std::memory_order_acquire) != seen;
+            });
+        }
+        // Run() does not start a new job before this one is done, so the
+        // generation moves by exactly one
+        seen++;
+        if (stop_) {
+            return;
+        }
+
+        (*job_)(id);
+
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_cv_.notify_one();
+        }
+    }
+}
+
+}  // namespace dramsim3
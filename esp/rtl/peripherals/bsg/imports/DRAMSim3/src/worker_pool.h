@@ -0,0 +1,39 @@
+#ifndef __WORKER_POOL_H
+#define __WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dramsim3 {
+
+// A fixed set of threads that all run the same job. Run() hands the job to
+// every worker, runs the share of worker 0 on the calling thread and returns
+// once all workers are done, so consecutive jobs are separated by a barrier.
+// Waiting threads spin for a while before they block, which keeps the
+// hand-off cheap when jobs are short.
+class WorkerPool {
+   public:
+    explicit WorkerPool(int num_workers);
+    ~WorkerPool();
+    int NumWorkers() const { return static_cast<int>(threads_.size()) + 1; }
+    void Run(const std::function<void(int)>& job);
+
+   private:
+    void WorkerLoop(int id);
+
+    std::vector<std::thread> threads_;
+    const std::function<void(int)>* job_;
+    std::atomic<uint64_t> generation_;
+    std::atomic<int> pending_;
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+};
+
+}  // namespace dramsim3
+#endif
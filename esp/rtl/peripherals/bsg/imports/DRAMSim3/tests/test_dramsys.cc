@@ -1,6 +1,8 @@
 #include "catch.hpp"
 #include "configuration.h"
 #include "dram_system.h"
+#include "memory_system.h"
+#include <cstdio>
 
 bool call_back_called = false;
 void dummy_call_back(uint64_t addr) {
@@ -30,3 +32,109 @@ TEST_CASE("Jedec DRAMSystem Testing", "[dramsim3]") {
         REQUIRE(clk == tRC);
     }
 }
+
+// Drive a system with the same random traffic, ticking either one cycle at a
+// time or in batches once the traffic stops, and record the completions
+static std::vector<std::pair<uint64_t, bool>> run_traffic(
+    dramsim3::Config& config, bool batched) {
+    std::vector<std::pair<uint64_t, bool>> done;
+    dramsim3::JedecDRAMSystem dramsys(
+        config, ".", [&done](uint64_t addr) { done.push_back({addr, false}); },
+        [&done](uint64_t addr) { done.push_back({addr, true}); });
+
+    uint64_t lfsr = 1;
+    for (int clk = 0; clk < 20000; clk++) {
+        for (int i = 0; i < 4; i++) {
+            lfsr = lfsr * 6364136223846793005ULL + 1442695040888963407ULL;
+            uint64_t addr = (lfsr >> 16) & ~0x3fULL;
+            bool is_write = (lfsr >> 60) & 1;
+            if (dramsys.WillAcceptTransaction(addr, is_write)) {
+                dramsys.AddTransaction(addr, is_write);
+            }
+        }
+        dramsys.ClockTick();
+    }
+    if (batched) {
+        dramsys.ClockTicks(20000);
+    } else {
+        for (int clk = 0; clk < 20000; clk++) {
+            dramsys.ClockTick();
+        }
+    }
+    return done;
+}
+
+TEST_CASE("Jedec DRAMSystem threaded channels", "[dramsim3]") {
+    dramsim3::Config config("configs/HBM2_8Gb_x128.ini", ".");
+
+    config.sim_threads = 0;
+    auto serial = run_traffic(config, false);
+    REQUIRE(!serial.empty());
+
+    SECTION("batched serial ticks complete in the same order") {
+        REQUIRE(run_traffic(config, true) == serial);
+    }
+
+    SECTION("threaded ticks complete in the same order") {
+        config.sim_threads = 4;
+        REQUIRE(run_traffic(config, false) == serial);
+        REQUIRE(run_traffic(config, true) == serial);
+    }
+}
+
+// Add random traffic to a memory system for cycles cycles, continuing the
+// sequence in lfsr, and record the completions
+static void drive_traffic(dramsim3::MemorySystem& memsys, uint64_t& lfsr,
+                          int cycles) {
+    for (int clk = 0; clk < cycles; clk++) {
+        for (int i = 0; i < 4; i++) {
+            lfsr = lfsr * 6364136223846793005ULL + 1442695040888963407ULL;
+            uint64_t addr = (lfsr >> 16) & ~0x3fULL;
+            bool is_write = (lfsr >> 60) & 1;
+            if (memsys.WillAcceptTransaction(addr, is_write)) {
+                memsys.AddTransaction(addr, is_write);
+            }
+        }
+        memsys.ClockTick();
+    }
+}
+
+TEST_CASE("MemorySystem checkpoints", "[dramsim3]") {
+    const char* ckpt = "test_dramsys.ckpt";
+    std::vector<std::pair<uint64_t, bool>> done;
+    auto read_done = [&done](uint64_t addr) { done.push_back({addr, false}); };
+    auto write_done = [&done](uint64_t addr) { done.push_back({addr, true}); };
+
+    // run up to the checkpoint, then on without interruption
+    dramsim3::MemorySystem memsys("configs/HBM2_8Gb_x128.ini", ".", read_done,
+                                  write_done);
+    uint64_t lfsr = 1;
+    drive_traffic(memsys, lfsr, 12345);
+    REQUIRE(memsys.SaveCheckpoint(ckpt));
+    uint64_t ckpt_lfsr = lfsr;
+    done.clear();
+    drive_traffic(memsys, lfsr, 20000);
+    auto expected = done;
+    REQUIRE(!expected.empty());
+
+    SECTION("restored system completes the same requests") {
+        dramsim3::MemorySystem restored("configs/HBM2_8Gb_x128.ini", ".",
+                                        read_done, write_done);
+        REQUIRE(restored.LoadCheckpoint(ckpt));
+        REQUIRE(restored.GetClock() == 12345);
+        done.clear();
+        lfsr = ckpt_lfsr;
+        drive_traffic(restored, lfsr, 20000);
+        REQUIRE(done == expected);
+        REQUIRE(restored.GetClock() == memsys.GetClock());
+    }
+
+    SECTION("checkpoint does not load into another config") {
+        dramsim3::MemorySystem other("configs/DDR4_8Gb_x8_2400.ini", ".",
+                                     read_done, write_done);
+        REQUIRE(!other.LoadCheckpoint(ckpt));
+        REQUIRE(!other.LoadCheckpoint("no_such_file.ckpt"));
+    }
+
+    std::remove(ckpt);
+}
@@ -46,6 +46,16 @@ Cache::Cache(int size, int assoc, int block_size,
   index_offset = calc_log2(block_size);
   tag_offset = calc_log2(block_num) + index_offset;
 
+  assert(assoc <= 16); // way numbers are packed in 4 bits
+  lines.resize(block_num * assoc);
+  sets.resize(block_num);
+
+  mshr_bits = calc_log2(mshr_entry_num) + 1;
+  if ((1u << mshr_bits) < 2u * unsigned(mshr_entry_num)) {
+    mshr_bits++;
+  }
+  mshr_table.resize(1 << mshr_bits);
+
   debug("index_offset %d", index_offset);
   debug("index_mask 0x%x", index_mask);
   debug("tag_offset %d", tag_offset);
@@ -112,16 +122,15 @@ bool Cache::send(Request req) {
     assert(req.type == Request::Type::READ);
     cache_read_access++;
   }
-  // If there isn't a set, create it.
-  auto& lines = get_lines(req.addr);
-  std::list<Line>::iterator line;
+  int set = get_index(req.addr);
+  int pos;
 
-  if (is_hit(lines, req.addr, &line)) {
-    lines.push_back(Line(req.addr, get_tag(req.addr), false,
-        line->dirty || (req.type == Request::Type::WRITE)));
-    lines.erase(line);
-    cachesys->hit_list.push_back(
-        make_pair(cachesys->clk + latency[int(level)], req));
+  if (is_hit(set, req.addr, &pos)) {
+    Line& line = line_at(set, pos);
+    line.addr = req.addr;
+    line.dirty = line.dirty || (req.type == Request::Type::WRITE);
+    touch_line(set, pos);
+    cachesys->add_hit(cachesys->clk + latency[int(level)], req);
 
     debug("hit, update timestamp %ld", cachesys->clk);
     debug("hit finish time %ld",
@@ -150,16 +159,16 @@ bool Cache::send(Request req) {
     // Look it up in MSHR entries
     assert(req.type == Request::Type::READ);
     auto mshr = hit_mshr(req.addr);
-    if (mshr != mshr_entries.end()) {
+    if (mshr != nullptr) {
       debug("hit mshr");
       cache_mshr_hit++;
-      mshr->second->dirty = dirty || mshr->second->dirty;
+      lines[mshr->line].dirty = dirty || lines[mshr->line].dirty;
       return true;
     }
 
     // All requests come to this stage will be READ, so they
     // should be recorded in MSHR entries.
-    if (mshr_entries.size() == mshr_entry_num) {
+    if (mshr_entries == mshr_entry_num) {
       // When no MSHR entries available, the miss request
       // is stalling.
       cache_mshr_unavailable++;
@@ -168,20 +177,20 @@ bool Cache::send(Request req) {
     }
 
     // Check whether there is a line available
-    if (all_sets_locked(lines)) {
+    if (all_sets_locked(set)) {
       cache_set_unavailable++;
       return false;
     }
 
-    auto newline = allocate_line(lines, req.addr);
-    if (newline == lines.end()) {
+    long newline = allocate_line(set, req.addr);
+    if (newline < 0) {
       return false;
     }
 
-    newline->dirty = dirty;
+    lines[newline].dirty = dirty;
 
     // Add to MSHR entries
-    mshr_entries.push_back(make_pair(req.addr, newline));
+    add_mshr(req.addr, newline);
 
     // Send the request to next level;
     if (!is_last_level) {
@@ -198,38 +207,39 @@ bool Cache::send(Request req) {
 
 void Cache::evictline(long addr, bool dirty) {
 
-  auto it = cache_lines.find(get_index(addr));
-  assert(it != cache_lines.end()); // check inclusive cache
-  auto& lines = it->second;
-  auto line = find_if(lines.begin(), lines.end(),
-      [addr, this](Line l){return (l.tag == get_tag(addr));});
+  int set = get_index(addr);
+  int pos = find_line(set, addr);
 
-  assert(line != lines.end());
+  assert(pos >= 0); // check inclusive cache
   // Update LRU queue. The dirty bit will be set if the dirty
   // bit inherited from higher level(s) is set.
-  lines.push_back(Line(addr, get_tag(addr), false,
-      dirty || line->dirty));
-  lines.erase(line);
+  Line& line = line_at(set, pos);
+  line.addr = addr;
+  line.lock = false;
+  line.dirty = dirty || line.dirty;
+  touch_line(set, pos);
 }
 
 std::pair<long, bool> Cache::invalidate(long addr) {
   long delay = latency_each[int(level)];
   bool dirty = false;
 
-  auto& lines = get_lines(addr);
-  if (lines.size() == 0) {
+  int set = get_index(addr);
+  if (sets[set].count == 0) {
     // The line of this address doesn't exist.
     return make_pair(0, false);
   }
-  auto line = find_if(lines.begin(), lines.end(),
-      [addr, this](Line l){return (l.tag == get_tag(addr));});
+  int pos = find_line(set, addr);
 
   // If the line is in this level cache, then erase it from
   // the buffer.
-  if (line != lines.end()) {
-    assert(!line->lock);
+  bool line_dirty;
+  if (pos >= 0) {
+    Line& line = line_at(set, pos);
+    assert(!line.lock);
     debug("invalidate %lx @ level %d", addr, int(level));
-    lines.erase(line);
+    line_dirty = line.dirty;
+    remove_line(set, pos);
   } else {
     // If it's not in current level, then no need to go up.
     return make_pair(delay, false);
@@ -244,24 +254,24 @@ std::pair<long, bool> Cache::invalidate(long addr) {
       } else {
         max_delay = max(max_delay, delay + result.first);
       }
-      dirty = dirty || line->dirty || result.second;
+      dirty = dirty || line_dirty || result.second;
     }
     delay = max_delay;
   } else {
-    dirty = line->dirty;
+    dirty = line_dirty;
   }
   return make_pair(delay, dirty);
 }
 
 
-void Cache::evict(std::list<Line>* lines,
-    std::list<Line>::iterator victim) {
-  debug("level %d miss evict victim %lx", int(level), victim->addr);
+void Cache::evict(int set, unsigned int pos) {
+  Line& victim = line_at(set, pos);
+  debug("level %d miss evict victim %lx", int(level), victim.addr);
   cache_eviction++;
 
-  long addr = victim->addr;
+  long addr = victim.addr;
   long invalidate_time = 0;
-  bool dirty = victim->dirty;
+  bool dirty = victim.dirty;
 
   // First invalidate the victim line in higher level.
   if (higher_cache.size()) {
@@ -269,7 +279,7 @@ void Cache::evict(std::list<Line>* lines,
       auto result = hc->invalidate(addr);
       invalidate_time = max(invalidate_time,
           result.first + (result.second ? latency_each[int(level)] : 0));
-      dirty = dirty || result.second || victim->dirty;
+      dirty = dirty || result.second || victim.dirty;
     }
   }
 
@@ -295,51 +305,116 @@ void Cache::evict(std::list<Line>* lines,
     }
   }
 
-  lines->erase(victim);
+  remove_line(set, pos);
 }
 
-std::list<Cache::Line>::iterator Cache::allocate_line(
-    std::list<Line>& lines, long addr) {
+long Cache::allocate_line(int set, long addr) {
   // See if an eviction is needed
-  if (need_eviction(lines, addr)) {
+  if (need_eviction(set, addr)) {
     // Get victim.
     // The first one might still be locked due to reorder in MC
-    auto victim = find_if(lines.begin(), lines.end(),
-        [this](Line line) {
-          bool check = !line.lock;
-          if (!is_first_level) {
-            for (auto hc : higher_cache) {
-              if(!check) {
-                return check;
-              }
-              check = check && hc->check_unlock(line.addr);
-            }
+    int victim = -1;
+    for (unsigned int pos = 0; pos < sets[set].count && victim < 0; pos++) {
+      Line& line = line_at(set, pos);
+      bool check = !line.lock;
+      if (!is_first_level) {
+        for (auto hc : higher_cache) {
+          if(!check) {
+            break;
           }
-          return check;
-        });
-    if (victim == lines.end()) {
-      return victim;  // doesn't exist a line that's already unlocked in each level
+          check = check && hc->check_unlock(line.addr);
+        }
+      }
+      if (check) {
+        victim = pos;
+      }
     }
-    assert(victim != lines.end());
-    evict(&lines, victim);
+    if (victim < 0) {
+      return -1;  // doesn't exist a line that's already unlocked in each level
+    }
+    evict(set, victim);
   }
 
   // Allocate newline, with lock bit on and dirty bit off
-  lines.push_back(Line(addr, get_tag(addr)));
-  auto last_element = lines.end();
-  --last_element;
-  return last_element;
+  return insert_line(set, Line(addr, get_tag(addr)));
 }
 
-bool Cache::is_hit(std::list<Line>& lines, long addr,
-    std::list<Line>::iterator* pos_ptr) {
-  auto pos = find_if(lines.begin(), lines.end(),
-      [addr, this](Line l){return (l.tag == get_tag(addr));});
+bool Cache::is_hit(int set, long addr, int* pos_ptr) {
+  int pos = find_line(set, addr);
   *pos_ptr = pos;
-  if (pos == lines.end()) {
+  if (pos < 0) {
     return false;
   }
-  return !pos->lock;
+  return !line_at(set, pos).lock;
+}
+
+// drop the 4-bit field at pos, shifting the ones above it down
+static uint64_t drop_way(uint64_t lru, unsigned int pos) {
+  uint64_t low = lru & ((1ULL << (4 * pos)) - 1);
+  uint64_t high = (pos == 15) ? 0 : (lru >> (4 * (pos + 1)));
+  return low | (high << (4 * pos));
+}
+
+void Cache::touch_line(int set, unsigned int pos) {
+  Set& s = sets[set];
+  uint64_t way = way_at(set, pos);
+  s.lru = drop_way(s.lru, pos) | (way << (4 * (s.count - 1)));
+}
+
+void Cache::remove_line(int set, unsigned int pos) {
+  Set& s = sets[set];
+  s.used &= ~(1u << way_at(set, pos));
+  s.lru = drop_way(s.lru, pos);
+  s.count--;
+}
+
+size_t Cache::insert_line(int set, const Line& line) {
+  Set& s = sets[set];
+  assert(s.count < assoc);
+  uint64_t way = __builtin_ctz(~s.used);
+  s.used |= 1u << way;
+  s.lru |= way << (4 * s.count);
+  s.count++;
+  lines[set * assoc + way] = line;
+  return set * assoc + way;
+}
+
+Cache::MSHR* Cache::hit_mshr(long addr) {
+  size_t mask = mshr_table.size() - 1;
+  for (size_t i = mshr_home(addr); mshr_table[i].valid; i = (i + 1) & mask) {
+    if (align(mshr_table[i].addr) == align(addr)) {
+      return &mshr_table[i];
+    }
+  }
+  return nullptr;
+}
+
+void Cache::add_mshr(long addr, size_t line) {
+  size_t mask = mshr_table.size() - 1;
+  size_t i = mshr_home(addr);
+  while (mshr_table[i].valid) {
+    i = (i + 1) & mask;
+  }
+  mshr_table[i].addr = addr;
+  mshr_table[i].line = line;
+  mshr_table[i].valid = true;
+  mshr_entries++;
+}
+
+void Cache::remove_mshr(MSHR* mshr) {
+  // backward shift deletion keeps every probe sequence unbroken
+  size_t mask = mshr_table.size() - 1;
+  size_t hole = mshr - &mshr_table[0];
+  for (size_t i = (hole + 1) & mask; mshr_table[i].valid; i = (i + 1) & mask) {
+    size_t home = mshr_home(mshr_table[i].addr);
+    // entry i may move to the hole unless its home lies in (hole, i]
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      mshr_table[hole] = mshr_table[i];
+      hole = i;
+    }
+  }
+  mshr_table[hole].valid = false;
+  mshr_entries--;
 }
 
 void Cache::concatlower(Cache* lower) {
@@ -348,15 +423,12 @@ void Cache::concatlower(Cache* lower) {
   lower->higher_cache.push_back(this);
 };
 
-bool Cache::need_eviction(const std::list<Line>& lines, long addr) {
-  if (find_if(lines.begin(), lines.end(),
-      [addr, this](Line l){
-        return (get_tag(addr) == l.tag);})
-      != lines.end()) {
+bool Cache::need_eviction(int set, long addr) {
+  if (find_line(set, addr) >= 0) {
     // Due to MSHR, the program can't reach here. Just for checking
     assert(false);
   } else {
-    if (lines.size() < assoc) {
+    if (sets[set].count < assoc) {
       return false;
     } else {
       return true;
@@ -367,14 +439,11 @@ bool Cache::need_eviction(const std::list<Line>& lines, long addr) {
 void Cache::callback(Request& req) {
   debug("level %d", int(level));
 
-  auto it = find_if(mshr_entries.begin(), mshr_entries.end(),
-      [&req, this](std::pair<long, std::list<Line>::iterator> mshr_entry) {
-        return (align(mshr_entry.first) == align(req.addr));
-      });
+  auto mshr = hit_mshr(req.addr);
 
-  if (it != mshr_entries.end()) {
-    it->second->lock = false;
-    mshr_entries.erase(it);
+  if (mshr != nullptr) {
+    lines[mshr->line].lock = false;
+    remove_mshr(mshr);
   }
 
   if (higher_cache.size()) {
@@ -402,31 +471,33 @@ void CacheSystem::tick() {
   ++clk;
 
   // Sends ready waiting request to memory
-  auto it = wait_list.begin();
-  while (it != wait_list.end() && clk >= it->first) {
-    if (!send_memory(it->second)) {
-      ++it;
-    } else {
-
-      debug("complete req: addr %lx", (it->second).addr);
-
-      it = wait_list.erase(it);
+  size_t ready = 0;
+  wait_sent.clear();
+  while (ready < wait_list.size() && clk >= wait_list[ready].first) {
+    wait_sent.push_back(send_memory(wait_list[ready].second));
+    if (wait_sent.back()) {
+      debug("complete req: addr %lx", wait_list[ready].second.addr);
+    }
+    ready++;
+  }
+  // keep the requests that were not accepted, in order, in front of
+  // the ones still waiting
+  size_t kept = ready;
+  for (size_t i = ready; i-- > 0;) {
+    if (!wait_sent[i]) {
+      wait_list[--kept] = wait_list[i];
     }
   }
+  wait_list.pop_front(kept);
 
   // hit request callback
-  it = hit_list.begin();
-  while (it != hit_list.end()) {
-    if (clk >= it->first) {
-      it->second.callback(it->second);
-
-      debug("finish hit: addr %lx", (it->second).addr);
+  auto& hits = hit_list[clk & (hit_list.size() - 1)];
+  for (auto& req : hits) {
+    req.callback(req);
 
-      it = hit_list.erase(it);
-    } else {
-      ++it;
-    }
+    debug("finish hit: addr %lx", req.addr);
   }
+  hits.clear();
 }
 
 } // namespace ramulator
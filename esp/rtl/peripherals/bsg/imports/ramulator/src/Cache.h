@@ -5,6 +5,7 @@
 #include "Request.h"
 #include "Statistics.h"
 #include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cassert>
 #include <functional>
@@ -12,7 +13,7 @@
 #include <map>
 #include <memory>
 #include <queue>
-#include <list>
+#include <vector>
 
 namespace ramulator
 {
@@ -44,6 +45,7 @@ public:
     long tag;
     bool lock; // When the lock is on, the value is not valid yet.
     bool dirty;
+    Line() {}
     Line(long addr, long tag):
         addr(addr), tag(tag), lock(true), dirty(false) {}
     Line(long addr, long tag, bool lock, bool dirty):
@@ -82,10 +84,29 @@ protected:
   unsigned int index_offset;
   unsigned int tag_offset;
   unsigned int mshr_entry_num;
-  std::vector<std::pair<long, std::list<Line>::iterator>> mshr_entries;
   std::list<Request> retry_list;
 
-  std::map<int, std::list<Line> > cache_lines;
+  // The lines of set s are lines[s * assoc, (s + 1) * assoc). Each set
+  // keeps its valid ways in recency order, least recently used first, as
+  // 4-bit way numbers packed into lru; this is the order in which victims
+  // are tried.
+  struct Set {
+    uint64_t lru = 0;
+    unsigned int count = 0; // number of valid ways
+    unsigned int used = 0;  // bitmask of valid ways
+  };
+  std::vector<Line> lines;
+  std::vector<Set> sets;
+
+  // MSHR entries, hashed by line address with linear probing
+  struct MSHR {
+    long addr;
+    size_t line;  // index into lines
+    bool valid = false;
+  };
+  std::vector<MSHR> mshr_table;
+  unsigned int mshr_bits;
+  unsigned int mshr_entries = 0;
 
   int calc_log2(int val) {
       int n = 0;
@@ -117,33 +138,30 @@ protected:
   // in higher level and this level.
   std::pair<long, bool> invalidate(long addr);
 
-  // Evict the victim from current set of lines.
+  // Evict the victim at recency position pos of set.
   // First do invalidation, then call evictline(L1 or L2) or send
   // a write request to memory(L3) when dirty bit is on.
-  void evict(std::list<Line>* lines,
-      std::list<Line>::iterator victim);
+  void evict(int set, unsigned int pos);
 
   // First test whether need eviction, if so, do eviction by
   // calling evict function. Then allocate a new line and return
-  // the iterator points to it.
-  std::list<Line>::iterator allocate_line(
-      std::list<Line>& lines, long addr);
+  // its index in lines, or -1 if no victim could be evicted.
+  long allocate_line(int set, long addr);
 
   // Check whether the set to hold addr has space or eviction is
   // needed.
-  bool need_eviction(const std::list<Line>& lines, long addr);
+  bool need_eviction(int set, long addr);
 
-  // Check whether this addr is hit and fill in the pos_ptr with
-  // the iterator to the hit line or lines.end()
-  bool is_hit(std::list<Line>& lines, long addr,
-              std::list<Line>::iterator* pos_ptr);
+  // Check whether this addr is hit and fill in pos_ptr with the
+  // recency position of the line, or -1
+  bool is_hit(int set, long addr, int* pos_ptr);
 
-  bool all_sets_locked(const std::list<Line>& lines) {
-    if (lines.size() < assoc) {
+  bool all_sets_locked(int set) {
+    if (sets[set].count < assoc) {
       return false;
     }
-    for (const auto& line : lines) {
-      if (!line.lock) {
+    for (unsigned int pos = 0; pos < sets[set].count; pos++) {
+      if (!line_at(set, pos).lock) {
         return false;
       }
     }
@@ -151,50 +169,58 @@ protected:
   }
 
   bool check_unlock(long addr) {
-    auto it = cache_lines.find(get_index(addr));
-    if (it == cache_lines.end()) {
+    int set = get_index(addr);
+    int pos = find_line(set, addr);
+    if (pos < 0) {
       return true;
     } else {
-      auto& lines = it->second;
-      auto line = find_if(lines.begin(), lines.end(),
-          [addr, this](Line l){return (l.tag == get_tag(addr));});
-      if (line == lines.end()) {
-        return true;
-      } else {
-        bool check = !line->lock;
-        if (!is_first_level) {
-          for (auto hc : higher_cache) {
-            if (!check) {
-              return check;
-            }
-            check = check && hc->check_unlock(line->addr);
+      Line& line = line_at(set, pos);
+      bool check = !line.lock;
+      if (!is_first_level) {
+        for (auto hc : higher_cache) {
+          if (!check) {
+            return check;
           }
+          check = check && hc->check_unlock(line.addr);
         }
-        return check;
       }
+      return check;
     }
   }
 
-  std::vector<std::pair<long, std::list<Line>::iterator>>::iterator
-  hit_mshr(long addr) {
-    auto mshr_it =
-        find_if(mshr_entries.begin(), mshr_entries.end(),
-            [addr, this](std::pair<long, std::list<Line>::iterator>
-                   mshr_entry) {
-              return (align(mshr_entry.first) == align(addr));
-            });
-    return mshr_it;
+  // Ways of a set by recency position, 0 being the LRU one
+  unsigned int way_at(int set, unsigned int pos) {
+    return (sets[set].lru >> (4 * pos)) & 0xf;
   }
 
-  std::list<Line>& get_lines(long addr) {
-    if (cache_lines.find(get_index(addr))
-        == cache_lines.end()) {
-      cache_lines.insert(make_pair(get_index(addr),
-          std::list<Line>()));
+  Line& line_at(int set, unsigned int pos) {
+    return lines[set * assoc + way_at(set, pos)];
+  }
+
+  // recency position of the line holding addr in set, or -1
+  int find_line(int set, long addr) {
+    long tag = get_tag(addr);
+    for (unsigned int pos = 0; pos < sets[set].count; pos++) {
+      if (line_at(set, pos).tag == tag) {
+        return pos;
+      }
     }
-    return cache_lines[get_index(addr)];
+    return -1;
+  }
+
+  // Make the line at pos the most recently used one
+  void touch_line(int set, unsigned int pos);
+  void remove_line(int set, unsigned int pos);
+  // Put a line in a free way as the most recently used one
+  size_t insert_line(int set, const Line& line);
+
+  size_t mshr_home(long addr) {
+    return (uint64_t(align(addr)) * 0x9e3779b97f4a7c15ULL) >> (64 - mshr_bits);
   }
 
+  MSHR* hit_mshr(long addr);
+  void add_mshr(long addr, size_t line);
+  void remove_mshr(MSHR* mshr);
 };
 
 class CacheSystem {
@@ -216,19 +242,61 @@ public:
       } else {
         last_level = Cache::Level::MAX; // no cache
       }
+
+      // a power of two longer than any hit latency
+      hit_list.resize(64);
     }
 
+  // FIFO of (time, request) pairs in a circular buffer that grows by
+  // doubling and otherwise never allocates.
+  class WaitRing {
+  public:
+    size_t size() const { return count; }
+    std::pair<long, Request>& operator[](size_t i) {
+      return buf[(head + i) & (buf.size() - 1)];
+    }
+    void push_back(const std::pair<long, Request>& entry) {
+      if (count == buf.size()) {
+        std::vector<std::pair<long, Request>> grown(std::max<size_t>(16, 2 * count));
+        for (size_t i = 0; i < count; i++) {
+          grown[i] = (*this)[i];
+        }
+        buf.swap(grown);
+        head = 0;
+      }
+      count++;
+      (*this)[count - 1] = entry;
+    }
+    void pop_front(size_t n) {
+      head = (head + n) & (buf.size() - 1);
+      count -= n;
+    }
+  private:
+    std::vector<std::pair<long, Request>> buf;
+    size_t head = 0;
+    size_t count = 0;
+  };
+
   // wait_list contains miss requests with their latencies in
   // cache. When this latency is met, the send_memory function
   // will be called to send the request to the memory system.
-  std::list<std::pair<long, Request> > wait_list;
+  // Requests are sent in order, up to the first one still waiting.
+  WaitRing wait_list;
 
   // hit_list contains hit requests with their latencies in cache.
   // callback function will be called when this latency is met and
   // set the instruction status to ready in processor's window.
-  std::list<std::pair<long, Request> > hit_list;
+  // Hits always complete within a few cycles, so the list is a wheel
+  // of per-cycle slots indexed by completion time.
+  std::vector<std::vector<Request>> hit_list;
+
+  void add_hit(long time, const Request& req) {
+    assert(time > clk && time - clk < long(hit_list.size()));
+    hit_list[time & (hit_list.size() - 1)].push_back(req);
+  }
 
   std::function<bool(Request)> send_memory;
+  std::vector<bool> wait_sent;
 
   long clk = 0;
   void tick();
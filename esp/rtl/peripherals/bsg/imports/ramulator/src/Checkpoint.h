@@ -0,0 +1,192 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+#include <deque>
+#include <iostream>
+#include <map>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Request.h"
+
+using namespace std;
+
+namespace ramulator
+{
+
+/* Binary checkpoint streams. Values are stored raw in host byte order and
+ * containers as a 64-bit length followed by their elements, so a checkpoint
+ * only restores into the same build with the same configuration. Errors
+ * are sticky: after the first failed read or write the others do nothing
+ * and ok() is false, so callers check once at the end. */
+class CheckpointOut
+{
+public:
+    explicit CheckpointOut(ostream& out) : out(out) {}
+    bool ok() const { return out.good(); }
+
+    template <typename V>
+    void put(const V& val)
+    {
+        static_assert(is_trivially_copyable<V>::value, "not a plain value");
+        out.write(reinterpret_cast<const char*>(&val), sizeof(V));
+    }
+
+    template <typename V1, typename V2>
+    void put(const pair<V1, V2>& val)
+    {
+        put(val.first);
+        put(val.second);
+    }
+
+    template <typename V>
+    void put(const vector<V>& vals) { put_all(vals); }
+
+    template <typename V>
+    void put(const deque<V>& vals) { put_all(vals); }
+
+    template <typename K, typename V>
+    void put(const map<K, V>& vals) { put_all(vals); }
+
+    void put(const AddrVec& addr_vec)
+    {
+        put(uint64_t(addr_vec.size()));
+        for (int val : addr_vec)
+            put(val);
+    }
+
+    // the callback is not saved, only whether there is one
+    void put(const Request& req)
+    {
+        put(req.is_first_command);
+        put(req.addr);
+        put(req.addr_vec);
+        put(req.coreid);
+        put(req.type);
+        put(req.arrive);
+        put(req.depart);
+        put(bool(req.callback));
+    }
+
+private:
+    template <typename C>
+    void put_all(const C& vals)
+    {
+        put(uint64_t(vals.size()));
+        for (auto& val : vals)
+            put(val);
+    }
+
+    ostream& out;
+};
+
+class CheckpointIn
+{
+public:
+    /* Restored requests that had a callback get this one: callbacks point
+     * into the process that saved them and cannot be stored. */
+    CheckpointIn(istream& in, RequestCallback callback = nullptr)
+        : in(in), callback(callback) {}
+    bool ok() const { return in.good(); }
+    void fail() { in.setstate(ios::failbit); }
+
+    template <typename V>
+    void get(V& val)
+    {
+        static_assert(is_trivially_copyable<V>::value, "not a plain value");
+        in.read(reinterpret_cast<char*>(&val), sizeof(V));
+    }
+
+    template <typename V1, typename V2>
+    void get(pair<V1, V2>& val)
+    {
+        get(val.first);
+        get(val.second);
+    }
+
+    // elements are appended one at a time, so a corrupt length runs into
+    // the end of the file rather than into a huge allocation
+    template <typename V>
+    void get(vector<V>& vals) { get_all(vals); }
+
+    template <typename V>
+    void get(deque<V>& vals) { get_all(vals); }
+
+    template <typename K, typename V>
+    void get(map<K, V>& vals)
+    {
+        uint64_t n = get_size();
+        vals.clear();
+        for (uint64_t i = 0; i < n && ok(); i++) {
+            pair<K, V> val;
+            get(val);
+            vals.insert(val);
+        }
+    }
+
+    void get(AddrVec& addr_vec)
+    {
+        uint64_t n = get_size();
+        if (n > uint64_t(AddrVec::MAX_LEVEL)) {
+            fail();
+            return;
+        }
+        addr_vec.resize(n);
+        for (int& val : addr_vec)
+            get(val);
+    }
+
+    void get(Request& req)
+    {
+        bool has_callback = false;
+        get(req.is_first_command);
+        get(req.addr);
+        get(req.addr_vec);
+        get(req.coreid);
+        get(req.type);
+        get(req.arrive);
+        get(req.depart);
+        get(has_callback);
+        req.callback = has_callback ? callback : nullptr;
+    }
+
+    // for containers whose size is given by the configuration
+    template <typename V>
+    void get_fixed(vector<V>& vals)
+    {
+        size_t n = vals.size();
+        get(vals);
+        if (vals.size() != n) {
+            fail();
+            vals.resize(n);
+        }
+    }
+
+private:
+    uint64_t get_size()
+    {
+        uint64_t n = 0;
+        get(n);
+        return ok() ? n : 0;
+    }
+
+    template <typename C>
+    void get_all(C& vals)
+    {
+        uint64_t n = get_size();
+        vals.clear();
+        for (uint64_t i = 0; i < n && ok(); i++) {
+            typename C::value_type val;
+            get(val);
+            vals.push_back(val);
+        }
+    }
+
+    istream& in;
+    RequestCallback callback;
+};
+
+} /*namespace ramulator*/
+
+#endif /*__CHECKPOINT_H*/
@@ -8,7 +8,7 @@ using namespace ramulator;
 namespace ramulator
 {
 
-static vector<int> get_offending_subarray(DRAM<SALP>* channel, vector<int> & addr_vec){
+static AddrVec get_offending_subarray(DRAM<SALP>* channel, const AddrVec& addr_vec){
     int sa_id = 0;
     auto rank = channel->children[addr_vec[int(SALP::Level::Rank)]];
     auto bank = rank->children[addr_vec[int(SALP::Level::Bank)]];
@@ -18,7 +18,7 @@ static vector<int> get_offending_subarray(DRAM<SALP>* channel, vector<int> & add
             sa_id = sa_other->id;
             break;
         }
-    vector<int> offending = addr_vec;
+    AddrVec offending = addr_vec;
     offending[int(SALP::Level::SubArray)] = sa_id;
     offending[int(SALP::Level::Row)] = -1;
     return offending;
@@ -26,7 +26,7 @@ static vector<int> get_offending_subarray(DRAM<SALP>* channel, vector<int> & add
 
 
 template <>
-vector<int> Controller<SALP>::get_addr_vec(SALP::Command cmd, list<Request>::iterator req){
+AddrVec Controller<SALP>::get_addr_vec(SALP::Command cmd, RequestList::iterator req){
     if (cmd == SALP::Command::PRE_OTHER)
         return get_offending_subarray(channel, req->addr_vec);
     else
@@ -35,11 +35,11 @@ vector<int> Controller<SALP>::get_addr_vec(SALP::Command cmd, list<Request>::ite
 
 
 template <>
-bool Controller<SALP>::is_ready(list<Request>::iterator req){
+bool Controller<SALP>::is_ready(RequestList::iterator req){
     SALP::Command cmd = get_first_cmd(req);
     if (cmd == SALP::Command::PRE_OTHER){
 
-        vector<int> addr_vec = get_offending_subarray(channel, req->addr_vec);
+        AddrVec addr_vec = get_offending_subarray(channel, req->addr_vec);
         return channel->check(cmd, addr_vec.data(), clk);
     }
     else return channel->check(cmd, req->addr_vec.data(), clk);
@@ -60,7 +60,7 @@ void Controller<TLDRAM>::tick(){
 
     /*** 1. Serve completed reads ***/
     if (pending.size()) {
-        Request& req = pending[0];
+        Request& req = pending.front();
         if (req.depart <= clk) {
           if (req.depart - req.arrive > 1) {
                   read_latency_sum += req.depart - req.arrive;
@@ -92,7 +92,7 @@ void Controller<TLDRAM>::tick(){
     if (otherq.size())
         queue = &otherq;  // "other" requests are rare, so we give them precedence over reads/writes
 
-    auto req = scheduler->get_head(queue->q);
+    auto req = scheduler->get_head(*queue);
     if (req == queue->q.end() || !is_ready(req)) {
         // we couldn't find a command to schedule -- let's try to be speculative
         auto cmd = TLDRAM::Command::PRE;
@@ -139,7 +139,7 @@ void Controller<TLDRAM>::tick(){
 
     /*** 5. Change a read request to a migration request ***/
     if (req->type == Request::Type::READ) {
-        req->type = Request::Type::EXTENSION;
+        queue->set_type(req, Request::Type::EXTENSION);
     }
 
     // issue command on behalf of request
@@ -150,22 +150,23 @@ void Controller<TLDRAM>::tick(){
     if (cmd != channel->spec->translate[int(req->type)])
         return;
 
+    if (req->type == Request::Type::WRITE) {
+        channel->update_serving_requests(req->addr_vec.data(), -1, clk);
+    }
     // set a future completion time for read requests
     if (req->type == Request::Type::READ || req->type == Request::Type::EXTENSION) {
         req->depart = clk + channel->spec->read_latency;
-        pending.push_back(*req);
-    }
-    if (req->type == Request::Type::WRITE) {
-        channel->update_serving_requests(req->addr_vec.data(), -1, clk);
+        queue->move(req, pending);
+        return;
     }
 
     // remove request from queue
-    queue->q.erase(req);
+    queue->erase(req);
 }
 
 template<>
 void Controller<TLDRAM>::cmd_issue_autoprecharge(typename TLDRAM::Command& cmd,
-                                                    const vector<int>& addr_vec) {
+                                                    const AddrVec& addr_vec) {
     //TLDRAM currently does not have autoprecharge commands
     return;
 }
@@ -3,12 +3,11 @@
 
 #include <cassert>
 #include <cstdio>
-#include <deque>
 #include <fstream>
-#include <list>
 #include <string>
 #include <vector>
 
+#include "Checkpoint.h"
 #include "Config.h"
 #include "DRAM.h"
 #include "Refresh.h"
@@ -30,6 +29,9 @@ namespace ramulator
 template <typename T>
 class Controller
 {
+    static_assert(int(T::Level::MAX) <= AddrVec::MAX_LEVEL,
+                  "AddrVec::MAX_LEVEL is too small for this standard");
+
 protected:
     // For counting bandwidth
     ScalarStat read_transaction_bytes;
@@ -75,10 +77,165 @@ public:
     RowTable<T>* rowtable;  // tracks metadata about rows (e.g., which are open and for how long)
     Refresh<T>* refresh;
 
+    /* Requests of the same type whose addresses match down to the row
+     * decode to the same next command, and that command becomes ready at
+     * the same time for all of them. A queue therefore groups its requests
+     * by row, and the scheduler only has to compare the oldest request of
+     * each row. The scheduling state of a row is cached until the next
+     * command issues on the channel. */
+    struct RowBucket {
+        Request::Type type;
+        AddrVec row;  // address down to the row level
+        // (position in the queue, request), ordered by arrival then position
+        vector<pair<unsigned long, RequestList::iterator>> reqs;
+
+        // state of the oldest request, valid while stamp == issued_cmds
+        long stamp = -1;
+        typename T::Command cmd;  // first command to issue
+        long ready_clk;  // earliest clk at which cmd can issue
+        int row_hits;  // hits to the row since it was opened
+
+        RequestList::iterator head() const { return reqs.front().second; }
+        unsigned long pos() const { return reqs.front().first; }
+    };
+
     struct Queue {
-        list<Request> q;
+        RequestList q;
         unsigned int max = 32;
         unsigned int size() {return q.size();}
+
+        // rows[0, nrows) group the requests in q; the buckets past nrows
+        // are empty and kept so that their storage is reused
+        vector<RowBucket> rows;
+        size_t nrows = 0;
+        unsigned long pos = 0;  // position of the next request in q
+
+        void push_back(const Request& req)
+        {
+            q.push_back(req);
+            index(--q.end(), pos++);
+        }
+
+        void erase(RequestList::iterator req)
+        {
+            unindex(req);
+            q.erase(req);
+        }
+
+        // move req to the end of another queue
+        void move(RequestList::iterator req, Queue& dst)
+        {
+            unindex(req);
+            dst.q.splice(dst.q.end(), q, req);
+            dst.index(req, dst.pos++);
+        }
+
+        void move(RequestList::iterator req, RequestList& dst)
+        {
+            unindex(req);
+            dst.splice(dst.end(), q, req);
+        }
+
+        void set_type(RequestList::iterator req, Request::Type type)
+        {
+            unsigned long req_pos = unindex(req);
+            req->type = type;
+            index(req, req_pos);
+        }
+
+        // checkpoint of the requests in queue order, with their positions
+        void save(CheckpointOut& out)
+        {
+            out.put(pos);
+            out.put(uint64_t(q.size()));
+            for (auto req = q.begin(); req != q.end(); ++req) {
+                out.put(position(req));
+                out.put(*req);
+            }
+        }
+
+        void load(CheckpointIn& in)
+        {
+            uint64_t n = 0;
+            while (!q.empty())
+                erase(q.begin());
+            in.get(pos);
+            in.get(n);
+            if (n > max) {
+                in.fail();
+                return;
+            }
+            for (uint64_t i = 0; i < n; i++) {
+                unsigned long req_pos = 0;
+                Request req;
+                in.get(req_pos);
+                in.get(req);
+                if (!in.ok())
+                    return;
+                q.push_back(req);
+                index(--q.end(), req_pos);
+            }
+        }
+
+    private:
+        unsigned long position(RequestList::iterator req)
+        {
+            auto& reqs = rows[find_row(*req)].reqs;
+            auto at = reqs.begin();
+            while (at->second != req)
+                ++at;
+            return at->first;
+        }
+
+        size_t find_row(const Request& req)
+        {
+            for (size_t i = 0; i < nrows; i++)
+                if (rows[i].type == req.type &&
+                        equal(rows[i].row.begin(), rows[i].row.end(), req.addr_vec.begin()))
+                    return i;
+            return nrows;
+        }
+
+        void index(RequestList::iterator req, unsigned long req_pos)
+        {
+            size_t i = find_row(*req);
+            if (i == nrows) {
+                if (nrows == rows.size())
+                    rows.emplace_back();
+                RowBucket& bucket = rows[nrows++];
+                bucket.type = req->type;
+                bucket.row.resize(0);
+                for (int lev = 0; lev <= int(T::Level::Row); lev++)
+                    bucket.row.push_back(req->addr_vec[lev]);
+                bucket.stamp = -1;
+            }
+            auto& reqs = rows[i].reqs;
+            auto at = reqs.end();
+            while (at != reqs.begin() && (at - 1)->second->arrive > req->arrive)
+                --at;
+            while (at != reqs.begin() && (at - 1)->second->arrive == req->arrive
+                    && (at - 1)->first > req_pos)
+                --at;
+            reqs.insert(at, {req_pos, req});
+        }
+
+        unsigned long unindex(RequestList::iterator req)
+        {
+            size_t i = find_row(*req);
+            assert(i < nrows);
+            auto& reqs = rows[i].reqs;
+            auto at = reqs.begin();
+            while (at->second != req)
+                ++at;
+            unsigned long req_pos = at->first;
+            reqs.erase(at);
+            if (reqs.empty()) {
+                nrows--;
+                if (i != nrows)
+                    swap(rows[i], rows[nrows]);
+            }
+            return req_pos;
+        }
     };
 
     Queue readq;  // queue for read requests
@@ -90,7 +247,8 @@ public:
                    // after ACTIVATE w/o READ of WRITE command)
     Queue otherq;  // queue for all "other" requests (e.g., refresh)
 
-    deque<Request> pending;  // read requests that are about to receive data from DRAM
+    RequestList pending;  // read requests that are about to receive data from DRAM
+    long issued_cmds = 0;  // number of commands issued, see RowBucket
     bool write_mode = false;  // whether write requests should be prioritized over reads
     float wr_high_watermark = 0.8f; // threshold for switching to write mode
     float wr_low_watermark = 0.2f; // threshold for switching back to read mode
@@ -291,6 +449,48 @@ public:
         cmd_trace_files.clear();
     }
 
+    /* Checkpoint of the controller: its queues, refresh schedule, row table
+     * and the state of the whole channel. Statistics are saved separately
+     * (see Stats::save_stats) and the command traces not at all. */
+    void save(CheckpointOut& out)
+    {
+        out.put(clk);
+        out.put(issued_cmds);
+        out.put(write_mode);
+        readq.save(out);
+        writeq.save(out);
+        actq.save(out);
+        otherq.save(out);
+        out.put(uint64_t(pending.size()));
+        for (auto& req : pending)
+            out.put(req);
+        refresh->save(out);
+        out.put(rowtable->table);
+        channel->save(out);
+    }
+
+    void load(CheckpointIn& in)
+    {
+        uint64_t npending = 0;
+        in.get(clk);
+        in.get(issued_cmds);
+        in.get(write_mode);
+        readq.load(in);
+        writeq.load(in);
+        actq.load(in);
+        otherq.load(in);
+        in.get(npending);
+        pending.clear();
+        for (uint64_t i = 0; i < npending && in.ok(); i++) {
+            Request req;
+            in.get(req);
+            pending.push_back(req);
+        }
+        refresh->load(in);
+        in.get(rowtable->table);
+        channel->load(in);
+    }
+
     void finish(long read_req, long dram_cycles) {
       read_latency_avg = read_latency_sum.value() / read_req;
       req_queue_length_avg = req_queue_length_sum.value() / dram_cycles;
@@ -317,14 +517,13 @@ public:
             return false;
 
         req.arrive = clk;
-        queue.q.push_back(req);
+        queue.push_back(req);
         // shortcut for read requests, if a write to same addr exists
         // necessary for coherence
         if (req.type == Request::Type::READ && find_if(writeq.q.begin(), writeq.q.end(),
-                [req](Request& wreq){ return req.addr == wreq.addr;}) != writeq.q.end()){
-            req.depart = clk + 1;
-            pending.push_back(req);
-            readq.q.pop_back();
+                [&req](Request& wreq){ return req.addr == wreq.addr;}) != writeq.q.end()){
+            readq.q.back().depart = clk + 1;
+            readq.move(--readq.q.end(), pending);
         }
         return true;
     }
@@ -338,7 +537,7 @@ public:
 
         /*** 1. Serve completed reads ***/
         if (pending.size()) {
-            Request& req = pending[0];
+            Request& req = pending.front();
             if (req.depart <= clk) {
                 if (req.depart - req.arrive > 1) { // this request really accessed a row
                   read_latency_sum += req.depart - req.arrive;
@@ -371,14 +570,14 @@ public:
         // are requests available to service in this cycle
         Queue* queue = &actq;
 
-        auto req = scheduler->get_head(queue->q);
+        auto req = scheduler->get_head(*queue);
         if ((req == queue->q.end() || !is_ready(req)) && actq.size()==0 ) {
             queue = !write_mode ? &readq : &writeq;
 
             if (otherq.size())
                 queue = &otherq;  // "other" requests are rare, so we give them precedence over reads/writes
 
-            req = scheduler->get_head(queue->q);
+            req = scheduler->get_head(*queue);
         }
 
         if (req == queue->q.end() || !is_ready(req)) {
@@ -434,59 +633,70 @@ public:
         if (!(channel->spec->is_accessing(cmd) || channel->spec->is_refreshing(cmd))) {
             if(channel->spec->is_opening(cmd)) {
                 // promote the request that caused issuing activation to actq
-                actq.q.push_back(*req);
-                queue->q.erase(req);
+                queue->move(req, actq);
             }
 
             return;
         }
 
-        // set a future completion time for read requests
-        if (req->type == Request::Type::READ) {
-            req->depart = clk + channel->spec->read_latency;
-            pending.push_back(*req);
-        }
-
         if (req->type == Request::Type::WRITE) {
             channel->update_serving_requests(req->addr_vec.data(), -1, clk);
             req->callback(*req);
         }
 
+        // set a future completion time for read requests, otherwise
         // remove request from queue
-        queue->q.erase(req);
+        if (req->type == Request::Type::READ) {
+            req->depart = clk + channel->spec->read_latency;
+            queue->move(req, pending);
+        } else {
+            queue->erase(req);
+        }
     }
 
-    bool is_ready(list<Request>::iterator req)
+    bool is_ready(RequestList::iterator req)
     {
         typename T::Command cmd = get_first_cmd(req);
         return channel->check(cmd, req->addr_vec.data(), clk);
     }
 
-    bool is_ready(typename T::Command cmd, const vector<int>& addr_vec)
+    bool is_ready(typename T::Command cmd, const AddrVec& addr_vec)
     {
         return channel->check(cmd, addr_vec.data(), clk);
     }
 
-    bool is_row_hit(list<Request>::iterator req)
+    bool is_ready(RowBucket& row)
+    {
+        update_row(row);
+        return row.ready_clk <= clk;
+    }
+
+    int get_hits(RowBucket& row)
+    {
+        update_row(row);
+        return row.row_hits;
+    }
+
+    bool is_row_hit(RequestList::iterator req)
     {
         // cmd must be decided by the request type, not the first cmd
         typename T::Command cmd = channel->spec->translate[int(req->type)];
         return channel->check_row_hit(cmd, req->addr_vec.data());
     }
 
-    bool is_row_hit(typename T::Command cmd, const vector<int>& addr_vec)
+    bool is_row_hit(typename T::Command cmd, const AddrVec& addr_vec)
     {
         return channel->check_row_hit(cmd, addr_vec.data());
     }
 
-    bool is_row_open(list<Request>::iterator req)
+    bool is_row_open(RequestList::iterator req)
     {
         // cmd must be decided by the request type, not the first cmd
         typename T::Command cmd = channel->spec->translate[int(req->type)];
         return channel->check_row_open(cmd, req->addr_vec.data());
     }
 
-    bool is_row_open(typename T::Command cmd, const vector<int>& addr_vec)
+    bool is_row_open(typename T::Command cmd, const AddrVec& addr_vec)
     {
         return channel->check_row_open(cmd, addr_vec.data());
     }
@@ -525,7 +735,19 @@ public:
     }
 
 private:
-    typename T::Command get_first_cmd(list<Request>::iterator req)
+    void update_row(RowBucket& row)
+    {
+        if (row.stamp == issued_cmds)
+            return;
+        auto req = row.head();
+        row.cmd = get_first_cmd(req);
+        // same outcome as is_ready(req), as long as no command issues
+        row.ready_clk = channel->get_next(row.cmd, get_addr_vec(row.cmd, req).data());
+        row.row_hits = rowtable->get_hits(req->addr_vec);
+        row.stamp = issued_cmds;
+    }
+
+    typename T::Command get_first_cmd(RequestList::iterator req)
     {
         typename T::Command cmd = channel->spec->translate[int(req->type)];
         return channel->decode(cmd, req->addr_vec.data());
@@ -533,7 +755,7 @@ private:
 
     // upgrade to an autoprecharge command
     void cmd_issue_autoprecharge(typename T::Command& cmd,
-                                            const vector<int>& addr_vec) {
+                                            const AddrVec& addr_vec) {
 
         // currently, autoprecharge is only used with closed row policy
         if(channel->spec->is_accessing(cmd) && rowpolicy->type == RowPolicy<T>::Type::ClosedAP) {
@@ -581,11 +803,12 @@ private:
 
     }
 
-    void issue_cmd(typename T::Command cmd, const vector<int>& addr_vec)
+    void issue_cmd(typename T::Command cmd, const AddrVec& addr_vec)
     {
         cmd_issue_autoprecharge(cmd, addr_vec);
         assert(is_ready(cmd, addr_vec));
         channel->update(cmd, addr_vec.data(), clk);
+        issued_cmds++;
 
         if(cmd == T::Command::PRE){
             if(rowtable->get_hits(addr_vec, true) == 0){
@@ -616,17 +839,17 @@ private:
             printf("\n");
         }
     }
-    vector<int> get_addr_vec(typename T::Command cmd, list<Request>::iterator req){
+    AddrVec get_addr_vec(typename T::Command cmd, RequestList::iterator req){
         return req->addr_vec;
     }
 };
 
 template <>
-vector<int> Controller<SALP>::get_addr_vec(
-    SALP::Command cmd, list<Request>::iterator req);
+AddrVec Controller<SALP>::get_addr_vec(
+    SALP::Command cmd, RequestList::iterator req);
 
 template <>
-bool Controller<SALP>::is_ready(list<Request>::iterator req);
+bool Controller<SALP>::is_ready(RequestList::iterator req);
 
 template <>
 void Controller<ALDRAM>::update_temp(ALDRAM::Temp current_temperature);
@@ -636,7 +859,7 @@ void Controller<TLDRAM>::tick();
 
 template <>
 void Controller<TLDRAM>::cmd_issue_autoprecharge(typename TLDRAM::Command& cmd,
-                                                    const vector<int>& addr_vec);
+                                                    const AddrVec& addr_vec);
 
 } /*namespace ramulator*/
 
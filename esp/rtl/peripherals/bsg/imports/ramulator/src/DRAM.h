@@ -1,6 +1,7 @@
 #ifndef __DRAM_H
 #define __DRAM_H
 
+#include "Checkpoint.h"
 #include "Statistics.h"
 #include <iostream>
 #include <vector>
@@ -89,6 +90,10 @@ public:
 
     void finish(long dram_cycles);
 
+    // Checkpoint of the state and timing of this node and all below it
+    void save(CheckpointOut& out) const;
+    void load(CheckpointIn& in);
+
 private:
     // Constructor
     DRAM(){}
@@ -185,6 +190,53 @@ void DRAM<T>::finish(long dram_cycles) {
   }
 }
 
+template <typename T>
+void DRAM<T>::save(CheckpointOut& out) const {
+  out.put(state);
+  out.put(row_state);
+  out.put(cur_serving_requests);
+  out.put(begin_of_serving);
+  out.put(end_of_serving);
+  out.put(begin_of_cur_reqcnt);
+  out.put(begin_of_refreshing);
+  out.put(end_of_refreshing);
+  out.put(refresh_intervals);
+  out.put(cur_clk);
+  out.put(next);
+  for (auto& cmd_prev : prev)
+    out.put(cmd_prev);
+
+  out.put(uint64_t(children.size()));
+  for (auto child : children)
+    child->save(out);
+}
+
+template <typename T>
+void DRAM<T>::load(CheckpointIn& in) {
+  in.get(state);
+  in.get(row_state);
+  in.get(cur_serving_requests);
+  in.get(begin_of_serving);
+  in.get(end_of_serving);
+  in.get(begin_of_cur_reqcnt);
+  in.get(begin_of_refreshing);
+  in.get(end_of_refreshing);
+  in.get(refresh_intervals);
+  in.get(cur_clk);
+  in.get(next);
+  for (auto& cmd_prev : prev)
+    in.get(cmd_prev);
+
+  uint64_t nchildren = 0;
+  in.get(nchildren);
+  if (nchildren != children.size()) {
+    in.fail();
+    return;
+  }
+  for (auto child : children)
+    child->load(in);
+}
+
 // Constructor
 template <typename T>
 DRAM<T>::DRAM(T* spec, typename T::Level level) :
@@ -1,6 +1,7 @@
 #ifndef __MEMORY_H
 #define __MEMORY_H
 
+#include "Checkpoint.h"
 #include "Config.h"
 #include "DRAM.h"
 #include "Request.h"
@@ -17,7 +18,9 @@
 #include <functional>
 #include <cmath>
 #include <cassert>
+#include <cstdint>
 #include <tuple>
+#include <unordered_map>
 
 using namespace std;
 
@@ -91,9 +94,18 @@ public:
       {"Random", Translation::Random},
     };
 
-    vector<int> free_physical_pages;
+    struct PageHash {
+        size_t operator()(const pair<int, long>& page) const {
+            return hash<long>()(page.second ^ (long(page.first) << 48));
+        }
+    };
+
+    // one bit per physical page, set once the page is assigned
+    vector<uint64_t> used_physical_pages;
+    long physical_pages;
     long free_physical_pages_remaining;
-    map<pair<int, long>, long> page_translation;
+    // (coreid, virtual page) -> physical page
+    unordered_map<pair<int, long>, long, PageHash> page_translation;
 
     vector<Controller<T>*> ctrls;
     T * spec;
@@ -104,6 +116,22 @@ public:
     
     int tx_bits;
 
+    static uint64_t checkpoint_magic()
+    {
+        return 0x3154504b434d4152;  // "RAMCKPT1"
+    }
+
+    // the configuration that decides the layout of a checkpoint
+    vector<int> checkpoint_shape()
+    {
+        vector<int> shape(addr_bits);
+        shape.push_back(ctrls.size());
+        shape.push_back(tx_bits);
+        shape.push_back(int(type));
+        shape.push_back(int(translation));
+        return shape;
+    }
+
     Memory(const Config& configs, vector<Controller<T>*> ctrls)
         : ctrls(ctrls),
           spec(ctrls[0]->channel->spec),
@@ -150,9 +178,10 @@ public:
         if (translation != Translation::None) {
           // construct a list of available pages
           // TODO: this should not assume a 4KB page!
-          free_physical_pages_remaining = max_address >> 12;
+          physical_pages = max_address >> 12;
+          free_physical_pages_remaining = physical_pages;
 
-          free_physical_pages.resize(free_physical_pages_remaining, -1);
+          used_physical_pages.resize((physical_pages + 63) / 64, 0);
         }
 
         dram_capacity
@@ -452,7 +481,7 @@ public:
         }
     }
     
-    void apply_mapping(long addr, std::vector<int>& addr_vec){
+    void apply_mapping(long addr, AddrVec& addr_vec){
         int *sz = spec->org_entry.count;
         int addr_total_bits = sizeof(addr_vec)*8;
         int addr_bits [int(T::Level::MAX)];
@@ -520,6 +549,59 @@ public:
       in_queue_write_req_num_avg = in_queue_write_req_num_sum.value() / dram_cycles;
     }
 
+    /* Checkpoint of the memory between two ticks: banks, rows, timing and
+     * refresh state of every channel, the queued and in-flight requests,
+     * the page table and all statistics. It only restores into a memory
+     * built from the same configuration, and a failed load leaves the
+     * memory in an unspecified state. Callbacks cannot be saved, so the
+     * restored requests that had one get the callback passed to load().
+     * Random translation also draws from rand(), whose state is not part
+     * of the checkpoint. */
+    bool save(ostream& file)
+    {
+        CheckpointOut out(file);
+        out.put(checkpoint_magic());
+        out.put(checkpoint_shape());
+        out.put(used_physical_pages);
+        out.put(free_physical_pages_remaining);
+        out.put(uint64_t(page_translation.size()));
+        for (auto& page : page_translation)
+            out.put(page);
+        for (auto ctrl : ctrls)
+            ctrl->save(out);
+#ifndef INTEGRATED_WITH_GEM5
+        Stats::save_stats(out);
+#endif
+        return out.ok();
+    }
+
+    bool load(istream& file, RequestCallback callback)
+    {
+        CheckpointIn in(file, callback);
+        uint64_t magic = 0, npages = 0;
+        vector<int> shape;
+        in.get(magic);
+        in.get(shape);
+        if (!in.ok() || magic != checkpoint_magic() || shape != checkpoint_shape())
+            return false;
+
+        in.get_fixed(used_physical_pages);
+        in.get(free_physical_pages_remaining);
+        in.get(npages);
+        page_translation.clear();
+        for (uint64_t i = 0; i < npages && in.ok(); i++) {
+            pair<pair<int, long>, long> page;
+            in.get(page);
+            page_translation.insert(page);
+        }
+        for (auto ctrl : ctrls)
+            ctrl->load(in);
+#ifndef INTEGRATED_WITH_GEM5
+        Stats::load_stats(in);
+#endif
+        return in.ok();
+    }
+
     long page_allocator(long addr, int coreid) {
         long virtual_page_number = addr >> 12;
 
@@ -529,7 +611,8 @@ public:
             }
             case int(Translation::Random): {
                 auto target = make_pair(coreid, virtual_page_number);
-                if(page_translation.find(target) == page_translation.end()) {
+                auto match = page_translation.find(target);
+                if(match == page_translation.end()) {
                     // page doesn't exist, so assign a new page
                     // make sure there are physical pages left to be assigned
 
@@ -537,35 +620,28 @@ public:
                     // physical page.
                     if (!free_physical_pages_remaining) {
                       physical_page_replacement++;
-                      long phys_page_to_read = lrand() % free_physical_pages.size();
-                      assert(free_physical_pages[phys_page_to_read] != -1);
-                      page_translation[target] = phys_page_to_read;
+                      long phys_page_to_read = lrand() % physical_pages;
+                      assert(is_page_used(phys_page_to_read));
+                      match = page_translation.emplace(target, phys_page_to_read).first;
                     } else {
                         // assign a new page
-                        long phys_page_to_read = lrand() % free_physical_pages.size();
-                        // if the randomly-selected page was already assigned
-                        if(free_physical_pages[phys_page_to_read] != -1) {
-                            long starting_page_of_search = phys_page_to_read;
-
-                            do {
-                                // iterate through the list until we find a free page
-                                // TODO: does this introduce serious non-randomness?
-                                ++phys_page_to_read;
-                                phys_page_to_read %= free_physical_pages.size();
-                            }
-                            while((phys_page_to_read != starting_page_of_search) && free_physical_pages[phys_page_to_read] != -1);
-                        }
+                        long phys_page_to_read = lrand() % physical_pages;
+                        // if the randomly-selected page was already assigned,
+                        // take the next free one
+                        // TODO: does this introduce serious non-randomness?
+                        if(is_page_used(phys_page_to_read))
+                            phys_page_to_read = next_free_page(phys_page_to_read);
 
-                        assert(free_physical_pages[phys_page_to_read] == -1);
+                        assert(!is_page_used(phys_page_to_read));
 
-                        page_translation[target] = phys_page_to_read;
-                        free_physical_pages[phys_page_to_read] = coreid;
+                        match = page_translation.emplace(target, phys_page_to_read).first;
+                        used_physical_pages[phys_page_to_read / 64] |= 1ULL << (phys_page_to_read % 64);
                         --free_physical_pages_remaining;
                     }
                 }
 
                 // SAUGATA TODO: page size should not always be fixed to 4KB
-                return (page_translation[target] << 12) | (addr & ((1 << 12) - 1));
+                return (match->second << 12) | (addr & ((1 << 12) - 1));
             }
             default:
                 assert(false);
@@ -595,6 +671,31 @@ private:
     {
         addr >>= bits;
     }
+    bool is_page_used(long page)
+    {
+        return (used_physical_pages[page / 64] >> (page % 64)) & 1;
+    }
+
+    // first free physical page after page, wrapping around
+    long next_free_page(long page)
+    {
+        long words = used_physical_pages.size();
+        long word = page / 64;
+        // skip the pages up to and including page in its word
+        uint64_t used = used_physical_pages[word] | (~0ULL >> (63 - page % 64));
+        for (long i = 0; i <= words; i++) {
+            if (~used) {
+                long next = (word * 64) + __builtin_ctzll(~used);
+                if (next < physical_pages)
+                    return next;
+            }
+            word = (word + 1) % words;
+            used = used_physical_pages[word];
+        }
+        assert(false && "no free physical page");
+        return -1;
+    }
+
     long lrand(void) {
         if(sizeof(int) < sizeof(long)) {
             return static_cast<long>(rand()) << (sizeof(int) * 8) | rand();
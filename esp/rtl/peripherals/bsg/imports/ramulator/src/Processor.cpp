@@ -1,5 +1,11 @@
 #include "Processor.h"
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace ramulator;
@@ -305,7 +311,8 @@ long Core::get_insts() {
 void Core::receive(Request& req)
 {
     window.set_ready(req.addr, ~(l1_blocksz - 1l));
-    if (req.arrive != -1 && req.depart > last) {
+    // writes complete without a depart time
+    if (req.type == Request::Type::READ && req.arrive != -1 && req.depart > last) {
       memory_access_cycles += (req.depart - max(last, req.arrive));
       last = req.depart;
     }
@@ -374,34 +381,112 @@ void Window::set_ready(long addr, int mask)
 
 
 
-Trace::Trace(const char* trace_fname) : file(trace_fname), trace_name(trace_fname)
+static const char trace_magic[8] = {'R', 'A', 'M', 'T', 'R', 'A', 'C', 'E'};
+
+Trace::Trace(const char* trace_fname) : trace_name(trace_fname)
 {
-    if (!file.good()) {
+    int fd = open(trace_fname, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
         std::cerr << "Bad trace file: " << trace_fname << std::endl;
         exit(1);
     }
+    size = st.st_size;
+    if (size) {
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            std::cerr << "Bad trace file: " << trace_fname << std::endl;
+            exit(1);
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(map);
+    }
+    close(fd);
+
+    binary = size >= sizeof(trace_magic) && !memcmp(data, trace_magic, sizeof(trace_magic));
+    rewind();
+}
+
+Trace::~Trace()
+{
+    if (data)
+        munmap(const_cast<char*>(data), size);
+}
+
+void Trace::rewind()
+{
+    pos = binary ? sizeof(trace_magic) : 0;
+}
+
+// a line only counts if it is terminated by a newline, as with getline()
+bool Trace::get_line(const char*& line, const char*& end)
+{
+    if (pos >= size)
+        return false;
+    line = data + pos;
+    end = static_cast<const char*>(memchr(line, '\n', size - pos));
+    if (!end)
+        return false;
+    pos = end - data + 1;
+    return true;
+}
+
+bool Trace::get_record(Record& record)
+{
+    if (size - pos < sizeof(Record))
+        return false;
+    memcpy(&record, data + pos, sizeof(Record));
+    pos += sizeof(Record);
+    return true;
+}
+
+// like string::find_first_not_of(' ', pos), with end standing for npos
+static const char* skip_spaces(const char* p, const char* end)
+{
+    while (p < end && *p == ' ')
+        p++;
+    return min(p, end);
+}
+
+static long parse_num(const char*& p, const char* end, int base)
+{
+    assert(p < end);
+    char* num_end;
+    long num = strtoul(p, &num_end, base);
+    p = num_end;
+    return num;
 }
 
 bool Trace::get_unfiltered_request(long& bubble_cnt, long& req_addr, Request::Type& req_type)
 {
-    string line;
-    getline(file, line);
-    if (file.eof()) {
-      file.clear();
-      file.seekg(0, file.beg);
-      getline(file, line);
+    if (binary) {
+        Record record;
+        if (!get_record(record)) {
+          rewind();
+          get_record(record);
+          //return false;
+        }
+        bubble_cnt = record.bubble_cnt;
+        req_addr = record.addr;
+        req_type = record.type ? Request::Type::WRITE : Request::Type::READ;
+        return true;
+    }
+
+    const char *p, *end;
+    if (!get_line(p, end)) {
+      rewind();
+      get_line(p, end);
       //return false;
     }
-    size_t pos, end;
-    bubble_cnt = std::stoul(line, &pos, 10);
-    pos = line.find_first_not_of(' ', pos+1);
-    req_addr = std::stoul(line.substr(pos), &end, 0);
+    bubble_cnt = parse_num(p, end, 10);
+    p = skip_spaces(p + 1, end);
+    req_addr = parse_num(p, end, 0);
 
-    pos = line.find_first_not_of(' ', pos+end);
+    p = skip_spaces(p, end);
 
-    if (pos == string::npos || line.substr(pos)[0] == 'R')
+    if (p == end || *p == 'R')
         req_type = Request::Type::READ;
-    else if (line.substr(pos)[0] == 'W')
+    else if (*p == 'W')
         req_type = Request::Type::WRITE;
     else assert(false);
     return true;
@@ -409,9 +494,21 @@ bool Trace::get_unfiltered_request(long& bubble_cnt, long& req_addr, Request::Ty
 
 bool Trace::get_filtered_request(long& bubble_cnt, long& req_addr, Request::Type& req_type)
 {
-    static bool has_write = false;
-    static long write_addr;
-    static int line_num = 0;
+    if (binary) {
+        Record record;
+        if (!get_record(record)) {
+            rewind();
+            if (expected_limit_insts == 0)
+                return false;
+            // starting over the input trace file
+            get_record(record);
+        }
+        bubble_cnt = record.bubble_cnt;
+        req_addr = record.addr;
+        req_type = record.type ? Request::Type::WRITE : Request::Type::READ;
+        return true;
+    }
+
     if (has_write){
         bubble_cnt = 0;
         req_addr = write_addr;
@@ -419,54 +516,55 @@ bool Trace::get_filtered_request(long& bubble_cnt, long& req_addr, Request::Type
         has_write = false;
         return true;
     }
-    string line;
-    getline(file, line);
-    line_num ++;
-    if (file.eof() || line.size() == 0) {
-        file.clear();
-        file.seekg(0, file.beg);
-        line_num = 0;
+    const char *p, *end;
+    if (!get_line(p, end) || p == end) {
+        rewind();
 
         if(expected_limit_insts == 0) {
             has_write = false;
             return false;
         }
         else { // starting over the input trace file
-            getline(file, line);
-            line_num++;
+            get_line(p, end);
         }
     }
 
-    size_t pos, end;
-    bubble_cnt = std::stoul(line, &pos, 10);
+    bubble_cnt = parse_num(p, end, 10);
 
-    pos = line.find_first_not_of(' ', pos+1);
-    req_addr = stoul(line.substr(pos), &end, 0);
+    p = skip_spaces(p + 1, end);
+    req_addr = parse_num(p, end, 0);
     req_type = Request::Type::READ;
 
-    pos = line.find_first_not_of(' ', pos+end);
-    if (pos != string::npos){
+    p = skip_spaces(p, end);
+    if (p != end){
         has_write = true;
-        write_addr = stoul(line.substr(pos), NULL, 0);
+        write_addr = parse_num(p, end, 0);
     }
     return true;
 }
 
 bool Trace::get_dramtrace_request(long& req_addr, Request::Type& req_type)
 {
-    string line;
-    getline(file, line);
-    if (file.eof()) {
+    if (binary) {
+        Record record;
+        if (!get_record(record))
+            return false;
+        req_addr = record.addr;
+        req_type = record.type ? Request::Type::WRITE : Request::Type::READ;
+        return true;
+    }
+
+    const char *p, *end;
+    if (!get_line(p, end)) {
         return false;
     }
-    size_t pos;
-    req_addr = std::stoul(line, &pos, 16);
+    req_addr = parse_num(p, end, 16);
 
-    pos = line.find_first_not_of(' ', pos+1);
+    p = skip_spaces(p + 1, end);
 
-    if (pos == string::npos || line.substr(pos)[0] == 'R')
+    if (p == end || *p == 'R')
         req_type = Request::Type::READ;
-    else if (line.substr(pos)[0] == 'W')
+    else if (*p == 'W')
         req_type = Request::Type::WRITE;
     else assert(false);
     return true;
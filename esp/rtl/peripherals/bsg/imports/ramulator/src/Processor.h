@@ -11,6 +11,7 @@
 #include <fstream>
 #include <string>
 #include <ctype.h>
+#include <cstdint>
 #include <functional>
 
 namespace ramulator 
@@ -19,6 +20,9 @@ namespace ramulator
 class Trace {
 public:
     Trace(const char* trace_fname);
+    ~Trace();
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
     // trace file format 1:
     // [# of bubbles(non-mem instructions)] [read address(dec or hex)] <optional: write address(evicted cacheline)>
     bool get_unfiltered_request(long& bubble_cnt, long& req_addr, Request::Type& req_type);
@@ -26,11 +30,31 @@ public:
     // trace file format 2:
     // [address(hex)] [R/W]
     bool get_dramtrace_request(long& req_addr, Request::Type& req_type);
+    // binary format, accepted by all of the above:
+    // "RAMTRACE" followed by one little-endian Record per request; a
+    // writeback is a WRITE record with no bubbles after its read
+    // (see trace2bin.py)
+    struct Record {
+        uint64_t addr;
+        uint32_t bubble_cnt;
+        uint32_t type;  // 0: read, 1: write
+    };
 
     long expected_limit_insts = 0;
 
 private:
-    std::ifstream file;
+    // the trace file is mapped, and lines or records are parsed in place
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+    bool binary = false;
+    // writeback of the last line read by get_filtered_request
+    bool has_write = false;
+    long write_addr;
+
+    bool get_line(const char*& line, const char*& end);
+    bool get_record(Record& record);
+    void rewind();
     std::string trace_name;
 };
 
@@ -21,6 +21,7 @@
 #include <iostream>
 #include <vector>
 
+#include "Checkpoint.h"
 #include "Request.h"
 #include "DSARP.h"
 #include "ALDRAM.h"
@@ -82,6 +83,27 @@ public:
     }
   }
 
+  // Checkpoint of the refresh schedule and the per-bank progress
+  void save(CheckpointOut& out) const {
+    out.put(clk);
+    out.put(refreshed);
+    out.put(bank_ref_counters);
+    for (auto backlog : bank_refresh_backlog)
+      out.put(*backlog);
+    out.put(subarray_ref_counters);
+    out.put(ctrl_write_mode);
+  }
+
+  void load(CheckpointIn& in) {
+    in.get(clk);
+    in.get(refreshed);
+    in.get_fixed(bank_ref_counters);
+    for (auto backlog : bank_refresh_backlog)
+      in.get_fixed(*backlog);
+    in.get_fixed(subarray_ref_counters);
+    in.get(ctrl_write_mode);
+  }
+
 private:
   // Keeping track of refresh status of every bank: + means ahead of schedule, - means behind schedule
   vector<vector<int>*> bank_refresh_backlog;
@@ -97,12 +119,12 @@ private:
   // Refresh based on the specified address
   void refresh_target(Controller<T>* ctrl, int rank, int bank, int sa)
   {
-    vector<int> addr_vec(int(T::Level::MAX), -1);
+    AddrVec addr_vec(int(T::Level::MAX), -1);
     addr_vec[0] = ctrl->channel->id;
     addr_vec[1] = rank;
     addr_vec[2] = bank;
     addr_vec[3] = sa;
-    Request req(addr_vec, Request::Type::REFRESH, NULL);
+    Request req(addr_vec, Request::Type::REFRESH, nullptr);
     bool res = ctrl->enqueue(req);
     assert(res);
   }
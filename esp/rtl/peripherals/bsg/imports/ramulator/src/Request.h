@@ -1,21 +1,139 @@
 #ifndef __REQUEST_H
 #define __REQUEST_H
 
-#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
 #include <functional>
+#include <iterator>
+#include <type_traits>
+#include <vector>
 
 using namespace std;
 
 namespace ramulator
 {
 
+class Request;
+
+/* Address of a request down the DRAM hierarchy, one entry per T::Level.
+ * The entries are stored inline, so copying a request never touches the
+ * heap. MAX_LEVEL covers the Level::MAX of every standard; Controller<T>
+ * checks it at compile time. */
+class AddrVec
+{
+public:
+    static const int MAX_LEVEL = 8;
+
+    typedef int value_type;
+    typedef int* iterator;
+    typedef const int* const_iterator;
+
+    AddrVec() : len(0) {}
+    AddrVec(size_t n, int val) : len(0) { resize(n, val); }
+    AddrVec(const vector<int>& vec) : len(0)
+    {
+        for (int val : vec)
+            push_back(val);
+    }
+
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    int* data() { return vals; }
+    const int* data() const { return vals; }
+    iterator begin() { return vals; }
+    iterator end() { return vals + len; }
+    const_iterator begin() const { return vals; }
+    const_iterator end() const { return vals + len; }
+
+    int& operator[](size_t i) { return vals[i]; }
+    const int& operator[](size_t i) const { return vals[i]; }
+
+    void resize(size_t n, int val = 0)
+    {
+        assert(n <= size_t(MAX_LEVEL));
+        for (size_t i = len; i < n; i++)
+            vals[i] = val;
+        len = n;
+    }
+
+    void push_back(int val)
+    {
+        assert(len < size_t(MAX_LEVEL));
+        vals[len++] = val;
+    }
+
+    bool operator==(const AddrVec& other) const
+    {
+        return len == other.len && equal(begin(), end(), other.begin());
+    }
+    bool operator!=(const AddrVec& other) const { return !(*this == other); }
+
+private:
+    int vals[MAX_LEVEL];
+    size_t len;
+};
+
+/* Completion callback of a request. Unlike std::function it never
+ * allocates and copies as two words: it either holds a plain function
+ * (including captureless lambdas), or refers to a std::function that the
+ * sender keeps alive until its requests complete. */
+class RequestCallback
+{
+public:
+    RequestCallback() : call(nullptr), obj(nullptr) {}
+    RequestCallback(nullptr_t) : RequestCallback() {}
+
+    RequestCallback(void (*fn)(Request&)) : call(fn ? &call_plain : nullptr)
+    {
+        this->fn = fn;
+    }
+
+    template <typename F, typename = typename enable_if<
+        is_convertible<F, void (*)(Request&)>::value>::type>
+    RequestCallback(F fn)
+        : RequestCallback(static_cast<void (*)(Request&)>(fn)) {}
+
+    RequestCallback(const function<void(Request&)>& fn)
+        : call(fn ? &call_function : nullptr), obj(&fn) {}
+
+    // a temporary std::function would be gone before the request completes
+    RequestCallback(function<void(Request&)>&& fn) = delete;
+
+    void operator()(Request& req) const
+    {
+        if (call)
+            call(*this, req);
+    }
+
+    explicit operator bool() const { return call != nullptr; }
+
+private:
+    static void call_plain(const RequestCallback& cb, Request& req)
+    {
+        cb.fn(req);
+    }
+
+    static void call_function(const RequestCallback& cb, Request& req)
+    {
+        (*static_cast<const function<void(Request&)>*>(cb.obj))(req);
+    }
+
+    void (*call)(const RequestCallback&, Request&);
+    union {
+        const void* obj;
+        void (*fn)(Request&);
+    };
+};
+
 class Request
 {
 public:
     bool is_first_command;
     long addr;
     // long addr_row;
-    vector<int> addr_vec;
+    AddrVec addr_vec;
     // specify which core this request sent from, for virtual address translation
     int coreid;
 
@@ -31,24 +149,162 @@ public:
     } type;
 
     long arrive = -1;
-    long depart;
-    function<void(Request&)> callback; // call back with more info
+    long depart = -1; // set for reads only
+    RequestCallback callback; // call back with more info
 
     Request(long addr, Type type, int coreid = 0)
-        : is_first_command(true), addr(addr), coreid(coreid), type(type),
-      callback([](Request& req){}) {}
+        : is_first_command(true), addr(addr), coreid(coreid), type(type) {}
 
-    Request(long addr, Type type, function<void(Request&)> callback, int coreid = 0)
+    Request(long addr, Type type, RequestCallback callback, int coreid = 0)
         : is_first_command(true), addr(addr), coreid(coreid), type(type), callback(callback) {}
 
-    Request(vector<int>& addr_vec, Type type, function<void(Request&)> callback, int coreid = 0)
+    Request(const AddrVec& addr_vec, Type type, RequestCallback callback, int coreid = 0)
         : is_first_command(true), addr_vec(addr_vec), coreid(coreid), type(type), callback(callback) {}
 
     Request()
         : is_first_command(true), coreid(0) {}
 };
 
+/* Queue of requests inside a controller. Requests live in pooled nodes
+ * that belong to exactly one list at a time: moving a request to another
+ * queue relinks its node (splice) instead of copying it, and the nodes of
+ * retired requests go back to a free list shared by all queues, so a
+ * simulation in steady state does not allocate. The API is the subset of
+ * std::list<Request> the controllers use. */
+class RequestList
+{
+    struct Link {
+        Link* prev;
+        Link* next;
+    };
+    struct Node : Link {
+        Request req;
+    };
+
+public:
+    class iterator
+    {
+    public:
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef Request value_type;
+        typedef ptrdiff_t difference_type;
+        typedef Request* pointer;
+        typedef Request& reference;
+
+        iterator() : link(nullptr) {}
+
+        Request& operator*() const { return static_cast<Node*>(link)->req; }
+        Request* operator->() const { return &static_cast<Node*>(link)->req; }
+
+        iterator& operator++() { link = link->next; return *this; }
+        iterator& operator--() { link = link->prev; return *this; }
+        iterator operator++(int) { iterator it = *this; link = link->next; return it; }
+        iterator operator--(int) { iterator it = *this; link = link->prev; return it; }
+
+        bool operator==(const iterator& other) const { return link == other.link; }
+        bool operator!=(const iterator& other) const { return link != other.link; }
+
+    private:
+        friend class RequestList;
+        explicit iterator(Link* link) : link(link) {}
+        Link* link;
+    };
+
+    RequestList() : count(0) { head.prev = head.next = &head; }
+    ~RequestList() { clear(); }
+    RequestList(const RequestList&) = delete;
+    RequestList& operator=(const RequestList&) = delete;
+
+    iterator begin() { return iterator(head.next); }
+    iterator end() { return iterator(&head); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    Request& front() { return *begin(); }
+    Request& back() { return *iterator(head.prev); }
+
+    void push_back(const Request& req)
+    {
+        Node* node = alloc_node();
+        node->req = req;
+        link_before(&head, node);
+    }
+
+    void pop_front() { erase(begin()); }
+    void pop_back() { erase(iterator(head.prev)); }
+
+    iterator erase(iterator pos)
+    {
+        Link* next = pos.link->next;
+        unlink(pos.link);
+        free_node(static_cast<Node*>(pos.link));
+        return iterator(next);
+    }
+
+    // move the request at it from other in front of pos
+    void splice(iterator pos, RequestList& other, iterator it)
+    {
+        other.unlink(it.link);
+        link_before(pos.link, it.link);
+    }
+
+    void clear()
+    {
+        while (!empty())
+            pop_front();
+    }
+
+private:
+    void link_before(Link* pos, Link* link)
+    {
+        link->prev = pos->prev;
+        link->next = pos;
+        pos->prev->next = link;
+        pos->prev = link;
+        count++;
+    }
+
+    void unlink(Link* link)
+    {
+        link->prev->next = link->next;
+        link->next->prev = link->prev;
+        count--;
+    }
+
+    static Link*& free_nodes()
+    {
+        static Link* free_list = nullptr;
+        return free_list;
+    }
+
+    static Node* alloc_node()
+    {
+        Link*& free_list = free_nodes();
+        if (!free_list) {
+            // nodes are recycled, never returned to the heap
+            const int chunk = 256;
+            Node* nodes = new Node[chunk];
+            for (int i = 0; i < chunk; i++) {
+                nodes[i].next = free_list;
+                free_list = &nodes[i];
+            }
+        }
+        Node* node = static_cast<Node*>(free_list);
+        free_list = free_list->next;
+        return node;
+    }
+
+    static void free_node(Node* node)
+    {
+        Link*& free_list = free_nodes();
+        node->next = free_list;
+        free_list = node;
+    }
+
+    Link head;
+    size_t count;
+};
+
 } /*namespace ramulator*/
 
 #endif /*__REQUEST_H*/
-
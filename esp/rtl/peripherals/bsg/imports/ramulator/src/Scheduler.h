@@ -77,8 +77,13 @@ public:
 
     Scheduler(Controller<T>* ctrl) : ctrl(ctrl) {}
 
-    list<Request>::iterator get_head(list<Request>& q)
+    RequestList::iterator get_head(typename Controller<T>::Queue& queue)
     {
+        // Requests are compared per row: all requests of a row are equally
+        // ready, and the oldest one wins among them (see RowBucket).
+        auto& q = queue.q;
+        auto& rows = queue.rows;
+
         // TODO make the decision at compile time
         if (type != Type::FRFCFS_PriorHit) {
             //If queue is empty, return end of queue
@@ -86,11 +91,11 @@ public:
                 return q.end();
 
             //Else return based on the policy
-            auto head = q.begin();
-            for (auto itr = next(q.begin(), 1); itr != q.end(); itr++)
-                head = compare[int(type)](head, itr);
+            RowIter head = &rows[0];
+            for (size_t i = 1; i < queue.nrows; i++)
+                head = compare(type, head, &rows[i]);
 
-            return head;
+            return head->head();
         } 
         else { //Code to get around edge cases for FRFCFS_PriorHit
             
@@ -99,41 +104,36 @@ public:
                 return q.end();
 
        //Else return based on FRFCFS_PriorHit Scheduling Policy
-            auto head = q.begin();
-            for (auto itr = next(q.begin(), 1); itr != q.end(); itr++) {
-                head = compare[int(Type::FRFCFS_PriorHit)](head, itr);
+            RowIter head = &rows[0];
+            for (size_t i = 1; i < queue.nrows; i++) {
+                head = compare(Type::FRFCFS_PriorHit, head, &rows[i]);
             }
 
-            if (this->ctrl->is_ready(head) && this->ctrl->is_row_hit(head)) {
-                return head;
+            if (this->ctrl->is_ready(*head) && this->ctrl->is_row_hit(head->head())) {
+                return head->head();
             }
 
             // prepare a list of hit request
-            vector<vector<int>> hit_reqs;
-            for (auto itr = q.begin() ; itr != q.end() ; ++itr) {
-                if (this->ctrl->is_row_hit(itr)) {
-                    auto begin = itr->addr_vec.begin();
-                    // TODO Here it assumes all DRAM standards use PRE to close a row
-                    // It's better to make it more general.
-                    auto end = begin + int(ctrl->channel->spec->scope[int(T::Command::PRE)]) + 1;
-                    vector<int> rowgroup(begin, end); // bank or subarray
-                    hit_reqs.push_back(rowgroup);
+            // TODO Here it assumes all DRAM standards use PRE to close a row
+            // It's better to make it more general.
+            int rowgroup_len = int(ctrl->channel->spec->scope[int(T::Command::PRE)]) + 1;
+            vector<const int*> hit_reqs;
+            for (size_t i = 0; i < queue.nrows; i++) {
+                if (this->ctrl->is_row_hit(rows[i].head())) {
+                    hit_reqs.push_back(rows[i].row.data()); // bank or subarray
                 }
             }
             // if we can't find proper request, we need to return q.end(),
             // so that no command will be scheduled
-            head = q.end();
-            for (auto itr = q.begin(); itr != q.end(); itr++) {
+            head = nullptr;
+            for (size_t i = 0; i < queue.nrows; i++) {
+                RowIter row = &rows[i];
                 bool violate_hit = false;
-                if ((!this->ctrl->is_row_hit(itr)) && this->ctrl->is_row_open(itr)) {
+                if ((!this->ctrl->is_row_hit(row->head())) && this->ctrl->is_row_open(row->head())) {
                     // so the next instruction to be scheduled is PRE, might violate hit
-                    auto begin = itr->addr_vec.begin();
-                    // TODO Here it assumes all DRAM standards use PRE to close a row
-                    // It's better to make it more general.
-                    auto end = begin + int(ctrl->channel->spec->scope[int(T::Command::PRE)]) + 1;
-                    vector<int> rowgroup(begin, end); // bank or subarray
-                    for (const auto& hit_req_rowgroup : hit_reqs) {
-                        if (rowgroup == hit_req_rowgroup) {
+                    for (const int* hit_req_rowgroup : hit_reqs) {
+                        if (equal(hit_req_rowgroup, hit_req_rowgroup + rowgroup_len,
+                                  row->row.data())) {
                             violate_hit = true;
                             break;
                         }  
@@ -143,67 +143,64 @@ public:
                     continue;
                 }
                 // If it comes here, that means it won't violate any hit request
-                if (head == q.end()) {
-                    head = itr;
+                if (head == nullptr) {
+                    head = row;
                 } else {
-                    head = compare[int(Type::FRFCFS)](head, itr);
+                    head = compare(Type::FRFCFS, head, row);
                 }
             }
 
-            return head;
+            return head ? head->head() : q.end();
         }
     }
 
 //Compare functions for each memory schedulers
 private:
-    typedef list<Request>::iterator ReqIter;
-    function<ReqIter(ReqIter, ReqIter)> compare[int(Type::MAX)] = {
-        // FCFS
-        [this] (ReqIter req1, ReqIter req2) {
-            if (req1->arrive <= req2->arrive) return req1;
-            return req2;},
-
-        // FRFCFS
-        [this] (ReqIter req1, ReqIter req2) {
-            bool ready1 = this->ctrl->is_ready(req1);
-            bool ready2 = this->ctrl->is_ready(req2);
-
-            if (ready1 ^ ready2) {
-                if (ready1) return req1;
-                return req2;
-            }
-
-            if (req1->arrive <= req2->arrive) return req1;
-            return req2;},
-
-        // FRFCFS_CAP
-        [this] (ReqIter req1, ReqIter req2) {
-            bool ready1 = this->ctrl->is_ready(req1);
-            bool ready2 = this->ctrl->is_ready(req2);
+    typedef typename Controller<T>::RowBucket* RowIter;
 
-            ready1 = ready1 && (this->ctrl->rowtable->get_hits(req1->addr_vec) <= this->cap);
-            ready2 = ready2 && (this->ctrl->rowtable->get_hits(req2->addr_vec) <= this->cap);
-
-            if (ready1 ^ ready2) {
-                if (ready1) return req1;
-                return req2;
-            }
+    // the oldest request wins ties, then the one queued first
+    static RowIter older(RowIter row1, RowIter row2)
+    {
+        long arrive1 = row1->head()->arrive, arrive2 = row2->head()->arrive;
+        if (arrive1 < arrive2 || (arrive1 == arrive2 && row1->pos() < row2->pos()))
+            return row1;
+        return row2;
+    }
 
-            if (req1->arrive <= req2->arrive) return req1;
-            return req2;},
-        // FRFCFS_PriorHit
-        [this] (ReqIter req1, ReqIter req2) {
-            bool ready1 = this->ctrl->is_ready(req1) && this->ctrl->is_row_hit(req1);
-            bool ready2 = this->ctrl->is_ready(req2) && this->ctrl->is_row_hit(req2);
+    RowIter compare(Type policy, RowIter row1, RowIter row2)
+    {
+        bool ready1, ready2;
+        switch (policy) {
+        case Type::FCFS:
+            return older(row1, row2);
+
+        case Type::FRFCFS:
+            ready1 = this->ctrl->is_ready(*row1);
+            ready2 = this->ctrl->is_ready(*row2);
+            break;
+
+        case Type::FRFCFS_Cap:
+            ready1 = this->ctrl->is_ready(*row1);
+            ready2 = this->ctrl->is_ready(*row2);
+
+            ready1 = ready1 && (this->ctrl->get_hits(*row1) <= this->cap);
+            ready2 = ready2 && (this->ctrl->get_hits(*row2) <= this->cap);
+            break;
+
+        case Type::FRFCFS_PriorHit:
+        default:
+            ready1 = this->ctrl->is_ready(*row1) && this->ctrl->is_row_hit(row1->head());
+            ready2 = this->ctrl->is_ready(*row2) && this->ctrl->is_row_hit(row2->head());
+            break;
+        }
 
-            if (ready1 ^ ready2) {
-                if (ready1) return req1;
-                return req2;
-            }
+        if (ready1 ^ ready2) {
+            if (ready1) return row1;
+            return row2;
+        }
 
-            if (req1->arrive <= req2->arrive) return req1;
-            return req2;}
-    };
+        return older(row1, row2);
+    }
 };
 
 
@@ -283,7 +280,7 @@ public:
 
     RowTable(Controller<T>* ctrl) : ctrl(ctrl) {}
 
-    void update(typename T::Command cmd, const vector<int>& addr_vec, long clk)
+    void update(typename T::Command cmd, const AddrVec& addr_vec, long clk)
     {
         auto begin = addr_vec.begin();
         auto end = begin + int(T::Level::Row);
@@ -326,7 +323,7 @@ public:
         } /* closing */
     }
 
-    int get_hits(const vector<int>& addr_vec, const bool to_opened_row = false)
+    int get_hits(const AddrVec& addr_vec, const bool to_opened_row = false)
     {
         auto begin = addr_vec.begin();
         auto end = begin + int(T::Level::Row);
@@ -344,7 +341,7 @@ public:
         return itr->second.hits;
     }
 
-    int get_open_row(const vector<int>& addr_vec) {
+    int get_open_row(const AddrVec& addr_vec) {
         auto begin = addr_vec.begin();
         auto end = begin + int(T::Level::Row);
 
@@ -14,6 +14,25 @@ void reset_stats() {
         s->reset();
 }
 
+void save_stats(ramulator::CheckpointOut& out) {
+    out.put(curTick);
+    out.put(uint64_t(all_stats.size()));
+    for(auto s : all_stats)
+        s->save(out);
+}
+
+void load_stats(ramulator::CheckpointIn& in) {
+    uint64_t n = 0;
+    in.get(curTick);
+    in.get(n);
+    if (n != all_stats.size()) {
+        in.fail();
+        return;
+    }
+    for(auto s : all_stats)
+        s->load(in);
+}
+
 void
 Histogram::grow_out()
 {
@@ -10,6 +10,8 @@
 #include <cmath>
 #include <cstdlib>
 
+#include "Checkpoint.h"
+
 namespace ramulator {
 
 class ScalarStat;
@@ -34,6 +36,10 @@ typedef std::numeric_limits<Counter> CounterLimits;
 class StatBase;
 extern std::vector<StatBase*> all_stats;
 void reset_stats();
+// Checkpoint the values of all stats in the order they were created, so
+// they only restore into a simulation that was set up the same way.
+void save_stats(ramulator::CheckpointOut& out);
+void load_stats(ramulator::CheckpointIn& in);
 
 // Flags
 const uint16_t init      = 0x00000001;
@@ -79,6 +85,10 @@ class StatBase {
   virtual VResult vresult() const { return VResult(); };
   virtual Result total() const { return Result(); };
 
+  // values only; vectors are saved through their elements
+  virtual void save(ramulator::CheckpointOut& out) const {}
+  virtual void load(ramulator::CheckpointIn& in) {}
+
   virtual bool is_display() const  = 0;
   virtual bool is_nozero() const = 0;
 };
@@ -262,6 +272,9 @@ class Scalar: public ScalarBase<Scalar> {
   void prepare() {}
   void reset() {_value = Counter();}
 
+  void save(ramulator::CheckpointOut& out) const {out.put(_value);}
+  void load(ramulator::CheckpointIn& in) {in.get(_value);}
+
 };
 
 extern Tick curTick;
@@ -318,6 +331,19 @@ class Average: public ScalarBase<Average> {
     return (Result)(total_val + current)/ (Result)(curTick - lastReset + 1);
   }
   Result total() const {return result();}
+
+  void save(ramulator::CheckpointOut& out) const {
+    out.put(current);
+    out.put(lastReset);
+    out.put(total_val);
+    out.put(last);
+  }
+  void load(ramulator::CheckpointIn& in) {
+    in.get(current);
+    in.get(lastReset);
+    in.get(total_val);
+    in.get(last);
+  }
 };
 
 template<class Derived, class Element>
@@ -499,6 +525,32 @@ class Distribution: public Stat<Distribution> {
     squares = Counter();
     samples = Counter();
   };
+  void save(ramulator::CheckpointOut& out) const {
+    out.put(min_track);
+    out.put(max_track);
+    out.put(bucket_size);
+    out.put(min_val);
+    out.put(max_val);
+    out.put(underflow);
+    out.put(overflow);
+    out.put(sum);
+    out.put(squares);
+    out.put(samples);
+    out.put(cvec);
+  }
+  void load(ramulator::CheckpointIn& in) {
+    in.get(min_track);
+    in.get(max_track);
+    in.get(bucket_size);
+    in.get(min_val);
+    in.get(max_val);
+    in.get(underflow);
+    in.get(overflow);
+    in.get(sum);
+    in.get(squares);
+    in.get(samples);
+    in.get_fixed(cvec);
+  }
   void add(Distribution &d) {
     size_type d_size = d.size();
     assert(size() == d_size);
@@ -578,6 +630,27 @@ class Histogram: public Stat<Histogram> {
   }
 
   size_type size() const {return param_buckets;}
+
+  void save(ramulator::CheckpointOut& out) const {
+    out.put(min_bucket);
+    out.put(max_bucket);
+    out.put(bucket_size);
+    out.put(sum);
+    out.put(logs);
+    out.put(squares);
+    out.put(samples);
+    out.put(cvec);
+  }
+  void load(ramulator::CheckpointIn& in) {
+    in.get(min_bucket);
+    in.get(max_bucket);
+    in.get(bucket_size);
+    in.get(sum);
+    in.get(logs);
+    in.get(squares);
+    in.get(samples);
+    in.get_fixed(cvec);
+  }
 };
 
 class StandardDeviation: public Stat<StandardDeviation> {
@@ -603,6 +676,16 @@ class StandardDeviation: public Stat<StandardDeviation> {
     squares = Counter();
     samples = Counter();
   }
+  void save(ramulator::CheckpointOut& out) const {
+    out.put(sum);
+    out.put(squares);
+    out.put(samples);
+  }
+  void load(ramulator::CheckpointIn& in) {
+    in.get(sum);
+    in.get(squares);
+    in.get(samples);
+  }
   void add(StandardDeviation& sd) {
     sum += sd.sum;
     squares += sd.squares;
@@ -629,6 +712,14 @@ class AverageDeviation: public Stat<AverageDeviation> {
     sum = Counter();
     squares = Counter();
   }
+  void save(ramulator::CheckpointOut& out) const {
+    out.put(sum);
+    out.put(squares);
+  }
+  void load(ramulator::CheckpointIn& in) {
+    in.get(sum);
+    in.get(squares);
+  }
   void add(AverageDeviation& ad) {
     sum += ad.sum;
     squares += ad.squares;
@@ -0,0 +1,60 @@
+#!/usr/bin/env python
+#
+# Convert a text trace into the binary trace format read by ramulator.
+#
+#   $ ./trace2bin.py --mode=cpu cpu.trace cpu.bin
+#   $ ./trace2bin.py --mode=dram dram.trace dram.bin
+#
+# The binary file is "RAMTRACE" followed by one 16-byte little-endian record
+# per request: address (u64), bubble count (u32), type (u32, 0 read/1 write).
+# A CPU trace line with a writeback address becomes a read record followed by
+# a write record without bubbles.
+
+import gzip
+import struct
+import sys
+
+MAGIC = b'RAMTRACE'
+RECORD = struct.Struct('<QII')
+READ, WRITE = 0, 1
+
+
+def cpu_records(line):
+  tokens = line.split()
+  bubbles, addr = int(tokens[0]), int(tokens[1], 0)
+  if len(tokens) < 3 or tokens[2] == 'R':
+    yield addr, bubbles, READ
+  elif tokens[2] == 'W':
+    yield addr, bubbles, WRITE
+  else:
+    yield addr, bubbles, READ
+    yield int(tokens[2], 0), 0, WRITE
+
+
+def dram_records(line):
+  tokens = line.split()
+  addr = int(tokens[0], 16)
+  if len(tokens) < 2 or tokens[1] == 'R':
+    yield addr, 0, READ
+  else:
+    yield addr, 0, WRITE
+
+
+def main():
+  if len(sys.argv) != 4 or sys.argv[1] not in ('--mode=cpu', '--mode=dram'):
+    sys.stderr.write('Usage: %s --mode=cpu,dram <text-trace> <binary-trace>\n' % sys.argv[0])
+    sys.exit(1)
+
+  records = cpu_records if sys.argv[1] == '--mode=cpu' else dram_records
+  opener = gzip.open if sys.argv[2].endswith('.gz') else open
+  with opener(sys.argv[2], 'rt') as fin, open(sys.argv[3], 'wb') as fout:
+    fout.write(MAGIC)
+    for line in fin:
+      if not line.strip():
+        break
+      for record in records(line):
+        fout.write(RECORD.pack(*record))
+
+
+if __name__ == '__main__':
+  main()
@@ -15,6 +15,15 @@
  *          DDR devices. Ignored for bigphysarea.
  * - size: Array with the size in bytes of each memory region.
  * - chunk_log: log2 of the size of each memory chunk. Default: 20 (i.e. 1MB).
+ * Optional:
+ * - cache_depth: number of freed descriptors kept per size class for
+ *                recycling. Default: 8. 0 disables recycling.
+ *
+ * Freed buffers of up to CONTIG_CACHE_CLASSES chunks allocated with the
+ * PREFERRED policy keep their chunks and chunk table, and are handed out
+ * again to the next request of the same size and preferred DDR node without
+ * taking contig_lock. Cached buffers are released when memory runs out.
+ * Statistics are available in debugfs under contig_alloc/stats.
  */
 //#include <linux/bigphysarea.h>
 #include <linux/dma-mapping.h>
@@ -24,6 +33,9 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/list.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
@@ -59,12 +71,34 @@ module_param_array_named(start, mem_start, ulong, &nddr, S_IRUGO);
 static unsigned long mem_size[MAX_DDR_NODES];
 module_param_array_named(size, mem_size, ulong, &nddr, S_IRUGO);
 
+static unsigned int cache_depth = 8;
+module_param(cache_depth, uint, S_IRUGO);
+
 static struct class *contig_class;
+/* contig_lock protects the chunk lists, desc_lock protects desc_list */
 static DEFINE_MUTEX(contig_lock);
+static DEFINE_SPINLOCK(desc_lock);
 static LIST_HEAD(desc_list);
 static struct list_head inactive_chunks[MAX_DDR_NODES];
 static unsigned long mem_allocated[MAX_DDR_NODES];
 static caddr_t bp_buf __maybe_unused;
+static struct dentry *contig_debugfs;
+
+/* Size classes of recycled descriptors, indexed by number of chunks - 1 */
+#define CONTIG_CACHE_CLASSES 16
+
+struct contig_cache_class {
+    spinlock_t lock;
+    struct list_head descs;
+    unsigned int count;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long recycled;
+    unsigned long released;
+};
+
+static struct contig_cache_class contig_cache[CONTIG_CACHE_CLASSES];
+static unsigned long cache_drains;
 
 static int contig_open(struct inode *, struct file *);
 static int contig_release(struct inode *, struct file *);
@@ -97,7 +131,8 @@ static struct contig_desc *contig_alloc_descriptor(unsigned int n_chunks)
 #endif
     if (unlikely(dma_mapping_error(NULL, desc->arr_dma_addr))) goto err_dma;
 
-    desc->n = n_chunks;
+    desc->n         = n_chunks;
+    desc->cache_key = -1;
     INIT_LIST_HEAD(&desc->alloc_list);
     return desc;
 
@@ -298,7 +333,13 @@ static struct contig_desc *__contig_alloc_chunks(const struct contig_alloc_param
         return ERR_PTR(rc);
     }
 
+    if (params->policy == CONTIG_ALLOC_PREFERRED && n_chunks <= CONTIG_CACHE_CLASSES)
+        desc->cache_key = params->pol.first.ddr_node;
+
+    refcount_set(&desc->refs, 1);
+    spin_lock(&desc_lock);
     list_add(&desc->desc_node, &desc_list);
+    spin_unlock(&desc_lock);
     return desc;
 }
 
@@ -319,44 +360,154 @@ static struct contig_desc *__contig_alloc(const struct contig_alloc_params *para
     return __contig_alloc_chunks(params, n_chunks);
 }
 
+/* Returns the chunks of a descriptor that is in no list to the inactive lists */
+static void __contig_release(struct contig_desc *desc)
+{
+    struct contig_chunk *ch, *nxt;
+    unsigned int deallocated = 0;
+
+    list_for_each_entry_safe(ch, nxt, &desc->alloc_list, node)
+    {
+        list_del(&ch->node);
+        list_add(&ch->node, &inactive_chunks[ch->ddr_node]);
+        deallocated += chunk_size;
+        mem_allocated[ch->ddr_node] -= chunk_size;
+    }
+    BUG_ON(deallocated != desc->n * chunk_size);
+    contig_free_descriptor(desc);
+}
+
+void __contig_free(struct contig_desc *desc)
+{
+    spin_lock(&desc_lock);
+    list_del(&desc->desc_node);
+    spin_unlock(&desc_lock);
+    __contig_release(desc);
+}
+
+static struct contig_desc *contig_cache_get(unsigned int n_chunks, int ddr_node)
+{
+    struct contig_cache_class *cls = &contig_cache[n_chunks - 1];
+    struct contig_desc *desc;
+
+    spin_lock(&cls->lock);
+    list_for_each_entry(desc, &cls->descs, desc_node)
+    {
+        if (desc->cache_key == ddr_node) {
+            list_del(&desc->desc_node);
+            cls->count--;
+            cls->hits++;
+            spin_unlock(&cls->lock);
+
+            refcount_set(&desc->refs, 1);
+            spin_lock(&desc_lock);
+            list_add(&desc->desc_node, &desc_list);
+            spin_unlock(&desc_lock);
+            return desc;
+        }
+    }
+    cls->misses++;
+    spin_unlock(&cls->lock);
+
+    return NULL;
+}
+
+static bool contig_cache_put(struct contig_desc *desc)
+{
+    struct contig_cache_class *cls;
+
+    if (desc->cache_key < 0) return false;
+
+    cls = &contig_cache[desc->n - 1];
+
+    spin_lock(&desc_lock);
+    list_del(&desc->desc_node);
+    spin_unlock(&desc_lock);
+
+    spin_lock(&cls->lock);
+    if (cls->count < cache_depth) {
+        list_add(&desc->desc_node, &cls->descs);
+        cls->count++;
+        cls->recycled++;
+        spin_unlock(&cls->lock);
+        return true;
+    }
+    spin_unlock(&cls->lock);
+
+    /* Class is full: the caller frees it, so it must be back in desc_list */
+    spin_lock(&desc_lock);
+    list_add(&desc->desc_node, &desc_list);
+    spin_unlock(&desc_lock);
+    return false;
+}
+
+/* Called with contig_lock held. Returns the number of descriptors released. */
+static unsigned int __contig_cache_drain(void)
+{
+    unsigned int released = 0;
+    int i;
+
+    for (i = 0; i < CONTIG_CACHE_CLASSES; i++) {
+        struct contig_cache_class *cls = &contig_cache[i];
+        struct contig_desc *desc, *nxt;
+        LIST_HEAD(drained);
+
+        spin_lock(&cls->lock);
+        list_splice_init(&cls->descs, &drained);
+        cls->released += cls->count;
+        released += cls->count;
+        cls->count = 0;
+        spin_unlock(&cls->lock);
+
+        list_for_each_entry_safe(desc, nxt, &drained, desc_node)
+        {
+            list_del(&desc->desc_node);
+            __contig_release(desc);
+        }
+    }
+
+    if (released) cache_drains++;
+    return released;
+}
+
 struct contig_desc *contig_alloc(const struct contig_alloc_params *params, unsigned long size)
 {
     struct contig_desc *ret;
 
     if (unlikely(size == 0)) return ERR_PTR(-EINVAL);
 
+    /* Fast path: recycle a descriptor without touching the chunk lists */
+    if (params->policy == CONTIG_ALLOC_PREFERRED && size <= CONTIG_CACHE_CLASSES * chunk_size) {
+        ret = contig_cache_get(DIV_ROUND_UP(size, chunk_size), params->pol.first.ddr_node);
+        if (ret) return ret;
+    }
+
     mutex_lock(&contig_lock);
     ret = __contig_alloc(params, size);
+    if (IS_ERR(ret) && PTR_ERR(ret) == -ENOMEM && __contig_cache_drain())
+        ret = __contig_alloc(params, size);
     mutex_unlock(&contig_lock);
 
     return ret;
 }
 EXPORT_SYMBOL_GPL(contig_alloc);
 
-void __contig_free(struct contig_desc *desc)
+/* Drops the owner's reference: a buffer still held by contig_get() users, e.g.
+ * queued on an accelerator, is only released by the last contig_put() */
+void contig_free(struct contig_desc *desc) { contig_put(desc); }
+EXPORT_SYMBOL_GPL(contig_free);
+
+void contig_put(struct contig_desc *desc)
 {
-    struct contig_chunk *ch, *nxt;
-    unsigned int deallocated = 0;
+    if (!refcount_dec_and_test(&desc->refs)) return;
 
-    list_for_each_entry_safe(ch, nxt, &desc->alloc_list, node)
-    {
-        list_del(&ch->node);
-        list_add(&ch->node, &inactive_chunks[ch->ddr_node]);
-        deallocated += chunk_size;
-        mem_allocated[ch->ddr_node] -= chunk_size;
-    }
-    BUG_ON(deallocated != desc->n * chunk_size);
-    list_del(&desc->desc_node);
-    contig_free_descriptor(desc);
-}
+    if (contig_cache_put(desc)) return;
 
-void contig_free(struct contig_desc *desc)
-{
     mutex_lock(&contig_lock);
     __contig_free(desc);
     mutex_unlock(&contig_lock);
 }
-EXPORT_SYMBOL_GPL(contig_free);
+EXPORT_SYMBOL_GPL(contig_put);
 
 /*
  * Check that this is a valid desc. Ideally we'd also make sure that the calling
@@ -367,17 +518,43 @@ struct contig_desc *contig_khandle_to_desc(contig_khandle_t khandle)
     struct contig_desc *handle = (struct contig_desc *)khandle;
     struct contig_desc *desc;
 
-    mutex_lock(&contig_lock);
+    spin_lock(&desc_lock);
     list_for_each_entry(desc, &desc_list, desc_node)
     {
         if (desc == handle) break;
     }
-    mutex_unlock(&contig_lock);
+    spin_unlock(&desc_lock);
 
     return desc == handle ? desc : NULL;
 }
 EXPORT_SYMBOL_GPL(contig_khandle_to_desc);
 
+/*
+ * Like contig_khandle_to_desc(), but also takes a reference that keeps the buffer
+ * allocated until the matching contig_put(), even if its owner frees it first.
+ * Does not sleep; contig_put() may.
+ */
+struct contig_desc *contig_get(contig_khandle_t khandle)
+{
+    struct contig_desc *handle = (struct contig_desc *)khandle;
+    struct contig_desc *desc;
+    bool found = false;
+
+    spin_lock(&desc_lock);
+    list_for_each_entry(desc, &desc_list, desc_node)
+    {
+        if (desc == handle) {
+            /* a descriptor on its way out may still be listed */
+            found = refcount_inc_not_zero(&desc->refs);
+            break;
+        }
+    }
+    spin_unlock(&desc_lock);
+
+    return found ? handle : NULL;
+}
+EXPORT_SYMBOL_GPL(contig_get);
+
 static void __contig_chunks_remove(void)
 {
     struct contig_chunk *ch, *nxt;
@@ -606,6 +783,78 @@ static int contig_mmap(struct file *file, struct vm_area_struct *vma)
     return 0;
 }
 
+static int contig_stats_show(struct seq_file *m, void *v)
+{
+    int i;
+
+    seq_printf(m, "chunk_size %lu cache_depth %u drains %lu\n", chunk_size, cache_depth,
+               cache_drains);
+
+    seq_puts(m, "class chunks cached hits misses recycled released\n");
+    for (i = 0; i < CONTIG_CACHE_CLASSES; i++) {
+        struct contig_cache_class *cls = &contig_cache[i];
+
+        spin_lock(&cls->lock);
+        if (cls->hits || cls->misses || cls->recycled)
+            seq_printf(m, "%5d %6d %6u %lu %lu %lu %lu\n", i, i + 1, cls->count, cls->hits,
+                       cls->misses, cls->recycled, cls->released);
+        spin_unlock(&cls->lock);
+    }
+
+    /*
+     * Per DDR node: chunks held by live and recycled buffers, free chunks and
+     * the number of physically contiguous runs the free chunks form.
+     */
+    seq_puts(m, "node size allocated cached free free_extents\n");
+    mutex_lock(&contig_lock);
+    for (i = 0; i < nddr; i++) {
+        unsigned long total = mem_size[i] / chunk_size;
+        unsigned long cached = 0, nfree = 0, extents = 0;
+        struct contig_chunk *ch;
+        int c;
+
+        for (c = 0; c < CONTIG_CACHE_CLASSES; c++) {
+            struct contig_desc *desc;
+
+            spin_lock(&contig_cache[c].lock);
+            list_for_each_entry(desc, &contig_cache[c].descs, desc_node)
+            {
+                list_for_each_entry(ch, &desc->alloc_list, node)
+                {
+                    if (ch->ddr_node == i) cached++;
+                }
+            }
+            spin_unlock(&contig_cache[c].lock);
+        }
+
+#ifndef CONFIG_BIGPHYS_AREA
+        {
+            unsigned long *map = kcalloc(BITS_TO_LONGS(total), sizeof(long), GFP_KERNEL);
+            unsigned long bit  = 0;
+
+            if (map) {
+                list_for_each_entry(ch, &inactive_chunks[i], node)
+                    set_bit((ch->paddr - mem_start[i]) / chunk_size, map);
+
+                while ((bit = find_next_bit(map, total, bit)) < total) {
+                    extents++;
+                    bit = find_next_zero_bit(map, total, bit);
+                }
+                kfree(map);
+            }
+        }
+#endif
+        list_for_each_entry(ch, &inactive_chunks[i], node) { nfree++; }
+
+        seq_printf(m, "%4d %lu %lu %lu %lu %lu\n", i, total, mem_allocated[i] / chunk_size,
+                   cached, nfree, extents);
+    }
+    mutex_unlock(&contig_lock);
+
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(contig_stats);
+
 static int __init contig_create_file(void)
 {
     contig_class = class_create(THIS_MODULE, "contig_alloc");
@@ -617,6 +866,10 @@ static int __init contig_create_file(void)
                              "contig_alloc")))
         goto err_device_create;
 
+    /* Statistics are best effort: debugfs may be disabled */
+    contig_debugfs = debugfs_create_dir("contig_alloc", NULL);
+    debugfs_create_file("stats", S_IRUGO, contig_debugfs, NULL, &contig_stats_fops);
+
     return 0;
 
 err_device_create:
@@ -628,6 +881,7 @@ err_chrdev:
 
 static void contig_remove_file(void)
 {
+    debugfs_remove_recursive(contig_debugfs);
     device_destroy(contig_class, MKDEV(CONTIG_MAJOR, CONTIG_MINOR));
     unregister_chrdev(CONTIG_MAJOR, "contig_alloc");
     class_destroy(contig_class);
@@ -649,6 +903,11 @@ static int __init contig_init(void)
         return -EINVAL;
     }
 
+    for (i = 0; i < CONTIG_CACHE_CLASSES; i++) {
+        spin_lock_init(&contig_cache[i].lock);
+        INIT_LIST_HEAD(&contig_cache[i].descs);
+    }
+
     for (i = 0; i < nddr; i++) {
         INIT_LIST_HEAD(&inactive_chunks[i]);
         if (mem_size[i] % chunk_size) {
@@ -683,6 +942,7 @@ static void contig_exit(void)
 {
     struct contig_desc *desc, *nxt;
 
+    __contig_cache_drain();
     list_for_each_entry_safe(desc, nxt, &desc_list, desc_node) { __contig_free(desc); }
     __contig_chunks_remove();
     contig_phys_free();
@@ -26,6 +26,8 @@
 #include <linux/mm.h>
 #include <linux/ioctl.h>
 #include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
 
 #include <asm/uaccess.h>
 
@@ -60,6 +62,8 @@ static size_t cache_llc_size      = 262144;
 
 struct esp_status esp_status;
 
+static void esp_queue_complete(struct esp_device *esp, int status);
+
 static irqreturn_t esp_irq(int irq, void *dev)
 {
     struct esp_device *esp = dev_get_drvdata(dev);
@@ -71,6 +75,11 @@ static irqreturn_t esp_irq(int irq, void *dev)
 
     /* printk(KERN_INFO "IRQ: %08x\n", status); */
 
+    if ((error || done) && esp->queue_running) {
+        iowrite32be(0, esp->iomem + CMD_REG);
+        esp_queue_complete(esp, error ? -EIO : 0);
+        return IRQ_HANDLED;
+    }
     if (error) {
         iowrite32be(0, esp->iomem + CMD_REG);
         esp->err = -1;
@@ -105,11 +114,21 @@ static int esp_open(struct inode *inode, struct file *file)
     return 0;
 }
 
+static void esp_queue_free(struct esp_device *esp);
+
 static int esp_release(struct inode *inode, struct file *file)
 {
     struct esp_device *esp;
 
     esp = file->private_data;
+
+    /* The ring is no longer mapped: the mapping holds a reference to the file */
+    if (smp_load_acquire(&esp->queue_file) == file) {
+        mutex_lock(&esp->lock);
+        esp_queue_free(esp);
+        mutex_unlock(&esp->lock);
+    }
+
     module_put(esp->module);
     return 0;
 }
@@ -373,7 +392,7 @@ static long esp_yx_table_init(struct esp_device *esp, struct esp_access *access)
 
 static int esp_access_ioctl(struct esp_device *esp, void __user *argp)
 {
-    struct contig_desc *contig;
+    struct contig_desc *contig = NULL;
     struct esp_access *access;
     void *arg;
     int rc = 0;
@@ -387,7 +406,7 @@ static int esp_access_ioctl(struct esp_device *esp, void __user *argp)
     }
 
     access = arg;
-    contig = contig_khandle_to_desc(access->contig);
+    contig = contig_get(access->contig);
     if (contig == NULL) {
         rc = -EFAULT;
         goto out;
@@ -413,6 +432,13 @@ static int esp_access_ioctl(struct esp_device *esp, void __user *argp)
         goto out;
     }
 
+    /* Let a running descriptor chain drain first */
+    if (wait_event_interruptible(esp->queue_wq, !READ_ONCE(esp->queue_running))) {
+        mutex_unlock(&esp->lock);
+        rc = -EINTR;
+        goto out;
+    }
+
     rc = esp_p2p_init(esp, access);
     if (rc) { goto out; }
 
@@ -459,6 +485,7 @@ static int esp_access_ioctl(struct esp_device *esp, void __user *argp)
     mutex_unlock(&esp->lock);
 
 out:
+    if (contig) contig_put(contig);
     kfree(arg);
     return rc;
 }
@@ -491,6 +518,352 @@ out:
     return rc;
 }
 
+/*
+ * Descriptor queue. Slots [queue_head, queue_ready) have been validated and
+ * copied to queue_desc at submit time, so that the IRQ handler only needs to
+ * program the registers of the next one and start it. Each of them holds a
+ * reference to its contig buffer, dropped by esp_queue_put_work() once it has
+ * completed, so that the buffer cannot be freed while the device may access it.
+ */
+#define ESP_QUEUE_SQ_OFFSET ALIGN(sizeof(struct esp_queue_ring), 64)
+
+static size_t esp_queue_cq_offset(struct esp_device *esp)
+{
+    return ALIGN(ESP_QUEUE_SQ_OFFSET + esp->queue_entries * esp->driver->arg_size, 64);
+}
+
+static void *esp_queue_desc(struct esp_device *esp, unsigned int index)
+{
+    return esp->queue_desc + (index & (esp->queue_entries - 1)) * esp->driver->arg_size;
+}
+
+/* Called with queue_lock held */
+static void esp_queue_start(struct esp_device *esp)
+{
+    unsigned int slot = esp->queue_head & (esp->queue_entries - 1);
+
+    esp_transfer(esp, esp->queue_contig[slot]);
+    if (esp->driver->prep_xfer) esp->driver->prep_xfer(esp, esp_queue_desc(esp, esp->queue_head));
+    esp_run(esp);
+}
+
+/* Called with queue_lock held */
+static void esp_queue_post(struct esp_device *esp, int status)
+{
+    struct esp_queue_ring *ring = esp->queue;
+    struct esp_queue_cqe *cq    = (void *)ring + esp_queue_cq_offset(esp);
+    struct esp_queue_cqe *cqe   = &cq[esp->queue_done & (esp->queue_entries - 1)];
+
+    cqe->index  = esp->queue_head;
+    cqe->status = status;
+    esp->queue_head++;
+    esp->queue_done++;
+
+    /* Publish the completion entry before the indices */
+    smp_wmb();
+    WRITE_ONCE(ring->sq_head, esp->queue_head);
+    WRITE_ONCE(ring->cq_tail, esp->queue_done);
+}
+
+static void esp_queue_complete(struct esp_device *esp, int status)
+{
+    spin_lock(&esp->queue_lock);
+
+    esp_queue_post(esp, status);
+
+    /* An error cancels the rest of the chain */
+    if (status)
+        while (esp->queue_head != esp->queue_ready)
+            esp_queue_post(esp, -ECANCELED);
+
+    if (esp->queue_head != esp->queue_ready) {
+        esp_queue_start(esp);
+    }
+    else {
+        WRITE_ONCE(esp->queue_running, false);
+        schedule_work(&esp->queue_work);
+    }
+
+    /* Queued together with the completions, see esp_queue_submit_ioctl() */
+    schedule_work(&esp->queue_put_work);
+
+    spin_unlock(&esp->queue_lock);
+
+    wake_up_interruptible_all(&esp->queue_wq);
+}
+
+/* Status accounting of a drained chain needs esp_status.lock, which may sleep */
+static void esp_queue_work(struct work_struct *work)
+{
+    struct esp_device *esp = container_of(work, struct esp_device, queue_work);
+
+    mutex_lock(&esp_status.lock);
+    esp_update_status(esp);
+    mutex_unlock(&esp_status.lock);
+}
+
+/* Drop the contig references of completed descriptors, contig_put() may sleep */
+static void esp_queue_put_work(struct work_struct *work)
+{
+    struct esp_device *esp = container_of(work, struct esp_device, queue_put_work);
+    unsigned int put       = esp->queue_put;
+    unsigned int head;
+
+    spin_lock_irq(&esp->queue_lock);
+    head = esp->queue_head;
+    spin_unlock_irq(&esp->queue_lock);
+
+    for (; put != head; put++) {
+        unsigned int slot = put & (esp->queue_entries - 1);
+
+        contig_put(esp->queue_contig[slot]);
+        esp->queue_contig[slot] = NULL;
+    }
+
+    /* Submit refills these slots once it sees the new value */
+    smp_store_release(&esp->queue_put, put);
+}
+
+static long esp_queue_setup_ioctl(struct esp_device *esp, struct file *file, void __user *argp)
+{
+    struct esp_queue_ring *ring;
+    unsigned int entries;
+    size_t size;
+    int rc = 0;
+
+    if (get_user(entries, (unsigned int __user *)argp)) return -EFAULT;
+    if (!entries || entries > ESP_QUEUE_MAX_ENTRIES || (entries & (entries - 1))) return -EINVAL;
+
+    if (mutex_lock_interruptible(&esp->lock)) return -EINTR;
+
+    /* The ring may be mapped by user space: it lives until its owner is released */
+    if (esp->queue) {
+        rc = esp->queue_file == file && esp->queue_entries == entries ? 0 : -EBUSY;
+        goto out;
+    }
+
+    esp->queue_entries = entries;
+    size               = esp_queue_cq_offset(esp) + entries * sizeof(struct esp_queue_cqe);
+
+    ring              = vmalloc_user(PAGE_ALIGN(size));
+    esp->queue_desc   = kvmalloc_array(entries, esp->driver->arg_size, GFP_KERNEL);
+    esp->queue_contig = kcalloc(entries, sizeof(*esp->queue_contig), GFP_KERNEL);
+    if (ring == NULL || esp->queue_desc == NULL || esp->queue_contig == NULL) {
+        vfree(ring);
+        kvfree(esp->queue_desc);
+        kfree(esp->queue_contig);
+        esp->queue_desc   = NULL;
+        esp->queue_contig = NULL;
+        rc                = -ENOMEM;
+        goto out;
+    }
+
+    ring->entries   = entries;
+    ring->desc_size = esp->driver->arg_size;
+    ring->sq_offset = ESP_QUEUE_SQ_OFFSET;
+    ring->cq_offset = esp_queue_cq_offset(esp);
+
+    esp->queue_put   = 0;
+    esp->queue_head  = 0;
+    esp->queue_ready = 0;
+    esp->queue_done  = 0;
+    esp->queue       = ring;
+
+    /* The other queue calls check the owner before they look at the queue */
+    smp_store_release(&esp->queue_file, file);
+
+out:
+    mutex_unlock(&esp->lock);
+    return rc;
+}
+
+/* Configure the device for a new chain starting at queue_head, called with esp->lock held */
+static int esp_queue_configure(struct esp_device *esp)
+{
+    struct esp_access *first = esp_queue_desc(esp, esp->queue_head);
+
+    /* Wait for the accounting of the previous chain before starting a new one */
+    flush_work(&esp->queue_work);
+
+    esp->coherence    = first->coherence;
+    esp->footprint    = first->footprint;
+    esp->alloc_policy = first->alloc_policy;
+    esp->ddr_node     = first->ddr_node;
+    esp->in_place     = first->in_place;
+    esp->reuse_factor = first->reuse_factor;
+
+    if (mutex_lock_interruptible(&esp_status.lock)) return -EINTR;
+
+    esp_runtime_config(esp);
+
+    mutex_unlock(&esp_status.lock);
+
+    esp_p2p_reset(esp);
+
+    return 0;
+}
+
+static long esp_queue_submit_ioctl(struct esp_device *esp, struct file *file)
+{
+    struct esp_queue_ring *ring;
+    unsigned int tail, i, j;
+    unsigned long flags;
+    bool idle;
+    int rc = 0;
+
+    if (smp_load_acquire(&esp->queue_file) != file) return -EINVAL;
+    ring = esp->queue;
+
+    if (mutex_lock_interruptible(&esp->lock)) return -EINTR;
+
+    /*
+     * Completions are posted under queue_lock together with the queueing of
+     * esp_queue_put_work(), so once it is flushed the slots of every completion
+     * user space may have seen are free again.
+     */
+    flush_work(&esp->queue_put_work);
+
+    tail = READ_ONCE(ring->sq_tail);
+    /* Read the descriptors after the tail that publishes them */
+    smp_rmb();
+
+    /* Neither the referenced descriptors nor unconsumed completions may be overwritten */
+    if (tail - esp->queue_ready > esp->queue_entries ||
+        tail - smp_load_acquire(&esp->queue_put) > esp->queue_entries ||
+        tail - READ_ONCE(ring->cq_head) > esp->queue_entries) {
+        rc = -ENOSPC;
+        goto out;
+    }
+
+    /* Validate everything first, so that a bad batch is rejected as a whole */
+    for (i = esp->queue_ready; i != tail; i++) {
+        unsigned int slot = i & (esp->queue_entries - 1);
+        void *arg         = esp_queue_desc(esp, i);
+        struct esp_access *access;
+        struct contig_desc *contig;
+
+        memcpy(arg, (void *)ring + ESP_QUEUE_SQ_OFFSET + slot * esp->driver->arg_size,
+               esp->driver->arg_size);
+        access = arg;
+
+        contig = contig_get(access->contig);
+        if (contig == NULL) {
+            rc = -EFAULT;
+            goto out_put;
+        }
+
+        if (access->p2p_store || access->p2p_nsrcs || access->ndev_yx_table ||
+            !esp_xfer_input_ok(esp, contig) ||
+            (esp->driver->xfer_input_ok && !esp->driver->xfer_input_ok(esp, arg))) {
+            contig_put(contig);
+            rc = -EINVAL;
+            goto out_put;
+        }
+
+        esp->queue_contig[slot] = contig;
+    }
+
+    if (tail == esp->queue_ready) goto out;
+
+    /*
+     * The chain only goes from idle to running here, under esp->lock, so a
+     * chain seen idle stays idle. A running one may drain at any time though:
+     * the decision to start it is taken under queue_lock together with the
+     * publication of the new descriptors, and if it drained since we looked,
+     * the device is configured for a new chain and its inputs flushed again.
+     */
+    idle = !READ_ONCE(esp->queue_running);
+    for (;;) {
+        if (idle) {
+            rc = esp_queue_configure(esp);
+            if (rc) goto out_put;
+        }
+
+        /* Inputs of the new descriptors were written by the CPU */
+        rc = esp_flush(esp);
+        if (rc) {
+            if (idle) schedule_work(&esp->queue_work);
+            goto out_put;
+        }
+
+        spin_lock_irqsave(&esp->queue_lock, flags);
+        if (idle || esp->queue_running) {
+            esp->queue_ready = tail;
+            if (idle) {
+                esp->queue_running = true;
+                esp_queue_start(esp);
+            }
+            spin_unlock_irqrestore(&esp->queue_lock, flags);
+            break;
+        }
+        spin_unlock_irqrestore(&esp->queue_lock, flags);
+        idle = true;
+    }
+
+out:
+    mutex_unlock(&esp->lock);
+    return rc;
+
+out_put:
+    /* Nothing was queued: drop the references taken so far */
+    for (j = esp->queue_ready; j != i; j++) {
+        unsigned int slot = j & (esp->queue_entries - 1);
+
+        contig_put(esp->queue_contig[slot]);
+        esp->queue_contig[slot] = NULL;
+    }
+    goto out;
+}
+
+static long esp_queue_wait_ioctl(struct esp_device *esp, struct file *file, void __user *argp)
+{
+    unsigned int target;
+
+    if (smp_load_acquire(&esp->queue_file) != file) return -EINVAL;
+    if (get_user(target, (unsigned int __user *)argp)) return -EFAULT;
+
+    if (wait_event_interruptible(esp->queue_wq, (int)(READ_ONCE(esp->queue_done) - target) >= 0))
+        return -EINTR;
+
+    return 0;
+}
+
+/* Called with esp->lock held, or once the device is gone */
+static void esp_queue_free(struct esp_device *esp)
+{
+    unsigned int i;
+
+    /* Drop the descriptors that have not started, the running one completes */
+    spin_lock_irq(&esp->queue_lock);
+    if (esp->queue_running) esp->queue_ready = esp->queue_head + 1;
+    spin_unlock_irq(&esp->queue_lock);
+
+    wait_event(esp->queue_wq, !READ_ONCE(esp->queue_running));
+    flush_work(&esp->queue_work);
+    flush_work(&esp->queue_put_work);
+
+    /* The work put every descriptor that ran, these are the dropped ones */
+    for (i = 0; i < esp->queue_entries; i++)
+        if (esp->queue_contig[i]) contig_put(esp->queue_contig[i]);
+
+    vfree(esp->queue);
+    kvfree(esp->queue_desc);
+    kfree(esp->queue_contig);
+    esp->queue_desc   = NULL;
+    esp->queue_contig = NULL;
+    esp->queue        = NULL;
+    WRITE_ONCE(esp->queue_file, NULL);
+}
+
+static int esp_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct esp_device *esp = file->private_data;
+
+    if (smp_load_acquire(&esp->queue_file) != file) return -EINVAL;
+
+    return remap_vmalloc_range(vma, esp->queue, vma->vm_pgoff);
+}
+
 static long esp_do_ioctl(struct file *file, unsigned int cm, void __user *arg)
 {
     struct esp_device *esp = file->private_data;
@@ -498,6 +871,9 @@ static long esp_do_ioctl(struct file *file, unsigned int cm, void __user *arg)
     switch (cm) {
         case ESP_IOC_RUN: return esp_run_ioctl(esp);
         case ESP_IOC_FLUSH: return esp_flush_ioctl(esp, arg);
+        case ESP_IOC_QUEUE_SETUP: return esp_queue_setup_ioctl(esp, file, arg);
+        case ESP_IOC_QUEUE_SUBMIT: return esp_queue_submit_ioctl(esp, file);
+        case ESP_IOC_QUEUE_WAIT: return esp_queue_wait_ioctl(esp, file, arg);
         default:
             if (cm == esp->driver->ioctl_cm) return esp_access_ioctl(esp, arg);
             return -ENOTTY;
@@ -514,6 +890,7 @@ static const struct file_operations esp_fops = {
     .open           = esp_open,
     .release        = esp_release,
     .unlocked_ioctl = esp_ioctl,
+    .mmap           = esp_mmap,
 };
 
 static int esp_create_cdev(struct esp_device *esp, int ndev)
@@ -563,6 +940,10 @@ int esp_device_register(struct esp_device *esp, struct platform_device *pdev)
     esp->pdev = &pdev->dev;
     mutex_init(&esp->lock);
     init_completion(&esp->completion);
+    spin_lock_init(&esp->queue_lock);
+    init_waitqueue_head(&esp->queue_wq);
+    INIT_WORK(&esp->queue_work, esp_queue_work);
+    INIT_WORK(&esp->queue_put_work, esp_queue_put_work);
 
     rc = esp_create_cdev(esp, esp->number);
     if (rc) goto out;
@@ -619,6 +1000,7 @@ EXPORT_SYMBOL_GPL(esp_device_register);
 void esp_device_unregister(struct esp_device *esp)
 {
     list_del(&esp->list);
+    if (esp->queue) esp_queue_free(esp);
     free_irq(esp->irq, esp->pdev);
     esp_destroy_cdev(esp, esp->number);
     devm_iounmap(esp->pdev, esp->iomem);
@@ -101,21 +101,26 @@ struct contig_alloc_req {
 #ifdef __KERNEL__
 
     #include <linux/list.h>
+    #include <linux/refcount.h>
 
 struct contig_desc {
     unsigned long *arr;
     dma_addr_t arr_dma_addr;
     unsigned int n;
     int most_allocated;
-    struct list_head desc_node;
+    int cache_key; /* preferred DDR node if the descriptor can be recycled, else -1 */
+    struct list_head desc_node; /* head: desc_list, or a cache class while recycled */
     struct list_head file_node;
     struct list_head alloc_list;
+    refcount_t refs; /* the owner's, plus one per contig_get() */
 };
 
 extern struct contig_desc *contig_alloc(const struct contig_alloc_params *params,
                                         unsigned long size);
 extern void contig_free(struct contig_desc *desc);
 extern struct contig_desc *contig_khandle_to_desc(contig_khandle_t khandle);
+extern struct contig_desc *contig_get(contig_khandle_t khandle);
+extern void contig_put(struct contig_desc *desc);
 
 extern unsigned long contig_chunk_size_log;
 
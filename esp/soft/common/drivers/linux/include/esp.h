@@ -35,8 +35,46 @@ struct esp_access {
     unsigned int reuse_factor;
 };
 
-#define ESP_IOC_RUN   _IO('E', 0)
-#define ESP_IOC_FLUSH _IO('E', 1)
+/*
+ * Descriptor queue. After ESP_IOC_QUEUE_SETUP, mmap() on the device file maps an
+ * esp_queue_ring followed by the descriptor array (sq) and the completion array
+ * (cq). Descriptors have the layout of the argument of the accelerator-specific
+ * access ioctl. Indices are free running; slot = index & (entries - 1).
+ *
+ * User space fills sq slots, advances sq_tail and calls ESP_IOC_QUEUE_SUBMIT. The
+ * driver chains the runs from its interrupt handler and posts one esp_queue_cqe
+ * per descriptor, in order. A slot may be reused once its completion has been
+ * consumed (cq_head advanced past it). Queued descriptors cannot use P2P and run
+ * with the coherence of the first descriptor of the chain.
+ *
+ * The queue belongs to the open file that set it up. Other opens of the device
+ * get EBUSY from ESP_IOC_QUEUE_SETUP and EINVAL from the other queue calls. When
+ * the owner is released, descriptors that have not started are dropped, the
+ * running one completes, and the ring is freed.
+ */
+struct esp_queue_ring {
+    uint32_t entries;   /* number of slots, power of two */
+    uint32_t desc_size; /* size of one sq slot */
+    uint32_t sq_offset; /* byte offset of the sq array */
+    uint32_t cq_offset; /* byte offset of the cq array */
+    uint32_t sq_head;   /* driver: next descriptor to run */
+    uint32_t sq_tail;   /* user: next descriptor to fill */
+    uint32_t cq_head;   /* user: next completion to consume */
+    uint32_t cq_tail;   /* driver: next completion to post */
+};
+
+struct esp_queue_cqe {
+    uint32_t index; /* sq index of the descriptor */
+    int32_t status; /* 0 or a negative errno */
+};
+
+#define ESP_QUEUE_MAX_ENTRIES 1024
+
+#define ESP_IOC_RUN          _IO('E', 0)
+#define ESP_IOC_FLUSH        _IO('E', 1)
+#define ESP_IOC_QUEUE_SETUP  _IOW('E', 2, unsigned int) /* number of entries */
+#define ESP_IOC_QUEUE_SUBMIT _IO('E', 3)
+#define ESP_IOC_QUEUE_WAIT   _IOW('E', 4, unsigned int) /* cq_tail to wait for */
 
 #ifdef __KERNEL__
 
@@ -47,6 +85,9 @@ struct esp_access {
     #include <linux/mutex.h>
     #include <linux/cdev.h>
     #include <linux/list.h>
+    #include <linux/spinlock.h>
+    #include <linux/wait.h>
+    #include <linux/workqueue.h>
 
     // TO DO do not hard-code this values
     #define N_MEM              8
@@ -62,6 +103,7 @@ struct esp_driver {
     /* the below are filled in by drivers */
     struct platform_driver plat;
     bool (*xfer_input_ok)(struct esp_device *esp, void *arg);
+    /* also called from the IRQ handler when chaining queued descriptors */
     void (*prep_xfer)(struct esp_device *esp, void *arg);
     unsigned int ioctl_cm;
     size_t arg_size;
@@ -87,6 +129,21 @@ struct esp_device {
     unsigned int ddr_node;
     unsigned int in_place;
     unsigned int reuse_factor;
+    /* descriptor queue, see ESP_IOC_QUEUE_SETUP */
+    spinlock_t queue_lock;
+    wait_queue_head_t queue_wq;
+    struct work_struct queue_work;
+    struct work_struct queue_put_work;
+    struct file *queue_file;           /* owner of the queue */
+    struct esp_queue_ring *queue;      /* shared with user space */
+    void *queue_desc;                  /* validated copies of the sq slots */
+    struct contig_desc **queue_contig; /* contig of each validated slot, referenced */
+    unsigned int queue_entries;
+    unsigned int queue_put;            /* end of the slots whose contig was put */
+    unsigned int queue_head;           /* next descriptor to run */
+    unsigned int queue_ready;          /* end of the validated descriptors */
+    unsigned int queue_done;           /* completions posted */
+    bool queue_running;
 };
 
 struct esp_status {
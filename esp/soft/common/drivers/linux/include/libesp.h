@@ -6,6 +6,7 @@
 #ifndef __ESPLIB_H__
 #define __ESPLIB_H__
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <math.h>
 #include <pthread.h>
@@ -45,20 +46,84 @@ typedef struct esp_accelerator_thread_info {
 
 typedef struct buf2handle_node {
     void *buf;
+    size_t size;
     contig_handle_t *handle;
     enum contig_alloc_policy policy;
-    struct buf2handle_node *next;
+    struct buf2handle_granule *granules;
 } buf2handle_node;
 
+/* Sub-allocator on top of a single contig buffer, see esp_arena_create() */
+typedef struct esp_arena {
+    void *base;
+    size_t size;
+    size_t used;
+    pthread_mutex_t lock;
+} esp_arena_t;
+
 struct thread_args {
     esp_thread_info_t *info;
     unsigned nacc;
 };
 
+/* Asynchronous invocation, see esp_submit() */
+typedef struct esp_request esp_request_t;
+typedef void (*esp_callback_t)(void *arg);
+
+/* Descriptor queue of one device, see esp_queue_open() */
+typedef struct esp_queue esp_queue_t;
+
 void *esp_alloc_policy(struct contig_alloc_params params, size_t size);
 void *esp_alloc(size_t size);
 void esp_run_parallel(esp_thread_info_t *cfg[], unsigned nthreads, unsigned *nacc);
 void esp_run(esp_thread_info_t cfg[], unsigned nacc);
 void esp_free(void *buf);
+size_t esp_offset(void *buf);
+
+/*
+ * An arena is one esp_alloc() buffer carved into sub-buffers by a bump pointer.
+ * Sub-buffers can be passed to esp_run() like any other buffer: use esp_offset()
+ * to get their offset in the arena for the src/dst offsets of the accelerator.
+ * They are released all at once by esp_arena_reset() or esp_arena_destroy().
+ * esp_arena_create() returns NULL if the arena or its buffer cannot be allocated.
+ */
+esp_arena_t *esp_arena_create(size_t size);
+void *esp_arena_alloc(esp_arena_t *arena, size_t size);
+void esp_arena_reset(esp_arena_t *arena);
+void esp_arena_destroy(esp_arena_t *arena);
+
+/*
+ * esp_submit() hands the nacc invocations in cfg[] to a pool with one persistent
+ * worker thread per device, which keeps the device file open, and returns right
+ * away. Invocations on different devices run concurrently, those on the same
+ * device in submission order. When all of them are done, cb (if not NULL) is
+ * called with arg from a worker thread.
+ *
+ * esp_submit() returns NULL if the request cannot be allocated. Every request
+ * must be released with esp_wait(), which blocks until it is done and returns 0,
+ * or -1 if any invocation failed. esp_poll() tells whether a request is done
+ * without blocking. esp_cleanup() stops the workers.
+ */
+esp_request_t *esp_submit(esp_thread_info_t cfg[], unsigned nacc, esp_callback_t cb, void *arg);
+int esp_wait(esp_request_t *req);
+bool esp_poll(esp_request_t *req);
+void esp_cleanup();
+
+/*
+ * esp_queue_open() sets up a descriptor queue of @entries slots (a power of two)
+ * on a device, see ESP_IOC_QUEUE_SETUP in esp.h. esp_queue_submit() copies one
+ * descriptor, laid out like the argument of the access ioctl of the device, into
+ * the next slot and hands it to the driver, which starts it from the interrupt
+ * of the previous one. The sq index of the descriptor is returned in @index.
+ * A full queue fails with errno set to ENOSPC until a completion is consumed.
+ *
+ * esp_queue_wait() blocks until descriptor @index has run and consumes its
+ * completion along with the ones before it. It returns 0, or the negative errno
+ * of the first of them that failed. A queue must not be used by more than one
+ * thread at a time.
+ */
+esp_queue_t *esp_queue_open(const char *devname, unsigned entries);
+int esp_queue_submit(esp_queue_t *q, const void *desc, unsigned *index);
+int esp_queue_wait(esp_queue_t *q, unsigned index);
+void esp_queue_close(esp_queue_t *q);
 
 #endif /* __ESPLIB_H__ */
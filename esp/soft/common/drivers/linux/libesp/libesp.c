@@ -5,54 +5,139 @@
 
 #include "libesp.h"
 
-buf2handle_node *head = NULL;
+/*
+ * Buffer registry. Every buffer is indexed under each 1 MB granule of address
+ * space it overlaps, so that interior pointers resolve with one hash lookup and
+ * a scan of the few buffers sharing that granule.
+ */
+#define REGISTRY_SHIFT 20
+#define REGISTRY_BITS  10
+
+struct buf2handle_granule {
+    uintptr_t granule;
+    buf2handle_node *node;
+    struct buf2handle_granule *next;
+};
 
-void insert_buf(void *buf, contig_handle_t *handle, enum contig_alloc_policy policy)
+static struct buf2handle_granule *registry[1 << REGISTRY_BITS];
+static pthread_rwlock_t registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static unsigned registry_hash(uintptr_t granule)
+{
+    return (granule * 0x9e3779b97f4a7c15ULL) >> (64 - REGISTRY_BITS);
+}
+
+static uintptr_t granule_first(buf2handle_node *node)
+{
+    return (uintptr_t)node->buf >> REGISTRY_SHIFT;
+}
+
+static uintptr_t granule_last(buf2handle_node *node)
+{
+    return ((uintptr_t)node->buf + (node->size ? node->size - 1 : 0)) >> REGISTRY_SHIFT;
+}
+
+int insert_buf(void *buf, size_t size, contig_handle_t *handle, enum contig_alloc_policy policy)
 {
     buf2handle_node *new = malloc(sizeof(buf2handle_node));
-    new->buf             = buf;
-    new->handle          = handle;
-    new->policy          = policy;
+    uintptr_t g, first;
+
+    if (new == NULL) return -1;
+
+    new->buf    = buf;
+    new->size   = size;
+    new->handle = handle;
+    new->policy = policy;
+
+    first         = granule_first(new);
+    new->granules = malloc((granule_last(new) - first + 1) * sizeof(struct buf2handle_granule));
+    if (new->granules == NULL) {
+        free(new);
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&registry_lock);
+    for (g = first; g <= granule_last(new); g++) {
+        struct buf2handle_granule *entry = &new->granules[g - first];
+        unsigned h                       = registry_hash(g);
 
-    new->next = head;
-    head      = new;
+        entry->granule = g;
+        entry->node    = new;
+        entry->next    = registry[h];
+        registry[h]    = entry;
+    }
+    pthread_rwlock_unlock(&registry_lock);
+
+    return 0;
 }
 
-contig_handle_t *lookup_handle(void *buf, enum contig_alloc_policy *policy)
+/* Called with registry_lock held */
+static buf2handle_node *lookup_node(void *buf)
 {
-    buf2handle_node *cur = head;
-    while (cur != NULL) {
-        if (cur->buf == buf) {
-            if (policy != NULL) *policy = cur->policy;
-            return cur->handle;
-        }
-        cur = cur->next;
+    uintptr_t p       = (uintptr_t)buf;
+    uintptr_t granule = p >> REGISTRY_SHIFT;
+    struct buf2handle_granule *entry;
+
+    for (entry = registry[registry_hash(granule)]; entry != NULL; entry = entry->next) {
+        buf2handle_node *node = entry->node;
+
+        if (entry->granule == granule && p >= (uintptr_t)node->buf &&
+            p - (uintptr_t)node->buf < (node->size ? node->size : 1))
+            return node;
     }
-    die("buf not in active allocations\n");
+    return NULL;
+}
+
+contig_handle_t *lookup_handle(void *buf, enum contig_alloc_policy *policy)
+{
+    buf2handle_node *node;
+
+    pthread_rwlock_rdlock(&registry_lock);
+    node = lookup_node(buf);
+    if (node != NULL && policy != NULL) *policy = node->policy;
+    pthread_rwlock_unlock(&registry_lock);
+
+    if (node == NULL) die("buf not in active allocations\n");
+    return node->handle;
+}
+
+size_t esp_offset(void *buf)
+{
+    buf2handle_node *node;
+
+    pthread_rwlock_rdlock(&registry_lock);
+    node = lookup_node(buf);
+    pthread_rwlock_unlock(&registry_lock);
+
+    if (node == NULL) die("buf not in active allocations\n");
+    return (uintptr_t)buf - (uintptr_t)node->buf;
 }
 
 void remove_buf(void *buf)
 {
-    buf2handle_node *cur = head;
-    if (cur->buf == buf) {
-        head = cur->next;
-        contig_free(*(cur->handle));
-        free(cur);
-        return;
+    buf2handle_node *node;
+    uintptr_t g;
+
+    pthread_rwlock_wrlock(&registry_lock);
+    node = lookup_node(buf);
+    if (node == NULL || node->buf != buf) {
+        pthread_rwlock_unlock(&registry_lock);
+        die("buf not in active allocations\n");
     }
 
-    buf2handle_node *prev;
-    while (cur != NULL && cur->buf != buf) {
-        prev = cur;
-        cur  = cur->next;
-    }
+    for (g = granule_first(node); g <= granule_last(node); g++) {
+        struct buf2handle_granule **pp = &registry[registry_hash(g)];
 
-    if (cur == NULL) die("buf not in active allocations\n");
+        while (*pp != NULL && (*pp)->node != node)
+            pp = &(*pp)->next;
+        if (*pp != NULL) *pp = (*pp)->next;
+    }
+    pthread_rwlock_unlock(&registry_lock);
 
-    prev->next = cur->next;
-    contig_free(*(cur->handle));
-    free(cur->handle);
-    free(cur);
+    contig_free(*(node->handle));
+    free(node->handle);
+    free(node->granules);
+    free(node);
 }
 
 bool thread_is_p2p(esp_thread_info_t *thread)
@@ -138,17 +223,41 @@ void *accelerator_thread_serial(void *ptr)
 void *esp_alloc_policy(struct contig_alloc_params params, size_t size)
 {
     contig_handle_t *handle = malloc(sizeof(contig_handle_t));
-    void *contig_ptr        = contig_alloc_policy(params, size, handle);
-    insert_buf(contig_ptr, handle, params.policy);
+    void *contig_ptr;
+
+    if (handle == NULL) return NULL;
+
+    contig_ptr = contig_alloc_policy(params, size, handle);
+    if (contig_ptr == NULL) goto err;
+    if (insert_buf(contig_ptr, size, handle, params.policy)) {
+        contig_free(*handle);
+        goto err;
+    }
     return contig_ptr;
+
+err:
+    free(handle);
+    return NULL;
 }
 
 void *esp_alloc(size_t size)
 {
     contig_handle_t *handle = malloc(sizeof(contig_handle_t));
-    void *contig_ptr        = contig_alloc(size, handle);
-    insert_buf(contig_ptr, handle, CONTIG_ALLOC_PREFERRED);
+    void *contig_ptr;
+
+    if (handle == NULL) return NULL;
+
+    contig_ptr = contig_alloc(size, handle);
+    if (contig_ptr == NULL) goto err;
+    if (insert_buf(contig_ptr, size, handle, CONTIG_ALLOC_PREFERRED)) {
+        contig_free(*handle);
+        goto err;
+    }
     return contig_ptr;
+
+err:
+    free(handle);
+    return NULL;
 }
 
 static void esp_config(esp_thread_info_t *cfg[], unsigned nthreads, unsigned *nacc)
@@ -276,3 +385,395 @@ void esp_run_parallel(esp_thread_info_t *cfg[], unsigned nthreads, unsigned *nac
 }
 
 void esp_free(void *buf) { remove_buf(buf); }
+
+#define ARENA_ALIGN 64
+
+esp_arena_t *esp_arena_create(size_t size)
+{
+    esp_arena_t *arena = malloc(sizeof(esp_arena_t));
+
+    if (arena == NULL) return NULL;
+
+    arena->base = esp_alloc(size);
+    if (arena->base == NULL) {
+        free(arena);
+        return NULL;
+    }
+    arena->size = size;
+    arena->used = 0;
+    pthread_mutex_init(&arena->lock, NULL);
+
+    return arena;
+}
+
+void *esp_arena_alloc(esp_arena_t *arena, size_t size)
+{
+    void *p = NULL;
+    size_t start;
+
+    pthread_mutex_lock(&arena->lock);
+    start = round_up(arena->used, ARENA_ALIGN);
+    if (start <= arena->size && size <= arena->size - start) {
+        p           = (char *)arena->base + start;
+        arena->used = start + size;
+    }
+    pthread_mutex_unlock(&arena->lock);
+
+    return p;
+}
+
+void esp_arena_reset(esp_arena_t *arena)
+{
+    pthread_mutex_lock(&arena->lock);
+    arena->used = 0;
+    pthread_mutex_unlock(&arena->lock);
+}
+
+void esp_arena_destroy(esp_arena_t *arena)
+{
+    esp_free(arena->base);
+    pthread_mutex_destroy(&arena->lock);
+    free(arena);
+}
+
+typedef struct esp_job {
+    esp_thread_info_t *info;
+    esp_request_t *req;
+    struct esp_job *next;
+} esp_job_t;
+
+struct esp_request {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned pending;
+    unsigned errors;
+    bool done;
+    esp_callback_t cb;
+    void *cb_arg;
+    esp_job_t jobs[];
+};
+
+typedef struct esp_worker {
+    char devname[65];
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    esp_job_t *head;
+    esp_job_t *tail;
+    bool quit;
+    struct esp_worker *next;
+} esp_worker_t;
+
+static esp_worker_t *workers        = NULL;
+static pthread_mutex_t workers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void job_done(esp_job_t *job, int rc)
+{
+    esp_request_t *req = job->req;
+    bool last;
+
+    pthread_mutex_lock(&req->lock);
+    if (rc < 0) req->errors++;
+    last = --req->pending == 0;
+    pthread_mutex_unlock(&req->lock);
+
+    if (!last) return;
+
+    /* The waiter may free the request as soon as done is set */
+    if (req->cb) req->cb(req->cb_arg);
+
+    pthread_mutex_lock(&req->lock);
+    req->done = true;
+    pthread_cond_broadcast(&req->cond);
+    pthread_mutex_unlock(&req->lock);
+}
+
+static void *worker_thread(void *ptr)
+{
+    esp_worker_t *w = (esp_worker_t *)ptr;
+
+    for (;;) {
+        struct timespec th_start;
+        struct timespec th_end;
+        esp_job_t *job;
+        int rc;
+
+        pthread_mutex_lock(&w->lock);
+        while (w->head == NULL && !w->quit)
+            pthread_cond_wait(&w->cond, &w->lock);
+        job = w->head;
+        if (job == NULL) {
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+        w->head = job->next;
+        if (w->head == NULL) w->tail = NULL;
+        pthread_mutex_unlock(&w->lock);
+
+        gettime(&th_start);
+        rc = ioctl(w->fd, job->info->ioctl_req, job->info->esp_desc);
+        gettime(&th_end);
+        if (rc < 0) { perror("ioctl"); }
+
+        job->info->fd    = w->fd;
+        job->info->hw_ns = ts_subtract(&th_start, &th_end);
+        job_done(job, rc);
+    }
+
+    return NULL;
+}
+
+/* Called with workers_lock held */
+static esp_worker_t *get_worker(const char *devname)
+{
+    esp_worker_t *w;
+    char path[70];
+
+    for (w = workers; w != NULL; w = w->next)
+        if (!strcmp(w->devname, devname)) return w;
+
+    if (strlen(devname) > 64)
+        die("Error: device name %s exceeds maximum length of 64 characters\n", devname);
+
+    w = calloc(1, sizeof(esp_worker_t));
+    if (w == NULL) die_errno("calloc failed\n");
+    strcpy(w->devname, devname);
+
+    sprintf(path, "/dev/%s", devname);
+    w->fd = open(path, O_RDWR, 0);
+    if (w->fd < 0) die_errno("fopen failed\n");
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, worker_thread, (void *)w) != 0)
+        die_errno("pthread_create failed\n");
+
+    w->next = workers;
+    workers = w;
+    return w;
+}
+
+esp_request_t *esp_submit(esp_thread_info_t cfg[], unsigned nacc, esp_callback_t cb, void *arg)
+{
+    esp_request_t *req = malloc(sizeof(esp_request_t) + nacc * sizeof(esp_job_t));
+    unsigned n         = 0;
+    int i;
+
+    if (req == NULL) return NULL;
+
+    esp_config(&cfg, 1, &nacc);
+
+    pthread_mutex_init(&req->lock, NULL);
+    pthread_cond_init(&req->cond, NULL);
+    req->errors = 0;
+    req->done   = false;
+    req->cb     = cb;
+    req->cb_arg = arg;
+
+    for (i = 0; i < nacc; i++)
+        if (cfg[i].run) n++;
+    req->pending = n;
+
+    if (n == 0) {
+        if (cb) cb(arg);
+        req->done = true;
+        return req;
+    }
+
+    /* Every job is counted in pending before the first one can complete */
+    pthread_mutex_lock(&workers_lock);
+    for (i = 0; i < nacc; i++) {
+        esp_job_t *job = &req->jobs[i];
+        esp_worker_t *w;
+
+        if (!cfg[i].run) continue;
+
+        job->info = &cfg[i];
+        job->req  = req;
+        job->next = NULL;
+
+        w = get_worker(cfg[i].devname);
+        pthread_mutex_lock(&w->lock);
+        if (w->tail) w->tail->next = job;
+        else
+            w->head = job;
+        w->tail = job;
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+    pthread_mutex_unlock(&workers_lock);
+
+    return req;
+}
+
+bool esp_poll(esp_request_t *req)
+{
+    bool done;
+
+    pthread_mutex_lock(&req->lock);
+    done = req->done;
+    pthread_mutex_unlock(&req->lock);
+
+    return done;
+}
+
+int esp_wait(esp_request_t *req)
+{
+    int rc;
+
+    pthread_mutex_lock(&req->lock);
+    while (!req->done)
+        pthread_cond_wait(&req->cond, &req->lock);
+    rc = req->errors ? -1 : 0;
+    pthread_mutex_unlock(&req->lock);
+
+    pthread_cond_destroy(&req->cond);
+    pthread_mutex_destroy(&req->lock);
+    free(req);
+
+    return rc;
+}
+
+void esp_cleanup()
+{
+    esp_worker_t *w;
+
+    pthread_mutex_lock(&workers_lock);
+    while (workers != NULL) {
+        w       = workers;
+        workers = w->next;
+
+        /* Pending jobs are drained before the worker exits */
+        pthread_mutex_lock(&w->lock);
+        w->quit = true;
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, NULL);
+
+        close(w->fd);
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        free(w);
+    }
+    pthread_mutex_unlock(&workers_lock);
+}
+
+struct esp_queue {
+    int fd;
+    struct esp_queue_ring *ring;
+    size_t size;
+    uint8_t *sq;
+    struct esp_queue_cqe *cq;
+};
+
+esp_queue_t *esp_queue_open(const char *devname, unsigned entries)
+{
+    struct esp_queue_ring *ring;
+    esp_queue_t *q;
+    char path[70];
+
+    if (strlen(devname) > 64) {
+        fprintf(stderr, "Error: device name %s exceeds maximum length of 64 characters\n",
+                devname);
+        return NULL;
+    }
+
+    q = calloc(1, sizeof(esp_queue_t));
+    if (q == NULL) return NULL;
+
+    sprintf(path, "/dev/%s", devname);
+    q->fd = open(path, O_RDWR, 0);
+    if (q->fd < 0) {
+        perror("open");
+        goto err_free;
+    }
+
+    if (ioctl(q->fd, ESP_IOC_QUEUE_SETUP, &entries) < 0) {
+        perror("ioctl");
+        goto err_close;
+    }
+
+    /* The header tells how far the sq and cq arrays extend */
+    ring = mmap(NULL, sizeof(*ring), PROT_READ, MAP_SHARED, q->fd, 0);
+    if (ring == MAP_FAILED) {
+        perror("mmap");
+        goto err_close;
+    }
+    q->size = ring->cq_offset + ring->entries * sizeof(struct esp_queue_cqe);
+    munmap(ring, sizeof(*ring));
+
+    q->ring = mmap(NULL, q->size, PROT_READ | PROT_WRITE, MAP_SHARED, q->fd, 0);
+    if (q->ring == MAP_FAILED) {
+        perror("mmap");
+        goto err_close;
+    }
+    q->sq = (uint8_t *)q->ring + q->ring->sq_offset;
+    q->cq = (struct esp_queue_cqe *)((uint8_t *)q->ring + q->ring->cq_offset);
+
+    return q;
+
+err_close:
+    close(q->fd);
+err_free:
+    free(q);
+    return NULL;
+}
+
+int esp_queue_submit(esp_queue_t *q, const void *desc, unsigned *index)
+{
+    struct esp_queue_ring *ring = q->ring;
+    unsigned tail               = ring->sq_tail;
+
+    if (tail - __atomic_load_n(&ring->cq_head, __ATOMIC_RELAXED) >= ring->entries) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    memcpy(q->sq + (tail & (ring->entries - 1)) * ring->desc_size, desc, ring->desc_size);
+
+    /* The driver reads the slot after the tail that publishes it */
+    __atomic_store_n(&ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (ioctl(q->fd, ESP_IOC_QUEUE_SUBMIT) < 0) {
+        perror("ioctl");
+        /* The driver rejected it, so the slot is free again */
+        __atomic_store_n(&ring->sq_tail, tail, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    *index = tail;
+    return 0;
+}
+
+int esp_queue_wait(esp_queue_t *q, unsigned index)
+{
+    struct esp_queue_ring *ring = q->ring;
+    unsigned target             = index + 1;
+    unsigned head               = ring->cq_head;
+    int status                  = 0;
+
+    while ((int)(__atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE) - target) < 0) {
+        if (ioctl(q->fd, ESP_IOC_QUEUE_WAIT, &target) < 0 && errno != EINTR) {
+            perror("ioctl");
+            return -errno;
+        }
+    }
+
+    /* Completions are posted in submission order */
+    for (; (int)(target - head) > 0; head++) {
+        struct esp_queue_cqe *cqe = &q->cq[head & (ring->entries - 1)];
+
+        if (cqe->status && !status) status = cqe->status;
+    }
+    __atomic_store_n(&ring->cq_head, head, __ATOMIC_RELEASE);
+
+    return status;
+}
+
+void esp_queue_close(esp_queue_t *q)
+{
+    munmap(q->ring, q->size);
+    close(q->fd);
+    free(q);
+}
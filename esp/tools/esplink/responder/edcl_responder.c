@@ -0,0 +1,207 @@
+// Copyright (c) 2011-2024 Columbia University, System Level Design Group
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * EDCL responder: answers esplink over UDP the way the GRLIB Ethernet
+ * debug link does, on top of a memory buffer, to test and benchmark
+ * esplink without an FPGA. Packets are taken in sequence order; an out
+ * of order packet is dropped and answered with a NACK carrying the
+ * sequence number expected. Requests and replies can be lost at random
+ * and replies delayed, to mimic a real link.
+ *
+ * Build esplink with -DESPLINK_IP=\"127.0.0.1\" -DPORT=<port> -DLOCAL_PORT=0
+ * (make esplink-local) to talk to it.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define NWORD_MAX  27
+#define BUFSIZE    (10 + 4 * NWORD_MAX)
+#define BATCH      64
+#define SEQ_MASK   0x3fff
+
+typedef unsigned char u8;
+typedef unsigned u32;
+typedef unsigned long long u64;
+
+static u32 port      = 46393;
+static u32 base      = 0x80000000;
+static u32 size      = 64 << 20;
+static u32 loss      = 0; // per mille
+static u32 delay     = 0; // us
+static u32 buffer    = BATCH;
+static u8 *mem;
+
+static u64 requests;
+static u64 nacks;
+static u64 dropped;
+
+static void die(char *s)
+{
+    perror(s);
+    exit(EXIT_FAILURE);
+}
+
+static void print_stats(int sig)
+{
+    printf("\n%llu requests, %llu NACKs, %llu packets dropped\n", requests, nacks, dropped);
+    exit(EXIT_SUCCESS);
+}
+
+static int lost(void) { return loss && (u32)(rand() % 1000) < loss; }
+
+static u32 get_sequence(u8 *m) { return ((((u32)m[2]) << 8) | m[3]) >> 2; }
+static u32 get_write(u8 *m) { return (m[3] >> 1) & 0x1; }
+static u32 get_length(u8 *m) { return ((m[3] & 0x1) << 9) | (m[4] << 1) | (m[5] >> 7); }
+static u32 get_address(u8 *m)
+{
+    return (((u32)m[6]) << 24) | (((u32)m[7]) << 16) | (((u32)m[8]) << 8) | m[9];
+}
+
+static void set_header(u8 *m, u32 sequence, u32 nack)
+{
+    m[2] = (u8)(sequence >> 6);
+    m[3] = (u8)((sequence << 2) | (nack << 1) | (m[3] & 0x1));
+}
+
+// Bytes of [address, address + length) inside the emulated memory
+static u8 *lookup(u32 address, u32 length)
+{
+    if (address < base || address - base > size || length > size - (address - base))
+        return NULL;
+    return &mem[address - base];
+}
+
+static void print_usage(char *exe)
+{
+    printf("Usage: %s [-p port] [-a base] [-s size] [-l loss] [-d delay] [-b buffer]\n", exe);
+    printf("  -p  UDP port (default %u)\n", port);
+    printf("  -a  base address of the memory (default 0x%08x)\n", base);
+    printf("  -s  memory size in Bytes (default %u)\n", size);
+    printf("  -l  packets lost, per mille (default 0)\n");
+    printf("  -d  reply latency in us (default 0)\n");
+    printf("  -b  packets taken at once, the rest is dropped (default %d)\n", BATCH);
+}
+
+int main(int argc, char *argv[])
+{
+    static u8 buf[BATCH][BUFSIZE];
+    static struct sockaddr_in addr[BATCH];
+    static struct iovec iov_rcv[BATCH], iov_snd[BATCH];
+    static struct mmsghdr msg_rcv[BATCH], msg_snd[BATCH];
+    struct sockaddr_in serv_addr;
+    u32 expected = 0;
+    int opt, s, r, i;
+
+    while ((opt = getopt(argc, argv, "p:a:s:l:d:b:h")) != -1) {
+        switch (opt) {
+            case 'p': port = strtoul(optarg, NULL, 0); break;
+            case 'a': base = strtoul(optarg, NULL, 0); break;
+            case 's': size = strtoul(optarg, NULL, 0); break;
+            case 'l': loss = strtoul(optarg, NULL, 0); break;
+            case 'd': delay = strtoul(optarg, NULL, 0); break;
+            case 'b': buffer = strtoul(optarg, NULL, 0); break;
+            case 'h': print_usage(argv[0]); exit(EXIT_SUCCESS);
+            default: print_usage(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+
+    if (buffer < 1 || buffer > BATCH) buffer = BATCH;
+
+    mem = calloc(size, 1);
+    if (!mem) die("calloc");
+
+    if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1) die("socket");
+
+    memset((char *)&serv_addr, 0, sizeof(struct sockaddr_in));
+    serv_addr.sin_family      = AF_INET;
+    serv_addr.sin_port        = htons(port);
+    serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(s, (struct sockaddr *)&serv_addr, sizeof(struct sockaddr_in)) == -1) die("bind");
+
+    for (i = 0; i < BATCH; i++) {
+        iov_rcv[i].iov_base            = buf[i];
+        iov_rcv[i].iov_len             = BUFSIZE;
+        msg_rcv[i].msg_hdr.msg_iov     = &iov_rcv[i];
+        msg_rcv[i].msg_hdr.msg_iovlen  = 1;
+        msg_rcv[i].msg_hdr.msg_name    = &addr[i];
+        iov_snd[i].iov_base            = buf[i];
+        msg_snd[i].msg_hdr.msg_iov     = &iov_snd[i];
+        msg_snd[i].msg_hdr.msg_iovlen  = 1;
+        msg_snd[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+
+    signal(SIGINT, print_stats);
+    signal(SIGTERM, print_stats);
+
+    printf("EDCL responder on port %u, %u Bytes at %08x\n", port, size, base);
+
+    while (1) {
+        int nsnd = 0;
+
+        for (i = 0; i < BATCH; i++)
+            msg_rcv[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+
+        r = recvmmsg(s, msg_rcv, BATCH, MSG_WAITFORONE, NULL);
+        if (r == -1) die("recvmmsg()");
+
+        for (i = 0; i < r; i++) {
+            u8 *m       = buf[i];
+            u32 length  = get_length(m);
+            u32 address = get_address(m);
+            u32 reply   = 10;
+            u8 *p;
+
+            if (msg_rcv[i].msg_len < 10 || i >= buffer || lost()) {
+                dropped++;
+                continue;
+            }
+            requests++;
+
+            if (get_sequence(m) != expected) {
+                set_header(m, expected, 1);
+                nacks++;
+            }
+            else {
+                if (length > 4 * NWORD_MAX) length = 4 * NWORD_MAX;
+                p = lookup(address, length);
+                if (get_write(m)) {
+                    if (p && msg_rcv[i].msg_len >= 10 + length) memcpy(p, &m[10], length);
+                }
+                else {
+                    if (p) memcpy(&m[10], p, length);
+                    else
+                        memset(&m[10], 0, length);
+                    reply += length;
+                }
+                set_header(m, expected, 0);
+                expected = (expected + 1) & SEQ_MASK;
+            }
+
+            if (lost()) {
+                dropped++;
+                continue;
+            }
+
+            // Replies go out in place, in the order requests came in
+            iov_snd[nsnd].iov_base          = m;
+            iov_snd[nsnd].iov_len           = reply;
+            msg_snd[nsnd].msg_hdr.msg_name  = &addr[i];
+            nsnd++;
+        }
+
+        if (delay) usleep(delay);
+
+        for (i = 0; i < nsnd; i += r)
+            if ((r = sendmmsg(s, &msg_snd[i], nsnd - i, 0)) == -1) die("sendmmsg()");
+    }
+
+    return 0;
+}
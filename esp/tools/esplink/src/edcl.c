@@ -1,5 +1,6 @@
 // Copyright (c) 2011-2024 Columbia University, System Level Design Group
 // SPDX-License-Identifier: Apache-2.0
+#define _GNU_SOURCE
 #include "edcl.h"
 
 // Helper functions
@@ -32,14 +33,6 @@ static void set_offset(u8 *_m, u32 _x)
     _m[1] = (u8)(_x >> 0);
 }
 
-static u32 get_offset(u8 *_m)
-{
-    u32 _x;
-    _x = ((u32)_m[0]) << 8;
-    _x |= ((u32)_m[1]) << 0;
-    return _x;
-}
-
 void set_sequence(u8 *_m, u32 _x)
 {
     _m[2] = _m[2] | (u8)(0xff & ((_x << 2) >> 8));
@@ -120,100 +113,201 @@ void get_data(u8 *_m, u32 *_x, u32 _n)
     }
 }
 
-static void set_edcl_msg(u8 *buf, edcl_snd_t *msg)
+static u32 set_edcl_msg(u8 *buf, edcl_chunk_t *chunk, u32 sequence, u32 write)
 {
-    set_offset(buf, msg->offset);
-    set_sequence(buf, msg->sequence);
-    set_write(buf, msg->write);
-    set_length(buf, msg->length);
-    set_address(buf, msg->address);
-    if (msg->write) set_data(buf, msg->data, msg->length / 4);
-    msg->msglen = 10 + (msg->write * msg->length);
-}
-
-static void get_edcl_msg(u8 *buf, edcl_rcv_t *msg)
-{
-    msg->offset   = get_offset(buf);
-    msg->sequence = get_sequence(buf);
-    msg->nack     = get_nack(buf);
-    msg->length   = get_length(buf);
-    msg->address  = get_address(buf);
-    get_data(buf, msg->data, msg->length / 4);
-    msg->msglen = 10 + msg->length;
+    memset(buf, 0, 10);
+    set_offset(buf, 0);
+    set_sequence(buf, sequence);
+    set_write(buf, write);
+    set_length(buf, chunk->length);
+    set_address(buf, chunk->address);
+    if (write) set_data(buf, chunk->data, NWORDS(chunk->length));
+    return 10 + (write * chunk->length);
 }
 
 struct sockaddr_in serv_addr, cli_addr;
 static int s;
 
-static void handle_edcl_message(edcl_snd_t *snd, edcl_rcv_t *rcv)
+static u32 window = EDCL_WINDOW;
+
+// Sequence number expected by the EDCL, confirmed once an ACK comes back
+static u32 sequence;
+static int synced;
+
+// Preallocated packets for sendmmsg() and recvmmsg()
+static u8 buf_snd[EDCL_WINDOW_MAX][BUFSIZE_MAX_SND];
+static u8 buf_rcv[EDCL_WINDOW_MAX][BUFSIZE_MAX_SND];
+static struct iovec iov_snd[EDCL_WINDOW_MAX];
+static struct iovec iov_rcv[EDCL_WINDOW_MAX];
+static struct mmsghdr msg_snd[EDCL_WINDOW_MAX];
+static struct mmsghdr msg_rcv[EDCL_WINDOW_MAX];
+
+enum { CHUNK_PENDING = 0, CHUNK_SENT, CHUNK_DONE };
+
+// The EDCL took the first k packets in flight: writes are done, reads
+// whose reply got lost go again. Returns the Bytes completed.
+static u64 retire(edcl_chunk_t *chunk, u8 *state, u32 *flight, u32 k, u32 write)
+{
+    u64 bytes = 0;
+    u32 i;
+
+    for (i = 0; i < k; i++) {
+        if (write) {
+            state[flight[i]] = CHUNK_DONE;
+            bytes += chunk[flight[i]].length;
+        }
+        else {
+            state[flight[i]] = CHUNK_PENDING;
+        }
+    }
+
+    return bytes;
+}
+
+/*
+ * Transfer n chunks keeping up to `window` packets in flight. The EDCL
+ * takes packets in sequence order and answers each one with an ACK, or
+ * with a NACK carrying the sequence number it expects. An ACK thus also
+ * accounts for the packets sent before it, and a NACK tells where the
+ * EDCL stopped: everything after that is sent again with new sequence
+ * numbers. Until an ACK confirms the sequence number, after a resync or
+ * a timeout, one packet at a time is sent.
+ */
+static void edcl_transfer(edcl_chunk_t *chunk, u32 n, u32 write, const char *prefix)
 {
+    u8 *state = calloc(n ? n : 1, sizeof(u8));
+    u32 flight[EDCL_WINDOW_MAX];
+    u32 nflight   = 0;
+    u32 first_seq = sequence; // sequence number of flight[0]
+    u32 iter      = 0;
+    u32 base      = 0; // chunks before base are done
+    u64 total     = 0;
+    u64 progress  = 0;
+    u64 percent   = 101;
+    u32 i, j, k;
+    int r;
+
+    if (!state) die("calloc");
+
+    for (i = 0; i < n; i++)
+        total += chunk[i].length;
+
+    while (base < n) {
+        u32 w    = synced ? window : 1;
+        u32 nsnd = 0;
+
+        if (nflight == 0) first_seq = sequence;
+
+        // Fill the window, lowest chunks first
+        for (i = base; i < n && nflight < w; i++) {
+            if (state[i] != CHUNK_PENDING) continue;
+
+            iov_snd[nsnd].iov_len = set_edcl_msg(buf_snd[nsnd], &chunk[i], sequence, write);
 #ifdef VERBOSE
-    int i = 0;
+            printf("Sending sequence %u address %08x\n", sequence, chunk[i].address);
 #endif
-    int iter       = 0;
-    u8 *buf_snd    = malloc(BUFSIZE_MAX_SND * sizeof(u8));
-    u8 *buf_rcv    = malloc(BUFSIZE_MAX_RCV * sizeof(u8));
-    socklen_t clen = sizeof(struct sockaddr_in);
+            sequence          = (sequence + 1) & EDCL_SEQ_MASK;
+            state[i]          = CHUNK_SENT;
+            flight[nflight++] = i;
+            nsnd++;
+        }
 
-    // Prepare Ethernet packet payload
-    set_edcl_msg(buf_snd, snd);
+        for (i = 0; i < nsnd; i += r)
+            if ((r = sendmmsg(s, &msg_snd[i], nsnd - i, 0)) == -1) die("sendmmsg()");
+
+        r = recvmmsg(s, msg_rcv, EDCL_WINDOW_MAX, MSG_WAITFORONE, NULL);
+        if (r == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) die("recvmmsg()");
+
+            // Send again whatever did not come back
+            printf("\ntimeout, retrying...\n");
+            for (i = 0; i < nflight; i++)
+                state[flight[i]] = CHUNK_PENDING;
+            sequence = first_seq;
+            synced   = 0;
+            nflight  = 0;
+            continue;
+        }
+
+        for (j = 0; j < r; j++) {
+            u8 *buf = buf_rcv[j];
+            u32 seq = get_sequence(buf);
+
+            if (msg_rcv[j].msg_len < 10) continue;
+
+            k = (seq - first_seq) & EDCL_SEQ_MASK;
 
-    while (1) {
 #ifdef VERBOSE
-        // Print message payload
-        printf("Sending payload: ");
-        for (i = 0; i < snd->msglen; i++)
-            printf("%02x ", buf_snd[i]);
-        printf("\n");
+            printf("Receiving %s sequence %u\n", get_nack(buf) ? "NACK" : "ACK", seq);
 #endif
-retry:
-        // send the message
-        if (sendto(s, buf_snd, snd->msglen, 0, (struct sockaddr *)&serv_addr,
-                   sizeof(struct sockaddr_in)) == -1)
-            die("sendto()");
-
-        /* if (!snd->write) { */
-        // clear the buffer by filling null, it might have previously received data
-        memset(buf_rcv, '\0', BUFSIZE_MAX_RCV);
-
-        // try to receive some data, this is a blocking call
-        if (recvfrom(s, buf_rcv, BUFSIZE_MAX_RCV, 0, (struct sockaddr *)&cli_addr, &clen) == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                printf("\ntimeout, retrying...\n");
-                goto retry;
+            if (!get_nack(buf)) {
+                edcl_chunk_t *c;
+
+                // Late replies to packets already sent again are dropped
+                if (k >= nflight) continue;
+                c = &chunk[flight[k]];
+                if (get_address(buf) != c->address) continue;
+                if (!write) {
+                    if (msg_rcv[j].msg_len < 10 + c->length) continue;
+                    get_data(buf, c->data, NWORDS(c->length));
+                }
+
+                progress += retire(chunk, state, flight, k, write) + c->length;
+                state[flight[k]] = CHUNK_DONE;
+                nflight -= k + 1;
+                memmove(flight, &flight[k + 1], nflight * sizeof(u32));
+                first_seq = (seq + 1) & EDCL_SEQ_MASK;
+                synced    = 1;
+                iter      = 0;
             }
             else {
-                die("recvfrom()");
+                // Packets sent before the last resync keep NACKing the
+                // sequence number it resumed from
+                if (!synced && seq == (nflight ? first_seq : sequence)) continue;
+
+                if (synced && k <= nflight) progress += retire(chunk, state, flight, k, write);
+                else
+                    k = 0;
+
+                for (i = k; i < nflight; i++)
+                    state[flight[i]] = CHUNK_PENDING;
+                sequence = seq;
+                synced   = 0;
+                nflight  = 0;
+
+                if (++iter > 10) die("Error: Handle EDCL message failed after 10 attempts");
             }
         }
 
-        get_edcl_msg(buf_rcv, rcv);
+        while (base < n && state[base] == CHUNK_DONE)
+            base++;
 
-#ifdef VERBOSE
-        // Print received message payload
-        printf("Receiving payload: ");
-        for (i = 0; i < rcv->msglen; i++)
-            printf("%02x ", buf_rcv[i]);
-        printf("\n");
-#endif
-        // Resend if necessary
-        if (rcv->nack) {
-            snd->sequence = rcv->sequence;
-            set_sequence(buf_snd, snd->sequence);
-            iter++;
-        }
-        else {
-            break;
+        if (prefix && progress * 100 / total != percent) {
+            percent = progress * 100 / total;
+            print_progress(progress, total, prefix);
         }
+    }
 
-        if (iter > 10) die("Error: Handle EDCL message failed after 10 attempts");
-        /* } else { */
-        /* 	break; */
-        /* } */
+    free(state);
+}
+
+// Cut [address, address + size) in chunks of at most max Bytes
+static edcl_chunk_t *split(u32 address, u32 size, u32 *data, u32 max, u32 *n)
+{
+    edcl_chunk_t *chunk;
+    u32 i;
+
+    *n    = (size + max - 1) / max;
+    chunk = malloc((*n ? *n : 1) * sizeof(edcl_chunk_t));
+    if (!chunk) die("malloc");
+
+    for (i = 0; i < *n; i++) {
+        chunk[i].address = address + i * max;
+        chunk[i].length  = size - i * max < max ? size - i * max : max;
+        chunk[i].data    = data + i * (max / 4);
     }
 
-    free(buf_snd);
-    free(buf_rcv);
+    return chunk;
 }
 
 /* static void clear_rcv_edcl() */
@@ -238,6 +332,8 @@ void die(char *s)
 
 void connect_edcl(const char *server)
 {
+    u32 i;
+
     /* printf("Connect ESPLink\n"); */
 
     // Open socket
@@ -257,96 +353,115 @@ void connect_edcl(const char *server)
     // Configure client address
     memset((char *)&cli_addr, 0, sizeof(struct sockaddr_in));
     cli_addr.sin_family      = AF_INET;
-    cli_addr.sin_port        = htons(PORT);
+    cli_addr.sin_port        = htons(LOCAL_PORT);
     cli_addr.sin_addr.s_addr = htonl(INADDR_ANY);
     if (bind(s, (struct sockaddr *)&cli_addr, sizeof(struct sockaddr_in)) == -1) die("bind");
+
+    for (i = 0; i < EDCL_WINDOW_MAX; i++) {
+        iov_snd[i].iov_base            = buf_snd[i];
+        msg_snd[i].msg_hdr.msg_name    = &serv_addr;
+        msg_snd[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msg_snd[i].msg_hdr.msg_iov     = &iov_snd[i];
+        msg_snd[i].msg_hdr.msg_iovlen  = 1;
+        iov_rcv[i].iov_base            = buf_rcv[i];
+        iov_rcv[i].iov_len             = BUFSIZE_MAX_SND;
+        msg_rcv[i].msg_hdr.msg_iov     = &iov_rcv[i];
+        msg_rcv[i].msg_hdr.msg_iovlen  = 1;
+    }
+}
+
+void set_window(u32 w)
+{
+    if (w < 1 || w > EDCL_WINDOW_MAX) {
+        fprintf(stderr, "Window must be between 1 and %d packets\n", EDCL_WINDOW_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    window = w;
 }
 
 void load_memory(char *fname)
 {
-    edcl_snd_t *snd = malloc(sizeof(edcl_snd_t));
-    edcl_rcv_t *rcv = malloc(sizeof(edcl_rcv_t));
+    edcl_chunk_t *chunk = NULL;
+    u32 *data           = NULL;
+    u32 n               = 0;
+    u32 max             = 0;
     u32 i;
     int r;
     u32 addr;
     FILE *fp = fopen(fname, "r");
     if (!fp) die("fopen");
 
-    // First packet
-    snd->offset   = 0;
-    snd->sequence = 0x0;
-    snd->write    = 1;
-
+    // One packet per NWORD_MAX_SND lines, at the address of the first one
     while (1) {
-        r = fscanf(fp, "%08x %08x\n", &snd->address, &snd->data[0]);
+        u32 *d;
+
+        if (n == max) {
+            max   = max ? 2 * max : 1024;
+            chunk = realloc(chunk, max * sizeof(edcl_chunk_t));
+            data  = realloc(data, max * MAX_SND_SZ);
+            if (!chunk || !data) die("realloc");
+        }
+
+        d = &data[n * NWORD_MAX_SND];
+        r = fscanf(fp, "%08x %08x\n", &chunk[n].address, &d[0]);
 
         if (r == EOF) break;
 
         if (r != 2) die("fscanf");
 
         for (i = 1; i < NWORD_MAX_SND; i++) {
-            r = fscanf(fp, "%08x %08x\n", &addr, &snd->data[i]);
+            r = fscanf(fp, "%08x %08x\n", &addr, &d[i]);
             if (r == EOF) break;
             if (r != 2) die("fscanf");
         }
 
-        snd->length = i * 4;
+        chunk[n++].length = i * 4;
+    }
 
-        handle_edcl_message(snd, rcv);
+    for (i = 0; i < n; i++)
+        chunk[i].data = &data[i * NWORD_MAX_SND];
 
-        snd->sequence++;
-    }
+    edcl_transfer(chunk, n, 1, NULL);
 
     fclose(fp);
-    free(snd);
-    free(rcv);
+    free(chunk);
+    free(data);
 }
 
 void dump_memory(u32 address, u32 size, char *fname)
 {
-    edcl_snd_t *snd = malloc(sizeof(edcl_snd_t));
-    edcl_rcv_t *rcv = malloc(sizeof(edcl_rcv_t));
-    u32 rem         = size;
-    u32 i;
+    u32 *buf = malloc(NWORDS(size) * sizeof(u32));
+    edcl_chunk_t *chunk;
+    u32 n;
+    u32 i, j;
     FILE *fp = fopen(fname, "w+");
     if (!fp) die("fopen");
+    if (!buf) die("malloc");
 
-    // First packet
-    snd->offset   = 0;
-    snd->sequence = 0x0;
-    snd->write    = 0;
-    snd->length   = size < MAX_RCV_SZ ? size : MAX_RCV_SZ;
-    snd->address  = address;
-
-    while (rem > 0) {
-        handle_edcl_message(snd, rcv);
+    chunk = split(address, size, buf, MAX_RCV_SZ, &n);
+    edcl_transfer(chunk, n, 0, NULL);
 
-        for (i = 0; i < snd->length / 4; i++) {
-            u32 addr = rcv->address + i * 4;
-            u32 data = rcv->data[i];
+    for (j = 0; j < n; j++) {
+        for (i = 0; i < chunk[j].length / 4; i++) {
+            u32 addr = chunk[j].address + i * 4;
+            u32 data = chunk[j].data[i];
             fprintf(fp, "%08x %08x\n", addr, data);
         }
-
-        rem -= snd->length;
-
-        snd->sequence++;
-        snd->address += snd->length;
-        snd->length = rem < MAX_RCV_SZ ? rem : MAX_RCV_SZ;
     }
 
     fclose(fp);
-    free(snd);
-    free(rcv);
+    free(chunk);
+    free(buf);
 }
 
 void load_memory_bin(u32 base_addr, char *fname)
 {
-    edcl_snd_t *snd = malloc(sizeof(edcl_snd_t));
-    edcl_rcv_t *rcv = malloc(sizeof(edcl_rcv_t));
-    FILE *fp        = fopen(fname, "rb");
+    FILE *fp = fopen(fname, "rb");
+    edcl_chunk_t *chunk;
+    u32 *data;
+    u32 n;
     size_t sz;
-    size_t rem;
-    u32 i = 0;
 
     if (!fp) die("fopen");
 
@@ -354,35 +469,20 @@ void load_memory_bin(u32 base_addr, char *fname)
     fseek(fp, 0L, SEEK_END);
     sz = ftell(fp);
     rewind(fp);
-    rem = sz;
-
-    // First packet
-    snd->offset   = 0;
-    snd->sequence = 0x0;
-    snd->write    = 1;
-    snd->address  = base_addr;
-    snd->length   = rem < MAX_SND_SZ ? rem : MAX_SND_SZ;
-
-    while (rem > 0) {
-        if (lefread(&snd->data[0], sizeof(u32), snd->length / sizeof(u32), fp) !=
-            snd->length / sizeof(u32))
-            die("fread");
 
-        handle_edcl_message(snd, rcv);
+    data = calloc(NWORDS(sz) + 1, sizeof(u32));
+    if (!data) die("calloc");
 
-        rem -= snd->length;
-        i += snd->length / sizeof(u32);
+    if (lefread(data, sizeof(u32), sz / sizeof(u32), fp) != sz / sizeof(u32)) die("fread");
+    if (lefread(&data[sz / sizeof(u32)], 1, sz % sizeof(u32), fp) != sz % sizeof(u32))
+        die("fread");
 
-        print_progress(sz - rem, sz, "loading binary");
-
-        snd->address += snd->length;
-        snd->length = rem < MAX_SND_SZ ? rem : MAX_SND_SZ;
-        snd->sequence++;
-    }
+    chunk = split(base_addr, sz, data, MAX_SND_SZ, &n);
+    edcl_transfer(chunk, n, 1, "loading binary");
 
     fclose(fp);
-    free(snd);
-    free(rcv);
+    free(chunk);
+    free(data);
 
     /* clear_rcv_edcl(); */
     printf("Loaded %zu Bytes at %08x\n", sz, base_addr);
@@ -390,116 +490,59 @@ void load_memory_bin(u32 base_addr, char *fname)
 
 void dump_memory_bin(u32 address, u32 size, char *fname)
 {
-    edcl_snd_t *snd = malloc(sizeof(edcl_snd_t));
-    edcl_rcv_t *rcv = malloc(sizeof(edcl_rcv_t));
-    u32 rem         = size;
-    FILE *fp        = fopen(fname, "wb+");
+    u32 *data = malloc(NWORDS(size) * sizeof(u32));
+    edcl_chunk_t *chunk;
+    u32 n;
+    u32 j;
+    FILE *fp = fopen(fname, "wb+");
     if (!fp) die("fopen");
+    if (!data) die("malloc");
 
-    // First packet
-    snd->offset   = 0;
-    snd->sequence = 0x0;
-    snd->write    = 0;
-    snd->length   = size < MAX_RCV_SZ ? size : MAX_RCV_SZ;
-    snd->address  = address;
-
-    while (rem > 0) {
-        handle_edcl_message(snd, rcv);
-        fwrite(&rcv->data[0], sizeof(u32), snd->length / sizeof(u32), fp);
+    chunk = split(address, size, data, MAX_RCV_SZ, &n);
+    edcl_transfer(chunk, n, 0, "loading binary");
 
-        rem -= snd->length;
-
-        print_progress(size - rem, size, "loading binary");
-
-        snd->sequence++;
-        snd->address += snd->length;
-        snd->length = rem < MAX_RCV_SZ ? rem : MAX_RCV_SZ;
-    }
+    for (j = 0; j < n; j++)
+        fwrite(chunk[j].data, sizeof(u32), chunk[j].length / sizeof(u32), fp);
 
     fclose(fp);
-    free(snd);
-    free(rcv);
+    free(chunk);
+    free(data);
 
     printf("Dumped %u Bytes starting at %08x\n", size, address);
 }
 
 void reset(u32 addr)
 {
-    edcl_snd_t *snd = malloc(sizeof(edcl_snd_t));
-    edcl_rcv_t *rcv = malloc(sizeof(edcl_rcv_t));
-
-    snd->offset   = 0;
-    snd->sequence = 0x0;
-    snd->write    = 1;
-    snd->address  = addr;
-    snd->data[0]  = 0x1;
-    snd->length   = 4;
+    u32 data           = 0x1;
+    edcl_chunk_t chunk = {addr, 4, &data};
 
     // Reset must be sent twice
-    handle_edcl_message(snd, rcv);
+    edcl_transfer(&chunk, 1, 1, NULL);
     usleep(500000);
 
-    free(snd);
-    free(rcv);
-
-    snd = malloc(sizeof(edcl_snd_t));
-    rcv = malloc(sizeof(edcl_rcv_t));
-
-    snd->offset   = 0;
-    snd->sequence = 0x0;
-    snd->write    = 1;
-    snd->address  = addr;
-    snd->data[0]  = 0x1;
-    snd->length   = 4;
-
-    handle_edcl_message(snd, rcv);
+    edcl_transfer(&chunk, 1, 1, NULL);
     usleep(500000);
 
-    free(snd);
-    free(rcv);
-
     printf("Reset ESP processor cores\n");
 }
 
 void set_word(u32 addr, u32 data)
 {
-    edcl_snd_t *snd = malloc(sizeof(edcl_snd_t));
-    edcl_rcv_t *rcv = malloc(sizeof(edcl_rcv_t));
-
-    // First packet
-    snd->offset   = 0;
-    snd->sequence = 0x0;
-    snd->write    = 1;
-    snd->address  = addr;
-    snd->data[0]  = data;
-    snd->length   = 4;
-
-    handle_edcl_message(snd, rcv);
+    edcl_chunk_t chunk = {addr, 4, &data};
 
-    free(snd);
-    free(rcv);
+    edcl_transfer(&chunk, 1, 1, NULL);
 
     printf("Write %08x at %08x\n", data, addr);
 }
 
 void get_word(u32 addr)
 {
-    edcl_snd_t *snd = malloc(sizeof(edcl_snd_t));
-    edcl_rcv_t *rcv = malloc(sizeof(edcl_rcv_t));
-
-    // First packet
-    snd->offset   = 0;
-    snd->sequence = 0x0;
-    snd->write    = 0;
-    snd->address  = addr;
-    snd->length   = 4;
-
-    handle_edcl_message(snd, rcv);
+    u32 data           = 0;
+    edcl_chunk_t chunk = {addr, 4, &data};
 
-    printf("Read %08x at %08x\n", rcv->data[0], addr);
+    edcl_transfer(&chunk, 1, 0, NULL);
 
-    free(snd);
-    free(rcv);
+    printf("Read %08x at %08x\n", data, addr);
 }
 
 void disconnect_edcl() { close(s); }
@@ -25,6 +25,26 @@
     #define MAX_RCV_SZ      (4 * NWORD_MAX_RCV)
     #define BUFSIZE_MAX_RCV (10 + 4 * NWORD_MAX_RCV)
 
+    #define NWORDS(_len) (((_len) + 3) / 4)
+
+    #define EDCL_SEQ_MASK 0x3fff
+
+/*
+ * Packets kept in flight by the transfer engine. The EDCL takes them in
+ * sequence order and drops what its buffer (CFG_ETH_BUF) cannot hold;
+ * drops are recovered through NACK resync, so a larger window only helps
+ * while the buffer keeps up.
+ */
+    #ifndef EDCL_WINDOW
+        #define EDCL_WINDOW 8
+    #endif
+    #define EDCL_WINDOW_MAX 64
+
+/* Local UDP port, PORT unless the EDCL is emulated on this host */
+    #ifndef LOCAL_PORT
+        #define LOCAL_PORT PORT
+    #endif
+
 typedef unsigned char u8;
 typedef unsigned u32;
 typedef unsigned long long u64;
@@ -42,28 +62,15 @@ typedef enum action {
     DO_RESET
 } action_t;
 
-typedef struct edcl_msg_rcv {
-    u32 offset;
-    u32 sequence;
-    u32 nack;
-    u32 length;
+typedef struct edcl_chunk {
     u32 address;
-    u32 data[NWORD_MAX_RCV];
-    size_t msglen;
-} edcl_rcv_t;
-
-typedef struct edcl_msg_snd {
-    u32 offset;
-    u32 sequence;
-    u32 write;
     u32 length;
-    u32 address;
-    u32 data[NWORD_MAX_SND];
-    size_t msglen;
-} edcl_snd_t;
+    u32 *data;
+} edcl_chunk_t;
 
 void die(char *s);
 void connect_edcl(const char *server);
+void set_window(u32 window);
 void dump_memory(u32 address, u32 size, char *fname);
 void load_memory(char *fname);
 void load_memory_bin(u32 base_addr, char *fname);
@@ -37,7 +37,9 @@ static void print_usage()
     printf("  -o --outfile        Output file.\n");
     printf("  -a --address        Base addres son target.\n");
     printf("  -s --size           Length transfer in Bytes.\n");
-    printf("  -d --data           Single 32-bits word to be written to target register.");
+    printf("  -d --data           Single 32-bits word to be written to target register.\n");
+    printf("  -w --window         Packets in flight, 1 to %d (default %d).", EDCL_WINDOW_MAX,
+           EDCL_WINDOW);
 
     printf("\n\n");
 }
@@ -67,12 +69,13 @@ static long int parse_int(char *str)
 static struct option long_options[] = {
     {"infile", required_argument, 0, 'i'},     {"outfile", required_argument, 0, 'o'},
     {"address", required_argument, 0, 'a'},    {"size", required_argument, 0, 's'},
-    {"data", required_argument, 0, 'd'},       {"help", no_argument, 0, 'h'},
-    {"wrhex", no_argument, 0, DO_WRITE},       {"rdhex", no_argument, 0, DO_READ},
-    {"load", no_argument, 0, DO_WRITE_BIN},    {"dump", no_argument, 0, DO_READ_BIN},
-    {"brom", no_argument, 0, DO_LOAD_BOOTROM}, {"dram", no_argument, 0, DO_LOAD_DRAM},
-    {"regw", no_argument, 0, DO_SET_WORD},     {"regr", no_argument, 0, DO_GET_WORD},
-    {"reset", no_argument, 0, DO_RESET},       {0, 0, 0, 0}};
+    {"data", required_argument, 0, 'd'},       {"window", required_argument, 0, 'w'},
+    {"help", no_argument, 0, 'h'},             {"wrhex", no_argument, 0, DO_WRITE},
+    {"rdhex", no_argument, 0, DO_READ},        {"load", no_argument, 0, DO_WRITE_BIN},
+    {"dump", no_argument, 0, DO_READ_BIN},     {"brom", no_argument, 0, DO_LOAD_BOOTROM},
+    {"dram", no_argument, 0, DO_LOAD_DRAM},    {"regw", no_argument, 0, DO_SET_WORD},
+    {"regr", no_argument, 0, DO_GET_WORD},     {"reset", no_argument, 0, DO_RESET},
+    {0, 0, 0, 0}};
 
 int main(int argc, char *argv[])
 {
@@ -93,13 +96,14 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-    while ((opt = getopt_long(argc, argv, "i:o:a:s:d:h", long_options, &long_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "i:o:a:s:d:w:h", long_options, &long_index)) != -1) {
         switch (opt) {
             case 'i': infile = optarg; break;
             case 'o': outfile = optarg; break;
             case 'a': address = parse_int(optarg); break;
             case 's': size = parse_int(optarg); break;
             case 'd': data = parse_int(optarg); break;
+            case 'w': set_window(parse_int(optarg)); break;
             case 'h':
                 print_usage();
                 exit(EXIT_SUCCESS);
@@ -56,6 +56,22 @@ esplink-fpga-proxy: $(ESP_CFG_BUILD)/esplink.h $(ESPLINK_HDRS) $(ESPLINK_SRCS)
 		-I$(ESP_ROOT)/tools/esplink/src/ -I$(DESIGN_PATH)/$(ESP_CFG_BUILD) \
 		$(ESPLINK_SRCS) -o $@
 
+# esplink against the EDCL responder on this host, to test without an FPGA
+ESPLINK_RESPONDER_PORT ?= 46393
+esplink-local: $(ESP_CFG_BUILD)/esplink.h $(ESPLINK_HDRS) $(ESPLINK_SRCS)
+	$(QUIET_CC) \
+	cd $(ESP_CFG_BUILD); \
+	gcc -O3 -Wall -Werror -fmax-errors=5 \
+		-DESPLINK_IP=\"127.0.0.1\" -DPORT=$(ESPLINK_RESPONDER_PORT) -DLOCAL_PORT=0 \
+		-I$(ESP_ROOT)/tools/esplink/src/ -I$(DESIGN_PATH)/$(ESP_CFG_BUILD) \
+		$(ESPLINK_SRCS) -o $@
+
+esplink-responder: $(ESP_CFG_BUILD) $(ESP_ROOT)/tools/esplink/responder/edcl_responder.c
+	$(QUIET_CC) \
+	cd $(ESP_CFG_BUILD); \
+	gcc -O3 -Wall -Werror -fmax-errors=5 \
+		$(ESP_ROOT)/tools/esplink/responder/edcl_responder.c -o $@
+
 esp-config: $(ESP_CFG_BUILD)/socmap.vhd
 
 esp-xconfig: $(ESP_CFG_BUILD) $(GRLIB_CFG_BUILD)/grlib_config.vhd
@@ -96,4 +112,4 @@ esp-config-distclean:
 config-distclean:
 	$(QUIET_CLEAN)$(RM) $(CFG_BUILD)
 
-.PHONY: esplink esp-xconfig esp-defconfig esp-config-clean esp-config-distclean config-distclean
+.PHONY: esplink esplink-local esplink-responder esp-xconfig esp-defconfig esp-config-clean esp-config-distclean config-distclean